@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/utils/system/system.h>
+
+// This define is required for Windows static linking of libarchive
+#define LIBARCHIVE_STATIC
+#include <archive.h>
+#include <archive_entry.h>
+#include <zstd.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <osquery/carver/carve_stream.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+namespace {
+
+/// Entry data is padded to the tar record size.
+const uint64_t kTarRecordSize{512};
+
+/// The two zero records ending a tar archive.
+const uint64_t kTarTrailerSize{2 * kTarRecordSize};
+
+} // namespace
+
+struct CarveStream::Writer {
+  /// Collect the archive output into the stream's pending bytes.
+  static la_ssize_t append(struct archive*,
+                           void* stream,
+                           const void* buffer,
+                           size_t length) {
+    static_cast<CarveStream*>(stream)->pending_.append(
+        static_cast<const char*>(buffer), length);
+    return static_cast<la_ssize_t>(length);
+  }
+
+  /// Only count the archive output.
+  static la_ssize_t count(struct archive*,
+                          void* size,
+                          const void* buffer,
+                          size_t length) {
+    *static_cast<uint64_t*>(size) += length;
+    return static_cast<la_ssize_t>(length);
+  }
+
+  /**
+   * @brief Create a tar writer passing its output to a callback.
+   *
+   * The writer does not block its output into records, so everything it
+   * writes reaches the callback and the archive is not padded after the
+   * trailer.
+   */
+  static struct archive* create(void* client, archive_write_callback* write) {
+    auto arch = archive_write_new();
+    if (arch == nullptr) {
+      return nullptr;
+    }
+
+    archive_write_set_format_pax_restricted(arch);
+    archive_write_set_bytes_per_block(arch, 0);
+    if (archive_write_open(arch, client, nullptr, write, nullptr) !=
+        ARCHIVE_OK) {
+      archive_write_free(arch);
+      return nullptr;
+    }
+    return arch;
+  }
+
+  static Status writeHeader(struct archive* arch, const Entry& entry) {
+    auto ae = archive_entry_new();
+    archive_entry_set_pathname(ae, entry.name.c_str());
+    archive_entry_set_size(ae, static_cast<la_int64_t>(entry.size));
+    archive_entry_set_filetype(ae, AE_IFREG);
+    archive_entry_set_perm(ae, 0644);
+    auto ret = archive_write_header(arch, ae);
+    archive_entry_free(ae);
+
+    if (ret < ARCHIVE_WARN) {
+      return Status::failure("Failed to write the archive header of " +
+                             entry.name + ": " + archive_error_string(arch));
+    }
+    return Status::success();
+  }
+
+  /**
+   * @brief Get the size of an entry's header.
+   *
+   * The header is written alone by a writer that is then failed, so it does
+   * not pad the entry's data.
+   */
+  static Status headerSize(const Entry& entry, uint64_t& size) {
+    size = 0;
+    auto arch = create(&size, &Writer::count);
+    if (arch == nullptr) {
+      return Status::failure("Failed to create tar archive");
+    }
+
+    auto s = writeHeader(arch, entry);
+    archive_write_fail(arch);
+    archive_write_free(arch);
+    return s;
+  }
+};
+
+CarveStream::CarveStream(const std::set<fs::path>& paths, size_t block_size)
+    : block_size_(std::max<size_t>(block_size, 1)) {
+  for (const auto& path : paths) {
+    Entry entry;
+    entry.source = path;
+    entry.name = path.string();
+    if (path.has_root_name()) {
+      boost::erase_first(entry.name, ":");
+    }
+    entries_.push_back(std::move(entry));
+  }
+}
+
+CarveStream::~CarveStream() {
+  if (archive_ != nullptr) {
+    archive_write_fail(archive_);
+    archive_write_free(archive_);
+  }
+}
+
+Status CarveStream::open() {
+  std::vector<Entry> entries;
+  for (auto& entry : entries_) {
+    // Ensure the file is a flat file on disk before carving
+    PlatformFile file(entry.source, PF_OPEN_EXISTING | PF_READ);
+    if (!file.isValid() || isDirectory(entry.source)) {
+      VLOG(1) << "File does not exist on disk or is subdirectory: "
+              << entry.source;
+      continue;
+    }
+
+    entry.size = file.size();
+    entries.push_back(std::move(entry));
+  }
+  entries_ = std::move(entries);
+
+  size_ = kTarTrailerSize;
+  for (const auto& entry : entries_) {
+    uint64_t header = 0;
+    auto s = Writer::headerSize(entry, header);
+    if (!s.ok()) {
+      return s;
+    }
+
+    auto records = (entry.size + kTarRecordSize - 1) / kTarRecordSize;
+    size_ += header + records * kTarRecordSize;
+  }
+
+  archive_ = Writer::create(this, &Writer::append);
+  if (archive_ == nullptr) {
+    return Status::failure("Failed to create tar archive");
+  }
+
+  buffer_.resize(block_size_);
+  return Status::success();
+}
+
+size_t CarveStream::blocks() const {
+  return static_cast<size_t>((size_ + block_size_ - 1) / block_size_);
+}
+
+Status CarveStream::advance(bool& done) {
+  done = false;
+  if (archive_ == nullptr) {
+    return Status::failure("The carve stream is not open");
+  }
+
+  if (file_ == nullptr) {
+    if (entry_ == entries_.size()) {
+      if (!closed_) {
+        closed_ = true;
+        if (archive_write_close(archive_) != ARCHIVE_OK) {
+          return Status::failure("Failed to close tar archive");
+        }
+      }
+      done = true;
+      return Status::success();
+    }
+
+    const auto& entry = entries_[entry_];
+    file_ = std::make_unique<PlatformFile>(entry.source,
+                                           PF_OPEN_EXISTING | PF_READ);
+    remaining_ = entry.size;
+    return Writer::writeHeader(archive_, entry);
+  }
+
+  ssize_t bytes = 0;
+  if (remaining_ > 0 && file_->isValid()) {
+    auto length = static_cast<size_t>(
+        std::min<uint64_t>(remaining_, static_cast<uint64_t>(block_size_)));
+    bytes = file_->read(buffer_.data(), length);
+  }
+
+  if (bytes > 0) {
+    if (archive_write_data(archive_, buffer_.data(), bytes) < 0) {
+      return Status::failure(std::string("Failed to write tar archive: ") +
+                             archive_error_string(archive_));
+    }
+    remaining_ -= static_cast<uint64_t>(bytes);
+  }
+
+  if (bytes <= 0 || remaining_ == 0) {
+    if (remaining_ > 0) {
+      // The archive pads the rest of the entry, its size was announced.
+      VLOG(1) << "File shrank while carving: " << entries_[entry_].source;
+    }
+
+    if (archive_write_finish_entry(archive_) != ARCHIVE_OK) {
+      return Status::failure("Failed to finish tar archive entry");
+    }
+    file_.reset();
+    entry_++;
+  }
+  return Status::success();
+}
+
+Status CarveStream::finish() {
+  if (produced_ != size_) {
+    return Status::failure("The carve archive is " + std::to_string(produced_) +
+                           " bytes, expected " + std::to_string(size_));
+  }
+
+  if (sha256_.empty()) {
+    sha256_ = hash_.digest();
+  }
+  return Status::success();
+}
+
+Status CarveStream::compress(const fs::path& spool) {
+  auto file = std::make_unique<PlatformFile>(
+      spool, PF_CREATE_ALWAYS | PF_READ | PF_WRITE);
+  if (!file->isValid()) {
+    return Status::failure("Could not open spool file: " + spool.string());
+  }
+
+  std::unique_ptr<ZSTD_CStream, decltype(&ZSTD_freeCStream)> cstream(
+      ZSTD_createCStream(), &ZSTD_freeCStream);
+  if (cstream == nullptr || ZSTD_isError(ZSTD_initCStream(cstream.get(), 1))) {
+    return Status::failure("Couldn't initialize compression stream");
+  }
+
+  auto tar_size = size_;
+  size_ = 0;
+  std::vector<char> out(ZSTD_CStreamOutSize());
+  auto drain = [&](ZSTD_outBuffer& output) {
+    if (output.pos > 0 && file->write(out.data(), output.pos) < 0) {
+      return false;
+    }
+    hash_.update(out.data(), output.pos);
+    size_ += output.pos;
+    return true;
+  };
+
+  uint64_t archived = 0;
+  bool done = false;
+  while (!done) {
+    auto s = advance(done);
+    if (!s.ok()) {
+      return s;
+    }
+
+    archived += pending_.size();
+    ZSTD_inBuffer input = {pending_.data(), pending_.size(), 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {out.data(), out.size(), 0};
+      auto ret = ZSTD_compressStream(cstream.get(), &output, &input);
+      if (ZSTD_isError(ret)) {
+        return Status::failure("ZSTD_compressStream() error : " +
+                               std::string(ZSTD_getErrorName(ret)));
+      }
+      if (!drain(output)) {
+        return Status::failure("Error writing bytes to the spool file");
+      }
+    }
+    pending_.clear();
+  }
+
+  if (archived != tar_size) {
+    return Status::failure("The carve archive is " + std::to_string(archived) +
+                           " bytes, expected " + std::to_string(tar_size));
+  }
+
+  size_t remaining = 0;
+  do {
+    ZSTD_outBuffer output = {out.data(), out.size(), 0};
+    remaining = ZSTD_endStream(cstream.get(), &output);
+    if (ZSTD_isError(remaining)) {
+      return Status::failure("Couldn't fully flush compressed file");
+    }
+    if (!drain(output)) {
+      return Status::failure("Error writing bytes to the spool file");
+    }
+  } while (remaining > 0);
+
+  file->seek(0, PF_SEEK_BEGIN);
+  spool_ = std::move(file);
+  sha256_ = hash_.digest();
+  produced_ = 0;
+  return Status::success();
+}
+
+Status CarveStream::next(std::string& block) {
+  block.clear();
+  if (spool_ != nullptr) {
+    block.resize(block_size_);
+    auto bytes = spool_->read(&block[0], block_size_);
+    if (bytes < 0) {
+      return Status::failure("Failed to read the carve spool file");
+    }
+    block.resize(static_cast<size_t>(bytes));
+    produced_ += block.size();
+    return block.empty() ? finish() : Status::success();
+  }
+
+  bool done = false;
+  while (pending_.size() < block_size_ && !done) {
+    auto s = advance(done);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  auto length = std::min(pending_.size(), block_size_);
+  block.assign(pending_, 0, length);
+  pending_.erase(0, length);
+  if (block.empty()) {
+    return finish();
+  }
+
+  hash_.update(block.data(), block.size());
+  produced_ += block.size();
+  return Status::success();
+}
+
+} // namespace osquery
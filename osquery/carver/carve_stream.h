@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/filesystem/fileops.h>
+#include <osquery/hashing/hashing.h>
+#include <osquery/utils/status/status.h>
+
+struct archive;
+
+namespace osquery {
+
+/**
+ * @brief The tar archive of a carve, produced block by block.
+ *
+ * Files are read from their original location and framed as they are
+ * archived, nothing is copied to disk and at most a couple of blocks are
+ * buffered. Entries are sized when the stream is opened: a file that grows
+ * afterwards is truncated and a file that shrinks is padded with zeros, so
+ * the size of the archive is known before any block is produced.
+ *
+ * A compressed archive has no known size until it is complete. It is
+ * compressed into a spool file first, in a single pass over the files, and
+ * the blocks are then read from the spool.
+ */
+class CarveStream : private boost::noncopyable {
+ public:
+  CarveStream(const std::set<boost::filesystem::path>& paths,
+              size_t block_size);
+  ~CarveStream();
+
+  /// Size the files and their archive, files that cannot be read are skipped.
+  Status open();
+
+  /// Compress the whole archive into a spool file, blocks are read from it.
+  Status compress(const boost::filesystem::path& spool);
+
+  /**
+   * @brief Produce the next block of the stream.
+   *
+   * Every block is block_size long except the last one. An empty block is
+   * returned once the stream ended.
+   */
+  Status next(std::string& block);
+
+  /// The size of the stream in bytes.
+  uint64_t size() const {
+    return size_;
+  }
+
+  /// The number of blocks in the stream.
+  size_t blocks() const;
+
+  /// The number of files in the archive.
+  size_t files() const {
+    return entries_.size();
+  }
+
+  /// The SHA256 of the stream, set once the stream ended.
+  const std::string& sha256() const {
+    return sha256_;
+  }
+
+ private:
+  struct Entry {
+    /// The file read when the entry is archived.
+    boost::filesystem::path source;
+
+    /// The path of the entry within the archive.
+    std::string name;
+
+    uint64_t size{0};
+  };
+
+  /// The libarchive callbacks and helpers, defined with the stream.
+  struct Writer;
+
+  /**
+   * @brief Archive the next part of a file.
+   *
+   * The output of the archive is appended to pending_.
+   *
+   * @param done [output] set once the archive is complete.
+   */
+  Status advance(bool& done);
+
+  /// Hash the produced bytes and check the stream size once it ended.
+  Status finish();
+
+ private:
+  std::vector<Entry> entries_;
+
+  /// The entry archived by advance.
+  size_t entry_{0};
+
+  /// The file of the current entry, nullptr between entries.
+  std::unique_ptr<PlatformFile> file_;
+
+  /// The bytes left to read from the current entry's file.
+  uint64_t remaining_{0};
+
+  struct archive* archive_{nullptr};
+
+  /// The archive trailer was written.
+  bool closed_{false};
+
+  /// The archive output that was not produced as a block yet.
+  std::string pending_;
+
+  /// The buffer files are read into.
+  std::vector<char> buffer_;
+
+  /// The compressed archive, blocks are read from it when set.
+  std::unique_ptr<PlatformFile> spool_;
+
+  size_t block_size_{0};
+  uint64_t size_{0};
+
+  /// The bytes produced as blocks so far.
+  uint64_t produced_{0};
+
+  Hash hash_{HASH_TYPE_SHA256};
+  std::string sha256_;
+};
+
+} // namespace osquery
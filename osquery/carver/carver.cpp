@@ -18,17 +18,21 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
-#include <osquery/filesystem/fileops.h>
-#include <osquery/hashing/hashing.h>
+#include <osquery/dispatcher/thread_pool.h>
 #include <osquery/logger/logger.h>
 #include <osquery/remote/serializers/json.h>
 #include <osquery/utils/base64.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/system.h>
 #include <osquery/utils/system/time.h>
 
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <thread>
 
 namespace fs = boost::filesystem;
 
@@ -67,8 +71,45 @@ CLI_FLAG(uint32,
          86400,
          "Seconds to store successful carve result metadata (in carves table)");
 
+/// Number of blocks posted concurrently.
+CLI_FLAG(uint32,
+         carver_parallel_blocks,
+         1,
+         "Number of carve blocks posted concurrently (default 1)");
+
+/// Number of times a block is posted again after a failure.
+CLI_FLAG(uint32,
+         carver_block_retries,
+         3,
+         "Number of times a failed carve block POST is retried (default 3)");
+
 DECLARE_bool(disable_carver);
-DECLARE_uint64(read_max);
+
+namespace {
+
+/// The delay before the first retry of a block, doubled for each retry.
+const std::chrono::milliseconds kBlockRetryDelay{200};
+
+/// The content type of blocks posted as raw bytes.
+const std::string kBinaryBlockContentType{"application/octet-stream"};
+
+/// Percent-encode a value for the query string of a URI.
+std::string encodeQueryValue(const std::string& value) {
+  std::string encoded;
+  for (const auto c : value) {
+    if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ||
+        c == '.' || c == '~') {
+      encoded += c;
+    } else {
+      char hex[4];
+      std::snprintf(hex, sizeof(hex), "%%%02X", static_cast<unsigned char>(c));
+      encoded += hex;
+    }
+  }
+  return encoded;
+}
+
+} // namespace
 
 std::atomic<bool> CarverRunnable::running_{false};
 
@@ -153,7 +194,6 @@ Carver::Carver(const std::set<std::string>& paths,
 }
 
 Status Carver::createPaths() {
-  // TODO: Adding in a manifest file of all carved files might be nice.
   carveDir_ =
       fs::temp_directory_path() / fs::path(kCarvePathPrefix + carveGuid_);
   auto ret = fs::create_directory(carveDir_);
@@ -161,8 +201,7 @@ Status Carver::createPaths() {
     return Status::failure("Failed to create carve file store");
   }
 
-  // Store the path to our archive for later exfiltration
-  archivePath_ = carveDir_ / fs::path(kCarveNamePrefix + carveGuid_ + ".tar");
+  // Store the path to our compressed archive for later exfiltration
   compressPath_ =
       carveDir_ / fs::path(kCarveNamePrefix + carveGuid_ + ".tar.zst");
 
@@ -182,130 +221,142 @@ Status Carver::carve() {
     return s;
   }
 
-  const auto carvedFiles = carveAll();
-  s = archive(carvedFiles, archivePath_, FLAGS_carver_block_size);
+  CarveStream stream(carvePaths_, FLAGS_carver_block_size);
+  s = stream.open();
   if (!s.ok()) {
     VLOG(1) << "Failed to create carve archive: " << s.getMessage();
     updateCarveValue(carveGuid_, "status", "ARCHIVE FAILED");
     return s;
   }
 
-  fs::path uploadPath;
   if (FLAGS_carver_compression) {
-    uploadPath = compressPath_;
-    s = compress(archivePath_, compressPath_);
+    s = stream.compress(compressPath_);
     if (!s.ok()) {
       VLOG(1) << "Failed to compress carve archive: " << s.getMessage();
       updateCarveValue(carveGuid_, "status", "COMPRESS FAILED");
       return s;
     }
-  } else {
-    uploadPath = archivePath_;
-  }
-
-  PlatformFile uploadFile(uploadPath, PF_OPEN_EXISTING | PF_READ);
-  updateCarveValue(carveGuid_, "size", uploadFile.size());
-
-  std::string uploadHash =
-      (uploadFile.size() > FLAGS_read_max)
-          ? "-1"
-          : hashFromFile(HashType::HASH_TYPE_SHA256, uploadPath.string());
-  if (uploadHash == "-1") {
-    VLOG(1)
-        << "Archive file size exceeds read max, skipping integrity computation";
   }
-  updateCarveValue(carveGuid_, "sha256", uploadHash);
+  updateCarveValue(carveGuid_, "size", stream.size());
 
-  s = postCarve(uploadPath);
+  s = upload(stream);
   if (!s.ok()) {
     VLOG(1) << "Failed to post carve: " << s.getMessage();
     updateCarveValue(carveGuid_, "status", "DATA POST FAILED");
     return s;
   }
+
+  // The archive is hashed as it is streamed.
+  updateCarveValue(carveGuid_, "sha256", stream.sha256());
+  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
   return Status::success();
 };
 
-std::set<fs::path> Carver::carveAll() {
-  std::set<fs::path> carvedFiles;
-  for (const auto& srcPath : carvePaths_) {
-    // Ensure the file is a flat file on disk before carving
-    PlatformFile src(srcPath, PF_OPEN_EXISTING | PF_READ);
-    if (!src.isValid() || isDirectory(srcPath)) {
-      VLOG(1) << "File does not exist on disk or is subdirectory: " << srcPath;
-      continue;
-    }
+Status Carver::upload(CarveStream& stream) {
+  CarveSession session;
+  auto s = startUpload(stream.blocks(), stream.size(), session);
+  if (!s.ok()) {
+    return s;
+  }
 
-    fs::path dstPath;
-    if (srcPath.has_root_name()) {
-      auto temp = srcPath.string();
-      boost::erase_first(temp, ":");
-      dstPath = carveDir_ / fs::path(temp);
-    } else {
-      dstPath = carveDir_ / srcPath;
-    }
-    if (!fs::exists(dstPath.parent_path())) {
-      auto ret = fs::create_directories(dstPath.parent_path());
-      if (!ret) {
-        VLOG(1) << "Failed to create directories for: "
-                << dstPath.parent_path();
-        continue;
+  // Bound the blocks held in memory to the ones being posted.
+  auto parallel = std::max<size_t>(FLAGS_carver_parallel_blocks, 1);
+  ThreadPool posters("CarverPoster", parallel);
+
+  Mutex mutex;
+  ConditionVariable posted;
+  size_t inflight = 0;
+  Status failure;
+
+  auto post = [this, &session, &mutex, &posted, &inflight, &failure](
+                  size_t id, const std::string& block) {
+    Status status;
+    for (size_t attempt = 0; attempt <= FLAGS_carver_block_retries;
+         attempt++) {
+      {
+        WriteLock lock(mutex);
+        if (!failure.ok()) {
+          // Another block failed, the carve will not complete.
+          status = failure;
+          break;
+        }
+      }
+
+      if (attempt > 0) {
+        auto backoff = 1 << std::min<size_t>(attempt - 1, 6);
+        std::this_thread::sleep_for(kBlockRetryDelay * backoff);
       }
+
+      status = postBlock(session, id, block);
+      if (status.ok()) {
+        break;
+      }
+      VLOG(1) << "Post of carved block " << id
+              << " failed: " << status.getMessage();
     }
 
-    PlatformFile dst(dstPath, PF_CREATE_NEW | PF_WRITE);
-    if (!dst.isValid()) {
-      VLOG(1) << "Destination temporary file is invalid: " << dstPath;
-      continue;
+    WriteLock lock(mutex);
+    inflight--;
+    if (!status.ok() && failure.ok()) {
+      failure = status;
     }
-    Status s = blockwiseCopy(src, dst);
-    if (s.ok()) {
-      carvedFiles.insert(dstPath);
-    } else {
-      VLOG(1) << "Failed to copy file from " << srcPath << " to " << dstPath
-              << " " << s.getMessage();
+    posted.notify_all();
+  };
+
+  size_t id = 0;
+  while (true) {
+    std::string block;
+    s = stream.next(block);
+    if (!s.ok() || block.empty()) {
+      break;
     }
-  }
-  return carvedFiles;
-}
 
-Status Carver::blockwiseCopy(PlatformFile& src, PlatformFile& dst) {
-  auto blkCount = ceil(static_cast<double>(src.size()) /
-                       static_cast<double>(FLAGS_carver_block_size));
-
-  std::vector<char> inBuff(FLAGS_carver_block_size, 0);
-  for (size_t i = 0; i < blkCount; i++) {
-    auto bytesRead = src.read(inBuff.data(), FLAGS_carver_block_size);
-    if (bytesRead > 0) {
-      auto bytesWritten = dst.write(inBuff.data(), bytesRead);
-      if (bytesWritten < 0) {
-        return Status(1, "Error writing bytes to tmp fs");
+    {
+      WriteLock lock(mutex);
+      posted.wait(lock, [&]() { return inflight < parallel || !failure.ok(); });
+      if (!failure.ok()) {
+        break;
       }
+      inflight++;
     }
+
+    posters.submit([post, id, block = std::move(block)]() { post(id, block); });
+    id++;
   }
+  posters.wait();
 
+  if (!s.ok()) {
+    return s;
+  }
+
+  WriteLock lock(mutex);
+  if (!failure.ok()) {
+    return Status::failure("Post of carved block failed: " +
+                           failure.getMessage());
+  }
   return Status::success();
-};
+}
 
-Status Carver::postCarve(const boost::filesystem::path& path) {
+Status Carver::startUpload(size_t blocks,
+                           uint64_t size,
+                           CarveSession& session) {
   // Construct the uri we post our data back to:
   auto startUri = TLSRequestHelper::makeURI(FLAGS_carver_start_endpoint);
   Request<TLSTransport, JSONSerializer> startRequest(startUri);
   startRequest.setOption("hostname", FLAGS_tls_hostname);
 
   // Perform the start request to get the session id
-  PlatformFile pFile(path, PF_OPEN_EXISTING | PF_READ);
-  auto blkCount =
-      static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
-                               static_cast<double>(FLAGS_carver_block_size)));
   JSON startParams;
-
-  startParams.add("block_count", blkCount);
+  startParams.add("block_count", blocks);
   startParams.add("block_size", size_t(FLAGS_carver_block_size));
-  startParams.add("carve_size", pFile.size());
+  startParams.add("carve_size", size);
   startParams.add("carve_id", carveGuid_);
   startParams.add("request_id", requestId_);
   startParams.add("node_key", getNodeKey("tls"));
 
+  // Offer to post blocks as raw bytes, the endpoint opts in when replying.
+  startParams.add("binary_blocks", true);
+
   auto status = startRequest.call(startParams);
   if (!status.ok()) {
     return status;
@@ -326,41 +377,43 @@ Status Carver::postCarve(const boost::filesystem::path& path) {
     return Status(1, "Invalid session_id received from remote endpoint");
   }
 
-  std::string session_id = it->value.GetString();
-  if (session_id.empty()) {
+  session.id = it->value.GetString();
+  if (session.id.empty()) {
     return Status(1, "Empty session_id received from remote endpoint");
   }
 
+  it = startRecv.doc().FindMember("binary_blocks");
+  session.binary = it != startRecv.doc().MemberEnd() && it->value.IsBool() &&
+                   it->value.GetBool();
+  return Status::success();
+}
+
+Status Carver::postBlock(const CarveSession& session,
+                         size_t id,
+                         const std::string& block) {
   auto contUri = TLSRequestHelper::makeURI(FLAGS_carver_continue_endpoint);
+  if (session.binary) {
+    // The block is the body, the identifiers move to the query string.
+    contUri += (contUri.find('?') != std::string::npos) ? "&" : "?";
+    contUri += "block_id=" + std::to_string(id) +
+               "&session_id=" + encodeQueryValue(session.id) +
+               "&request_id=" + encodeQueryValue(requestId_);
+  }
+
   Request<TLSTransport, JSONSerializer> contRequest(contUri);
   contRequest.setOption("hostname", FLAGS_tls_hostname);
-  for (size_t i = 0; i < blkCount; i++) {
-    std::vector<char> block(FLAGS_carver_block_size, 0);
-    auto r = pFile.read(block.data(), FLAGS_carver_block_size);
-
-    if (r != FLAGS_carver_block_size && r > 0) {
-      // resize the buffer to size we read as last block is likely smaller
-      block.resize(r);
-    }
-
-    JSON params;
-    params.add("block_id", i);
-    params.add("session_id", session_id);
-    params.add("request_id", requestId_);
-    params.add("data", base64::encode(std::string(block.begin(), block.end())));
-
-    // TODO: Error sending files.
-    status = contRequest.call(params);
-    if (!status.ok()) {
-      VLOG(1) << "Post of carved block " << i
-              << " failed: " << status.getMessage();
-      continue;
-    }
+  if (session.binary) {
+    contRequest.setOption("_content_type", kBinaryBlockContentType);
+    return contRequest.callRaw(block);
   }
 
-  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
-  return Status::success();
-};
+  JSON params;
+  params.add("block_id", id);
+  params.add("session_id", session.id);
+  params.add("request_id", requestId_);
+  params.add("data", base64::encode(block));
+  return contRequest.call(params);
+}
 
 void scheduleCarves() {
   if (!FLAGS_disable_carver && kCarverPendingCarves &&
@@ -9,11 +9,13 @@
 
 #pragma once
 
+#include <osquery/carver/carve_stream.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/utils/status/status.h>
 
 #include <atomic>
+#include <cstdint>
 #include <set>
 #include <string>
 
@@ -85,6 +87,15 @@ class CarverRunner : public CarverRunnable {
   size_t carves_{0};
 };
 
+/// The upload session created by the start request of a carve.
+struct CarveSession {
+  /// The session_id returned by the start endpoint.
+  std::string id;
+
+  /// The endpoint accepts blocks as raw bytes rather than base64 in JSON.
+  bool binary{false};
+};
+
 class Carver {
  public:
   Carver(const std::set<std::string>& paths,
@@ -96,40 +107,40 @@ class Carver {
   /**
    * @brief A helper function to perform a start to finish carve.
    *
-   * This function walks through the carve, compress, and post functions
-   * in one fell swoop. Use of this class should largely happen through
-   * this function.
+   * This function streams the archive of the carved files, optionally
+   * compressed, to the remote endpoints in one fell swoop. Use of this class
+   * should largely happen through this function.
    */
   Status carve();
 
-  /// Create the archive and compression paths.
+  /// Create the carve directory and the compression spool path.
   Status createPaths();
 
  protected:
   /**
-   * @brief A helper function that 'carves' all files from disk.
+   * @brief Stream the carve archive to the remote endpoints.
    *
-   * This function copies all source files to a temporary directory and returns
-   * a list of all destination files.
+   * Blocks are produced on the calling thread while up to
+   * carver_parallel_blocks of them are posted concurrently. A block that
+   * fails is retried carver_block_retries times before the upload fails.
    */
-  std::set<boost::filesystem::path> carveAll();
+  Status upload(CarveStream& stream);
 
   /**
-   * @brief A helper function that does a blockwise copy from src to dst.
+   * @brief Request an upload session from the carver_start_endpoint.
    *
-   * This function copies the source file to the destination file, doing so
-   * by blocks specified with FLAGS_carver_block_size (defaults to 8K).
+   * @param blocks the number of blocks of the carve.
+   * @param size the size of the carve in bytes.
+   * @param session [output] the session the blocks are posted to.
    */
-  Status blockwiseCopy(PlatformFile& src, PlatformFile& dst);
+  virtual Status startUpload(size_t blocks,
+                             uint64_t size,
+                             CarveSession& session);
 
-  /**
-   * @brief Helper function to POST a carve to the graph endpoint.
-   *
-   * Once all of the files have been carved and the tgz has been
-   * created, we POST the carved file to an endpoint specified by the
-   * carver_start_endpoint and carver_continue_endpoint.
-   */
-  virtual Status postCarve(const boost::filesystem::path& path);
+  /// POST a block of the carve to the carver_continue_endpoint.
+  virtual Status postBlock(const CarveSession& session,
+                           size_t id,
+                           const std::string& block);
 
   /// Helper function to return the carve directory.
   boost::filesystem::path getCarveDir() {
@@ -140,9 +151,8 @@ class Carver {
   /**
    * @brief a variable to keep track of the temp path used in carving.
    *
-   * This variable represents the location in which we store all of our carved
-   * files. When a carve has completed all of the desired files, as well
-   * as the tar archive should reside in this directory.
+   * Files are streamed from their original location, this directory only
+   * holds the compressed archive when compression is used.
    */
   boost::filesystem::path carveDir_;
 
@@ -154,19 +164,11 @@ class Carver {
    */
   std::set<boost::filesystem::path> carvePaths_;
 
-  /**
-   * @brief a helper variable for keeping track of the posix tar archive.
-   *
-   * This variable is the absolute location of the tar archive created from
-   * tar'ing all of the carved files from the carve temp dir.
-   */
-  boost::filesystem::path archivePath_;
-
   /**
    * @brief a helper variable for keeping track of the compressed tar.
    *
-   * This variable is the absolute location of the tar archive created from
-   * zstd of the archive.
+   * This variable is the absolute location of the zstd compressed archive,
+   * which is spooled before upload as its size is not known in advance.
    */
   boost::filesystem::path compressPath_;
 
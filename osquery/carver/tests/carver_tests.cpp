@@ -7,25 +7,35 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+
 #include <boost/filesystem.hpp>
 
 #include <gtest/gtest.h>
 
+#include <osquery/carver/carve_stream.h>
 #include <osquery/carver/carver.h>
 #include <osquery/carver/carver_utils.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/registry/registry.h>
+#include <osquery/remote/enroll/enroll.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
+
+#include "osquery/remote/tests/test_utils.h"
 
 namespace osquery {
 
-namespace fs = boost::filesystem;
+DECLARE_uint32(carver_block_size);
+DECLARE_bool(carver_compression);
+DECLARE_uint32(carver_parallel_blocks);
+DECLARE_uint32(carver_block_retries);
 
-/// Prefix used for posix tar archive.
-const std::string kTestCarveNamePrefix = "carve_";
+namespace fs = boost::filesystem;
 
 class FakeCarver : public Carver {
  public:
@@ -34,17 +44,56 @@ class FakeCarver : public Carver {
              const std::string& requestId)
       : Carver(paths, guid, requestId) {}
 
+  /// Fail the next attempts to post a block.
+  void failBlock(size_t id, size_t attempts) {
+    WriteLock lock(mutex_);
+    failures_[id] = attempts;
+  }
+
+  /// The posted blocks, in order.
+  std::string uploaded() {
+    WriteLock lock(mutex_);
+    std::string carve;
+    for (const auto& block : blocks_) {
+      carve += block.second;
+    }
+    return carve;
+  }
+
  protected:
-  Status postCarve(const boost::filesystem::path&) override {
-    updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
+  Status startUpload(size_t blocks,
+                     uint64_t size,
+                     CarveSession& session) override {
+    blockCount_ = blocks;
+    carveSize_ = size;
+    session.id = "session";
+    return Status::success();
+  }
+
+  Status postBlock(const CarveSession&,
+                   size_t id,
+                   const std::string& block) override {
+    WriteLock lock(mutex_);
+    auto& failures = failures_[id];
+    if (failures > 0) {
+      failures--;
+      return Status::failure("Failed to post block");
+    }
+    blocks_[id] = block;
     return Status::success();
   }
 
+ private:
+  Mutex mutex_;
+  std::map<size_t, std::string> blocks_;
+  std::map<size_t, size_t> failures_;
+  size_t blockCount_{0};
+  uint64_t carveSize_{0};
+
  private:
   friend class CarverTests;
-  FRIEND_TEST(CarverTests, test_carve_files_locally);
-  FRIEND_TEST(CarverTests, test_carve_start);
-  FRIEND_TEST(CarverTests, test_carve_files_not_exists);
+  FRIEND_TEST(CarverTests, test_carve);
+  FRIEND_TEST(CarverTests, test_carve_parallel_blocks);
 };
 
 class FakeCarverRunner : public CarverRunner<FakeCarver> {
@@ -93,6 +142,19 @@ class CarverTests : public testing::Test {
                          "MZP\x00\x02\x00\x00\x00\x04\x00\x0f\x00\xff\xff");
   }
 
+  /// Read a carve archive block by block.
+  Status readStream(CarveStream& stream, std::string& archive) {
+    archive.clear();
+    while (true) {
+      std::string block;
+      auto s = stream.next(block);
+      if (!s.ok() || block.empty()) {
+        return s;
+      }
+      archive += block;
+    }
+  }
+
   void writeTextFileToCarve(const fs::path& path, const std::string& content) {
     EXPECT_TRUE(writeTextFile(path, content).ok());
     carvePaths.insert(path.string());
@@ -109,31 +171,168 @@ class CarverTests : public testing::Test {
   std::set<std::string> carvePaths;
 };
 
-TEST_F(CarverTests, test_carve_files_locally) {
-  auto guid = createCarveGuid();
-  std::string requestId = createCarveGuid();
-  FakeCarver carve(getCarvePaths(), guid, requestId);
-
-  ASSERT_TRUE(carve.createPaths());
-  const auto carves = carve.carveAll();
-  EXPECT_EQ(carves.size(), 3U);
+TEST_F(CarverTests, test_carve_stream) {
+  std::set<fs::path> paths(getCarvePaths().begin(), getCarvePaths().end());
+  CarveStream stream(paths, 512);
+  ASSERT_TRUE(stream.open().ok());
+  EXPECT_EQ(stream.files(), 3U);
+
+  // Tar headers and data are padded to 512 byte records.
+  EXPECT_EQ(stream.size() % 512, 0U);
+  EXPECT_EQ(stream.blocks(), stream.size() / 512);
+
+  size_t blocks = 0;
+  std::string archive;
+  while (true) {
+    std::string block;
+    ASSERT_TRUE(stream.next(block).ok());
+    if (block.empty()) {
+      break;
+    }
+    EXPECT_EQ(block.size(), 512U);
+    archive += block;
+    blocks++;
+  }
+  EXPECT_EQ(blocks, stream.blocks());
+  EXPECT_EQ(archive.size(), stream.size());
 
-  const auto carveFSPath = carve.getCarveDir();
-  const auto tarPath = carveFSPath / (kTestCarveNamePrefix + guid + ".tar");
-  const auto s = archive(carves, tarPath);
-  EXPECT_TRUE(s.ok());
+  // File contents are framed without compression.
+  EXPECT_NE(archive.find("This is a message I'd rather no one saw."),
+            std::string::npos);
+  EXPECT_NE(archive.find("This is a hidden file"), std::string::npos);
 
-  PlatformFile tar(tarPath, PF_OPEN_EXISTING | PF_READ);
-  EXPECT_TRUE(tar.isValid());
-  EXPECT_GT(tar.size(), 0U);
+  Hash hash(HASH_TYPE_SHA256);
+  hash.update(archive.data(), archive.size());
+  EXPECT_EQ(stream.sha256(), hash.digest());
 }
 
 TEST_F(CarverTests, test_carve) {
-  auto guid = createCarveGuid();
-  std::string requestId = createCarveGuid();
-  FakeCarver carve(getCarvePaths(), guid, requestId);
+  std::string guid;
+  auto s = osquery::carvePaths(getCarvePaths(), "request-id", guid);
+  ASSERT_TRUE(s.ok());
+
+  FakeCarver carve(getCarvePaths(), guid, "request-id");
+  s = carve.carve();
+  ASSERT_TRUE(s.ok());
+
+  auto uploaded = carve.uploaded();
+  EXPECT_EQ(uploaded.size(), carve.carveSize_);
+  EXPECT_EQ(carve.blockCount_, 1U);
+
+  std::string value;
+  s = getDatabaseValue(kCarves, kCarverDBPrefix + guid, value);
+  ASSERT_TRUE(s.ok());
+
+  JSON tree;
+  ASSERT_TRUE(tree.fromString(value).ok());
+  EXPECT_EQ(std::string(tree.doc()["status"].GetString()),
+            kCarverStatusSuccess);
+
+  Hash hash(HASH_TYPE_SHA256);
+  hash.update(uploaded.data(), uploaded.size());
+  EXPECT_EQ(std::string(tree.doc()["sha256"].GetString()), hash.digest());
+}
+
+TEST_F(CarverTests, test_carve_parallel_blocks) {
+  auto block_size = FLAGS_carver_block_size;
+  auto parallel_blocks = FLAGS_carver_parallel_blocks;
+  FLAGS_carver_block_size = 512;
+  FLAGS_carver_parallel_blocks = 4;
+
+  std::string archive;
+  {
+    std::set<fs::path> paths(getCarvePaths().begin(), getCarvePaths().end());
+    CarveStream stream(paths, FLAGS_carver_block_size);
+    ASSERT_TRUE(stream.open().ok());
+    ASSERT_TRUE(readStream(stream, archive).ok());
+  }
+
+  FakeCarver carve(getCarvePaths(), createCarveGuid(), "request-id");
+  carve.failBlock(1, 2);
   auto s = carve.carve();
+  EXPECT_TRUE(s.ok()) << s.getMessage();
+
+  // Blocks posted concurrently and retried reassemble into the archive.
+  EXPECT_GT(carve.blockCount_, 4U);
+  EXPECT_EQ(carve.uploaded(), archive);
+
+  FLAGS_carver_block_size = block_size;
+  FLAGS_carver_parallel_blocks = parallel_blocks;
+}
+
+TEST_F(CarverTests, test_carve_block_failure) {
+  auto block_retries = FLAGS_carver_block_retries;
+  FLAGS_carver_block_retries = 1;
+
+  FakeCarver carve(getCarvePaths(), createCarveGuid(), "request-id");
+  carve.failBlock(0, 2);
+  EXPECT_FALSE(carve.carve().ok());
+
+  FLAGS_carver_block_retries = block_retries;
+}
+
+TEST_F(CarverTests, test_carve_compressed) {
+  auto compression = FLAGS_carver_compression;
+  FLAGS_carver_compression = true;
+
+  std::string archive;
+  {
+    std::set<fs::path> paths(getCarvePaths().begin(), getCarvePaths().end());
+    CarveStream stream(paths, FLAGS_carver_block_size);
+    ASSERT_TRUE(stream.open().ok());
+    ASSERT_TRUE(readStream(stream, archive).ok());
+  }
+
+  FakeCarver carve(getCarvePaths(), createCarveGuid(), "request-id");
+  auto s = carve.carve();
+  FLAGS_carver_compression = compression;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  auto const compressed = getWorkingDir() / "carve.tar.zst";
+  auto const decompressed = getWorkingDir() / "carve.tar";
+  ASSERT_TRUE(writeTextFile(compressed, carve.uploaded()).ok());
+  ASSERT_TRUE(osquery::decompress(compressed, decompressed).ok());
+
+  std::string content;
+  ASSERT_TRUE(readFile(decompressed, content).ok());
+  EXPECT_EQ(content, archive);
+}
+
+TEST_F(CarverTests, test_carve_tls) {
+  ASSERT_TRUE(TLSServerRunner::start());
+  TLSServerRunner::setClientConfig();
+  clearNodeKey();
+
+  auto start_endpoint = Flag::getValue("carver_start_endpoint");
+  auto continue_endpoint = Flag::getValue("carver_continue_endpoint");
+  Flag::updateValue("carver_start_endpoint", "/carve_init");
+  Flag::updateValue("carver_continue_endpoint", "/carve_block");
+
+  std::string guid;
+  auto s = osquery::carvePaths(getCarvePaths(), "request-id", guid);
   ASSERT_TRUE(s.ok());
+  {
+    // The local server accepts binary blocks and writes the carve to /tmp.
+    Carver carve(getCarvePaths(), guid, "request-id");
+    s = carve.carve();
+  }
+
+  Flag::updateValue("carver_start_endpoint", start_endpoint);
+  Flag::updateValue("carver_continue_endpoint", continue_endpoint);
+  TLSServerRunner::stop();
+  TLSServerRunner::unsetClientConfig();
+  clearNodeKey();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  std::string value;
+  ASSERT_TRUE(getDatabaseValue(kCarves, kCarverDBPrefix + guid, value).ok());
+  JSON tree;
+  ASSERT_TRUE(tree.fromString(value).ok());
+
+  auto const carved = fs::path("/tmp") / (guid + ".tar");
+  EXPECT_EQ(hashFromFile(HashType::HASH_TYPE_SHA256, carved.string()),
+            std::string(tree.doc()["sha256"].GetString()));
+  fs::remove(carved);
 }
 
 TEST_F(CarverTests, test_schedule_carves) {
@@ -254,13 +453,14 @@ TEST_F(CarverTests, test_expiration) {
 }
 
 TEST_F(CarverTests, test_carve_files_not_exists) {
-  auto guid = createCarveGuid();
-  std::string requestId = "";
-  const std::set<std::string> notExistsCarvePaths = {
-      (getFilesToCarveDir() / "not_exists").string()};
-  FakeCarver carve(notExistsCarvePaths, guid, requestId);
-  const auto carves = carve.carveAll();
-  EXPECT_TRUE(carves.empty());
+  const std::set<fs::path> notExistsCarvePaths = {getFilesToCarveDir() /
+                                                  "not_exists"};
+  CarveStream stream(notExistsCarvePaths, 512);
+  ASSERT_TRUE(stream.open().ok());
+  EXPECT_EQ(stream.files(), 0U);
+
+  // Only the archive trailer is left.
+  EXPECT_EQ(stream.size(), 1024U);
 }
 
 TEST_F(CarverTests, test_compression_decompression) {
@@ -12,6 +12,7 @@
 #include <functional>
 #include <map>
 #include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,7 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
@@ -106,6 +108,12 @@ FLAG_ALIAS(google::uint64,
            config_tls_accelerated_refresh,
            config_accelerated_refresh);
 
+FLAG(uint64,
+     schedule_performance_flush,
+     60,
+     "Interval in seconds to write scheduled query stats to the database, "
+     "0 to write them after every execution");
+
 DECLARE_string(config_plugin);
 DECLARE_string(pack_delimiter);
 
@@ -119,6 +127,14 @@ DECLARE_string(pack_delimiter);
 const std::string kExecutingQuery{"executing_query"};
 const std::string kFailedQueries{"failed_queries"};
 
+/**
+ * @brief The backing store key prefix for each running scheduled query.
+ *
+ * Scheduler workers run several queries at once, each of them records and
+ * clears its own key, the query name follows the prefix.
+ */
+const std::string kExecutingQueryPrefix{"executing_query."};
+
 // The config may be accessed and updated asynchronously; use mutexes.
 Mutex config_hash_mutex_;
 Mutex config_refresh_mutex_;
@@ -129,6 +145,34 @@ RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
 RecursiveMutex config_performance_mutex_;
 
+/**
+ * @brief Scheduled query stats, written to the backing store in batches.
+ *
+ * Stats are read from the store the first time a query is recorded, then
+ * served from here. All of these are protected by config_performance_mutex_.
+ */
+std::map<std::string, QueryPerformance> query_performance_;
+
+/// Names of the queries with stats not yet written to the store.
+std::set<std::string> dirty_query_performance_;
+
+/// Execution times not yet written to the store, used for results eviction.
+std::map<std::string, uint64_t> pending_query_timestamps_;
+
+/// The last time the pending stats were written.
+uint64_t query_performance_flushed_{0};
+
+/// The scheduled query running on this thread, see getExecutingQuery.
+thread_local std::string executing_query_;
+
+/// Remove the stats of a query that is no longer scheduled.
+static void forgetQueryPerformance(const std::string& name) {
+  RecursiveLock lock(config_performance_mutex_);
+  query_performance_.erase(name);
+  dirty_query_performance_.erase(name);
+  deleteDatabaseValue(kQueryPerformance, name);
+}
+
 using PackRef = std::unique_ptr<Pack>;
 
 /**
@@ -194,10 +238,10 @@ class Schedule : private boost::noncopyable {
   /**
    * @brief The schedule will check and record previously executing queries.
    *
-   * If a query is found on initialization, the name will be recorded, it is
-   * possible to skip previously failed queries.
+   * If queries are found on initialization, their names will be recorded, it
+   * is possible to skip previously failed queries.
    */
-  std::string failed_query_;
+  std::vector<std::string> failed_queries_;
 
   /**
    * @brief List of denylisted queries.
@@ -338,6 +382,35 @@ void saveScheduleDenylist(const std::map<std::string, uint64_t>& denylist) {
   setDatabaseValue(kPersistentSettings, kFailedQueries, content);
 }
 
+std::vector<std::string> denylistExecutingQueries(
+    std::map<std::string, uint64_t>& denylist) {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kPersistentSettings, keys, kExecutingQueryPrefix);
+
+  std::vector<std::string> failed_queries;
+  for (const auto& key : keys) {
+    failed_queries.push_back(key.substr(kExecutingQueryPrefix.size()));
+    deleteDatabaseValue(kPersistentSettings, key);
+  }
+
+  // Older versions only recorded the single executing query.
+  std::string executing_query;
+  getDatabaseValue(kPersistentSettings, kExecutingQuery, executing_query);
+  if (!executing_query.empty()) {
+    setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
+    if (failed_queries.empty()) {
+      failed_queries.push_back(std::move(executing_query));
+    }
+  }
+
+  auto expire = getUnixTime() + 86400;
+  for (const auto& name : failed_queries) {
+    LOG(WARNING) << "Scheduled query may have failed: " << name;
+    denylist[name] = expire;
+  }
+  return failed_queries;
+}
+
 Schedule::Schedule() {
   if (RegistryFactory::get().external()) {
     // Extensions should not restore or save schedule details.
@@ -347,12 +420,9 @@ Schedule::Schedule() {
   restoreScheduleDenylist(denylist_);
 
   // Check if any queries were executing when the tool last stopped.
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
-  if (!failed_query_.empty()) {
-    LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
-    setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-    // Add this query name to the denylist and save the denylist.
-    denylist_[failed_query_] = getUnixTime() + 86400;
+  // Add these query names to the denylist and save the denylist.
+  failed_queries_ = denylistExecutingQueries(denylist_);
+  if (!failed_queries_.empty()) {
     saveScheduleDenylist(denylist_);
   }
 }
@@ -782,8 +852,7 @@ Status Config::updateSource(const std::string& source,
     if (newQueries.find(oldPack.first) == newQueries.end()) {
       // This pack was removed. Also remove performance stats.
       for (const auto& oldQuery : oldPack.second) {
-        deleteDatabaseValue(kQueryPerformance,
-                            getQueryName(oldPack.first, oldQuery.first));
+        forgetQueryPerformance(getQueryName(oldPack.first, oldQuery.first));
       }
       continue;
     }
@@ -791,8 +860,7 @@ Status Config::updateSource(const std::string& source,
       if (newQueries[oldPack.first].find(oldQuery.first) ==
           newQueries[oldPack.first].end()) {
         // This query was removed. Also remove performance stats.
-        deleteDatabaseValue(kQueryPerformance,
-                            getQueryName(oldPack.first, oldQuery.first));
+        forgetQueryPerformance(getQueryName(oldPack.first, oldQuery.first));
         continue;
       }
       if (queries[oldPack.first][oldQuery.first] !=
@@ -801,6 +869,8 @@ Status Config::updateSource(const std::string& source,
         auto fullName = getQueryName(oldPack.first, oldQuery.first);
         RecursiveLock lock(config_performance_mutex_);
         LOG(INFO) << "Clearing performance stats for query: " << fullName;
+        query_performance_.erase(fullName);
+        dirty_query_performance_.erase(fullName);
         setDatabaseValue(
             kQueryPerformance, fullName, QueryPerformance().toCSV());
       }
@@ -986,6 +1056,9 @@ Status Config::update(const ConfigMap& config) {
 }
 
 void Config::purge() {
+  // Execution times are compared below, write the pending ones first.
+  flushQueryPerformance();
+
   // The first use of purge is removing expired query results.
   std::vector<std::string> saved_queries;
   scanDatabaseKeys(kQueries, saved_queries);
@@ -1033,6 +1106,7 @@ void Config::purge() {
       // Query has not run in the last week, expire results and interval.
       deleteDatabaseValue(kQueries, saved_query);
       deleteDatabaseValue(kQueries, saved_query + "epoch");
+      Query::removeHashedResults(saved_query);
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -1043,6 +1117,14 @@ void Config::purge() {
 void Config::reset() {
   setStartTime(getUnixTime());
 
+  {
+    // Pending stats are dropped, a reset starts over from the store.
+    RecursiveLock lock(config_performance_mutex_);
+    query_performance_.clear();
+    dirty_query_performance_.clear();
+    pending_query_timestamps_.clear();
+  }
+
   schedule_ = std::make_unique<Schedule>();
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
@@ -1086,81 +1168,151 @@ void Config::recordQueryPerformance(const std::string& name,
                                     uint64_t size,
                                     const Row& r0,
                                     const Row& r1) {
+  auto difference = [&r0, &r1](const std::string& column) -> uint64_t {
+    if (r1.at(column).empty() || r0.at(column).empty()) {
+      return 0;
+    }
+
+    auto end = tryTo<long long>(r1.at(column));
+    auto start = tryTo<long long>(r0.at(column));
+    auto diff = (end && start) ? end.take() - start.take() : 0;
+    return (diff > 0) ? diff : 0;
+  };
+
+  QueryResourceUsage usage;
+  usage.user_time = difference("user_time");
+  usage.system_time = difference("system_time");
+  usage.memory = difference("resident_size");
+  recordQueryPerformance(name, delay_ms, size, usage);
+}
+
+void Config::recordQueryPerformance(const std::string& name,
+                                    uint64_t delay_ms,
+                                    uint64_t size,
+                                    const QueryResourceUsage& usage) {
   RecursiveLock lock(config_performance_mutex_);
-  std::string csv;
-  QueryPerformance query;
-  auto status = getDatabaseValue(kQueryPerformance, name, csv);
-  if (status.ok()) {
-    query = QueryPerformance(csv);
+  auto it = query_performance_.find(name);
+  if (it == query_performance_.end()) {
+    std::string csv;
+    QueryPerformance stored;
+    if (getDatabaseValue(kQueryPerformance, name, csv).ok()) {
+      stored = QueryPerformance(csv);
+    }
+    it = query_performance_.emplace(name, stored).first;
   }
 
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time += diff;
-      query.last_user_time = diff;
-    }
+  auto& query = it->second;
+  if (usage.user_time > 0) {
+    query.user_time += usage.user_time;
+    query.last_user_time = usage.user_time;
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time += diff;
-      query.last_system_time = diff;
-    }
+  if (usage.system_time > 0) {
+    query.system_time += usage.system_time;
+    query.last_system_time = usage.system_time;
   }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-      query.last_memory = diff;
-    }
+  if (usage.memory > 0) {
+    // Memory is stored as an average of changes between query executions.
+    query.average_memory =
+        (query.average_memory * query.executions) + usage.memory;
+    query.average_memory = (query.average_memory / (query.executions + 1));
+    query.last_memory = usage.memory;
   }
 
+  query.instructions += usage.instructions;
+  query.cache_misses += usage.cache_misses;
   query.last_wall_time_ms = delay_ms;
   query.wall_time_ms += delay_ms;
   query.wall_time += (delay_ms / 1000);
   query.output_size += size;
   query.executions += 1;
   query.last_executed = getUnixTime();
+  dirty_query_performance_.insert(name);
 
-  status = setDatabaseValue(kQueryPerformance, name, query.toCSV());
-  if (!status.ok()) {
-    LOG(WARNING) << "Could not write performance stats for query " << name
-                 << " to the database: " << status.getMessage();
+  if (query.last_executed >=
+      query_performance_flushed_ + FLAGS_schedule_performance_flush) {
+    flushQueryPerformance();
   }
 
   /* Clear the executing query only if a resource limit has not been hit.
      This is used by the next worker execution to denylist a query
      that triggered a watchdog resource limit. */
   if (!Initializer::isResourceLimitHit()) {
-    setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
+    deleteDatabaseValue(kPersistentSettings, kExecutingQueryPrefix + name);
+  }
+
+  if (executing_query_ == name) {
+    executing_query_.clear();
+  }
+}
+
+void Config::flushQueryPerformance() {
+  RecursiveLock lock(config_performance_mutex_);
+  query_performance_flushed_ = getUnixTime();
+  if (!dirty_query_performance_.empty()) {
+    DatabaseStringValueList stats;
+    for (const auto& name : dirty_query_performance_) {
+      stats.emplace_back(name, query_performance_[name].toCSV());
+    }
+    dirty_query_performance_.clear();
+
+    auto status = setDatabaseBatch(kQueryPerformance, stats);
+    if (!status.ok()) {
+      LOG(WARNING) << "Could not write performance stats for "
+                   << stats.size()
+                   << " queries to the database: " << status.getMessage();
+    }
+  }
+
+  if (!pending_query_timestamps_.empty()) {
+    DatabaseStringValueList timestamps;
+    for (const auto& timestamp : pending_query_timestamps_) {
+      timestamps.emplace_back("timestamp." + timestamp.first,
+                              std::to_string(timestamp.second));
+    }
+    pending_query_timestamps_.clear();
+    setDatabaseBatch(kPersistentSettings, timestamps);
   }
 }
 
 void Config::recordQueryStart(const std::string& name) {
-  // There should only ever be a single executing query in the schedule.
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, name);
+  // Each query has its own executing key, scheduler workers may run several.
+  // This is written right away, the query may not return if it hits a
+  // watchdog resource limit.
+  setDatabaseValue(kPersistentSettings,
+                   kExecutingQueryPrefix + name,
+                   std::to_string(getUnixTime()));
+
+  // Event subscribers find the query through the thread running it.
+  executing_query_ = name;
+
+  RecursiveLock lock(config_performance_mutex_);
+
   // Store the time this query name last executed for later results eviction.
   // When configuration updates occur the previous schedule is searched for
   // 'stale' query names, aka those that have week-old or longer last execute
   // timestamps. Offending queries have their database results purged.
-  setDatabaseValue(
-      kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
+  // These are written along with the performance stats.
+  pending_query_timestamps_[name] = getUnixTime();
+}
+
+const std::string& Config::getExecutingQuery() {
+  return executing_query_;
 }
 
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) {
+  {
+    RecursiveLock lock(config_performance_mutex_);
+    auto it = query_performance_.find(name);
+    if (it != query_performance_.end()) {
+      predicate(it->second);
+      return;
+    }
+  }
+
   std::string csv;
   auto status = getDatabaseValue(kQueryPerformance, name, csv);
   if (status.ok()) {
@@ -31,7 +31,7 @@ class Schedule;
 class ConfigParserPlugin;
 class ConfigRefreshRunner;
 
-/// The name of the executing query within the single-threaded schedule.
+/// The executing query key written by older versions, only read on start.
 extern const std::string kExecutingQuery;
 
 /**
@@ -96,6 +96,25 @@ class Config : private boost::noncopyable {
                                      const Row& r0,
                                      const Row& r1);
 
+  /**
+   * @brief Record performance information measured by the query itself.
+   *
+   * The statistics are accumulated in memory and written to the backing
+   * store every schedule_performance_flush seconds, see flushQueryPerformance.
+   *
+   * @param name The unique name of the scheduled item
+   * @param delay_ms Number of milliseconds (wall time) taken by the query
+   * @param size Number of characters generated by query
+   * @param usage Resources used by the query execution
+   */
+  static void recordQueryPerformance(const std::string& name,
+                                     uint64_t delay_ms,
+                                     uint64_t size,
+                                     const QueryResourceUsage& usage);
+
+  /// Write the pending performance stats and execution times to the store.
+  static void flushQueryPerformance();
+
   /**
    * @brief Record a query 'initialization', meaning the query will run.
    *
@@ -109,6 +128,16 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief The scheduled query running on the calling thread.
+   *
+   * Set by recordQueryStart and cleared by recordQueryPerformance, event
+   * subscribers use it to resume each query where its last run stopped.
+   *
+   * @return The query name, empty if the thread is not running one.
+   */
+  static const std::string& getExecutingQuery();
+
   /**
    * @brief Calculate the hash of the osquery config
    *
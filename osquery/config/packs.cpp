@@ -231,6 +231,14 @@ void Pack::initialize(const std::string& name,
     query.splayed_interval =
         restoreSplayedValue(q.name.GetString(), query.interval);
 
+    if (q.value.HasMember("timeout")) {
+      query.timeout = JSON::valueToSize(q.value["timeout"]);
+    }
+
+    if (q.value.HasMember("priority") && q.value["priority"].IsInt64()) {
+      query.priority = q.value["priority"].GetInt64();
+    }
+
     if (!q.value.HasMember("snapshot")) {
       query.options["snapshot"] = false;
     } else {
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <map>
@@ -44,6 +45,7 @@ namespace osquery {
 DECLARE_uint64(config_refresh);
 DECLARE_uint64(config_accelerated_refresh);
 DECLARE_bool(config_enable_backup);
+DECLARE_uint64(schedule_performance_flush);
 
 namespace fs = boost::filesystem;
 
@@ -51,6 +53,8 @@ namespace fs = boost::filesystem;
 extern void restoreScheduleDenylist(std::map<std::string, uint64_t>& denylist);
 extern void saveScheduleDenylist(
     const std::map<std::string, uint64_t>& denylist);
+extern std::vector<std::string> denylistExecutingQueries(
+    std::map<std::string, uint64_t>& denylist);
 
 class ConfigTests : public testing::Test {
  public:
@@ -438,6 +442,100 @@ TEST_F(ConfigTests, test_pack_stats) {
   ASSERT_TRUE(statFound);
 }
 
+TEST_F(ConfigTests, test_query_performance_flush) {
+  auto flush_interval = FLAGS_schedule_performance_flush;
+  FLAGS_schedule_performance_flush = 3600;
+  Config::flushQueryPerformance();
+
+  std::string name = "pack_flush_pack_query";
+  QueryResourceUsage usage;
+  usage.user_time = 5;
+  usage.memory = 100;
+  usage.instructions = 1000;
+  get().recordQueryStart(name);
+  get().recordQueryPerformance(name, 10, 10, usage);
+  get().recordQueryPerformance(name, 10, 10, usage);
+
+  // The stats are served from memory until the next batch is written.
+  std::string csv;
+  getDatabaseValue(kQueryPerformance, name, csv);
+  EXPECT_TRUE(csv.empty());
+
+  QueryPerformance perf;
+  Config::get().getPerformanceStats(
+      name, [&perf](const QueryPerformance& r) { perf = r; });
+  EXPECT_EQ(perf.executions, 2U);
+  EXPECT_EQ(perf.user_time, 10U);
+  EXPECT_EQ(perf.average_memory, 100U);
+  EXPECT_EQ(perf.instructions, 2000U);
+
+  Config::flushQueryPerformance();
+  getDatabaseValue(kQueryPerformance, name, csv);
+  EXPECT_EQ(QueryPerformance(csv), perf);
+
+  std::string timestamp;
+  getDatabaseValue(kPersistentSettings, "timestamp." + name, timestamp);
+  EXPECT_FALSE(timestamp.empty());
+
+  FLAGS_schedule_performance_flush = flush_interval;
+}
+
+TEST_F(ConfigTests, test_executing_queries) {
+  QueryResourceUsage usage;
+  get().recordQueryStart("executing_query_1");
+  get().recordQueryStart("executing_query_2");
+
+  // The first query to finish leaves the record of the other one.
+  get().recordQueryPerformance("executing_query_1", 10, 10, usage);
+
+  std::string started;
+  getDatabaseValue(
+      kPersistentSettings, "executing_query.executing_query_1", started);
+  EXPECT_TRUE(started.empty());
+  getDatabaseValue(
+      kPersistentSettings, "executing_query.executing_query_2", started);
+  EXPECT_FALSE(started.empty());
+
+  // Each thread sees the query it runs.
+  EXPECT_EQ(Config::getExecutingQuery(), "executing_query_2");
+  std::thread([]() {
+    EXPECT_TRUE(Config::getExecutingQuery().empty());
+  }).join();
+
+  // A query still running when the process stopped is denylisted.
+  get().recordQueryStart("executing_query_3");
+
+  std::map<std::string, uint64_t> denylist;
+  auto failed_queries = denylistExecutingQueries(denylist);
+  std::sort(failed_queries.begin(), failed_queries.end());
+
+  std::vector<std::string> expected = {"executing_query_2",
+                                       "executing_query_3"};
+  EXPECT_EQ(failed_queries, expected);
+  EXPECT_EQ(denylist.size(), 2U);
+  EXPECT_EQ(denylist.count("executing_query_1"), 0U);
+
+  // The records are removed once denylisted.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kPersistentSettings, keys, "executing_query.");
+  EXPECT_TRUE(keys.empty());
+  std::string executing_query;
+  getDatabaseValue(kPersistentSettings, kExecutingQuery, executing_query);
+  EXPECT_TRUE(executing_query.empty());
+
+  // The single key written by older versions is still honored.
+  setDatabaseValue(kPersistentSettings, kExecutingQuery, "executing_query_4");
+  denylist.clear();
+  failed_queries = denylistExecutingQueries(denylist);
+  ASSERT_EQ(failed_queries.size(), 1U);
+  EXPECT_EQ(failed_queries[0], "executing_query_4");
+  EXPECT_EQ(denylist.count("executing_query_4"), 1U);
+
+  get().recordQueryPerformance("executing_query_2", 10, 10, usage);
+  get().recordQueryPerformance("executing_query_3", 10, 10, usage);
+  EXPECT_TRUE(Config::getExecutingQuery().empty());
+}
+
 TEST_F(ConfigTests, test_pack_removal) {
   size_t pack_count = 0;
   get().packs(([&pack_count](const Pack& pack) { pack_count++; }));
@@ -871,6 +871,9 @@ int Initializer::shutdown(int retcode) const {
 
   // Request that all services stop.
   Dispatcher::stopServices();
+  // A query may keep the scheduler from stopping before the watchdog kills
+  // this worker, write its batched performance stats first.
+  Config::flushQueryPerformance();
   // Attempt to be the only place in code where a join is attempted.
   Dispatcher::joinServices();
   // End any event type run loops.
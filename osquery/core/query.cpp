@@ -8,22 +8,29 @@
  */
 
 #include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 
 namespace rj = rapidjson;
 
 namespace osquery {
 
 DECLARE_bool(decorations_top_level);
+DECLARE_bool(database_binary_rows);
 
 /// Log numeric values as numbers (in JSON syntax)
 FLAG(bool,
@@ -32,6 +39,64 @@ FLAG(bool,
      "Use numeric JSON syntax for numeric values");
 FLAG_ALIAS(bool, log_numerics_as_numbers, logger_numerics);
 
+FLAG(bool,
+     differential_hashing,
+     false,
+     "Store scheduled query results as row fingerprints for differentials");
+
+namespace {
+
+/// Query names whose fingerprint index was already dropped by this process.
+std::set<std::string> kUnhashedQueries;
+Mutex kUnhashedQueriesMutex;
+
+/// Each fingerprint is stored as a fixed-width hex string.
+const size_t kRowHashWidth = 16;
+
+std::string rowHashToString(uint64_t hash) {
+  char buffer[kRowHashWidth + 1] = {0};
+  snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+  return std::string(buffer, kRowHashWidth);
+}
+
+std::string rowHashKey(const std::string& name, uint64_t hash) {
+  return name + "." + rowHashToString(hash);
+}
+
+std::string serializeRowHashes(const RowHashes& hashes) {
+  std::string index;
+  index.reserve(hashes.size() * kRowHashWidth);
+  for (const auto& hash : hashes) {
+    index += rowHashToString(hash);
+  }
+  return index;
+}
+
+Status deserializeRowHashes(const std::string& index, RowHashes& hashes) {
+  if (index.size() % kRowHashWidth != 0) {
+    return Status::failure("Invalid row fingerprint index");
+  }
+
+  hashes.clear();
+  hashes.reserve(index.size() / kRowHashWidth);
+  for (size_t i = 0; i < index.size(); i += kRowHashWidth) {
+    char* end = nullptr;
+    auto chunk = index.substr(i, kRowHashWidth);
+    auto hash = std::strtoull(chunk.c_str(), &end, 16);
+    if (end == nullptr || *end != '\0') {
+      return Status::failure("Invalid row fingerprint index");
+    }
+    hashes.push_back(hash);
+  }
+
+  if (!std::is_sorted(hashes.begin(), hashes.end())) {
+    std::sort(hashes.begin(), hashes.end());
+  }
+  return Status::success();
+}
+
+} // namespace
+
 uint64_t Query::getPreviousEpoch() const {
   uint64_t epoch = 0;
   std::string raw;
@@ -64,14 +129,51 @@ uint64_t Query::getQueryCounter(bool is_reset,
   return counter;
 }
 
+bool Query::getPreviousRowHashes(RowHashes& hashes) const {
+  std::string index;
+  if (!getDatabaseValue(kQueryResultRows, name_, index).ok()) {
+    return false;
+  }
+  return deserializeRowHashes(index, hashes).ok();
+}
+
+Status Query::getHashedQueryResults(const RowHashes& hashes,
+                                    QueryDataSet& results) const {
+  for (const auto& hash : hashes) {
+    std::string json;
+    auto status =
+        getDatabaseValue(kQueryResultRows, rowHashKey(name_, hash), json);
+    if (!status.ok()) {
+      return status;
+    }
+
+    RowTyped row;
+    status = deserializeRowJSON(json, row);
+    if (!status.ok()) {
+      return status;
+    }
+    results.insert(std::move(row));
+  }
+  return Status::success();
+}
+
 Status Query::getPreviousQueryResults(QueryDataSet& results) const {
+  RowHashes hashes;
+  if (FLAGS_differential_hashing && getPreviousRowHashes(hashes)) {
+    return getHashedQueryResults(hashes, results);
+  }
+
   std::string raw;
   auto status = getDatabaseValue(kQueries, name_, raw);
   if (!status.ok()) {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  if (isBinaryRowData(raw)) {
+    status = deserializeQueryDataBinary(raw, results);
+  } else {
+    status = deserializeQueryDataJSON(raw, results);
+  }
   if (!status.ok()) {
     return status;
   }
@@ -93,6 +195,63 @@ std::vector<std::string> Query::getStoredQueryNames() {
   return results;
 }
 
+Status Query::removeHashedResults(const std::string& name) {
+  std::string index;
+  if (!getDatabaseValue(kQueryResultRows, name, index).ok()) {
+    return Status::success();
+  }
+
+  RowHashes hashes;
+  std::vector<std::string> keys;
+  if (deserializeRowHashes(index, hashes).ok()) {
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    for (const auto& hash : hashes) {
+      keys.push_back(rowHashKey(name, hash));
+    }
+  }
+  keys.push_back(name);
+  return deleteDatabaseBatch(kQueryResultRows, keys);
+}
+
+Status Query::restoreUnhashedResults() const {
+  {
+    // The index is only looked for once, it is not written without hashing.
+    WriteLock lock(kUnhashedQueriesMutex);
+    if (!kUnhashedQueries.insert(name_).second) {
+      return Status::success();
+    }
+  }
+
+  RowHashes hashes;
+  if (!getPreviousRowHashes(hashes)) {
+    return Status::success();
+  }
+
+  // The stored results were replaced by the index, rebuild them from it.
+  QueryDataSet previous_qd;
+  auto status = getHashedQueryResults(hashes, previous_qd);
+  if (status.ok()) {
+    QueryDataTyped previous(previous_qd.begin(), previous_qd.end());
+    std::string data;
+    status = FLAGS_database_binary_rows
+                 ? serializeQueryDataBinary(previous, data)
+                 : serializeQueryDataJSON(previous, data, true);
+    if (status.ok()) {
+      status = setDatabaseValue(kQueries, name_, data);
+    }
+  }
+
+  // An index left in place would be reused if hashing is turned back on.
+  if (status.ok()) {
+    status = removeHashedResults(name_);
+  }
+  if (!status.ok()) {
+    WriteLock lock(kUnhashedQueriesMutex);
+    kUnhashedQueries.erase(name_);
+  }
+  return status;
+}
+
 bool Query::isQueryNameInDatabase() const {
   auto names = Query::getStoredQueryNames();
   return std::find(names.begin(), names.end(), name_) != names.end();
@@ -164,10 +323,21 @@ Status Query::addNewResults(QueryDataTyped current_qd,
                             const uint64_t current_epoch,
                             uint64_t& counter,
                             DiffResults& dr) const {
+  if (FLAGS_differential_hashing) {
+    return addNewResultsHashed(
+        std::move(current_qd), current_epoch, counter, dr);
+  }
+
   bool new_query_epoch = false;
   bool new_query_sql = false;
   getQueryStatus(current_epoch, new_query_epoch, new_query_sql);
 
+  // Results from an earlier run with hashing enabled are kept in the index.
+  auto status = restoreUnhashedResults();
+  if (!status.ok()) {
+    return status;
+  }
+
   // Use a 'target' avoid copying the query data when serializing and saving.
   // If a differential is requested and needed the target remains the original
   // query data, otherwise the content is moved to the differential's added set.
@@ -176,7 +346,7 @@ Status Query::addNewResults(QueryDataTyped current_qd,
   if (!new_query_epoch) {
     // Get the rows from the last run of this query name.
     QueryDataSet previous_qd;
-    auto status = getPreviousQueryResults(previous_qd);
+    status = getPreviousQueryResults(previous_qd);
     if (!status.ok()) {
       return status;
     }
@@ -192,19 +362,169 @@ Status Query::addNewResults(QueryDataTyped current_qd,
 
   if (update_db) {
     // Replace the "previous" query data with the current.
-    std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json, true);
+    std::string data;
+    status = FLAGS_database_binary_rows
+                 ? serializeQueryDataBinary(*target_gd, data)
+                 : serializeQueryDataJSON(*target_gd, data, true);
     if (!status.ok()) {
       return status;
     }
 
-    status = saveQueryResults(json, current_epoch);
+    status = saveQueryResults(data, current_epoch);
     if (!status.ok()) {
       return status;
     }
   }
 
   if (update_db || new_query_epoch) {
+    status = incrementCounter(new_query_epoch, true, counter);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
+Status Query::addNewResultsHashed(QueryDataTyped current_qd,
+                                  const uint64_t current_epoch,
+                                  uint64_t& counter,
+                                  DiffResults& dr) const {
+  bool new_query_epoch = false;
+  bool new_query_sql = false;
+  getQueryStatus(current_epoch, new_query_epoch, new_query_sql);
+
+  {
+    // Look for the index again if hashing is turned off later.
+    WriteLock lock(kUnhashedQueriesMutex);
+    kUnhashedQueries.erase(name_);
+  }
+
+  // Rows from a JSON result set stored before fingerprints were enabled.
+  // They are only used once, to migrate the previous results.
+  std::multimap<uint64_t, RowTyped> legacy_rows;
+  RowHashes previous;
+  bool migrate = false;
+  if (!getPreviousRowHashes(previous)) {
+    QueryDataSet previous_qd;
+    if (getPreviousQueryResults(previous_qd).ok()) {
+      for (auto& row : previous_qd) {
+        auto hash = hashRow(row);
+        previous.push_back(hash);
+        legacy_rows.emplace(hash, row);
+      }
+      std::sort(previous.begin(), previous.end());
+    }
+    migrate = true;
+  }
+
+  RowHashes current;
+  std::vector<size_t> added;
+  RowHashes removed;
+  diffHashes(previous, current_qd, current, added, removed);
+
+  bool changed = !added.empty() || !removed.empty();
+  if (migrate || changed) {
+    // Write rows whose fingerprint is new, along with the updated index.
+    // When migrating the row store is empty and every row is written.
+    DatabaseStringValueList data;
+    auto add_row = [this, &data](const RowTyped& row, uint64_t hash) {
+      std::string json;
+      auto status = serializeRowJSON(row, json, true);
+      if (status.ok()) {
+        data.push_back(
+            std::make_pair(rowHashKey(name_, hash), std::move(json)));
+      }
+      return status;
+    };
+
+    if (migrate) {
+      for (const auto& row : current_qd) {
+        auto status = add_row(row, hashRow(row));
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    } else {
+      for (const auto& i : added) {
+        auto hash = hashRow(current_qd[i]);
+        if (std::binary_search(previous.begin(), previous.end(), hash)) {
+          continue;
+        }
+
+        auto status = add_row(current_qd[i], hash);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+
+    data.push_back(std::make_pair(name_, serializeRowHashes(current)));
+    auto status = setDatabaseBatch(kQueryResultRows, data);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // Removed rows are only read back when they will be reported.
+  if (!new_query_epoch) {
+    for (const auto& hash : removed) {
+      auto legacy = legacy_rows.find(hash);
+      if (legacy != legacy_rows.end()) {
+        dr.removed.push_back(std::move(legacy->second));
+        legacy_rows.erase(legacy);
+        continue;
+      }
+
+      std::string json;
+      auto status =
+          getDatabaseValue(kQueryResultRows, rowHashKey(name_, hash), json);
+      if (!status.ok()) {
+        return status;
+      }
+
+      RowTyped row;
+      status = deserializeRowJSON(json, row);
+      if (!status.ok()) {
+        return status;
+      }
+      dr.removed.push_back(std::move(row));
+    }
+    // Match the ordering of the multiset-based differential.
+    std::sort(dr.removed.begin(), dr.removed.end());
+  }
+
+  // Drop row store entries that are no longer referenced.
+  if (!migrate) {
+    std::vector<std::string> keys;
+    auto last = std::unique(removed.begin(), removed.end());
+    for (auto it = removed.begin(); it != last; ++it) {
+      if (!std::binary_search(current.begin(), current.end(), *it)) {
+        keys.push_back(rowHashKey(name_, *it));
+      }
+    }
+    auto status = deleteDatabaseBatch(kQueryResultRows, keys);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (new_query_epoch) {
+    dr.added = std::move(current_qd);
+  } else {
+    for (const auto& i : added) {
+      dr.added.push_back(std::move(current_qd[i]));
+    }
+  }
+
+  if (new_query_epoch || migrate) {
+    // Keep the query name stored, the JSON results are no longer used.
+    auto status = saveQueryResults("[]", current_epoch);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (changed || new_query_epoch) {
     auto status = incrementCounter(new_query_epoch, true, counter);
     if (!status.ok()) {
       return status;
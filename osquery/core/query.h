@@ -232,6 +232,19 @@ class Query {
                        uint64_t& counter,
                        DiffResults& dr) const;
 
+  /**
+   * @brief Add new results using the stored row fingerprints.
+   *
+   * This is the --differential_hashing version of addNewResults. The previous
+   * results are kept as a sorted list of row fingerprints and a row store
+   * keyed by fingerprint. Only removed rows are read back and only changed
+   * rows are written.
+   */
+  Status addNewResultsHashed(QueryDataTyped qd,
+                             uint64_t epoch,
+                             uint64_t& counter,
+                             DiffResults& dr) const;
+
   /// A version of adding new results for events-based queries.
   Status addNewEvents(QueryDataTyped current_qd,
                       const uint64_t current_epoch,
@@ -259,6 +272,26 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+  /// Remove the fingerprint index and row store for a scheduled query name.
+  static Status removeHashedResults(const std::string& name);
+
+ private:
+  /// Read the fingerprint index, returns false if there is none stored.
+  bool getPreviousRowHashes(RowHashes& hashes) const;
+
+  /// Read the stored rows for each fingerprint of an index.
+  Status getHashedQueryResults(const RowHashes& hashes,
+                               QueryDataSet& results) const;
+
+  /**
+   * @brief Replace a fingerprint index with the results it stores.
+   *
+   * Results stored with differential hashing enabled leave only an empty
+   * result set. The first run without hashing in this process rebuilds them
+   * from the index, then removes the index.
+   */
+  Status restoreUnhashedResults() const;
+
  private:
   /// The scheduled query's query string.
   std::string query_;
@@ -274,6 +307,7 @@ class Query {
   FRIEND_TEST(QueryTests, test_get_executions);
   FRIEND_TEST(QueryTests, test_get_query_results);
   FRIEND_TEST(QueryTests, test_query_name_not_found_in_db);
+  FRIEND_TEST(QueryTests, test_add_hashed_results);
 };
 
 } // namespace osquery
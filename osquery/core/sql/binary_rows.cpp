@@ -0,0 +1,489 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "binary_rows.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/static_visitor.hpp>
+
+namespace osquery {
+
+namespace {
+
+/**
+ * Every binary value starts with the marker, the encoding version, and a
+ * record kind. The marker is a control character, which never starts JSON.
+ */
+const char kBinaryRowsMarker = '\x01';
+const size_t kBinaryRowsHeaderSize = 3;
+
+enum RecordKind : char {
+  kRowRecord = 'r',
+  kQueryDataRecord = 'q',
+  kDictionaryRecord = 'd',
+};
+
+enum ValueTag : char {
+  kStringTag = 's',
+  kIntegerTag = 'i',
+  kDoubleTag = 'f',
+};
+
+void writeHeader(RecordKind kind, std::string& data) {
+  data.push_back(kBinaryRowsMarker);
+  data.push_back(static_cast<char>(kBinaryRowsVersion));
+  data.push_back(kind);
+}
+
+void writeVarint(uint64_t value, std::string& data) {
+  while (value >= 0x80) {
+    data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  data.push_back(static_cast<char>(value));
+}
+
+void writeString(const std::string& value, std::string& data) {
+  writeVarint(value.size(), data);
+  data.append(value);
+}
+
+void writeInteger(long long value, std::string& data) {
+  // Zigzag encode so small negative values stay short.
+  auto v = static_cast<uint64_t>(value);
+  data.push_back(kIntegerTag);
+  writeVarint((v << 1) ^ (value < 0 ? ~uint64_t{0} : uint64_t{0}), data);
+}
+
+void writeDouble(double value, std::string& data) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  data.push_back(kDoubleTag);
+  for (size_t i = 0; i < sizeof(bits); ++i) {
+    data.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+  }
+}
+
+/// Only strings that print back identically may be stored as integers.
+bool isCanonicalInteger(const std::string& value, long long& integer) {
+  if (value.empty() || value.size() > 20) {
+    return false;
+  }
+
+  size_t start = (value[0] == '-') ? 1 : 0;
+  if (start == value.size()) {
+    return false;
+  }
+
+  if (value[start] == '0' && (value.size() != start + 1 || start == 1)) {
+    return false;
+  }
+
+  for (size_t i = start; i < value.size(); ++i) {
+    if (value[i] < '0' || value[i] > '9') {
+      return false;
+    }
+  }
+
+  errno = 0;
+  integer = std::strtoll(value.c_str(), nullptr, 10);
+  return errno != ERANGE;
+}
+
+class BinaryValueWriter : public boost::static_visitor<> {
+ public:
+  explicit BinaryValueWriter(std::string& data) : data_(data) {}
+
+  void operator()(long long i) const {
+    writeInteger(i, data_);
+  }
+
+  void operator()(double d) const {
+    writeDouble(d, data_);
+  }
+
+  void operator()(const std::string& s) const {
+    data_.push_back(kStringTag);
+    writeString(s, data_);
+  }
+
+ private:
+  std::string& data_;
+};
+
+void writeRowBody(const Row& r, ColumnDictionary& columns, std::string& data) {
+  writeVarint(r.size(), data);
+  for (const auto& column : r) {
+    writeVarint(columns.getOrAdd(column.first), data);
+
+    long long integer = 0;
+    if (isCanonicalInteger(column.second, integer)) {
+      writeInteger(integer, data);
+    } else {
+      data.push_back(kStringTag);
+      writeString(column.second, data);
+    }
+  }
+}
+
+void writeRowBody(const RowTyped& r,
+                  ColumnDictionary& columns,
+                  std::string& data) {
+  BinaryValueWriter writer(data);
+  writeVarint(r.size(), data);
+  for (const auto& column : r) {
+    writeVarint(columns.getOrAdd(column.first), data);
+    boost::apply_visitor(writer, column.second);
+  }
+}
+
+void writeDictionary(const ColumnDictionary& columns, std::string& data) {
+  writeVarint(columns.size(), data);
+  for (const auto& name : columns.names()) {
+    writeString(name, data);
+  }
+}
+
+/// Write the rows after the dictionary of the columns they use.
+template <typename QueryDataType>
+Status writeQueryData(const QueryDataType& q, std::string& data) {
+  ColumnDictionary columns;
+  std::string rows;
+  writeVarint(q.size(), rows);
+  for (const auto& r : q) {
+    writeRowBody(r, columns, rows);
+  }
+
+  data.clear();
+  writeHeader(kQueryDataRecord, data);
+  writeDictionary(columns, data);
+  data.append(rows);
+  return Status::success();
+}
+
+/// A bounds-checked cursor over a binary value.
+class BinaryReader {
+ public:
+  explicit BinaryReader(const std::string& data)
+      : pos_(data.data()), end_(data.data() + data.size()) {}
+
+  bool done() const {
+    return pos_ == end_;
+  }
+
+  bool readByte(char& value) {
+    if (pos_ == end_) {
+      return false;
+    }
+    value = *pos_++;
+    return true;
+  }
+
+  bool readVarint(uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      char byte = 0;
+      if (!readByte(byte)) {
+        return false;
+      }
+
+      auto bits = static_cast<uint8_t>(byte);
+      value |= static_cast<uint64_t>(bits & 0x7f) << shift;
+      if ((bits & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readString(std::string& value) {
+    uint64_t size = 0;
+    if (!readVarint(size) || size > static_cast<uint64_t>(end_ - pos_)) {
+      return false;
+    }
+    value.assign(pos_, static_cast<size_t>(size));
+    pos_ += size;
+    return true;
+  }
+
+  bool readValue(RowDataTyped& value) {
+    char tag = 0;
+    if (!readByte(tag)) {
+      return false;
+    }
+
+    if (tag == kStringTag) {
+      std::string s;
+      if (!readString(s)) {
+        return false;
+      }
+      value = std::move(s);
+    } else if (tag == kIntegerTag) {
+      uint64_t v = 0;
+      if (!readVarint(v)) {
+        return false;
+      }
+      value = static_cast<long long>((v >> 1) ^ (~(v & 1) + 1));
+    } else if (tag == kDoubleTag) {
+      if (end_ - pos_ < static_cast<ptrdiff_t>(sizeof(uint64_t))) {
+        return false;
+      }
+
+      uint64_t bits = 0;
+      for (size_t i = 0; i < sizeof(bits); ++i) {
+        auto byte = static_cast<uint8_t>(*pos_++);
+        bits |= static_cast<uint64_t>(byte) << (i * 8);
+      }
+
+      double d = 0;
+      std::memcpy(&d, &bits, sizeof(d));
+      value = d;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+Status readHeader(BinaryReader& reader, RecordKind kind) {
+  char marker = 0;
+  char version = 0;
+  char record = 0;
+  if (!reader.readByte(marker) || marker != kBinaryRowsMarker ||
+      !reader.readByte(version) || !reader.readByte(record)) {
+    return Status::failure("Not a binary row encoding");
+  }
+
+  if (static_cast<uint8_t>(version) != kBinaryRowsVersion) {
+    return Status::failure("Unsupported binary row encoding version: " +
+                           std::to_string(static_cast<uint8_t>(version)));
+  }
+
+  if (record != kind) {
+    return Status::failure("Unexpected binary record kind");
+  }
+  return Status::success();
+}
+
+Status readDictionary(BinaryReader& reader, ColumnDictionary& columns) {
+  uint64_t count = 0;
+  if (!reader.readVarint(count)) {
+    return Status::failure("Malformed column dictionary");
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    std::string name;
+    if (!reader.readString(name) || columns.getOrAdd(name) != i) {
+      return Status::failure("Malformed column dictionary");
+    }
+  }
+  return Status::success();
+}
+
+Status readRowBody(BinaryReader& reader,
+                   const ColumnDictionary& columns,
+                   RowTyped& r) {
+  uint64_t count = 0;
+  if (!reader.readVarint(count)) {
+    return Status::failure("Malformed binary row");
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t id = 0;
+    RowDataTyped value;
+    if (!reader.readVarint(id) || !reader.readValue(value)) {
+      return Status::failure("Malformed binary row");
+    }
+
+    const auto* name = columns.getName(static_cast<size_t>(id));
+    if (name == nullptr) {
+      return Status::failure("Unknown column identifier in binary row");
+    }
+
+    if (!r.emplace(*name, std::move(value)).second) {
+      return Status::failure("Duplicate column in binary row");
+    }
+  }
+  return Status::success();
+}
+
+/// Convert a decoded row back to strings, as it was before encoding.
+Status toRow(RowTyped& typed, Row& r) {
+  for (auto& column : typed) {
+    auto& value = column.second;
+    if (value.which() == 0) {
+      r[column.first] = std::to_string(boost::get<long long>(value));
+    } else if (value.which() == 2) {
+      r[column.first] = std::move(boost::get<std::string>(value));
+    } else {
+      return Status::failure("Unexpected value type in binary row");
+    }
+  }
+  return Status::success();
+}
+
+template <typename Inserter>
+Status readQueryData(const std::string& data, Inserter insert) {
+  BinaryReader reader(data);
+  auto status = readHeader(reader, kQueryDataRecord);
+  if (!status.ok()) {
+    return status;
+  }
+
+  ColumnDictionary columns;
+  status = readDictionary(reader, columns);
+  if (!status.ok()) {
+    return status;
+  }
+
+  uint64_t count = 0;
+  if (!reader.readVarint(count)) {
+    return Status::failure("Malformed binary query data");
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    RowTyped r;
+    status = readRowBody(reader, columns, r);
+    if (!status.ok()) {
+      return status;
+    }
+
+    status = insert(std::move(r));
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (!reader.done()) {
+    return Status::failure("Trailing bytes in binary query data");
+  }
+  return Status::success();
+}
+
+} // namespace
+
+size_t ColumnDictionary::getOrAdd(const std::string& column) {
+  auto it = ids_.find(column);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+
+  auto id = names_.size();
+  names_.push_back(column);
+  ids_.emplace(column, id);
+  return id;
+}
+
+const std::string* ColumnDictionary::getName(size_t id) const {
+  return (id < names_.size()) ? &names_[id] : nullptr;
+}
+
+bool isBinaryRowData(const std::string& data) {
+  return data.size() >= kBinaryRowsHeaderSize && data[0] == kBinaryRowsMarker;
+}
+
+Status serializeColumnDictionary(const ColumnDictionary& columns,
+                                 std::string& data) {
+  data.clear();
+  writeHeader(kDictionaryRecord, data);
+  writeDictionary(columns, data);
+  return Status::success();
+}
+
+Status deserializeColumnDictionary(const std::string& data,
+                                   ColumnDictionary& columns) {
+  BinaryReader reader(data);
+  auto status = readHeader(reader, kDictionaryRecord);
+  if (!status.ok()) {
+    return status;
+  }
+
+  ColumnDictionary result;
+  status = readDictionary(reader, result);
+  if (!status.ok()) {
+    return status;
+  }
+
+  columns = std::move(result);
+  return Status::success();
+}
+
+Status serializeRowBinary(const Row& r,
+                          ColumnDictionary& columns,
+                          std::string& data) {
+  data.clear();
+  writeHeader(kRowRecord, data);
+  writeRowBody(r, columns, data);
+  return Status::success();
+}
+
+Status deserializeRowBinary(const std::string& data,
+                            const ColumnDictionary& columns,
+                            Row& r) {
+  BinaryReader reader(data);
+  auto status = readHeader(reader, kRowRecord);
+  if (!status.ok()) {
+    return status;
+  }
+
+  RowTyped typed;
+  status = readRowBody(reader, columns, typed);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (!reader.done()) {
+    return Status::failure("Trailing bytes in binary row");
+  }
+
+  return toRow(typed, r);
+}
+
+Status serializeQueryDataBinary(const QueryDataTyped& q, std::string& data) {
+  return writeQueryData(q, data);
+}
+
+Status serializeQueryDataBinary(const QueryData& q, std::string& data) {
+  return writeQueryData(q, data);
+}
+
+Status deserializeQueryDataBinary(const std::string& data, QueryDataTyped& q) {
+  return readQueryData(data, [&q](RowTyped&& r) {
+    q.push_back(std::move(r));
+    return Status::success();
+  });
+}
+
+Status deserializeQueryDataBinary(const std::string& data, QueryDataSet& q) {
+  return readQueryData(data, [&q](RowTyped&& r) {
+    q.insert(std::move(r));
+    return Status::success();
+  });
+}
+
+Status deserializeQueryDataBinary(const std::string& data, QueryData& q) {
+  return readQueryData(data, [&q](RowTyped&& r) {
+    Row row;
+    auto status = toRow(r, row);
+    if (status.ok()) {
+      q.push_back(std::move(row));
+    }
+    return status;
+  });
+}
+
+} // namespace osquery
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The current version of the binary row encoding.
+const uint8_t kBinaryRowsVersion = 1;
+
+/**
+ * @brief An append-only mapping of column names to compact identifiers.
+ *
+ * Binary encoded rows refer to their columns by position in a dictionary.
+ * Event subscribers keep one dictionary for all of their stored events, and
+ * each stored scheduled query result set embeds its own.
+ */
+class ColumnDictionary {
+ public:
+  /// Return the identifier of a column, adding the column if it is new.
+  size_t getOrAdd(const std::string& column);
+
+  /// Return the column name for an identifier, nullptr if it is unknown.
+  const std::string* getName(size_t id) const;
+
+  /// The column names, ordered by identifier.
+  const ColumnNames& names() const {
+    return names_;
+  }
+
+  size_t size() const {
+    return names_.size();
+  }
+
+ private:
+  ColumnNames names_;
+  std::unordered_map<std::string, size_t> ids_;
+};
+
+/**
+ * @brief Check if a stored value uses the binary row encoding.
+ *
+ * Binary values start with a marker byte that cannot begin a JSON document,
+ * so both encodings may be read from the same domain.
+ */
+bool isBinaryRowData(const std::string& data);
+
+/**
+ * @brief Serialize a ColumnDictionary into a binary string.
+ *
+ * @param columns the dictionary to serialize.
+ * @param data [output] the output binary string.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeColumnDictionary(const ColumnDictionary& columns,
+                                 std::string& data);
+
+/**
+ * @brief Deserialize a ColumnDictionary from a binary string.
+ *
+ * @param data the input binary string.
+ * @param columns [output] the output dictionary.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeColumnDictionary(const std::string& data,
+                                   ColumnDictionary& columns);
+
+/**
+ * @brief Serialize a Row into a binary string.
+ *
+ * Columns missing from the dictionary are added to it, the caller is
+ * responsible for storing the updated dictionary. Values that are canonical
+ * decimal integers are stored as varints.
+ *
+ * @param r the Row to serialize.
+ * @param columns the dictionary used to encode column names.
+ * @param data [output] the output binary string.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeRowBinary(const Row& r,
+                          ColumnDictionary& columns,
+                          std::string& data);
+
+/**
+ * @brief Deserialize a Row from a binary string.
+ *
+ * @param data the input binary string.
+ * @param columns the dictionary used when the Row was serialized.
+ * @param r [output] the output Row.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeRowBinary(const std::string& data,
+                            const ColumnDictionary& columns,
+                            Row& r);
+
+/**
+ * @brief Serialize a QueryDataTyped into a self-contained binary string.
+ *
+ * The column dictionary is written ahead of the rows.
+ *
+ * @param q the QueryDataTyped to serialize.
+ * @param data [output] the output binary string.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryDataBinary(const QueryDataTyped& q, std::string& data);
+
+/**
+ * @brief Serialize a QueryData into a self-contained binary string.
+ *
+ * As with serializeRowBinary, canonical decimal integers are stored as
+ * varints and read back as the same strings.
+ *
+ * @param q the QueryData to serialize.
+ * @param data [output] the output binary string.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryDataBinary(const QueryData& q, std::string& data);
+
+/// Inverse of serializeQueryDataBinary, convert a binary string to QueryData.
+Status deserializeQueryDataBinary(const std::string& data, QueryDataTyped& q);
+
+/// Inverse of serializeQueryDataBinary, append the rows to a QueryData.
+Status deserializeQueryDataBinary(const std::string& data, QueryData& q);
+
+/// Inverse of serializeQueryDataBinary, convert a binary string to a set.
+Status deserializeQueryDataBinary(const std::string& data, QueryDataSet& q);
+
+} // namespace osquery
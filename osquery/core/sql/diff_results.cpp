@@ -9,6 +9,10 @@
 
 #include "diff_results.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
 namespace rj = rapidjson;
 
 namespace osquery {
@@ -69,4 +73,117 @@ DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
   return r;
 }
 
+namespace {
+
+const uint64_t kFNVOffsetBasis = 0xcbf29ce484222325ULL;
+const uint64_t kFNVPrime = 0x100000001b3ULL;
+
+inline void hashBytes(uint64_t& h, const void* data, size_t size) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    h ^= bytes[i];
+    h *= kFNVPrime;
+  }
+}
+
+inline void hashInteger(uint64_t& h, uint64_t value) {
+  // Hash little-endian bytes so the fingerprint does not depend on the host.
+  for (size_t i = 0; i < sizeof(value); ++i) {
+    h ^= static_cast<unsigned char>(value >> (i * 8));
+    h *= kFNVPrime;
+  }
+}
+
+inline void hashSizedBytes(uint64_t& h, const void* data, size_t size) {
+  // Prefix each field with its length so adjacent fields cannot alias.
+  hashInteger(h, size);
+  hashBytes(h, data, size);
+}
+
+class RowValueHasher : public boost::static_visitor<> {
+ public:
+  explicit RowValueHasher(uint64_t& h) : h_(h) {}
+
+  void operator()(long long i) const {
+    unsigned char tag = 0;
+    hashBytes(h_, &tag, sizeof(tag));
+    hashInteger(h_, static_cast<uint64_t>(i));
+  }
+
+  void operator()(double d) const {
+    unsigned char tag = 1;
+    hashBytes(h_, &tag, sizeof(tag));
+    uint64_t bits = 0;
+    std::memcpy(&bits, &d, sizeof(bits));
+    hashInteger(h_, bits);
+  }
+
+  void operator()(const std::string& str) const {
+    unsigned char tag = 2;
+    hashBytes(h_, &tag, sizeof(tag));
+    hashSizedBytes(h_, str.data(), str.size());
+  }
+
+ private:
+  uint64_t& h_;
+};
+
+} // namespace
+
+uint64_t hashRow(const RowTyped& r) {
+  uint64_t h = kFNVOffsetBasis;
+  RowValueHasher hasher(h);
+  for (const auto& column : r) {
+    hashSizedBytes(h, column.first.data(), column.first.size());
+    boost::apply_visitor(hasher, column.second);
+  }
+
+  // Finalize with a 64-bit mix, FNV alone has weak high bits.
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void diffHashes(const RowHashes& old_,
+                const QueryDataTyped& new_,
+                RowHashes& new_hashes,
+                std::vector<size_t>& added,
+                RowHashes& removed) {
+  std::vector<std::pair<uint64_t, size_t>> current;
+  current.reserve(new_.size());
+  for (size_t i = 0; i < new_.size(); ++i) {
+    current.emplace_back(hashRow(new_[i]), i);
+  }
+  std::sort(current.begin(), current.end());
+
+  new_hashes.clear();
+  new_hashes.reserve(current.size());
+  for (const auto& item : current) {
+    new_hashes.push_back(item.first);
+  }
+
+  // Both sides are sorted, a single merge pass finds the difference.
+  added.clear();
+  removed.clear();
+  size_t i = 0;
+  size_t j = 0;
+  while (i < old_.size() || j < current.size()) {
+    if (j == current.size() ||
+        (i < old_.size() && old_[i] < current[j].first)) {
+      removed.push_back(old_[i++]);
+    } else if (i == old_.size() || current[j].first < old_[i]) {
+      added.push_back(current[j++].second);
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+
+  // Report added rows in the order they were returned by the query.
+  std::sort(added.begin(), added.end());
+}
+
 } // namespace osquery
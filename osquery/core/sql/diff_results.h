@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <osquery/core/sql/query_data.h>
 
 namespace osquery {
@@ -96,4 +99,35 @@ Status serializeDiffResultsJSON(const DiffResults& d,
  */
 DiffResults diff(QueryDataSet& old_, QueryDataTyped& new_);
 
+/// Sorted 64-bit row fingerprints, one entry per row including duplicates.
+using RowHashes = std::vector<uint64_t>;
+
+/**
+ * @brief Compute a stable 64-bit fingerprint of a typed row.
+ *
+ * The fingerprint covers column names, value types, and values. Numbers are
+ * hashed in a fixed byte order, so the fingerprint does not depend on the
+ * process, build, or host and may be persisted between runs.
+ */
+uint64_t hashRow(const RowTyped& r);
+
+/**
+ * @brief Compute a differential using row fingerprints.
+ *
+ * This is the fingerprint equivalent of diff, with multiset semantics: a row
+ * present N times in old_ and M times in new_ is added or removed |N - M|
+ * times.
+ *
+ * @param old_ the sorted fingerprints of the previous results.
+ * @param new_ the current results.
+ * @param new_hashes [output] the sorted fingerprints of new_.
+ * @param added [output] ascending indexes into new_ of the added rows.
+ * @param removed [output] the sorted fingerprints of the removed rows.
+ */
+void diffHashes(const RowHashes& old_,
+                const QueryDataTyped& new_,
+                RowHashes& new_hashes,
+                std::vector<size_t>& added,
+                RowHashes& removed);
+
 } // namespace osquery
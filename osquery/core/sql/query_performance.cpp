@@ -45,6 +45,12 @@ QueryPerformance::QueryPerformance(const std::string& csv) {
   average_memory = convert<std::uint64_t>(parts[9]);
   last_memory = convert<std::uint64_t>(parts[10]);
   output_size = convert<std::uint64_t>(parts[11]);
+
+  // The hardware counters were added later, older stats do not have them.
+  if (parts.size() >= 14) {
+    instructions = convert<std::uint64_t>(parts[12]);
+    cache_misses = convert<std::uint64_t>(parts[13]);
+  }
 }
 
 std::string QueryPerformance::toCSV() const {
@@ -55,7 +61,8 @@ std::string QueryPerformance::toCSV() const {
          "," + std::to_string(system_time) + "," +
          std::to_string(last_system_time) + "," +
          std::to_string(average_memory) + "," + std::to_string(last_memory) +
-         "," + std::to_string(output_size);
+         "," + std::to_string(output_size) + "," +
+         std::to_string(instructions) + "," + std::to_string(cache_misses);
 }
 
 bool operator==(const QueryPerformance& l, const QueryPerformance& r) {
@@ -70,18 +77,22 @@ bool operator==(const QueryPerformance& l, const QueryPerformance& r) {
                   l.last_system_time,
                   l.average_memory,
                   l.last_memory,
-                  l.output_size) == std::tie(r.executions,
-                                             r.last_executed,
-                                             r.wall_time,
-                                             r.wall_time_ms,
-                                             r.last_wall_time_ms,
-                                             r.user_time,
-                                             r.last_user_time,
-                                             r.system_time,
-                                             r.last_system_time,
-                                             r.average_memory,
-                                             r.last_memory,
-                                             r.output_size);
+                  l.output_size,
+                  l.instructions,
+                  l.cache_misses) == std::tie(r.executions,
+                                              r.last_executed,
+                                              r.wall_time,
+                                              r.wall_time_ms,
+                                              r.last_wall_time_ms,
+                                              r.user_time,
+                                              r.last_user_time,
+                                              r.system_time,
+                                              r.last_system_time,
+                                              r.average_memory,
+                                              r.last_memory,
+                                              r.output_size,
+                                              r.instructions,
+                                              r.cache_misses);
 }
 
 } // namespace osquery
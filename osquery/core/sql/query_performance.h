@@ -15,6 +15,29 @@
 
 namespace osquery {
 
+/**
+ * @brief Resources used by a single query execution.
+ *
+ * Filled in by the query usage meter around the execution, the counters are
+ * 0 when unavailable on the platform.
+ */
+struct QueryResourceUsage {
+  /// User time in milliseconds
+  std::uint64_t user_time{0};
+
+  /// System time in milliseconds
+  std::uint64_t system_time{0};
+
+  /// Bytes the heap grew by after collecting results, 0 when not measured
+  std::uint64_t memory{0};
+
+  /// Instructions retired, when hardware counters are enabled
+  std::uint64_t instructions{0};
+
+  /// Last level cache misses, when hardware counters are enabled
+  std::uint64_t cache_misses{0};
+};
+
 /**
  * @brief performance statistics about a query
  */
@@ -46,17 +69,22 @@ struct QueryPerformance {
   /// System time in milliseconds of the latest execution
   std::uint64_t last_system_time{0};
 
-  /// Average of the bytes of resident memory left allocated
-  /// after collecting results
+  /// Average of the bytes the heap grew by after collecting results
   std::uint64_t average_memory{0};
 
-  /// Resident memory in bytes left allocated after collecting results
-  /// of the latest execution
+  /// Bytes the heap grew by after collecting results of the latest
+  /// measured execution
   std::uint64_t last_memory{0};
 
   /// Total bytes for the query
   std::uint64_t output_size{0};
 
+  /// Total instructions retired, when hardware counters are enabled
+  std::uint64_t instructions{0};
+
+  /// Total last level cache misses, when hardware counters are enabled
+  std::uint64_t cache_misses{0};
+
   // Default constructor
   QueryPerformance() = default;
 
@@ -41,6 +41,12 @@ struct ScheduledQuery : private only_movable {
   /// A temporary splayed internal.
   uint64_t splayed_interval{0};
 
+  /// Seconds the query may run before it is interrupted, 0 for the default.
+  uint64_t timeout{0};
+
+  /// Queries due in the same second start in decreasing priority.
+  int64_t priority{0};
+
   /**
    * @brief Queries are denylisted based on logic in the configuration.
    *
@@ -24,8 +24,8 @@ FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
 CREATE_LAZY_REGISTRY(TablePlugin, "table");
 
-uint64_t TablePlugin::kCacheInterval = 0;
-uint64_t TablePlugin::kCacheStep = 0;
+thread_local uint64_t TablePlugin::kCacheInterval = 0;
+thread_local uint64_t TablePlugin::kCacheStep = 0;
 
 #define kDisableRowId "WITHOUT ROWID"
 
@@ -192,6 +192,13 @@ PluginResponse TablePlugin::routeInfo() const {
   response.push_back(
       {{"id", "attributes"},
        {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+
+  auto hints = plannerHints();
+  if (hints.rows > 0 || hints.cost > 0) {
+    response.push_back({{"id", "plannerHints"},
+                        {"rows", INTEGER(hints.rows)},
+                        {"cost", INTEGER(hints.cost)}});
+  }
   return response;
 }
 
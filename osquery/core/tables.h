@@ -192,6 +192,9 @@ enum class TableAttributes {
 
   /// (Deprecated) This table's data requires an osquery kernel module.
   KERNEL_REQUIRED = 16,
+
+  /// IN lists on indexed columns are passed as one set of EQUALS constraints.
+  BATCHED_IN = 32,
 };
 
 /// Treat table attributes as a set of flags.
@@ -205,6 +208,20 @@ inline size_t operator&(TableAttributes a, TableAttributes b) {
   return static_cast<size_t>(a) & static_cast<size_t>(b);
 }
 
+/**
+ * @brief Estimates used by the SQLite planner to order table scans.
+ *
+ * Tables declare these in their spec with planner_hints. They are replaced
+ * by observed generate costs once the table has been scanned.
+ */
+struct TablePlannerHints {
+  /// Estimated number of rows returned by a scan without constraints.
+  uint64_t rows{0};
+
+  /// Estimated microseconds spent generating each row.
+  uint64_t cost{0};
+};
+
 /// Alias for an ordered list of column name and corresponding SQL type.
 using TableColumns =
     std::vector<std::tuple<std::string, ColumnType, ColumnOptions>>;
@@ -403,6 +420,9 @@ struct VirtualTableContent {
   /// passed to the SQL and optional Query for inspection.
   TableAttributes attributes{TableAttributes::NONE};
 
+  /// Planner hints, copied into the content like the attributes.
+  TablePlannerHints plannerHints;
+
   /**
    * @brief Table column aliases structure.
    *
@@ -421,6 +441,24 @@ struct VirtualTableContent {
   /// Transient set of virtual table used columns (as bitmasks)
   std::unordered_map<size_t, UsedColumnsBitset> colsUsedBitsets;
 
+  /// Transient set of constraint positions that receive a whole IN list.
+  std::unordered_map<size_t, std::set<size_t>> inListConstraints;
+
+  /// Indexes planned by cached statements, kept when queries are cleared.
+  std::set<size_t> cachedIndexes;
+
+  /**
+   * @brief Rows generated for repeated filter requests within a statement.
+   *
+   * A JOIN on an indexed column may filter the same table with the same
+   * constraints and used columns many times. The first repeat of a request
+   * keeps a copy of the generated rows and later repeats are served from it.
+   *
+   * The filter requests and memoized rows are expired after each statement.
+   */
+  std::set<std::string> filterRequests;
+  std::map<std::string, TableRows> filterMemo;
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -705,6 +743,11 @@ class TablePlugin : public Plugin {
     return TableAttributes::NONE;
   }
 
+  /// Return the estimates used to plan scans of the table.
+  virtual TablePlannerHints plannerHints() const {
+    return TablePlannerHints();
+  }
+
   /**
    * @brief Generate a complete table representation.
    *
@@ -850,14 +893,14 @@ class TablePlugin : public Plugin {
   /**
    * @brief The scheduled interval for the executing query.
    *
-   * Scheduled queries execute within a pseudo-mutex, and each may communicate
-   * their scheduled interval to internal TablePlugin implementations. If the
+   * Each scheduled query communicates its scheduled interval to internal
+   * TablePlugin implementations, through the thread running it. If the
    * table is cachable then the interval can be used to calculate freshness.
    */
-  static uint64_t kCacheInterval;
+  static thread_local uint64_t kCacheInterval;
 
-  /// The schedule step, this is the current position of the schedule.
-  static uint64_t kCacheStep;
+  /// The schedule step of the executing query, see kCacheInterval.
+  static thread_local uint64_t kCacheStep;
 
  public:
   /**
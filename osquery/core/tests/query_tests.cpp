@@ -25,6 +25,7 @@ namespace osquery {
 
 DECLARE_bool(disable_database);
 DECLARE_bool(logger_numerics);
+DECLARE_bool(differential_hashing);
 
 class QueryTests : public testing::Test {
  public:
@@ -156,6 +157,93 @@ TEST_F(QueryTests, test_add_and_get_current_results) {
   }
 }
 
+TEST_F(QueryTests, test_add_hashed_results) {
+  FLAGS_logger_numerics = true;
+  auto query = getOsqueryScheduledQuery();
+
+  // Start from a JSON result set to exercise the migration.
+  auto legacy = Query("hashed", query);
+  uint64_t counter = 0;
+  DiffResults dr;
+  auto status =
+      legacy.addNewResults(getTestDBExpectedResults(), 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+
+  FLAGS_differential_hashing = true;
+  auto cf = Query("hashed", query);
+  uint64_t expected_counter = counter + 1;
+  for (auto result : getTestDBResultStream()) {
+    QueryDataSet previous_qd;
+    status = cf.getPreviousQueryResults(previous_qd);
+    EXPECT_TRUE(status.ok());
+
+    DiffResults hashed_dr;
+    status = cf.addNewResults(result.second, 0, counter, hashed_dr);
+    EXPECT_TRUE(status.ok());
+
+    // The fingerprint differential must match the multiset differential.
+    DiffResults expected = diff(previous_qd, result.second);
+    EXPECT_EQ(hashed_dr, expected);
+    if (!expected.hasNoResults()) {
+      EXPECT_EQ(counter, expected_counter++);
+    }
+
+    QueryDataSet qds_previous;
+    cf.getPreviousQueryResults(qds_previous);
+
+    QueryDataSet qds(result.second.begin(), result.second.end());
+    EXPECT_EQ(qds_previous, qds);
+  }
+
+  // A new epoch reports every row as added and nothing as removed.
+  DiffResults epoch_dr;
+  auto rows = getTestDBExpectedResults();
+  status = cf.addNewResults(rows, 1, counter, epoch_dr);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(epoch_dr.added, rows);
+  EXPECT_TRUE(epoch_dr.removed.empty());
+  EXPECT_EQ(counter, 0UL);
+
+  EXPECT_TRUE(Query::removeHashedResults("hashed").ok());
+  std::string index;
+  EXPECT_FALSE(getDatabaseValue(kQueryResultRows, "hashed", index).ok());
+  FLAGS_differential_hashing = false;
+}
+
+TEST_F(QueryTests, test_toggle_hashed_results) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("toggled", query);
+  auto rows = getTestDBExpectedResults();
+
+  FLAGS_differential_hashing = true;
+  uint64_t counter = 0;
+  DiffResults dr;
+  ASSERT_TRUE(cf.addNewResults(rows, 0, counter, dr).ok());
+
+  // Results stored without fingerprints are rebuilt from the index.
+  FLAGS_differential_hashing = false;
+  dr = DiffResults();
+  ASSERT_TRUE(cf.addNewResults(rows, 0, counter, dr).ok());
+  EXPECT_TRUE(dr.hasNoResults());
+
+  std::string index;
+  EXPECT_FALSE(getDatabaseValue(kQueryResultRows, "toggled", index).ok());
+
+  dr = DiffResults();
+  ASSERT_TRUE(cf.addNewResults({}, 0, counter, dr).ok());
+  EXPECT_EQ(dr.removed.size(), rows.size());
+
+  // Turning fingerprints back on migrates the current results.
+  FLAGS_differential_hashing = true;
+  dr = DiffResults();
+  auto status = cf.addNewResults({}, 0, counter, dr);
+  FLAGS_differential_hashing = false;
+
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(dr.hasNoResults());
+  EXPECT_TRUE(Query::removeHashedResults("toggled").ok());
+}
+
 TEST_F(QueryTests, test_get_query_results) {
   // Grab an expected set of query data and add it as the previous result.
   auto encoded_qd = getSerializedQueryDataJSON();
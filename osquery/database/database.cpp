@@ -13,6 +13,7 @@
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
@@ -39,6 +40,11 @@ FLAG_ALIAS(std::string, db_path, database_path);
 
 FLAG(bool, disable_database, false, "Disable the persistent RocksDB storage");
 
+FLAG(bool,
+     database_binary_rows,
+     false,
+     "Store event and scheduled query result rows in a compact binary format");
+
 const std::string kInternalDatabase = "rocksdb";
 const std::string kPersistentSettings = "configurations";
 const std::string kQueries = "queries";
@@ -48,11 +54,16 @@ const std::string kLogs = "logs";
 const std::string kDistributedQueries = "distributed";
 const std::string kDistributedRunningQueries = "distributed_running";
 const std::string kQueryPerformance = "query_performance";
+const std::string kQueryResultRows = "query_result_rows";
 
 const std::string kDbEpochSuffix = "epoch";
 const std::string kDbCounterSuffix = "counter";
 
 const std::string kDbVersionKey = "results_version";
+const std::string kDbRowEncodingKey = "results_encoding";
+const std::string kEventColumnsPrefix = "columns.";
+const std::string kEventsDomainPrefix = "events.";
+const std::string kEventsDomainListPrefix = "domains.";
 
 const std::vector<std::string> kDomains = {kPersistentSettings,
                                            kQueries,
@@ -61,7 +72,8 @@ const std::vector<std::string> kDomains = {kPersistentSettings,
                                            kCarves,
                                            kDistributedQueries,
                                            kDistributedRunningQueries,
-                                           kQueryPerformance};
+                                           kQueryPerformance,
+                                           kQueryResultRows};
 
 std::atomic<bool> kDBAllowOpen(false);
 std::atomic<bool> kDBInitialized(false);
@@ -154,6 +166,21 @@ Status DatabasePlugin::call(const PluginRequest& request,
     auto status = this->get(domain, key, value);
     response.push_back({{"v", value}});
     return status;
+  } else if (request.at("action") == "get_range") {
+    auto key_high =
+        (request.count("key_high") > 0) ? request.at("key_high") : "";
+    size_t max = 0;
+    if (request.count("max") > 0) {
+      max = std::stoul(request.at("max"));
+    }
+
+    DatabaseStringValueList values;
+    auto status = this->getRange(domain, key, key_high, values, max);
+    for (auto& p : values) {
+      response.push_back(
+          {{"k", std::move(p.first)}, {"v", std::move(p.second)}});
+    }
+    return status;
   } else if (request.at("action") == "put") {
     if (request.count("value") == 0) {
       return Status(1, "Database plugin put action requires a value");
@@ -186,13 +213,37 @@ Status DatabasePlugin::call(const PluginRequest& request,
                       "received. Only string values are supported");
       }
 
-      data.push_back(
-          std::make_pair(item.name.GetString(), item.value.GetString()));
+      data.push_back(std::make_pair(
+          std::string(item.name.GetString(), item.name.GetStringLength()),
+          std::string(item.value.GetString(), item.value.GetStringLength())));
     }
 
     return this->putBatch(domain, data);
   } else if (request.at("action") == "remove") {
     return this->remove(domain, key);
+  } else if (request.at("action") == "remove_batch") {
+    if (request.count("json") == 0) {
+      return Status(1,
+                    "Database plugin remove_batch action requires a "
+                    "json-encoded key list");
+    }
+
+    auto json_array = JSON::newArray();
+    auto status = json_array.fromString(request.at("json"));
+    if (!status.ok() || !json_array.doc().IsArray()) {
+      return Status(1, "Database plugin remove_batch action requires a list");
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(json_array.doc().Size());
+    for (const auto& item : json_array.doc().GetArray()) {
+      if (!item.IsString()) {
+        return Status(1, "Only string keys can be removed");
+      }
+      keys.emplace_back(item.GetString(), item.GetStringLength());
+    }
+
+    return this->removeBatch(domain, keys);
   } else if (request.at("action") == "remove_range") {
     auto key_high =
         (request.count("key_high") > 0) ? request.at("key_high") : "";
@@ -318,6 +369,43 @@ Status getDatabaseValue(const std::string& domain,
   return s;
 }
 
+Status getDatabaseRange(const std::string& domain,
+                        const std::string& low,
+                        const std::string& high,
+                        DatabaseStringValueList& values,
+                        uint64_t max) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "get_range"},
+                             {"domain", domain},
+                             {"key", low},
+                             {"key_high", high},
+                             {"max", std::to_string(max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+    for (const auto& item : response) {
+      if (item.count("k") > 0 && item.count("v") > 0) {
+        values.push_back(std::make_pair(item.at("k"), item.at("v")));
+      }
+    }
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot get database values: " + low + " - " +
+                             high);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->getRange(domain, low, high, values, max);
+  }
+}
+
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         const std::string& value) {
@@ -377,6 +465,45 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   }
 }
 
+Status deleteDatabaseBatch(const std::string& domain,
+                           const std::vector<std::string>& keys) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (keys.empty()) {
+    return Status::success();
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    auto json_array = JSON::newArray();
+    for (const auto& key : keys) {
+      json_array.pushCopy(key);
+    }
+
+    std::string serialized_keys;
+    auto status = json_array.toString(serialized_keys);
+    if (!status.ok()) {
+      return status;
+    }
+
+    PluginRequest request = {{"action", "remove_batch"},
+                             {"domain", domain},
+                             {"json", std::move(serialized_keys)}};
+    return Registry::call("database", request);
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot delete database values");
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->removeBatch(domain, keys);
+  }
+}
+
 Status deleteDatabaseRange(const std::string& domain,
                            const std::string& low,
                            const std::string& high) {
@@ -451,8 +578,29 @@ void resetDatabase() {
   Registry::call("database", request);
 }
 
+bool isEventsDomain(const std::string& domain) {
+  return boost::algorithm::starts_with(domain, kEventsDomainPrefix);
+}
+
+Status listEventsDomains(std::vector<std::string>& domains) {
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kEvents, keys, kEventsDomainListPrefix, 0);
+  if (!s.ok()) {
+    return s;
+  }
+
+  for (const auto& key : keys) {
+    domains.push_back(kEventsDomainPrefix +
+                      key.substr(kEventsDomainListPrefix.size()));
+  }
+  return Status::success();
+}
+
 void dumpDatabase() {
-  for (const auto& domain : kDomains) {
+  auto domains = kDomains;
+  listEventsDomains(domains);
+
+  for (const auto& domain : domains) {
     std::vector<std::string> keys;
     if (!scanDatabaseKeys(domain, keys)) {
       continue;
@@ -627,6 +775,334 @@ static Status migrateV1V2(void) {
   return Status::success();
 }
 
+static Status migrateQueryResultsEncoding(bool binary) {
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kQueries, keys);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan query results from database");
+  }
+
+  for (const auto& key : keys) {
+    // Only the stored result sets are rows, skip the query bookkeeping.
+    if (boost::algorithm::ends_with(key, kDbEpochSuffix) ||
+        boost::algorithm::ends_with(key, kDbCounterSuffix) ||
+        boost::algorithm::starts_with(key, "query.") ||
+        boost::algorithm::starts_with(key, "cache.")) {
+      continue;
+    }
+
+    std::string value;
+    if (!getDatabaseValue(kQueries, key, value).ok() ||
+        isBinaryRowData(value) == binary) {
+      continue;
+    }
+
+    QueryDataSet results;
+    s = binary ? deserializeQueryDataJSON(value, results)
+               : deserializeQueryDataBinary(value, results);
+    if (!s.ok()) {
+      LOG(WARNING) << "Cannot convert the results of '" << key
+                   << "': " << s.getMessage();
+      continue;
+    }
+
+    QueryDataTyped rows(results.begin(), results.end());
+    value.clear();
+    s = binary ? serializeQueryDataBinary(rows, value)
+               : serializeQueryDataJSON(rows, value, true);
+    if (s.ok()) {
+      s = setDatabaseValue(kQueries, key, value);
+    }
+
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to update value in database " << key;
+    }
+  }
+
+  return Status::success();
+}
+
+/// Column dictionaries of each subscriber, and how many columns are stored.
+using EventColumnDictionaries =
+    std::map<std::string, std::pair<ColumnDictionary, size_t>>;
+
+static Status migrateEventEncoding(const std::string& domain,
+                                   const std::string& key,
+                                   const std::string& dictionary_key,
+                                   EventColumnDictionaries& dictionaries,
+                                   bool binary) {
+  std::string value;
+  if (!getDatabaseValue(domain, key, value).ok() ||
+      isBinaryRowData(value) == binary) {
+    return Status::success();
+  }
+
+  auto it = dictionaries.find(dictionary_key);
+  if (it == dictionaries.end()) {
+    it = dictionaries.insert({dictionary_key, {}}).first;
+
+    std::string stored;
+    if (getDatabaseValue(kEvents, dictionary_key, stored).ok()) {
+      deserializeColumnDictionary(stored, it->second.first);
+      it->second.second = it->second.first.size();
+    }
+  }
+  auto& columns = it->second.first;
+
+  Row row;
+  auto s = binary ? deserializeRowJSON(value, row)
+                  : deserializeRowBinary(value, columns, row);
+  if (!s.ok()) {
+    LOG(WARNING) << "Cannot convert the event '" << key
+                 << "': " << s.getMessage();
+    return Status::success();
+  }
+
+  value.clear();
+  s = binary ? serializeRowBinary(row, columns, value)
+             : serializeRowJSON(row, value);
+  if (!s.ok()) {
+    return Status::success();
+  }
+
+  if (!binary && !value.empty() && value.back() == '\n') {
+    value.pop_back();
+  }
+
+  // New columns are stored before any event refers to them.
+  if (columns.size() != it->second.second) {
+    std::string stored;
+    serializeColumnDictionary(columns, stored);
+    s = setDatabaseValue(kEvents, dictionary_key, stored);
+    if (!s.ok()) {
+      return Status::failure("Failed to store the column dictionary " +
+                             dictionary_key);
+    }
+    it->second.second = columns.size();
+  }
+
+  if (!setDatabaseValue(domain, key, value).ok()) {
+    LOG(WARNING) << "Failed to update value in database " << key;
+  }
+  return Status::success();
+}
+
+static Status migrateEventsEncoding(bool binary) {
+  EventColumnDictionaries dictionaries;
+
+  // Events stored before version 4 share the events domain.
+  const std::string data_prefix = "data.";
+
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kEvents, keys, data_prefix, 0);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan event keys from database");
+  }
+
+  for (const auto& key : keys) {
+    auto separator = key.rfind('.');
+    if (separator <= data_prefix.size()) {
+      continue;
+    }
+
+    auto dictionary_key = kEventColumnsPrefix +
+                          key.substr(data_prefix.size(),
+                                     separator - data_prefix.size());
+    s = migrateEventEncoding(
+        kEvents, key, dictionary_key, dictionaries, binary);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  std::vector<std::string> domains;
+  s = listEventsDomains(domains);
+  if (!s.ok()) {
+    return Status::failure("Failed to list the events domains");
+  }
+
+  for (const auto& domain : domains) {
+    keys.clear();
+    s = scanDatabaseKeys(domain, keys, "", 0);
+    if (!s.ok()) {
+      return Status::failure("Failed to scan event keys from " + domain);
+    }
+
+    auto dictionary_key =
+        kEventColumnsPrefix + domain.substr(kEventsDomainPrefix.size());
+    for (const auto& key : keys) {
+      s = migrateEventEncoding(
+          domain, key, dictionary_key, dictionaries, binary);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  return Status::success();
+}
+
+/**
+ * @brief Convert stored rows to the encoding selected by database_binary_rows.
+ *
+ * Readers accept both encodings, converting keeps the backing store uniform
+ * when the flag changes between runs.
+ */
+static Status migrateRowEncoding(void) {
+  const std::string encoding = FLAGS_database_binary_rows ? "binary" : "json";
+
+  std::string stored_encoding;
+  getDatabaseValue(kPersistentSettings, kDbRowEncodingKey, stored_encoding);
+  if (stored_encoding == encoding) {
+    return Status::success();
+  }
+
+  // Databases created before the binary encoding only contain JSON.
+  if (!stored_encoding.empty() || FLAGS_database_binary_rows) {
+    auto s = migrateQueryResultsEncoding(FLAGS_database_binary_rows);
+    if (!s.ok()) {
+      return s;
+    }
+
+    s = migrateEventsEncoding(FLAGS_database_binary_rows);
+    if (!s.ok()) {
+      return s;
+    }
+
+    LOG(INFO) << "Converted stored rows to the " << encoding << " encoding";
+  }
+
+  return setDatabaseValue(kPersistentSettings, kDbRowEncodingKey, encoding);
+}
+
+static Status migrateV2V3(void) {
+  return migrateRowEncoding();
+}
+
+/**
+ * @brief The key of an event in its subscriber's domain.
+ *
+ * Matches EventSubscriberPlugin::databaseKeyForEvent: the time padded to the
+ * width of the largest time, then the event id.
+ */
+static std::string eventsDomainKey(uint64_t time, uint64_t eid) {
+  auto time_index = std::to_string(time);
+  time_index.insert(time_index.begin(), 20 - time_index.size(), '0');
+
+  auto eid_index = std::to_string(eid);
+  if (eid_index.size() < 10) {
+    eid_index.insert(eid_index.begin(), 10 - eid_index.size(), '0');
+  }
+  return time_index + "." + eid_index;
+}
+
+/**
+ * @brief Move the stored events into the events domain of each subscriber.
+ *
+ * Events were stored in the events domain with "data.<namespace>.<eid>" keys.
+ * The keys in a subscriber's domain start with the event time, each event is
+ * read once to find it. Events that cannot be read are dropped.
+ */
+static Status migrateV3V4(void) {
+  const std::string data_prefix = "data.";
+  const size_t kEventsMigrationBatchSize = 1024;
+
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kEvents, keys, data_prefix, 0);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan event keys from database");
+  }
+
+  struct PendingEvents {
+    ColumnDictionary columns;
+    DatabaseStringValueList events;
+
+    /// The keys of the moved and dropped events.
+    std::vector<std::string> legacy_keys;
+  };
+  std::map<std::string, PendingEvents> namespaces;
+
+  auto flush = [](const std::string& name, PendingEvents& pending) {
+    if (!pending.events.empty()) {
+      auto status =
+          setDatabaseBatch(kEventsDomainPrefix + name, pending.events);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    if (!deleteDatabaseBatch(kEvents, pending.legacy_keys).ok()) {
+      LOG(WARNING) << "Failed to delete the migrated events of " << name;
+    }
+    pending.events.clear();
+    pending.legacy_keys.clear();
+    return Status::success();
+  };
+
+  size_t dropped = 0;
+  for (const auto& key : keys) {
+    auto separator = key.rfind('.');
+    if (separator <= data_prefix.size()) {
+      continue;
+    }
+
+    auto name = key.substr(data_prefix.size(), separator - data_prefix.size());
+    auto it = namespaces.find(name);
+    if (it == namespaces.end()) {
+      s = setDatabaseValue(
+          kEvents, kEventsDomainListPrefix + name, kEventsDomainPrefix + name);
+      if (!s.ok()) {
+        return Status::failure("Failed to record the events domain of " + name);
+      }
+
+      it = namespaces.insert({name, {}}).first;
+      std::string stored;
+      if (getDatabaseValue(kEvents, kEventColumnsPrefix + name, stored).ok()) {
+        deserializeColumnDictionary(stored, it->second.columns);
+      }
+    }
+    auto& pending = it->second;
+
+    std::string value;
+    Row row;
+    s = getDatabaseValue(kEvents, key, value);
+    if (s.ok()) {
+      s = isBinaryRowData(value)
+              ? deserializeRowBinary(value, pending.columns, row)
+              : deserializeRowJSON(value, row);
+    }
+
+    auto eid = tryTo<uint64_t>(key.substr(separator + 1));
+    auto time = tryTo<uint64_t>(row.count("time") > 0 ? row["time"] : "");
+    pending.legacy_keys.push_back(key);
+    if (!s.ok() || eid.isError() || time.isError()) {
+      dropped++;
+      continue;
+    }
+
+    pending.events.push_back(
+        std::make_pair(eventsDomainKey(time.get(), eid.get()), value));
+    if (pending.events.size() >= kEventsMigrationBatchSize) {
+      s = flush(name, pending);
+      if (!s.ok()) {
+        return Status::failure("Failed to move the events of " + name);
+      }
+    }
+  }
+
+  for (auto& it : namespaces) {
+    s = flush(it.first, it.second);
+    if (!s.ok()) {
+      return Status::failure("Failed to move the events of " + it.first);
+    }
+  }
+
+  if (dropped > 0) {
+    LOG(WARNING) << "Dropped " << dropped << " unreadable events";
+  }
+  return Status::success();
+}
+
 Status upgradeDatabase(int to_version) {
   std::string value;
   Status st = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
@@ -658,6 +1134,14 @@ Status upgradeDatabase(int to_version) {
       migrate_status = migrateV1V2();
       break;
 
+    case 2:
+      migrate_status = migrateV2V3();
+      break;
+
+    case 3:
+      migrate_status = migrateV3V4();
+      break;
+
     default:
       LOG(ERROR) << "Logic error: the migration code is broken!";
       migrate_status = Status::failure("Migration code broken.");
@@ -683,6 +1167,10 @@ Status upgradeDatabase(int to_version) {
     db_version++;
   }
 
+  // The row encoding may change between runs of the same database version.
+  if (to_version >= 3) {
+    return migrateRowEncoding();
+  }
   return Status::success();
 }
 
@@ -703,6 +1191,14 @@ class OsqueryDatabase final : public IDatabaseInterface {
     return osquery::getDatabaseValue(domain, key, value);
   }
 
+  virtual Status getDatabaseRange(const std::string& domain,
+                                  const std::string& low,
+                                  const std::string& high,
+                                  DatabaseStringValueList& values,
+                                  size_t max) const override {
+    return osquery::getDatabaseRange(domain, low, high, values, max);
+  }
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const override {
@@ -726,6 +1222,12 @@ class OsqueryDatabase final : public IDatabaseInterface {
     return osquery::deleteDatabaseValue(domain, key);
   }
 
+  virtual Status deleteDatabaseBatch(
+      const std::string& domain,
+      const std::vector<std::string>& keys) const override {
+    return osquery::deleteDatabaseBatch(domain, keys);
+  }
+
   virtual Status deleteDatabaseRange(const std::string& domain,
                                      const std::string& low,
                                      const std::string& high) const override {
@@ -52,6 +52,24 @@ extern const std::string kCarves;
 /// The key for the DB version
 extern const std::string kDbVersionKey;
 
+/// The key for the encoding of stored event and scheduled query result rows
+extern const std::string kDbRowEncodingKey;
+
+/// The events domain key prefix of each subscriber's binary column dictionary
+extern const std::string kEventColumnsPrefix;
+
+/**
+ * @brief The prefix of the domains where each subscriber stores its events.
+ *
+ * Every event subscriber owns a domain named after this prefix and its
+ * namespace. These domains are not part of kDomains, database plugins create
+ * them the first time they are written to.
+ */
+extern const std::string kEventsDomainPrefix;
+
+/// The events domain key prefix recording each subscriber's events domain
+extern const std::string kEventsDomainListPrefix;
+
 /// The "domain" where distributed queries are stored.
 extern const std::string kDistributedQueries;
 
@@ -61,8 +79,11 @@ extern const std::string kDistributedRunningQueries;
 /// The "domain" where query performance stats are stored.
 extern const std::string kQueryPerformance;
 
+/// The "domain" where fingerprinted scheduled query results are stored.
+extern const std::string kQueryResultRows;
+
 /// The running version of our database schema
-const int kDbCurrentVersion = 2;
+const int kDbCurrentVersion = 4;
 
 /**
  * @brief The "domain" where buffered log results are stored.
@@ -113,6 +134,25 @@ class DatabasePlugin : public Plugin {
                      const std::string& key,
                      int& value) const = 0;
 
+  /**
+   * @brief Read the keys and values of an inclusive key range.
+   *
+   * Pairs are appended in key order. A caller may continue a limited read
+   * from the key following the last one returned.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param low The first key of the range.
+   * @param high The last key of the range.
+   * @param values The output list of key and value pairs.
+   * @param max The maximum number of pairs to read, 0 for no limit.
+   * @return Failure if the data could not be accessed.
+   */
+  virtual Status getRange(const std::string& domain,
+                          const std::string& low,
+                          const std::string& high,
+                          DatabaseStringValueList& values,
+                          uint64_t max) const = 0;
+
   /**
    * @brief Store a string-represented value using a domain and key index.
    *
@@ -138,6 +178,10 @@ class DatabasePlugin : public Plugin {
   /// Data removal method.
   virtual Status remove(const std::string& domain, const std::string& k) = 0;
 
+  /// Data removal of a list of keys, applied as a single write if possible.
+  virtual Status removeBatch(const std::string& domain,
+                             const std::vector<std::string>& keys) = 0;
+
   /// Data removal with range bounds.
   virtual Status removeRange(const std::string& domain,
                              const std::string& low,
@@ -206,6 +250,13 @@ Status getDatabaseValue(const std::string& domain,
                         const std::string& key,
                         int& value);
 
+/// Read the keys and values of an inclusive key range, in key order.
+Status getDatabaseRange(const std::string& domain,
+                        const std::string& low,
+                        const std::string& high,
+                        DatabaseStringValueList& values,
+                        uint64_t max = 0);
+
 /**
  * @brief Set or put a value into the active osquery DatabasePlugin storage.
  *
@@ -232,6 +283,10 @@ Status setDatabaseBatch(const std::string& domain,
 /// Remove a domain/key identified value from backing-store.
 Status deleteDatabaseValue(const std::string& domain, const std::string& key);
 
+/// Remove a list of domain/key identified values from backing-store.
+Status deleteDatabaseBatch(const std::string& domain,
+                           const std::vector<std::string>& keys);
+
 /// Remove a range of keys in domain.
 Status deleteDatabaseRange(const std::string& domain,
                            const std::string& low,
@@ -251,6 +306,12 @@ Status scanDatabaseKeys(const std::string& domain,
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
+/// Check if a domain is the events domain of a subscriber.
+bool isEventsDomain(const std::string& domain);
+
+/// List the events domains recorded by subscribers.
+Status listEventsDomains(std::vector<std::string>& domains);
+
 /// Allow callers to scan each column family and print each value.
 void dumpDatabase();
 
@@ -41,6 +41,11 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
   Status get(const std::string& domain,
              const std::string& key,
              int& value) const override;
+  Status getRange(const std::string& domain,
+                  const std::string& low,
+                  const std::string& high,
+                  DatabaseStringValueList& values,
+                  uint64_t max) const override;
   /// Data storage method.
   Status put(const std::string& domain,
              const std::string& key,
@@ -55,6 +60,9 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  Status removeBatch(const std::string& domain,
+                     const std::vector<std::string>& keys) override;
+
   Status removeRange(const std::string& domain,
                      const std::string& low,
                      const std::string& high) override;
@@ -114,6 +122,33 @@ Status EphemeralDatabasePlugin::get(const std::string& domain,
   return this->getAny(domain, key, value);
 }
 
+Status EphemeralDatabasePlugin::getRange(const std::string& domain,
+                                         const std::string& low,
+                                         const std::string& high,
+                                         DatabaseStringValueList& values,
+                                         uint64_t max) const {
+  auto domainIterator = db_.find(domain);
+  if (domainIterator == db_.end() || low > high) {
+    return Status(0);
+  }
+
+  const auto& domainValues = domainIterator->second;
+  auto last = domainValues.upper_bound(high);
+  uint64_t count = 0;
+  for (auto it = domainValues.lower_bound(low); it != last; ++it) {
+    const auto* value = boost::get<std::string>(&it->second);
+    if (value == nullptr) {
+      continue;
+    }
+
+    values.push_back(std::make_pair(it->first, *value));
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+  return Status(0);
+}
+
 void EphemeralDatabasePlugin::setValue(const std::string& domain,
                                        const std::string& key,
                                        const std::string& value) {
@@ -158,6 +193,15 @@ Status EphemeralDatabasePlugin::remove(const std::string& domain,
   return Status(0);
 }
 
+Status EphemeralDatabasePlugin::removeBatch(
+    const std::string& domain, const std::vector<std::string>& keys) {
+  auto& values = db_[domain];
+  for (const auto& key : keys) {
+    values.erase(key);
+  }
+  return Status(0);
+}
+
 Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
                                             const std::string& low,
                                             const std::string& high) {
@@ -165,16 +209,8 @@ Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
     return Status::failure("Invalid range: low > high");
   }
 
-  std::vector<std::string> keys;
-  for (const auto& it : db_[domain]) {
-    if (it.first >= low && it.first <= high) {
-      keys.push_back(it.first);
-    }
-  }
-
-  for (const auto& key : keys) {
-    db_[domain].erase(key);
-  }
+  auto& values = db_[domain];
+  values.erase(values.lower_bound(low), values.upper_bound(high));
   return Status(0);
 }
 
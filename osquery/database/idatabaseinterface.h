@@ -33,6 +33,12 @@ class IDatabaseInterface {
                                   const std::string& key,
                                   int& value) const = 0;
 
+  virtual Status getDatabaseRange(const std::string& domain,
+                                  const std::string& low,
+                                  const std::string& high,
+                                  DatabaseStringValueList& values,
+                                  size_t max) const = 0;
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const = 0;
@@ -47,6 +53,10 @@ class IDatabaseInterface {
   virtual Status deleteDatabaseValue(const std::string& domain,
                                      const std::string& key) const = 0;
 
+  virtual Status deleteDatabaseBatch(
+      const std::string& domain,
+      const std::vector<std::string>& keys) const = 0;
+
   virtual Status deleteDatabaseRange(const std::string& domain,
                                      const std::string& low,
                                      const std::string& high) const = 0;
@@ -8,6 +8,7 @@
  */
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
@@ -22,6 +23,8 @@ namespace rj = rapidjson;
 
 namespace osquery {
 
+DECLARE_bool(database_binary_rows);
+
 class DatabaseTests : public testing::Test {
  public:
   void SetUp() override {
@@ -294,4 +297,107 @@ TEST_F(DatabaseTests, test_migration_v1v2) {
   EXPECT_EQ(value, "event_data");
 }
 
+TEST_F(DatabaseTests, test_migration_v2v3) {
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "2");
+  ASSERT_TRUE(status.ok());
+  deleteDatabaseValue(kPersistentSettings, kDbRowEncodingKey);
+
+  const std::string results = "[{\"name\":\"osqueryd\",\"pid\":42}]";
+  status = setDatabaseValue(kQueries, "binary_rows", results);
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kQueries, "binary_rowsepoch", "3");
+  ASSERT_TRUE(status.ok());
+
+  const std::string event = "{\"eid\":\"0000000001\",\"time\":\"10\"}";
+  const std::string event_key = "data.publisher.subscriber.0000000001";
+  status = setDatabaseValue(kEvents, event_key, event);
+  ASSERT_TRUE(status.ok());
+
+  FLAGS_database_binary_rows = true;
+  status = upgradeDatabase(3);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "3");
+  getDatabaseValue(kPersistentSettings, kDbRowEncodingKey, value);
+  EXPECT_EQ(value, "binary");
+
+  // The query results are self-contained binary values.
+  getDatabaseValue(kQueries, "binary_rows", value);
+  ASSERT_TRUE(isBinaryRowData(value));
+  QueryDataTyped rows;
+  EXPECT_TRUE(deserializeQueryDataBinary(value, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(boost::get<long long>(rows[0]["pid"]), 42);
+
+  getDatabaseValue(kQueries, "binary_rowsepoch", value);
+  EXPECT_EQ(value, "3");
+
+  // Events refer to the subscriber's column dictionary.
+  getDatabaseValue(kEvents, event_key, value);
+  ASSERT_TRUE(isBinaryRowData(value));
+  std::string serialized_columns;
+  auto columns_key = kEventColumnsPrefix + "publisher.subscriber";
+  status = getDatabaseValue(kEvents, columns_key, serialized_columns);
+  ASSERT_TRUE(status.ok());
+
+  ColumnDictionary columns;
+  EXPECT_TRUE(deserializeColumnDictionary(serialized_columns, columns).ok());
+  Row row;
+  EXPECT_TRUE(deserializeRowBinary(value, columns, row).ok());
+  EXPECT_EQ(row["eid"], "0000000001");
+  EXPECT_EQ(row["time"], "10");
+
+  // Selecting JSON again converts the rows back.
+  FLAGS_database_binary_rows = false;
+  status = upgradeDatabase(3);
+  ASSERT_TRUE(status.ok());
+
+  getDatabaseValue(kEvents, event_key, value);
+  EXPECT_EQ(value, event);
+  getDatabaseValue(kQueries, "binary_rows", value);
+  EXPECT_EQ(value, results);
+}
+
+TEST_F(DatabaseTests, test_migration_v3v4) {
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "3");
+  ASSERT_TRUE(status.ok());
+
+  const std::string event = "{\"eid\":\"0000000002\",\"time\":\"10\"}";
+  status =
+      setDatabaseValue(kEvents, "data.publisher.subscriber.0000000002", event);
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(
+      kEvents, "data.publisher.subscriber.0000000003", "broken_value");
+  ASSERT_TRUE(status.ok());
+
+  status = upgradeDatabase(4);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "4");
+
+  // The events are moved to the subscriber's domain, keyed by time first.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, "data.", 0);
+  EXPECT_TRUE(keys.empty());
+
+  const auto domain = kEventsDomainPrefix + "publisher.subscriber";
+  status = getDatabaseValue(domain, "00000000000000000010.0000000002", value);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(value, event);
+
+  // Events that cannot be read are dropped.
+  keys.clear();
+  scanDatabaseKeys(domain, keys, "", 0);
+  EXPECT_EQ(keys.size(), 1U);
+
+  // The domain is recorded for the later encoding migrations.
+  std::vector<std::string> domains;
+  EXPECT_TRUE(listEventsDomains(domains).ok());
+  EXPECT_EQ(domains, std::vector<std::string>{domain});
+}
+
 } // namespace osquery
@@ -10,6 +10,7 @@
 #include <osquery/database/database.h>
 
 #include <osquery/core/query.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/core/sql/diff_results.h>
 #include <osquery/core/sql/query_data.h>
 #include <osquery/sql/tests/sql_test_utils.h>
@@ -90,6 +91,76 @@ TEST_F(ResultsTests, test_deserialize_query_data_json) {
   EXPECT_EQ(output, resultSet);
 }
 
+TEST_F(ResultsTests, test_binary_row) {
+  Row input = {
+      {"pid", "1234"},
+      {"delta", "-7"},
+      {"padded", "0001"},
+      {"huge", "99999999999999999999"},
+      {"empty", ""},
+      {"path", "/usr/bin/true"},
+  };
+
+  ColumnDictionary columns;
+  std::string data;
+  auto s = serializeRowBinary(input, columns, data);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(isBinaryRowData(data));
+  EXPECT_EQ(columns.size(), input.size());
+
+  // Values are restored exactly, including strings that look numeric.
+  Row output;
+  s = deserializeRowBinary(data, columns, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, input);
+
+  // The dictionary is required to decode column names.
+  std::string serialized_columns;
+  serializeColumnDictionary(columns, serialized_columns);
+  ColumnDictionary stored_columns;
+  s = deserializeColumnDictionary(serialized_columns, stored_columns);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(stored_columns.names(), columns.names());
+
+  output.clear();
+  s = deserializeRowBinary(data, ColumnDictionary(), output);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(ResultsTests, test_binary_query_data) {
+  auto results = getSerializedQueryDataJSON();
+  QueryDataSet resultSet =
+      QueryDataSet(results.second.begin(), results.second.end());
+
+  RowTyped typed;
+  typed["int"] = -3LL;
+  typed["double"] = 2.5;
+  results.second.push_back(typed);
+  resultSet.insert(typed);
+
+  std::string data;
+  auto s = serializeQueryDataBinary(results.second, data);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(isBinaryRowData(data));
+  EXPECT_FALSE(isBinaryRowData(results.first));
+
+  QueryDataTyped output;
+  s = deserializeQueryDataBinary(data, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+
+  QueryDataSet outputSet;
+  s = deserializeQueryDataBinary(data, outputSet);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(outputSet, resultSet);
+
+  // Truncated values are rejected.
+  output.clear();
+  data.pop_back();
+  s = deserializeQueryDataBinary(data, output);
+  EXPECT_FALSE(s.ok());
+}
+
 TEST_F(ResultsTests, test_serialize_diff_results) {
   auto results = getSerializedDiffResults();
   auto doc = JSON::newObject();
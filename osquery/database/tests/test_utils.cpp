@@ -184,6 +184,13 @@ void DatabasePluginTests::testGet() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(r, "bar");
 
+  // Values may contain NUL bytes, such as binary encoded rows.
+  std::string binary("a\0b", 3);
+  getPlugin()->put(kQueries, "test_get_binary", binary);
+  s = getPlugin()->get(kQueries, "test_get_binary", r);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(r, binary);
+
   auto reset = std::async(std::launch::async, kTestReseter);
   reset.get();
 }
@@ -200,6 +207,29 @@ void DatabasePluginTests::testDelete() {
   EXPECT_TRUE(r.empty());
 }
 
+void DatabasePluginTests::testDeleteBatch() {
+  getPlugin()->put(kQueries, "test_batch1", "1");
+  getPlugin()->put(kQueries, "test_batch2", "2");
+  getPlugin()->put(kQueries, "test_batch3", "3");
+  auto s = getPlugin()->removeBatch(
+      kQueries, {"test_batch1", "test_batch3", "test_batch_missing"});
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(s.getMessage(), "OK");
+
+  std::string r;
+  s = getPlugin()->get(kQueries, "test_batch1", r);
+  EXPECT_FALSE(s.ok());
+  s = getPlugin()->get(kQueries, "test_batch3", r);
+  EXPECT_FALSE(s.ok());
+  s = getPlugin()->get(kQueries, "test_batch2", r);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(r, "2");
+
+  // An empty batch is a no-op.
+  s = getPlugin()->removeBatch(kQueries, {});
+  EXPECT_TRUE(s.ok());
+}
+
 void DatabasePluginTests::testDeleteRange() {
   getPlugin()->put(kQueries, "test_delete", "baz");
   getPlugin()->put(kQueries, "test1", "1");
@@ -241,6 +271,47 @@ void DatabasePluginTests::testDeleteRange() {
   EXPECT_FALSE(s.ok());
 }
 
+void DatabasePluginTests::testGetRange() {
+  getPlugin()->put(kQueries, "test_range_1", "a");
+  getPlugin()->put(kQueries, "test_range_2", std::string("b\0c", 3));
+  getPlugin()->put(kQueries, "test_range_3", "d");
+  getPlugin()->put(kQueries, "test_range_4", "e");
+
+  DatabaseStringValueList values;
+  auto s = getPlugin()->getRange(
+      kQueries, "test_range_2", "test_range_3", values, 0);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 2U);
+  EXPECT_EQ(values[0].first, "test_range_2");
+  EXPECT_EQ(values[0].second, std::string("b\0c", 3));
+  EXPECT_EQ(values[1].first, "test_range_3");
+  EXPECT_EQ(values[1].second, "d");
+
+  // A limited read may be continued after the last returned key.
+  values.clear();
+  s = getPlugin()->getRange(
+      kQueries, "test_range_1", "test_range_4", values, 3);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 3U);
+  EXPECT_EQ(values[2].first, "test_range_3");
+
+  s = getPlugin()->getRange(kQueries,
+                            values.back().first + '\0',
+                            "test_range_4",
+                            values,
+                            3);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 4U);
+  EXPECT_EQ(values[3].first, "test_range_4");
+  EXPECT_EQ(values[3].second, "e");
+
+  values.clear();
+  s = getPlugin()->getRange(
+      kQueries, "test_range_5", "test_range_9", values, 0);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(values.empty());
+}
+
 void DatabasePluginTests::testScan() {
   getPlugin()->put(kQueries, "test_scan_foo1", "baz");
   getPlugin()->put(kQueries, "test_scan_foo2", "baz");
@@ -269,4 +340,43 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testEventsDomain() {
+  const auto domain = kEventsDomainPrefix + "publisher.subscriber";
+
+  // A subscriber's events domain that was never written to is empty.
+  std::vector<std::string> keys;
+  auto s = getPlugin()->scan(domain, keys, "", 0);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(keys.empty());
+
+  DatabaseStringValueList values;
+  s = getPlugin()->getRange(domain, "0", "9", values, 0);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(values.empty());
+
+  // It is created by the first write.
+  s = getPlugin()->putBatch(domain, {{"01.01", "a"}, {"01.02", "b"}});
+  EXPECT_TRUE(s.ok());
+  s = getPlugin()->put(domain, "02.03", "c");
+  EXPECT_TRUE(s.ok());
+
+  std::string r;
+  s = getPlugin()->get(domain, "01.02", r);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(r, "b");
+
+  // Its keys are not in the shared events domain.
+  keys.clear();
+  getPlugin()->scan(kEvents, keys, "01.", 0);
+  EXPECT_TRUE(keys.empty());
+
+  s = getPlugin()->removeRange(domain, "01.", "01/");
+  EXPECT_TRUE(s.ok());
+
+  keys.clear();
+  s = getPlugin()->scan(domain, keys, "", 0);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(keys, std::vector<std::string>{"02.03"});
+}
 } // namespace osquery
@@ -33,14 +33,23 @@
   TEST_F(n, test_delete) {                                                     \
     testDelete();                                                              \
   }                                                                            \
+  TEST_F(n, test_delete_batch) {                                               \
+    testDeleteBatch();                                                         \
+  }                                                                            \
   TEST_F(n, test_delete_range) {                                               \
     testDeleteRange();                                                         \
   }                                                                            \
+  TEST_F(n, test_get_range) {                                                  \
+    testGetRange();                                                            \
+  }                                                                            \
   TEST_F(n, test_scan) {                                                       \
     testScan();                                                                \
   }                                                                            \
   TEST_F(n, test_scan_limit) {                                                 \
     testScanLimit();                                                           \
+  }                                                                            \
+  TEST_F(n, test_events_domain) {                                              \
+    testEventsDomain();                                                        \
   }
 
 namespace osquery {
@@ -92,8 +101,11 @@ class DatabasePluginTests : public testing::Test {
   void testPutBatch();
   void testGet();
   void testDelete();
+  void testDeleteBatch();
   void testDeleteRange();
+  void testGetRange();
   void testScan();
   void testScanLimit();
+  void testEventsDomain();
 };
 } // namespace osquery
@@ -11,6 +11,9 @@
 
 #include <algorithm>
 #include <ctime>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <boost/format.hpp>
 #include <boost/io/quoted.hpp>
@@ -26,6 +29,7 @@
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/process/process.h>
 #include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_usage.h>
 #include <osquery/sql/sqlite_util.h>
 #include <osquery/utils/expected/expected.h>
 #include <osquery/utils/system/time.h>
@@ -53,6 +57,18 @@ FLAG(bool,
      false,
      "Log the running scheduled query name at INFO level");
 
+FLAG(uint64,
+     schedule_workers,
+     0,
+     "Number of threads running scheduled queries, 0 to run them in turn on "
+     "the scheduler thread");
+
+FLAG(uint64,
+     schedule_query_timeout,
+     0,
+     "Seconds a scheduled query may run before it is interrupted, 0 for no "
+     "limit");
+
 HIDDEN_FLAG(bool,
             schedule_reload_sql,
             false,
@@ -63,7 +79,38 @@ DECLARE_bool(events_optimize);
 DECLARE_bool(enable_numeric_monitoring);
 DECLARE_bool(verbose);
 
+namespace {
+
+/// The time a query may run, the pack's timeout overrides the flag.
+std::chrono::milliseconds getQueryTimeout(const ScheduledQuery& query) {
+  auto timeout = (query.timeout > 0) ? query.timeout
+                                     : FLAGS_schedule_query_timeout;
+  return std::chrono::seconds(timeout);
+}
+
+/// Copy a query out of the schedule, so it may run after the config changed.
+ScheduledQuery copyScheduledQuery(const ScheduledQuery& query) {
+  ScheduledQuery copy(query.pack_name, query.name, query.query);
+  copy.oncall = query.oncall;
+  copy.interval = query.interval;
+  copy.splayed_interval = query.splayed_interval;
+  copy.timeout = query.timeout;
+  copy.priority = query.priority;
+  copy.denylisted = query.denylisted;
+  copy.options = query.options;
+  return copy;
+}
+
+} // namespace
+
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
+  SQLInterrupt interrupt(getQueryTimeout(query));
+  return monitor(name, query, interrupt);
+}
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const SQLInterrupt& interrupt) {
   if (FLAGS_enable_numeric_monitoring) {
     CodeProfiler profiler(
         {(boost::format("scheduler.pack.%s") % query.pack_name).str(),
@@ -78,43 +125,30 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
           monitoring::hostIdentifierKeys().scheme % query.pack_name %
           query.name)
              .str()});
-    return SQLInternal(query.query, true);
+    return SQLInternal(query.query, true, interrupt);
   } else {
-    // Snapshot the performance and times for the worker before running.
-    auto pid = std::to_string(PlatformProcess::getCurrentPid());
-    auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    // Account for the resources used by this thread, without another query.
+    QueryUsageMeter meter;
 
     using namespace std::chrono;
     auto t0 = steady_clock::now();
     Config::get().recordQueryStart(name);
-    SQLInternal sql(query.query, true);
+    SQLInternal sql(query.query, true, interrupt);
 
-    // Snapshot the performance after, and compare.
     auto t1 = steady_clock::now();
-    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
-    if (r0.size() > 0 && r1.size() > 0) {
-      // Always called while processes table is working.
-      uint64_t size = sql.getSize();
-      Config::get().recordQueryPerformance(
-          name,
-          duration_cast<milliseconds>(t1 - t0).count(),
-          size,
-          r0[0],
-          r1[0]);
-    }
+    auto usage = meter.stop();
+    Config::get().recordQueryPerformance(
+        name,
+        duration_cast<milliseconds>(t1 - t0).count(),
+        sql.getSize(),
+        usage);
     return sql;
   }
 }
 
-Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+Status launchQuery(const std::string& name,
+                   const ScheduledQuery& query,
+                   const SQLInterrupt& interrupt) {
   // Execute the scheduled query and create a named query object.
   if (FLAGS_verbose) {
     VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
@@ -123,7 +157,7 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   }
   runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
+  auto sql = monitor(name, query, interrupt);
   if (!sql.getStatus().ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getStatus().toString();
@@ -239,6 +273,13 @@ void SchedulerRunner::maybeScheduleCarves(uint64_t time_step) {
 
 void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
   if (FLAGS_schedule_reload > 0 && (time_step % FLAGS_schedule_reload) == 0) {
+    /* Queries running on workers use the databases being reset; wait for
+       them first. New queries are only submitted by this thread, so none
+       starts until the reload is done. */
+    if (workers_ != nullptr) {
+      workers_->wait();
+    }
+
     /* Before resetting the database we want to ensure that there's no pending
        log relay thread started by the scheduler thread in a previous loop,
        to avoid deadlocks.
@@ -253,6 +294,9 @@ void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
     if (FLAGS_schedule_reload_sql) {
       SQLiteDBManager::resetPrimary();
     }
+
+    // The reloaded schedule may plan its queries differently.
+    SQLiteStatementCache::invalidate();
     resetDatabase();
   }
 }
@@ -271,34 +315,107 @@ void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
   }
 }
 
+void SchedulerRunner::runQuery(const std::string& name,
+                               const ScheduledQuery& query,
+                               uint64_t time_step) {
+  // Tables read the cache interval of the query running on their thread.
+  TablePlugin::kCacheInterval = query.splayed_interval;
+  TablePlugin::kCacheStep = time_step;
+
+  // The timeout starts when the query runs, not when it was queued.
+  auto interrupt = std::make_shared<SQLInterrupt>(getQueryTimeout(query));
+  {
+    WriteLock lock(running_mutex_);
+    running_[name] = interrupt;
+  }
+  if (interrupted()) {
+    interrupt->cancel();
+  }
+
+  const auto status = launchQuery(name, query, *interrupt);
+  monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
+                      query.pack_name % query.name %
+                      (status.ok() ? "success" : "failure"))
+                         .str(),
+                     1,
+                     monitoring::PreAggregationType::Sum,
+                     true);
+
+#ifdef OSQUERY_LINUX
+  // Attempt to release some unused memory kept by malloc internal caching
+  releaseRetainedMemory();
+#endif
+
+  WriteLock lock(running_mutex_);
+  running_.erase(name);
+}
+
+void SchedulerRunner::launchDueQueries(uint64_t time_step) {
+  std::vector<std::pair<std::string, ScheduledQuery>> due;
+  Config::get().scheduledQueries(
+      ([&due, time_step](std::string name, const ScheduledQuery& query) {
+        if (query.splayed_interval > 0 &&
+            time_step % query.splayed_interval == 0) {
+          due.emplace_back(std::move(name), copyScheduledQuery(query));
+        }
+      }));
+
+  // Queries with the same priority keep the order of the schedule.
+  std::stable_sort(
+      due.begin(), due.end(), [](const auto& left, const auto& right) {
+        return left.second.priority > right.second.priority;
+      });
+
+  for (auto& item : due) {
+    if (shutdownRequested() || interrupted()) {
+      break;
+    }
+
+    {
+      WriteLock lock(running_mutex_);
+      if (!running_.emplace(item.first, nullptr).second) {
+        VLOG(1) << "Scheduled query " << item.first
+                << " is still running, skipping this interval";
+        continue;
+      }
+    }
+
+    if (workers_ == nullptr) {
+      runQuery(item.first, item.second, time_step);
+      continue;
+    }
+
+    auto query = std::make_shared<std::pair<std::string, ScheduledQuery>>(
+        std::move(item));
+    workers_->submit([this, query, time_step]() {
+      runQuery(query->first, query->second, time_step);
+    });
+  }
+}
+
+void SchedulerRunner::stop() {
+  WriteLock lock(running_mutex_);
+  for (auto& query : running_) {
+    if (query.second != nullptr) {
+      query.second->cancel();
+    }
+  }
+}
+
 void SchedulerRunner::start() {
   // Start the counter at the second.
   auto i = osquery::getUnixTime();
   // Timeout is the number of seconds from starting.
   auto end = (timeout_ == 0) ? 0 : timeout_ + i;
 
+  if (FLAGS_schedule_workers > 0) {
+    workers_ = std::make_unique<ThreadPool>(
+        "SchedulerWorker", static_cast<size_t>(FLAGS_schedule_workers));
+  }
+
   for (; (end == 0) || (i <= end); ++i) {
     auto start_time_point = std::chrono::steady_clock::now();
-    Config::get().scheduledQueries(([&i](const std::string& name,
-                                         const ScheduledQuery& query) {
-      if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-        TablePlugin::kCacheInterval = query.splayed_interval;
-        TablePlugin::kCacheStep = i;
-        const auto status = launchQuery(name, query);
-        monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
-                            query.pack_name % query.name %
-                            (status.ok() ? "success" : "failure"))
-                               .str(),
-                           1,
-                           monitoring::PreAggregationType::Sum,
-                           true);
-
-#ifdef OSQUERY_LINUX
-        // Attempt to release some unused memory kept by malloc internal caching
-        releaseRetainedMemory();
-#endif
-      }
-    }));
+    launchDueQueries(i);
 
     maybeRunDecorators(i);
     maybeReloadSchedule(i);
@@ -314,10 +431,21 @@ void SchedulerRunner::start() {
     }
   }
 
+  // Queued queries are dropped, running queries were cancelled by stop.
+  if (workers_ != nullptr) {
+    if (!interrupted()) {
+      workers_->wait();
+    }
+    workers_->stop();
+  }
+
   /* Wait for the thread relaying/flushing the logs,
      to prevent race conditions on shutdown */
   waitLogRelay();
 
+  // Keep the stats of the queries run since the last batch.
+  Config::flushQueryPerformance();
+
   // Scheduler ended.
   if (!interrupted() && request_shutdown_on_expiration) {
     LOG(INFO) << "The scheduler ended after " << timeout_ << " seconds";
@@ -11,8 +11,10 @@
 
 #include <chrono>
 #include <map>
+#include <memory>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/dispatcher/thread_pool.h>
 
 #include "osquery/sql/sqlite_util.h"
 
@@ -35,8 +37,8 @@ class SchedulerRunner : public InternalRunnable {
   /// The Dispatcher thread entry point.
   void start() override;
 
-  /// The Dispatcher interrupt point.
-  void stop() override {}
+  /// The Dispatcher interrupt point, cancels the running queries.
+  void stop() override;
 
   /// Accumulated for some time time drift to compensate.
   std::chrono::milliseconds getCurrentTimeDrift() const noexcept;
@@ -57,6 +59,14 @@ class SchedulerRunner : public InternalRunnable {
   /// Check if carve requests should be scheduled.
   void maybeScheduleCarves(uint64_t time_step);
 
+  /// Run or queue the queries due at a step, in decreasing priority.
+  void launchDueQueries(uint64_t time_step);
+
+  /// Run a query due at a step and record its status.
+  void runQuery(const std::string& name,
+                const ScheduledQuery& query,
+                uint64_t time_step);
+
  private:
   /// Interval in seconds between schedule steps.
   const std::chrono::milliseconds interval_;
@@ -71,6 +81,20 @@ class SchedulerRunner : public InternalRunnable {
 
   const std::chrono::milliseconds max_time_drift_;
 
+  /// Threads running the due queries, if `--schedule_workers` is set.
+  std::unique_ptr<ThreadPool> workers_;
+
+  /**
+   * @brief The queued and running queries, keyed by name.
+   *
+   * A query is not started again until its previous run completes, so the
+   * differential results of a query are stored and logged in order. Queued
+   * queries do not have an interrupt yet.
+   */
+  std::map<std::string, std::shared_ptr<SQLInterrupt>> running_;
+
+  Mutex running_mutex_;
+
   /// Tests should not always trigger a shutdown when the scheduler expires,
   /// so let tests decide when this should happen.
   FRIEND_TEST(TLSConfigTests, test_runner_and_scheduler);
@@ -79,6 +103,11 @@ class SchedulerRunner : public InternalRunnable {
 
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
 
+/// Run a scheduled query that can be interrupted.
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const SQLInterrupt& interrupt);
+
 /// Start querying according to the config's schedule
 void startScheduler();
 
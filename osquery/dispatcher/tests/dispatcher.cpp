@@ -7,11 +7,14 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
 #include <chrono>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/dispatcher/thread_pool.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
@@ -144,4 +147,32 @@ TEST_F(DispatcherTests, test_stop_dispatcher) {
   auto s = Dispatcher::addService(r1);
   EXPECT_FALSE(s);
 }
+
+TEST_F(DispatcherTests, test_thread_pool) {
+  ThreadPool pool("TestPool", 4);
+  EXPECT_EQ(pool.size(), 4U);
+
+  // Tasks run concurrently, each waits until all of them started.
+  std::atomic<size_t> started{0};
+  std::atomic<size_t> completed{0};
+  for (size_t i = 0; i < 4; i++) {
+    pool.submit([&started, &completed]() {
+      started++;
+      while (started < 4) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      completed++;
+    });
+  }
+
+  pool.wait();
+  EXPECT_EQ(completed, 4U);
+  EXPECT_EQ(pool.pending(), 0U);
+
+  // Tasks submitted after stopping are dropped.
+  pool.stop();
+  pool.submit([&completed]() { completed++; });
+  EXPECT_EQ(completed, 4U);
+  EXPECT_EQ(pool.pending(), 0U);
+}
 }
@@ -23,6 +23,7 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_uint64(schedule_workers);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -79,6 +80,8 @@ TEST_F(SchedulerTests, test_monitor) {
 
   // Finally, make sure there is a recorded timestamp for the execution.
   // We are not concerned with the APPROX value, only that it was recorded.
+  // Timestamps are written along with the performance stats.
+  Config::flushQueryPerformance();
   getDatabaseValue(kPersistentSettings, "timestamp." + name, timestamp);
   EXPECT_FALSE(timestamp.empty());
 }
@@ -113,6 +116,27 @@ TEST_F(SchedulerTests, test_output_size) {
   EXPECT_EQ(perf.output_size, 28U);
 }
 
+TEST_F(SchedulerTests, test_monitor_timeout) {
+  // This query never completes on its own.
+  ScheduledQuery query("timeout_pack",
+                       "timeout",
+                       "with recursive c(x) as (select 1 union all select x + 1 "
+                       "from c) select count(*) from c");
+  query.interval = 10;
+  query.timeout = 1;
+
+  auto results = monitor("pack_timeout_pack_timeout", query);
+  EXPECT_FALSE(results.getStatus().ok());
+  EXPECT_EQ(results.getStatus().getMessage(),
+            "The query ran past its timeout");
+
+  // A cancelled query stops immediately.
+  SQLInterrupt interrupt;
+  interrupt.cancel();
+  results = monitor("pack_timeout_pack_timeout", query, interrupt);
+  EXPECT_EQ(results.getStatus().getMessage(), "The query was cancelled");
+}
+
 TEST_F(SchedulerTests, test_config_results_purge) {
   // Set a query time for now (time is only important relative to a week ago).
   auto query_time = osquery::getUnixTime();
@@ -283,6 +307,40 @@ TEST_F(SchedulerTests, test_scheduler_drift_accumulation) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_scheduler_workers) {
+  auto backup_workers = FLAGS_schedule_workers;
+  FLAGS_schedule_workers = 2;
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "workers": {
+        "queries": {
+          "1": {"query": "select 1 as number", "interval": 1},
+          "2": {"query": "select 2 as number", "interval": 1, "priority": 5},
+          "3": {"query": "select 3 as number", "interval": 1, "timeout": 5}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  // Run the scheduler for 1 second with a second interval.
+  SchedulerRunner runner(static_cast<unsigned long int>(1), 1);
+  runner.start();
+
+  // Every query ran on a worker and stored its results.
+  for (const auto& name : {"1", "2", "3"}) {
+    QueryPerformance perf;
+    Config::get().getPerformanceStats(
+        std::string("pack_workers_") + name,
+        ([&perf](const QueryPerformance& r) { perf = r; }));
+    EXPECT_GE(perf.executions, 1U);
+  }
+
+  FLAGS_schedule_workers = backup_workers;
+}
+
 TEST_F(SchedulerTests, test_scheduler_reload) {
   std::string config =
       "{\"schedule\":{\"1\":{"
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/core/system.h>
+#include <osquery/dispatcher/thread_pool.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+ThreadPool::ThreadPool(const std::string& name, size_t threads)
+    : name_(name) {
+  threads = std::max<size_t>(threads, 1);
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&ThreadPool::run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  stop();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    WriteLock lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    tasks_.push_back(std::move(task));
+  }
+  queued_.notify_one();
+}
+
+void ThreadPool::wait() {
+  WriteLock lock(mutex_);
+  completed_.wait(lock, [this]() { return tasks_.empty() && running_ == 0; });
+}
+
+void ThreadPool::stop() {
+  {
+    WriteLock lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+    tasks_.clear();
+  }
+  queued_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  completed_.notify_all();
+}
+
+size_t ThreadPool::pending() const {
+  WriteLock lock(mutex_);
+  return tasks_.size() + running_;
+}
+
+void ThreadPool::run() {
+  setThreadName(name_);
+
+  WriteLock lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      // The pool is stopping and every queued task was dropped.
+      break;
+    }
+
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    running_++;
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    running_--;
+    completed_.notify_all();
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A bounded set of threads running queued tasks.
+ *
+ * Services such as the scheduler use a pool to run independent work, like
+ * queries, concurrently without starting a thread for each of them. Tasks
+ * run in the order they were submitted, each on the first idle thread.
+ *
+ * Stopping the pool drops the tasks that did not start and joins the
+ * threads once the running tasks return. Tasks that take long should be
+ * interrupted by their owner before.
+ */
+class ThreadPool : private boost::noncopyable {
+ public:
+  /**
+   * @brief Start the threads of the pool.
+   *
+   * @param name the name given to each thread.
+   * @param threads the number of threads, at least one is started.
+   */
+  ThreadPool(const std::string& name, size_t threads);
+  ~ThreadPool();
+
+  /// Queue a task, it is dropped if the pool is stopping.
+  void submit(std::function<void()> task);
+
+  /// Wait until every queued task ran.
+  void wait();
+
+  /// Drop the queued tasks and join the threads.
+  void stop();
+
+  /// The number of queued and running tasks.
+  size_t pending() const;
+
+  /// The number of threads.
+  size_t size() const {
+    return threads_.size();
+  }
+
+ private:
+  /// The entry point of each thread.
+  void run();
+
+ private:
+  std::vector<std::thread> threads_;
+
+  /// Tasks waiting for a thread.
+  std::deque<std::function<void()>> tasks_;
+
+  /// The number of tasks a thread is running.
+  size_t running_{0};
+
+  bool stopping_{false};
+
+  /// The name of the threads.
+  std::string name_;
+
+  mutable Mutex mutex_;
+
+  /// Signaled when a task is queued or the pool stops.
+  ConditionVariable queued_;
+
+  /// Signaled when a task completes.
+  ConditionVariable completed_;
+};
+
+} // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <utility>
 
@@ -14,12 +16,15 @@
 #include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/thread_pool.h>
 #include <osquery/distributed/distributed.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
-#include <osquery/process/process.h>
+#include <osquery/profiler/query_usage.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/utils/conversions/castvariant.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/time.h>
@@ -48,9 +53,112 @@ FLAG(uint64,
      86400,
      "Seconds to denylist distributed queries (default 1 day)");
 
+FLAG(uint64,
+     distributed_workers,
+     1,
+     "Number of threads running the queries of a distributed request");
+
+FLAG(uint64,
+     distributed_time_budget,
+     0,
+     "Seconds the queries of a distributed request may run before the "
+     "unfinished ones report a timeout, checked between SQLite steps, 0 for "
+     "no limit");
+
 DECLARE_bool(verbose);
 
-std::string Distributed::currentRequestId_{""};
+thread_local std::string Distributed::currentRequestId_{""};
+
+namespace {
+
+/**
+ * @brief A query that stops when interrupted, keeping the rows it read.
+ *
+ * The interruption is only seen between SQLite steps, a table generating
+ * its rows runs to completion first, even past the time budget.
+ */
+class InterruptibleSQL : public SQL {
+ public:
+  InterruptibleSQL(const std::string& query, const SQLInterrupt& interrupt) {
+    TableColumns table_columns;
+    status_ = getQueryColumns(query, table_columns);
+    if (!status_.ok()) {
+      return;
+    }
+
+    for (const auto& column : table_columns) {
+      columns_.push_back(std::get<0>(column));
+    }
+
+    SQLInternal sql(query, true, interrupt);
+    status_ = sql.getStatus();
+    results_.reserve(sql.rowsTyped().size());
+    for (const auto& row : sql.rowsTyped()) {
+      Row r;
+      for (const auto& column : row) {
+        r[column.first] = castVariant(column.second);
+      }
+      results_.push_back(std::move(r));
+    }
+  }
+};
+
+/// Serialize results and the performance statistics of their queries.
+Status serializeResultsJSON(
+    const std::vector<DistributedQueryResult>& results,
+    const std::map<std::string, QueryPerformance>& performance,
+    std::string& json) {
+  auto doc = JSON::newObject();
+  auto queries_obj = doc.getObject();
+  auto statuses_obj = doc.getObject();
+  auto messages_obj = doc.getObject();
+  auto stats_obj = doc.getObject();
+  for (const auto& result : results) {
+    auto arr = doc.getArray();
+    auto s = serializeQueryData(result.results, result.columns, doc, arr);
+    if (!s.ok()) {
+      return s;
+    }
+    doc.add(result.request.id, arr, queries_obj);
+    doc.add(result.request.id, result.status.getCode(), statuses_obj);
+    doc.add(result.request.id, result.message, messages_obj);
+
+    auto obj = doc.getObject();
+    auto query_perf = performance.find(result.request.id);
+    if (query_perf != performance.end()) {
+      const auto& perf = query_perf->second;
+      obj.AddMember("wall_time_ms",
+                    static_cast<uint64_t>(perf.wall_time_ms),
+                    obj.GetAllocator());
+      obj.AddMember("user_time",
+                    static_cast<uint64_t>(perf.user_time),
+                    obj.GetAllocator());
+      obj.AddMember("system_time",
+                    static_cast<uint64_t>(perf.system_time),
+                    obj.GetAllocator());
+      obj.AddMember("memory",
+                    static_cast<uint64_t>(perf.last_memory),
+                    obj.GetAllocator());
+    };
+
+    doc.add(result.request.id, obj, stats_obj);
+  }
+
+  doc.add("queries", queries_obj);
+  doc.add("statuses", statuses_obj);
+  doc.add("messages", messages_obj);
+  doc.add("stats", stats_obj);
+  return doc.toString(json);
+}
+
+/// Completion of the requests of a batch, results are flushed as it grows.
+struct DistributedBatch {
+  size_t completed{0};
+  Mutex mutex;
+  ConditionVariable condition;
+};
+
+} // namespace
 
 Status DistributedPlugin::call(const PluginRequest& request,
                                PluginResponse& response) {
@@ -101,98 +209,136 @@ std::vector<std::string> Distributed::getPendingQueries() {
 }
 
 size_t Distributed::getCompletedCount() {
+  WriteLock lock(results_mutex_);
   return results_.size();
 }
 
 Status Distributed::serializeResults(std::string& json) {
-  auto doc = JSON::newObject();
-  auto queries_obj = doc.getObject();
-  auto statuses_obj = doc.getObject();
-  auto messages_obj = doc.getObject();
-  auto stats_obj = doc.getObject();
-  for (const auto& result : results_) {
-    auto arr = doc.getArray();
-    auto s = serializeQueryData(result.results, result.columns, doc, arr);
-    if (!s.ok()) {
-      return s;
-    }
-    doc.add(result.request.id, arr, queries_obj);
-    doc.add(result.request.id, result.status.getCode(), statuses_obj);
-    doc.add(result.request.id, result.message, messages_obj);
-
-    auto obj = doc.getObject();
-    if (performance_.count(result.request.id) > 0) {
-      auto perf = performance_[result.request.id];
-      obj.AddMember("wall_time_ms",
-                    static_cast<uint64_t>(perf.wall_time_ms),
-                    obj.GetAllocator());
-      obj.AddMember("user_time",
-                    static_cast<uint64_t>(perf.user_time),
-                    obj.GetAllocator());
-      obj.AddMember("system_time",
-                    static_cast<uint64_t>(perf.system_time),
-                    obj.GetAllocator());
-      obj.AddMember("memory",
-                    static_cast<uint64_t>(perf.last_memory),
-                    obj.GetAllocator());
-    };
-
-    doc.add(result.request.id, obj, stats_obj);
-  }
-
-  doc.add("queries", queries_obj);
-  doc.add("statuses", statuses_obj);
-  doc.add("messages", messages_obj);
-  doc.add("stats", stats_obj);
-  return doc.toString(json);
+  WriteLock lock(results_mutex_);
+  return serializeResultsJSON(results_, performance_, json);
 }
 
 void Distributed::addResult(const DistributedQueryResult& result) {
+  WriteLock lock(results_mutex_);
+  if (result.performance) {
+    performance_[result.request.id] = *result.performance;
+  }
   results_.push_back(result);
 }
 
-Status Distributed::runQueries() {
-  auto queries = getPendingQueries();
+void Distributed::runRequest(const DistributedQueryRequest& request,
+                             const SQLInterrupt& budget) {
+  if (budget.interrupted()) {
+    DistributedQueryResult result;
+    result.request = request;
+    result.status = Status(1, "Timeout");
+    result.message = "distributed query did not start within the time budget";
+    addResult(result);
+    return;
+  }
 
-  for (const auto& query : queries) {
-    auto request = popRequest(query);
-
-    const auto denylisted = checkAndSetAsRunning(request.query);
-    if (denylisted) {
-      VLOG(1) << "Not executing distributed denylisted query: \""
-              << request.query << "\"";
-      DistributedQueryResult result;
-      result.request = request;
-      result.status = Status(1, "Denylisted");
-      result.message = "distributed query is denylisted";
-      addResult(result);
-      continue;
+  // Requests of the batch running the same query share its running mark.
+  bool denylisted = false;
+  {
+    WriteLock lock(running_mutex_);
+    auto& running = running_[request.query];
+    if (running == 0) {
+      denylisted = checkAndSetAsRunning(request.query);
     }
+    if (!denylisted) {
+      running++;
+    }
+  }
+
+  if (denylisted) {
+    VLOG(1) << "Not executing distributed denylisted query: \""
+            << request.query << "\"";
+    DistributedQueryResult result;
+    result.request = request;
+    result.status = Status(1, "Denylisted");
+    result.message = "distributed query is denylisted";
+    addResult(result);
+    return;
+  }
 
-    if (FLAGS_verbose) {
-      VLOG(1) << "Executing distributed query: " << request.id << ": "
+  if (FLAGS_verbose) {
+    VLOG(1) << "Executing distributed query: " << request.id << ": "
+            << request.query;
+  } else if (FLAGS_distributed_loginfo) {
+    LOG(INFO) << "Executing distributed query: " << request.id << ": "
               << request.query;
-    } else if (FLAGS_distributed_loginfo) {
-      LOG(INFO) << "Executing distributed query: " << request.id << ": "
-                << request.query;
+  }
+
+  // Keep track of the currently executing request
+  Distributed::setCurrentRequestId(request.id);
+
+  QueryPerformance performance;
+  auto sql = monitorNonnumeric(request.query, budget, performance);
+  auto status = sql.getStatus();
+  std::string msg;
+  if (!status.ok() && budget.timedOut()) {
+    // The rows read before the query was interrupted are still reported.
+    status = Status(1, "Timeout");
+    msg = "distributed query ran past the time budget";
+  } else if (!status.ok()) {
+    msg = sql.getMessageString();
+    LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
+               << msg;
+  }
+
+  {
+    WriteLock lock(running_mutex_);
+    auto running = running_.find(request.query);
+    if (--running->second == 0) {
+      running_.erase(running);
+      setAsNotRunning(request.query);
     }
+  }
 
-    // Keep track of the currently executing request
-    Distributed::setCurrentRequestId(request.id);
+  DistributedQueryResult result(
+      request, sql.rows(), sql.columns(), status, msg);
+  result.performance = performance;
+  addResult(result);
+}
 
-    auto sql = monitorNonnumeric(request.id, request.query);
-    const auto ok = sql.getStatus().ok();
-    const auto& msg = ok ? "" : sql.getMessageString();
-    if (!ok) {
-      LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
-                 << msg;
+Status Distributed::runQueries() {
+  auto queries = getPendingQueries();
+  if (queries.empty()) {
+    return flushCompleted();
+  }
+
+  // The time budget is shared by every query of the request.
+  SQLInterrupt budget{std::chrono::seconds(FLAGS_distributed_time_budget)};
+  DistributedBatch batch;
+  {
+    auto threads = std::min<size_t>(
+        std::max<uint64_t>(FLAGS_distributed_workers, 1), queries.size());
+    ThreadPool workers("DistributedWorker", threads);
+    for (const auto& query : queries) {
+      auto request = popRequest(query);
+      workers.submit([this, request, &budget, &batch]() {
+        runRequest(request, budget);
+
+        WriteLock lock(batch.mutex);
+        batch.completed++;
+        batch.condition.notify_one();
+      });
     }
 
-    setAsNotRunning(request.query);
+    // Upload the results of the completed queries while the others run.
+    size_t flushed = 0;
+    while (flushed < queries.size()) {
+      {
+        WriteLock lock(batch.mutex);
+        batch.condition.wait(
+            lock, [&batch, flushed]() { return batch.completed > flushed; });
+        flushed = batch.completed;
+      }
 
-    DistributedQueryResult result(
-        request, sql.rows(), sql.columns(), sql.getStatus(), msg);
-    addResult(result);
+      if (flushed < queries.size()) {
+        flushCompleted();
+      }
+    }
   }
   return flushCompleted();
 }
@@ -262,19 +408,31 @@ Status Distributed::flushCompleted() {
     return Status(1, "Missing distributed plugin " + distributed_plugin);
   }
 
-  std::string results;
-  auto s = serializeResults(results);
-  if (!s.ok()) {
-    return s;
+  // Results added by workers during the upload are sent by the next flush.
+  std::vector<DistributedQueryResult> completed;
+  std::map<std::string, QueryPerformance> performance;
+  {
+    WriteLock lock(results_mutex_);
+    completed.swap(results_);
+    performance.swap(performance_);
   }
 
-  PluginResponse response;
-  s = Registry::call("distributed",
-                     {{"action", "writeResults"}, {"results", results}},
-                     response);
+  std::string results;
+  auto s = serializeResultsJSON(completed, performance, results);
   if (s.ok()) {
-    results_.clear();
-    performance_.clear();
+    PluginResponse response;
+    s = Registry::call("distributed",
+                       {{"action", "writeResults"}, {"results", results}},
+                       response);
+  }
+
+  if (!s.ok()) {
+    // Keep the results, in order, until a flush succeeds.
+    WriteLock lock(results_mutex_);
+    results_.insert(results_.begin(),
+                    std::make_move_iterator(completed.begin()),
+                    std::make_move_iterator(completed.end()));
+    performance_.insert(performance.begin(), performance.end());
   }
 
 #ifdef OSQUERY_LINUX
@@ -378,71 +536,33 @@ void Distributed::setCurrentRequestId(const std::string& cReqId) {
   currentRequestId_ = cReqId;
 }
 
-SQL Distributed::monitorNonnumeric(const std::string& name,
-                                   const std::string& query) {
-  // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentPid());
-  auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
+SQL Distributed::monitorNonnumeric(const std::string& query,
+                                   const SQLInterrupt& interrupt,
+                                   QueryPerformance& performance) {
+  // Account for the resources used by this thread, without another query.
+  QueryUsageMeter meter;
 
   using namespace std::chrono;
   auto t0 = steady_clock::now();
-  SQL sql(query, true);
+  SQL sql = InterruptibleSQL(query, interrupt);
 
-  // Snapshot the performance after, and compare.
   auto t1 = steady_clock::now();
-  auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
-  if (r0.size() > 0 && r1.size() > 0) {
-    // Always called while processes table is working.
-    uint64_t size = sql.rows().size();
-    recordQueryPerformance(
-        name, duration_cast<milliseconds>(t1 - t0).count(), size, r0[0], r1[0]);
-  }
+  auto usage = meter.stop();
+  uint64_t size = sql.rows().size();
+  recordQueryPerformance(
+      duration_cast<milliseconds>(t1 - t0).count(), size, usage, performance);
   return sql;
 }
 
-void Distributed::recordQueryPerformance(const std::string& name,
-                                         uint64_t delay_ms,
+void Distributed::recordQueryPerformance(uint64_t delay_ms,
                                          uint64_t size,
-                                         const Row& r0,
-                                         const Row& r1) {
-  performance_[name] = QueryPerformance();
-
-  auto& query = performance_.at(name);
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time = diff;
-    }
-  }
-
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time = diff;
-    }
-  }
-
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      query.last_memory = diff;
-    }
-  }
-
+                                         const QueryResourceUsage& usage,
+                                         QueryPerformance& query) {
+  query.user_time = usage.user_time;
+  query.system_time = usage.system_time;
+  query.last_memory = usage.memory;
+  query.instructions = usage.instructions;
+  query.cache_misses = usage.cache_misses;
   query.wall_time_ms = delay_ms;
 }
 
@@ -9,17 +9,23 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 
+#include <boost/optional.hpp>
+
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/query.h>
 #include <osquery/core/sql/query_performance.h>
 #include <osquery/sql/sql.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
 
+class SQLInterrupt;
+
 /**
  * @brief Small struct containing the query and ID information for a
  * distributed query
@@ -96,6 +102,9 @@ struct DistributedQueryResult {
   ColumnNames columns;
   Status status;
   std::string message;
+
+  /// Statistics of the query run, sent along with the result.
+  boost::optional<QueryPerformance> performance;
 };
 
 /**
@@ -260,7 +269,13 @@ class Distributed {
   /// Serialize result data into a JSON string and clear the results
   Status serializeResults(std::string& json);
 
-  /// Process and execute queued queries
+  /**
+   * @brief Process and execute queued queries
+   *
+   * Queries run concurrently on up to `--distributed_workers` threads and
+   * their results are flushed as they complete. Queries still running or
+   * queued when `--distributed_time_budget` elapses report a timeout.
+   */
   Status runQueries();
 
   /// Cleanup distributed queries marked as running that have expired.
@@ -299,6 +314,9 @@ class Distributed {
   /**
    * @brief Queue a result to be batch sent to the server
    *
+   * The performance statistics of the result are queued with it, so a flush
+   * sends both or neither.
+   *
    * @param result is a DistributedQueryResult object to be sent to the server
    */
   void addResult(const DistributedQueryResult& result);
@@ -340,33 +358,45 @@ class Distributed {
   // Setter for ID of currently executing request
   static void setCurrentRequestId(const std::string& cReqId);
 
-  // Run a query and record its performance statistics
-  SQL monitorNonnumeric(const std::string& name, const std::string& query);
+  /// Run a request on a worker and add its result.
+  void runRequest(const DistributedQueryRequest& request,
+                  const SQLInterrupt& budget);
+
+  // Run a query and measure its performance statistics
+  SQL monitorNonnumeric(const std::string& query,
+                        const SQLInterrupt& interrupt,
+                        QueryPerformance& performance);
 
   /**
-   * @brief Calculate query performance and record it into the performance_
-   * object
+   * @brief Calculate query performance
    *
-   * @param name Query name, as sent by the server
    * @param delay_ms Time taken for query to run
    * @param size number of rows output
-   * @param r0 Row generated from first call to the processes table
-   * @param r1 Row generated from second call to the processes table
+   * @param usage Resources used by the query execution
+   * @param performance The output statistics
    */
-  void recordQueryPerformance(const std::string& name,
-                              uint64_t delay_ms,
+  void recordQueryPerformance(uint64_t delay_ms,
                               uint64_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              const QueryResourceUsage& usage,
+                              QueryPerformance& performance);
 
   std::vector<DistributedQueryResult> results_;
 
-  // ID of the currently executing query
-  static std::string currentRequestId_;
+  // ID of the query executing on the thread
+  static thread_local std::string currentRequestId_;
 
   // Performance statistics recorded from distributed queries
   std::map<std::string, QueryPerformance> performance_;
 
+  /// Protects the results and performance statistics written by workers.
+  Mutex results_mutex_;
+
+  /// Number of requests running each query, keyed by SQL.
+  std::map<std::string, size_t> running_;
+
+  /// Protects the running queries.
+  Mutex running_mutex_;
+
  private:
   friend class DistributedTests;
   FRIEND_TEST(DistributedTests, test_workflow);
@@ -375,5 +405,6 @@ class Distributed {
   FRIEND_TEST(DistributedTests, test_accept_work_basic);
   FRIEND_TEST(DistributedTests, test_accept_work_with_discovery);
   FRIEND_TEST(DistributedTests, test_accept_work_with_discovery_all_fail);
+  FRIEND_TEST(DistributedTests, test_run_queries_time_budget);
 };
 } // namespace osquery
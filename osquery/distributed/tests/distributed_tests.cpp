@@ -30,6 +30,8 @@ namespace osquery {
 
 DECLARE_string(distributed_tls_read_endpoint);
 DECLARE_string(distributed_tls_write_endpoint);
+DECLARE_uint64(distributed_workers);
+DECLARE_uint64(distributed_time_budget);
 
 class DistributedTests : public testing::Test {
  protected:
@@ -267,8 +269,8 @@ class DistributedMock : public Distributed {
 TEST_F(DistributedTests, test_run_queries_with_denylisted_query) {
   auto dist = DistributedMock();
   // flushCompleted is mocked to avoid sending results in
-  // Distributed.runQueries.
-  EXPECT_CALL(dist, flushCompleted).Times(2);
+  // Distributed.runQueries, it also runs as each query completes.
+  EXPECT_CALL(dist, flushCompleted).Times(testing::AtLeast(2));
 
   // Simulate a denylisted query by manually marking it as running.
   const auto denylistedQuery = "SELECT * FROM osquery_info;";
@@ -435,4 +437,57 @@ TEST_F(DistributedTests, test_accept_work_with_discovery_all_fail) {
   const auto queries = dist.getPendingQueries();
   ASSERT_EQ(queries.size(), 0);
 }
+TEST_F(DistributedTests, test_run_queries_time_budget) {
+  auto backup_workers = FLAGS_distributed_workers;
+  auto backup_budget = FLAGS_distributed_time_budget;
+  FLAGS_distributed_workers = 2;
+  FLAGS_distributed_time_budget = 1;
+
+  auto dist = DistributedMock();
+  EXPECT_CALL(dist, flushCompleted).Times(testing::AtLeast(1));
+
+  // The first query never completes on its own.
+  const std::string work = R"json(
+{
+  "queries": {
+    "q1": "with recursive c(x) as (select 1 union all select x + 1 from c) select count(*) from c",
+    "q2": "SELECT * FROM osquery_info;"
+  }
+}
+)json";
+  auto status = dist.acceptWork(work);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = dist.runQueries();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  // The second query completed while the first ran past the budget.
+  ASSERT_EQ(dist.results_.size(), 2U);
+  for (const auto& result : dist.results_) {
+    if (result.request.id == "q1") {
+      EXPECT_EQ(result.status.getMessage(), "Timeout");
+      EXPECT_EQ(result.message, "distributed query ran past the time budget");
+    } else {
+      EXPECT_TRUE(result.status.ok());
+      EXPECT_FALSE(result.results.empty());
+    }
+  }
+
+  // Each result is queued along with the statistics of its run.
+  EXPECT_EQ(dist.performance_.size(), 2U);
+  for (const auto& result : dist.results_) {
+    EXPECT_TRUE(result.performance);
+    EXPECT_EQ(dist.performance_.count(result.request.id), 1U);
+  }
+
+  // The interrupted query is not left marked as running.
+  for (const auto& result : dist.results_) {
+    std::string ts;
+    status = getDatabaseValue(
+        kDistributedRunningQueries, hashQuery(result.request.query), ts);
+    EXPECT_FALSE(status.ok());
+  }
+
+  FLAGS_distributed_workers = backup_workers;
+  FLAGS_distributed_time_budget = backup_budget;
+}
 } // namespace osquery
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/events/linux/auditdnetlink.h>
+#include <osquery/events/linux/auditeventpublisher.h>
+
+namespace osquery {
+
+namespace {
+
+/// Records captured from the audit netlink while a process opened a file.
+const std::vector<std::pair<int, std::string>> kCapturedRecords = {
+    {1300,
+     "audit(1502573850.697:38396): arch=c000003e syscall=2 success=yes "
+     "exit=3 a0=7f6a824d4df5 a1=80000 a2=1 a3=7f6a826db4f8 items=1 ppid=4316 "
+     "pid=5581 auid=1000 uid=0 gid=0 euid=0 suid=0 fsuid=0 egid=0 sgid=0 "
+     "fsgid=0 tty=pts1 ses=1 comm=\"mytest\" exe=\"/home/alessandro/mytest\" "
+     "subj=unconfined_u:unconfined_r:unconfined_t:s0-s0:c0.c1023 "
+     "key=(null)"},
+    {1307, "audit(1502573850.697:38396):  cwd=\"/home/alessandro\""},
+    {1302,
+     "audit(1502573850.697:38396): item=0 name=\"/etc/ld.so.cache\" "
+     "inode=67842177 dev=fd:00 mode=0100644 ouid=0 ogid=0 rdev=00:00 "
+     "obj=unconfined_u:object_r:ld_so_cache_t:s0 objtype=NORMAL"},
+    {1320, "audit(1502573850.697:38396): "},
+    {1300,
+     "audit(1502573850.697:38397): arch=c000003e syscall=9 success=yes "
+     "exit=140095431385088 a0=0 a1=15e5b a2=1 a3=2 items=0 ppid=4316 "
+     "pid=5581 auid=1000 uid=0 gid=0 euid=0 suid=0 fsuid=0 egid=0 sgid=0 "
+     "fsgid=0 tty=pts1 ses=1 comm=\"mytest\" exe=\"/home/alessandro/mytest\" "
+     "subj=unconfined_u:unconfined_r:unconfined_t:s0-s0:c0.c1023 "
+     "key=(null)"},
+    {1323, "audit(1502573850.697:38397): fd=3 flags=0x2"},
+    {1320, "audit(1502573850.697:38397): "},
+};
+
+/// The number of times the captured records are replayed per iteration.
+const size_t kReplays{1000};
+
+/// Frame the captured records as the netlink messages the kernel sends.
+std::vector<audit_message> getCapturedMessages() {
+  std::vector<audit_message> messages;
+  for (const auto& record : kCapturedRecords) {
+    audit_message message = {};
+    message.nlh.nlmsg_type = static_cast<__u16>(record.first);
+    message.nlh.nlmsg_len = static_cast<__u32>(record.second.size());
+    std::memcpy(NLMSG_DATA(&message.nlh),
+                record.second.data(),
+                record.second.size());
+    messages.push_back(message);
+  }
+  return messages;
+}
+
+/// The field list of each captured record, without the record header.
+std::vector<std::string> getCapturedFieldLists() {
+  std::vector<std::string> field_lists;
+  for (const auto& record : kCapturedRecords) {
+    auto preamble_end = record.second.find("): ");
+    field_lists.push_back(record.second.substr(preamble_end + 3));
+  }
+  return field_lists;
+}
+
+/// Tokenize a field list into a map, as records used to be stored.
+void tokenizeIntoMap(const std::string& field_list,
+                     std::map<std::string, std::string>& fields) {
+  std::string key, value;
+  bool found_assignment{false};
+  bool found_enclose{false};
+
+  for (const auto& c : field_list) {
+    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
+      if (c == '"') {
+        value += c;
+      }
+
+      if (!key.empty()) {
+        fields.emplace(std::move(key), std::move(value));
+      }
+
+      found_enclose = false;
+      found_assignment = false;
+      key.clear();
+      value.clear();
+
+    } else if (found_assignment) {
+      if (c == '"') {
+        found_enclose = true;
+      }
+      value += c;
+
+    } else if (c == '=') {
+      found_assignment = true;
+
+    } else {
+      key += c;
+    }
+  }
+
+  if (!key.empty()) {
+    fields.emplace(std::move(key), std::move(value));
+  }
+}
+
+} // namespace
+
+/// The baseline: every key and value is copied into a map node.
+static void AUDIT_tokenize_map(benchmark::State& state) {
+  auto field_lists = getCapturedFieldLists();
+
+  while (state.KeepRunning()) {
+    for (const auto& field_list : field_lists) {
+      std::map<std::string, std::string> fields;
+      tokenizeIntoMap(field_list, fields);
+      benchmark::DoNotOptimize(fields);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * field_lists.size());
+}
+
+BENCHMARK(AUDIT_tokenize_map);
+
+static void AUDIT_tokenize_field_list(benchmark::State& state) {
+  auto field_lists = getCapturedFieldLists();
+  AuditFieldList fields;
+
+  while (state.KeepRunning()) {
+    for (const auto& field_list : field_lists) {
+      fields.parse(field_list);
+      benchmark::DoNotOptimize(fields);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * field_lists.size());
+}
+
+BENCHMARK(AUDIT_tokenize_field_list);
+
+/// The lookups the publisher makes on every AUDIT_SYSCALL record.
+static void AUDIT_syscall_field_lookups(benchmark::State& state) {
+  AuditFieldList fields;
+  fields.parse(getCapturedFieldLists().front());
+
+  std::string executable_path;
+  std::uint64_t value = 0;
+  while (state.KeepRunning()) {
+    GetStringFieldFromMap(executable_path, fields, "exe");
+    for (const auto& name : {"syscall", "pid", "ppid", "uid", "auid", "euid",
+                             "fsuid", "suid", "gid", "egid", "fsgid", "sgid"}) {
+      GetIntegerFieldFromMap(value, fields, name);
+      benchmark::DoNotOptimize(value);
+    }
+  }
+}
+
+BENCHMARK(AUDIT_syscall_field_lookups);
+
+static void AUDIT_parse_reply(benchmark::State& state) {
+  auto messages = getCapturedMessages();
+  audit_reply reply = {};
+  AuditEventRecord record;
+
+  while (state.KeepRunning()) {
+    for (const auto& message : messages) {
+      reply.msg = message;
+      AuditdNetlinkParser::AdjustAuditReply(reply);
+      AuditdNetlinkParser::ParseAuditReply(reply, record);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * messages.size());
+}
+
+BENCHMARK(AUDIT_parse_reply);
+
+/**
+ * Replay the captured records through the reader, parser and publisher
+ * threads, and the rings between them.
+ */
+static void AUDIT_ring_replay(benchmark::State& state) {
+  auto messages = getCapturedMessages();
+  auto total = messages.size() * kReplays;
+
+  SPSCRing<audit_reply> replies(kAuditReplyRingCapacity);
+  SPSCRing<AuditEventRecord> records(kAuditRecordRingCapacity);
+
+  while (state.KeepRunning()) {
+    // The reader receives each message into the next free slot.
+    std::thread reader([&]() {
+      for (size_t i = 0; i < total; i++) {
+        audit_reply* reply = nullptr;
+        while ((reply = replies.claim()) == nullptr) {
+          replies.waitForSpace(std::chrono::milliseconds(100));
+        }
+
+        reply->msg = messages[i % messages.size()];
+        replies.publish();
+      }
+    });
+
+    std::thread parser([&]() {
+      for (size_t i = 0; i < total; i++) {
+        audit_reply* reply = nullptr;
+        while ((reply = replies.front()) == nullptr) {
+          replies.waitForData(std::chrono::milliseconds(100));
+        }
+
+        AuditEventRecord* record = nullptr;
+        while ((record = records.claim()) == nullptr) {
+          records.waitForSpace(std::chrono::milliseconds(100));
+        }
+
+        AuditdNetlinkParser::AdjustAuditReply(*reply);
+        AuditdNetlinkParser::ParseAuditReply(*reply, *record);
+        records.publish();
+        replies.pop();
+      }
+    });
+
+    // The publisher drains the parsed records.
+    for (size_t i = 0; i < total; i++) {
+      AuditEventRecord* record = nullptr;
+      while ((record = records.front()) == nullptr) {
+        records.waitForData(std::chrono::milliseconds(100));
+      }
+
+      benchmark::DoNotOptimize(record->type);
+      records.pop();
+    }
+
+    reader.join();
+    parser.join();
+  }
+
+  state.SetItemsProcessed(state.iterations() * total);
+  state.counters["reader_stalls"] = static_cast<double>(replies.stalls());
+  state.counters["parser_stalls"] = static_cast<double>(records.stalls());
+}
+
+BENCHMARK(AUDIT_ring_replay)->UseRealTime();
+
+} // namespace osquery
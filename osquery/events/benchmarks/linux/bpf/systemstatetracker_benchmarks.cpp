@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/events/linux/bpf/systemstatetracker.h>
+#include <osquery/events/tests/linux/bpf/mockedprocesscontextfactory.h>
+#include <osquery/events/tests/linux/bpf/utils.h>
+
+namespace osquery {
+
+namespace {
+
+/// The process that forks, as captured by the mocked factory.
+const pid_t kParentProcessId{1000};
+
+/// The first pid assigned to the forked children.
+const pid_t kChildProcessId{2000};
+
+/// The number of children each iteration forks.
+const size_t kForks{100};
+
+/// The number of files each child opens and closes again.
+const size_t kOpens{16};
+
+const std::vector<std::string> kExecArgumentList = {"date", "--help"};
+
+/// The header of an event emitted by the child process.
+tob::ebpfpub::IFunctionTracer::Event::Header getEventHeader(pid_t process_id) {
+  tob::ebpfpub::IFunctionTracer::Event::Header header = {};
+  header.thread_id = process_id;
+  header.process_id = process_id;
+  header.user_id = 1000;
+  header.group_id = 1000;
+  return header;
+}
+
+/**
+ * Capture the parent process, and grow its file descriptor table to the
+ * given size. Every other descriptor is marked as close-on-exec.
+ */
+void initializeContext(SystemStateTracker::Context& context,
+                       MockedProcessContextFactory& process_context_factory,
+                       int fd_count) {
+  SystemStateTracker::getProcessContext(
+      context, process_context_factory, kParentProcessId);
+
+  for (int fd = 100; fd < 100 + fd_count; ++fd) {
+    setFileDescriptor(context.process_map,
+                      kParentProcessId,
+                      fd,
+                      (fd % 2) == 0,
+                      "/var/log/file" + std::to_string(fd));
+  }
+}
+
+/// Fork all the children from the parent process.
+void forkChildren(SystemStateTracker::Context& context,
+                  MockedProcessContextFactory& process_context_factory) {
+  for (size_t i = 0; i < kForks; ++i) {
+    auto child_process_id = kChildProcessId + static_cast<pid_t>(i);
+
+    SystemStateTracker::createProcess(context,
+                                      process_context_factory,
+                                      getEventHeader(child_process_id),
+                                      kParentProcessId,
+                                      child_process_id);
+  }
+}
+
+/// Drop the children and their events, as if they had exited.
+void reapChildren(SystemStateTracker::Context& context) {
+  for (size_t i = 0; i < kForks; ++i) {
+    context.process_map.erase(kChildProcessId + static_cast<pid_t>(i));
+  }
+
+  context.event_list.clear();
+}
+
+} // namespace
+
+/// Fork storm: the children never touch their process contexts.
+static void BPF_fork_storm(benchmark::State& state) {
+  MockedProcessContextFactory process_context_factory;
+  SystemStateTracker::Context context;
+  initializeContext(
+      context, process_context_factory, static_cast<int>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    forkChildren(context, process_context_factory);
+    reapChildren(context);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kForks);
+}
+
+BENCHMARK(BPF_fork_storm)->Arg(16)->Arg(256)->Arg(1024);
+
+/// Each child executes a new binary, dropping the close-on-exec descriptors.
+static void BPF_fork_exec_storm(benchmark::State& state) {
+  MockedProcessContextFactory process_context_factory;
+  SystemStateTracker::Context context;
+  initializeContext(
+      context, process_context_factory, static_cast<int>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    forkChildren(context, process_context_factory);
+
+    for (size_t i = 0; i < kForks; ++i) {
+      auto child_process_id = kChildProcessId + static_cast<pid_t>(i);
+
+      SystemStateTracker::executeBinary(context,
+                                        process_context_factory,
+                                        getEventHeader(child_process_id),
+                                        child_process_id,
+                                        AT_FDCWD,
+                                        0,
+                                        "/usr/bin/date",
+                                        kExecArgumentList);
+    }
+
+    reapChildren(context);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kForks);
+}
+
+BENCHMARK(BPF_fork_exec_storm)->Arg(16)->Arg(256)->Arg(1024);
+
+/// Each child opens a few files and closes them again.
+static void BPF_fork_open_storm(benchmark::State& state) {
+  MockedProcessContextFactory process_context_factory;
+  SystemStateTracker::Context context;
+  initializeContext(
+      context, process_context_factory, static_cast<int>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    forkChildren(context, process_context_factory);
+
+    for (size_t i = 0; i < kForks; ++i) {
+      auto child_process_id = kChildProcessId + static_cast<pid_t>(i);
+
+      for (size_t j = 0; j < kOpens; ++j) {
+        auto fd = 10 + static_cast<int>(j);
+
+        SystemStateTracker::openFile(context,
+                                     process_context_factory,
+                                     child_process_id,
+                                     AT_FDCWD,
+                                     fd,
+                                     "/etc/hosts",
+                                     O_RDONLY);
+
+        SystemStateTracker::closeHandle(
+            context, process_context_factory, child_process_id, fd);
+      }
+    }
+
+    reapChildren(context);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kForks);
+}
+
+BENCHMARK(BPF_fork_open_storm)->Arg(16)->Arg(256)->Arg(1024);
+
+} // namespace osquery
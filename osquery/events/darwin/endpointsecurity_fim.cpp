@@ -130,6 +130,7 @@ void EndpointSecurityFileEventPublisher::configure() {
       auto parser = Config::getParser("file_paths");
       if (parser != nullptr) {
         // resolve and collect all the exclude_paths first from the config
+        std::vector<std::string> exclude_patterns;
         const auto& doc = parser->getData().doc();
         auto it = doc.FindMember("exclude_paths");
         if (it != doc.MemberEnd()) {
@@ -141,6 +142,7 @@ void EndpointSecurityFileEventPublisher::configure() {
                     std::string pattern = ex_path.GetString();
                     if (!pattern.empty()) {
                       resolveFilePattern(pattern, exclude_paths_);
+                      exclude_patterns.push_back(std::move(pattern));
                     }
                   }
                 }
@@ -150,11 +152,13 @@ void EndpointSecurityFileEventPublisher::configure() {
         }
 
         // grab all the file_paths from the config
-        Config::get().files([this](const std::string& category,
-                                   const std::vector<std::string>& files) {
+        // excluded trees are not walked while resolving recursive patterns
+        Config::get().files([this, &exclude_patterns](
+                                const std::string& category,
+                                const std::vector<std::string>& files) {
           for (auto file : files) {
             replaceGlobWildcards(file);
-            resolveFilePattern(file, file_paths_);
+            resolveFilePattern(file, file_paths_, GLOB_ALL, exclude_patterns);
           }
         });
 
@@ -10,7 +10,9 @@
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
+#include <osquery/events/eventstream.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
@@ -34,6 +36,40 @@ struct SubscriberExpirationDetails {
   size_t query_count{0};
 };
 
+/// Parse the streaming queries of a subscriber from the "events" config.
+EventStreamQueryList getStreamQueries(const std::string& subscriber) {
+  EventStreamQueryList queries;
+  auto plugin = Config::get().getParser("events");
+  if (plugin == nullptr || plugin.get() == nullptr) {
+    return queries;
+  }
+
+  const auto& data = plugin->getData().doc();
+  if (!data["events"].HasMember("streams") ||
+      !data["events"]["streams"].IsObject()) {
+    return queries;
+  }
+
+  for (const auto& stream : data["events"]["streams"].GetObject()) {
+    const auto& obj = stream.value;
+    if (!obj.IsObject() || !obj.HasMember("subscriber") ||
+        !obj["subscriber"].IsString() ||
+        obj["subscriber"].GetString() != subscriber) {
+      continue;
+    }
+
+    auto query = std::make_shared<EventStreamQuery>();
+    auto status = EventStreamQuery::parse(stream.name.GetString(), obj, *query);
+    if (!status.ok()) {
+      LOG(WARNING) << status.getMessage();
+      continue;
+    }
+    queries.push_back(std::move(query));
+  }
+
+  return queries;
+}
+
 } // namespace
 
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
@@ -85,6 +121,12 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
     }
   }
 
+  // Subscribers with streaming queries log their rows instead of storing them.
+  base_sub->setStreamQueries(getStreamQueries(name));
+  if (base_sub->isStreaming()) {
+    VLOG(1) << "Streaming the events of subscriber: " << name;
+  }
+
   if (base_sub->state() != EventState::EVENT_NONE) {
     base_sub->tearDown();
   }
@@ -303,6 +345,10 @@ void EventFactory::forwardEvent(const std::string& event) {
   }
 }
 
+bool EventFactory::hasForwarders() {
+  return !getInstance().loggers_.empty();
+}
+
 void EventFactory::configUpdate() {
   // Scan the schedule for queries that touch "_events" tables.
   // We will count the queries
@@ -335,6 +381,14 @@ void EventFactory::configUpdate() {
       });
 
   auto& ef = EventFactory::getInstance();
+  {
+    RecursiveLock lock(ef.factory_lock_);
+    for (const auto& subscriber : ef.event_subs_) {
+      subscriber.second->setStreamQueries(getStreamQueries(subscriber.first));
+    }
+  }
+  startStreamRunner();
+
   for (const auto& details : subscriber_details) {
     if (!ef.exists(details.first)) {
       continue;
@@ -437,6 +491,29 @@ void EventFactory::delay() {
       ef.threads_.push_back(thread_);
     }
   }
+
+  {
+    RecursiveLock lock(ef.factory_lock_);
+    ef.delayed_ = true;
+  }
+  startStreamRunner();
+}
+
+void EventFactory::startStreamRunner() {
+  auto& ef = EventFactory::getInstance();
+  RecursiveLock lock(ef.factory_lock_);
+  if (!ef.delayed_ || ef.stream_runner_started_) {
+    return;
+  }
+
+  // Streamed events are logged by a service, started by the first stream.
+  for (const auto& subscriber : ef.event_subs_) {
+    if (subscriber.second->isStreaming()) {
+      Dispatcher::addService(std::make_shared<EventStreamRunner>());
+      ef.stream_runner_started_ = true;
+      break;
+    }
+  }
 }
 
 void EventFactory::end(bool join) {
@@ -466,6 +543,7 @@ void EventFactory::end(bool join) {
     // Threads may still be executing, when they finish, release publishers.
     ef.event_pubs_.clear();
     ef.event_subs_.clear();
+    ef.delayed_ = false;
   }
 }
 
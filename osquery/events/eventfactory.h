@@ -149,6 +149,9 @@ class EventFactory : private boost::noncopyable {
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
+  /// Check if any logger receives forwarded events.
+  static bool hasForwarders();
+
   /**
    * @brief The event factory, subscribers, and publishers respond to updates.
    *
@@ -211,6 +214,9 @@ class EventFactory : private boost::noncopyable {
   EventFactory() = default;
   ~EventFactory() = default;
 
+  /// Start the EventStreamRunner once running subscribers declare streams.
+  static void startStreamRunner();
+
  private:
   /// Set of registered EventPublisher instances.
   std::map<std::string, EventPublisherRef> event_pubs_;
@@ -221,6 +227,12 @@ class EventFactory : private boost::noncopyable {
   /// Set of running EventPublisher run loop threads.
   std::vector<std::shared_ptr<std::thread>> threads_;
 
+  /// True between EventFactory::delay and EventFactory::end.
+  bool delayed_{false};
+
+  /// True once the EventStreamRunner service was started.
+  bool stream_runner_started_{false};
+
   /// Set of logger plugins to forward events.
   std::vector<std::string> loggers_;
 
@@ -0,0 +1,423 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/query.h>
+#include <osquery/core/system.h>
+#include <osquery/events/eventstream.h>
+#include <osquery/logger/data_logger.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/time.h>
+#include <plugins/config/parsers/decorators.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     events_stream_max,
+     10000,
+     "Maximum number of streamed event rows waiting for the loggers");
+
+FLAG(uint64,
+     events_stream_wait,
+     0,
+     "Milliseconds a subscriber waits for room in a full event stream");
+
+namespace {
+
+/// The number of rows logged at a time.
+const std::size_t kEventStreamBatchSize{1024U};
+
+/// How long the runner waits for rows before checking for interruptions.
+const std::chrono::milliseconds kEventStreamPollInterval{1000};
+
+/// Seconds between two warnings about dropped rows.
+const std::uint64_t kEventStreamDropReportInterval{60U};
+
+/// Match a value against a like pattern, ignoring the case of ASCII letters.
+bool matchesLikePattern(const std::string& value, const std::string& pattern) {
+  auto equals = [](char l, char r) {
+    return std::tolower(static_cast<unsigned char>(l)) ==
+           std::tolower(static_cast<unsigned char>(r));
+  };
+
+  std::size_t v{0};
+  std::size_t p{0};
+
+  // Where to resume after the last '%' when the rest fails to match.
+  std::size_t star_p{std::string::npos};
+  std::size_t star_v{0};
+
+  while (v < value.size()) {
+    if (p < pattern.size() &&
+        (pattern[p] == '_' || equals(pattern[p], value[v]))) {
+      ++v;
+      ++p;
+    } else if (p < pattern.size() && pattern[p] == '%') {
+      star_p = p++;
+      star_v = v;
+    } else if (star_p != std::string::npos) {
+      p = star_p + 1;
+      v = ++star_v;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '%') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+Status parseOperator(const std::string& op,
+                     EventStreamPredicate::Operator& result) {
+  using Operator = EventStreamPredicate::Operator;
+
+  static const std::map<std::string, Operator> kOperators = {
+      {"=", Operator::Equals},
+      {"==", Operator::Equals},
+      {"!=", Operator::NotEquals},
+      {"<>", Operator::NotEquals},
+      {"<", Operator::Less},
+      {"<=", Operator::LessOrEquals},
+      {">", Operator::Greater},
+      {">=", Operator::GreaterOrEquals},
+      {"like", Operator::Like},
+      {"LIKE", Operator::Like},
+  };
+
+  auto it = kOperators.find(op);
+  if (it == kOperators.end()) {
+    return Status::failure("Unsupported operator: " + op);
+  }
+
+  result = it->second;
+  return Status::success();
+}
+
+Status parseValue(const rapidjson::Value& value, std::string& result) {
+  if (value.IsString()) {
+    result = value.GetString();
+  } else if (value.IsInt64()) {
+    result = std::to_string(value.GetInt64());
+  } else if (value.IsUint64()) {
+    result = std::to_string(value.GetUint64());
+  } else {
+    return Status::failure("Values must be strings or integers");
+  }
+  return Status::success();
+}
+
+Status parsePredicate(const rapidjson::Value& obj,
+                      EventStreamPredicate& predicate) {
+  if (!obj.IsObject() || !obj.HasMember("column") ||
+      !obj["column"].IsString() || !obj.HasMember("value")) {
+    return Status::failure("Conditions need a column and a value");
+  }
+  predicate.column = obj["column"].GetString();
+
+  if (obj.HasMember("op")) {
+    if (!obj["op"].IsString()) {
+      return Status::failure("The operator must be a string");
+    }
+
+    auto status = parseOperator(obj["op"].GetString(), predicate.op);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  return parseValue(obj["value"], predicate.value);
+}
+
+} // namespace
+
+bool EventStreamPredicate::matches(const Row& row) const {
+  auto it = row.find(column);
+  if (it == row.end()) {
+    return false;
+  }
+
+  const auto& actual = it->second;
+  if (op == Operator::Like) {
+    return matchesLikePattern(actual, value);
+  }
+
+  int comparison{0};
+  auto actual_integer = tryTo<long long>(actual);
+  auto expected_integer = tryTo<long long>(value);
+  if (actual_integer.isValue() && expected_integer.isValue()) {
+    auto l = actual_integer.get();
+    auto r = expected_integer.get();
+    comparison = (l < r) ? -1 : (l > r) ? 1 : 0;
+  } else {
+    comparison = actual.compare(value);
+  }
+
+  switch (op) {
+  case Operator::Equals:
+    return comparison == 0;
+  case Operator::NotEquals:
+    return comparison != 0;
+  case Operator::Less:
+    return comparison < 0;
+  case Operator::LessOrEquals:
+    return comparison <= 0;
+  case Operator::Greater:
+    return comparison > 0;
+  case Operator::GreaterOrEquals:
+    return comparison >= 0;
+  default:
+    return false;
+  }
+}
+
+Status EventStreamQuery::parse(const std::string& name,
+                               const rapidjson::Value& obj,
+                               EventStreamQuery& query) {
+  if (!obj.IsObject()) {
+    return Status::failure("The event stream " + name + " is not an object");
+  }
+
+  if (!obj.HasMember("subscriber") || !obj["subscriber"].IsString()) {
+    return Status::failure("The event stream " + name + " has no subscriber");
+  }
+
+  query = EventStreamQuery();
+  query.name_ = name;
+  query.subscriber_ = obj["subscriber"].GetString();
+
+  if (obj.HasMember("columns")) {
+    if (!obj["columns"].IsArray()) {
+      return Status::failure("The columns of the event stream " + name +
+                             " are not a list");
+    }
+
+    for (const auto& column : obj["columns"].GetArray()) {
+      if (!column.IsString()) {
+        return Status::failure("The columns of the event stream " + name +
+                               " must be strings");
+      }
+      query.columns_.push_back(column.GetString());
+    }
+  }
+
+  if (obj.HasMember("where")) {
+    if (!obj["where"].IsArray()) {
+      return Status::failure("The conditions of the event stream " + name +
+                             " are not a list");
+    }
+
+    for (const auto& condition : obj["where"].GetArray()) {
+      EventStreamPredicate predicate;
+      auto status = parsePredicate(condition, predicate);
+      if (!status.ok()) {
+        return Status::failure("Invalid condition in the event stream " +
+                               name + ": " + status.getMessage());
+      }
+      query.predicates_.push_back(std::move(predicate));
+    }
+  }
+
+  return Status::success();
+}
+
+bool EventStreamQuery::matches(const Row& row) const {
+  return std::all_of(predicates_.begin(),
+                     predicates_.end(),
+                     [&row](const auto& p) { return p.matches(row); });
+}
+
+Row EventStreamQuery::project(const Row& row) const {
+  if (columns_.empty()) {
+    return row;
+  }
+
+  Row projected;
+  for (const auto& column : columns_) {
+    auto it = row.find(column);
+    if (it != row.end()) {
+      projected.insert(*it);
+    }
+  }
+  return projected;
+}
+
+EventStream& EventStream::get() {
+  static EventStream stream;
+  return stream;
+}
+
+void EventStream::push(std::vector<EventStreamItem>& items) {
+  if (items.empty()) {
+    return;
+  }
+
+  auto max_items = std::max<std::size_t>(FLAGS_events_stream_max, 1U);
+  auto fits = [this, &items, max_items]() {
+    return queue_.size() + items.size() <= max_items;
+  };
+
+  std::size_t queued{0};
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!fits()) {
+      backpressure_++;
+      if (FLAGS_events_stream_wait > 0) {
+        space_cv_.wait_for(
+            lock, std::chrono::milliseconds(FLAGS_events_stream_wait), fits);
+      }
+    }
+
+    auto room = max_items - std::min(max_items, queue_.size());
+    queued = std::min(room, items.size());
+    for (std::size_t i = 0; i < queued; ++i) {
+      queue_.push_back(std::move(items[i]));
+    }
+  }
+
+  if (queued < items.size()) {
+    dropped_ += items.size() - queued;
+  }
+
+  if (queued > 0) {
+    data_cv_.notify_one();
+  }
+}
+
+void EventStream::pop(std::vector<EventStreamItem>& items,
+                      std::size_t max_items,
+                      std::chrono::milliseconds timeout) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.empty()) {
+      data_cv_.wait_for(lock, timeout);
+    }
+
+    auto count = std::min(max_items, queue_.size());
+    auto end = std::next(queue_.begin(), count);
+    items.insert(items.end(),
+                 std::make_move_iterator(queue_.begin()),
+                 std::make_move_iterator(end));
+    queue_.erase(queue_.begin(), end);
+
+    if (count == 0) {
+      return;
+    }
+  }
+
+  space_cv_.notify_all();
+}
+
+void EventStream::recordLogged(std::size_t count) {
+  logged_ += count;
+}
+
+void EventStream::wakeAll() {
+  data_cv_.notify_all();
+  space_cv_.notify_all();
+}
+
+EventStreamStats EventStream::getStats() const {
+  EventStreamStats stats;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.queued = queue_.size();
+  }
+  stats.logged = logged_;
+  stats.backpressure = backpressure_;
+  stats.dropped = dropped_;
+  return stats;
+}
+
+Status EventStreamRunner::logItems(std::vector<EventStreamItem>& items) {
+  if (items.empty() || Flag::getValue("disable_logging") == "true") {
+    return Status::success();
+  }
+
+  // Rows are logged as scheduled query results would be.
+  auto identifier = getHostIdentifier();
+  auto time = getUnixTime();
+  auto calendar_time = getAsciiTime();
+  auto epoch = tryTo<std::uint64_t>(Flag::getValue("schedule_epoch"))
+                   .takeOr(std::uint64_t{0});
+
+  std::map<std::string, std::string> decorations;
+  getDecorations(decorations);
+
+  Status result;
+  for (auto it = items.begin(); it != items.end();) {
+    QueryLogItem item;
+    item.isSnapshot = false;
+    item.name = it->name;
+    item.identifier = identifier;
+    item.time = time;
+    item.epoch = epoch;
+    item.calendar_time = calendar_time;
+    item.decorations = decorations;
+
+    // Consecutive rows of a stream share a log item.
+    for (; it != items.end() && it->name == item.name; ++it) {
+      RowTyped row;
+      for (auto& column : it->row) {
+        row[column.first] = std::move(column.second);
+      }
+      item.results.added.push_back(std::move(row));
+    }
+
+    // Keep logging the other streams, but report the first failure.
+    auto status = logQueryLogItem(item);
+    if (!status.ok() && result.ok()) {
+      result = status;
+    }
+  }
+
+  EventStream::get().recordLogged(items.size());
+  return result;
+}
+
+void EventStreamRunner::start() {
+  auto& stream = EventStream::get();
+
+  std::vector<EventStreamItem> items;
+  std::uint64_t reported_drops{0};
+  std::uint64_t last_report_time{0};
+
+  while (!interrupted()) {
+    items.clear();
+    stream.pop(items, kEventStreamBatchSize, kEventStreamPollInterval);
+
+    auto status = logItems(items);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to log the streamed events: " << status.getMessage();
+    }
+
+    auto dropped = stream.getStats().dropped;
+    auto now = getUnixTime();
+    if (dropped != reported_drops &&
+        now - last_report_time >= kEventStreamDropReportInterval) {
+      LOG(WARNING) << "Dropped " << (dropped - reported_drops)
+                   << " streamed event rows, the loggers are falling behind";
+      reported_drops = dropped;
+      last_report_time = now;
+    }
+  }
+}
+
+void EventStreamRunner::stop() {
+  EventStream::get().wakeAll();
+}
+
+} // namespace osquery
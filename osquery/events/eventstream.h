@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A condition on one column of the rows of a streaming query.
+struct EventStreamPredicate {
+  enum class Operator {
+    Equals,
+    NotEquals,
+    Less,
+    LessOrEquals,
+    Greater,
+    GreaterOrEquals,
+    Like,
+  };
+
+  std::string column;
+  Operator op{Operator::Equals};
+  std::string value;
+
+  /**
+   * @brief Check a row against the condition.
+   *
+   * Values are compared as integers when both are integers, as strings
+   * otherwise. Like patterns match as in SQLite. A row without the column
+   * never matches, as a NULL would not.
+   */
+  bool matches(const Row& row) const;
+};
+
+/**
+ * @brief A streaming query on the rows of an event subscriber.
+ *
+ * The equivalent of "SELECT <columns> FROM <subscriber> WHERE <predicates>",
+ * evaluated on each row as it is added instead of on the stored rows.
+ */
+class EventStreamQuery {
+ public:
+  /**
+   * @brief Parse a streaming query from its configuration.
+   *
+   * @param name The name the rows of the stream are logged under.
+   * @param obj The "subscriber", "columns" and "where" of the stream.
+   * @param query [output] The parsed query.
+   */
+  static Status parse(const std::string& name,
+                      const rapidjson::Value& obj,
+                      EventStreamQuery& query);
+
+  const std::string& name() const {
+    return name_;
+  }
+
+  const std::string& subscriber() const {
+    return subscriber_;
+  }
+
+  /// Check a row against all the predicates.
+  bool matches(const Row& row) const;
+
+  /// The projected columns of a row, all of them if none were listed.
+  Row project(const Row& row) const;
+
+ private:
+  std::string name_;
+  std::string subscriber_;
+  std::vector<std::string> columns_;
+  std::vector<EventStreamPredicate> predicates_;
+};
+
+using EventStreamQueryRef = std::shared_ptr<const EventStreamQuery>;
+using EventStreamQueryList = std::vector<EventStreamQueryRef>;
+
+/// A row waiting in the stream for the loggers.
+struct EventStreamItem {
+  /// The name of the stream the row matched.
+  std::string name;
+
+  Row row;
+};
+
+/// The state of the stream, see EventStream::getStats.
+struct EventStreamStats {
+  /// Rows waiting for the loggers
+  std::size_t queued{};
+
+  /// Rows handed to the loggers
+  std::uint64_t logged{};
+
+  /// Times a subscriber found the stream full
+  std::uint64_t backpressure{};
+
+  /// Rows dropped because the stream stayed full
+  std::uint64_t dropped{};
+};
+
+/**
+ * @brief The bounded queue between streaming subscribers and the loggers.
+ *
+ * Subscribers push the rows matching their streaming queries while adding
+ * events, and the EventStreamRunner drains them into the loggers. When the
+ * loggers fall behind, a subscriber waits up to events_stream_wait for room
+ * and drops the rows that still do not fit.
+ */
+class EventStream : private boost::noncopyable {
+ public:
+  static EventStream& get();
+
+  /// Queue rows, the ones that do not fit after waiting are dropped.
+  void push(std::vector<EventStreamItem>& items);
+
+  /**
+   * @brief Take the oldest rows out of the queue.
+   *
+   * @param items [output] The rows, in the order they were queued.
+   * @param max_items The number of rows to take at most.
+   * @param timeout How long to wait for a row if the queue is empty.
+   */
+  void pop(std::vector<EventStreamItem>& items,
+           std::size_t max_items,
+           std::chrono::milliseconds timeout);
+
+  /// Count rows handed to the loggers.
+  void recordLogged(std::size_t count);
+
+  /// Wake up the runner and waiting subscribers, such as when stopping.
+  void wakeAll();
+
+  EventStreamStats getStats() const;
+
+ private:
+  EventStream() = default;
+
+ private:
+  mutable std::mutex mutex_;
+
+  /// Notified when rows are queued.
+  std::condition_variable data_cv_;
+
+  /// Notified when rows are taken.
+  std::condition_variable space_cv_;
+
+  std::deque<EventStreamItem> queue_;
+
+  std::atomic<std::uint64_t> logged_{0};
+  std::atomic<std::uint64_t> backpressure_{0};
+  std::atomic<std::uint64_t> dropped_{0};
+};
+
+/**
+ * @brief The service logging the rows of the event stream.
+ *
+ * Rows are logged as the "added" results of their stream, decorated and
+ * formatted the same way as scheduled query results.
+ */
+class EventStreamRunner : public InternalRunnable {
+ public:
+  EventStreamRunner() : InternalRunnable("EventStreamRunner") {}
+
+  /// Log a batch of rows taken from the stream.
+  static Status logItems(std::vector<EventStreamItem>& items);
+
+ protected:
+  void start() override;
+  void stop() override;
+};
+
+} // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/database/database.h>
@@ -26,6 +28,60 @@ namespace {
 /// Checkpoint interval to inspect max event buffering.
 const EventContextID kEventsCheckpoint{256U};
 
+/// Number of events read and emitted at a time when generating rows.
+const std::size_t kEventsReadBatchSize{1024U};
+
+/// Split an event key into the time and identifier of the event.
+bool parseEventKey(const std::string& key,
+                   EventTime& event_time,
+                   EventID& event_id) {
+  const char* start = key.c_str();
+  char* end = nullptr;
+
+  auto time = std::strtoull(start, &end, 10);
+  if (end == start || *end != '.') {
+    return false;
+  }
+
+  start = end + 1;
+  auto id = std::strtoull(start, &end, 10);
+  if (end == start || *end != '\0' || id == 0U) {
+    return false;
+  }
+
+  event_time = static_cast<EventTime>(time);
+  event_id = static_cast<EventID>(id);
+  return true;
+}
+
+/// Times are padded to the width of the largest time, so keys sort by time.
+std::string toTimeIndex(EventTime event_time) {
+  auto time_index = std::to_string(event_time);
+  time_index.insert(time_index.begin(), 20U - time_index.size(), '0');
+  return time_index;
+}
+
+/// The range of keys holding the event batches between two times.
+std::pair<std::string, std::string> eventBatchKeyRange(EventTime first_time,
+                                                       EventTime last_time) {
+  // Every key of a batch is between "<time>." and "<time>/".
+  return std::make_pair(toTimeIndex(first_time) + ".",
+                        toTimeIndex(last_time) + "/");
+}
+
+/// Serialize a row as a JSON event, without the trailing newline.
+Status serializeEventJSON(const Row& row, std::string& serialized_row) {
+  auto status = serializeRowJSON(row, serialized_row);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
+    serialized_row.pop_back();
+  }
+  return Status::success();
+}
+
 void removeDeprecatedEventKeysOnceHelper() {
   std::vector<std::string> key_list;
   auto status = scanDatabaseKeys(kEvents, key_list);
@@ -70,6 +126,8 @@ void removeDeprecatedEventKeysOnce() {
 
 } // namespace
 
+DECLARE_bool(database_binary_rows);
+
 FLAG(bool,
      events_optimize,
      true,
@@ -110,6 +168,14 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list) {
 
 Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
                                        EventTime custom_event_time) {
+  auto event_time = custom_event_time != 0 ? custom_event_time : getTime();
+
+  // Streamed rows never reach the backing store.
+  auto stream_queries = std::atomic_load(&stream_queries_);
+  if (stream_queries != nullptr) {
+    return streamBatch(*stream_queries, row_list, event_time);
+  }
+
   removeDeprecatedEventKeysOnce();
 
   DatabaseStringValueList database_data;
@@ -118,9 +184,16 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   EventIDList event_id_list;
   event_id_list.reserve(row_list.size());
 
-  auto event_time = custom_event_time != 0 ? custom_event_time : getTime();
   auto string_event_time = std::to_string(event_time);
 
+  // Binary rows refer to the column dictionary, which must not change until
+  // the batch and any new columns have been stored.
+  bool binary_rows = FLAGS_database_binary_rows;
+  WriteLock dictionary_lock(context.column_dictionary_mutex, boost::defer_lock);
+  if (binary_rows) {
+    dictionary_lock.lock();
+  }
+
   for (auto& row : row_list) {
     auto event_identifier = getEventID();
     event_id_list.push_back(event_identifier);
@@ -130,27 +203,28 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
     row["time"] = string_event_time;
     row["eid"] = string_event_identifier;
 
-    // Serialize and store the row data, for query-time retrieval.
+    // Serialize the row as JSON if it is stored or forwarded as such.
     std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      VLOG(1) << status.getMessage();
-      continue;
-    }
+    if (!binary_rows || EventFactory::hasForwarders()) {
+      auto status = serializeEventJSON(row, serialized_row);
+      if (!status.ok()) {
+        VLOG(1) << status.getMessage();
+        continue;
+      }
 
-    // Then remove the newline.
-    if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
-      serialized_row.pop_back();
+      // Logger plugins may request events to be forwarded directly.
+      // If no active logger is marked 'usesLogEvent' then this is a no-op.
+      EventFactory::forwardEvent(serialized_row);
     }
 
-    // Logger plugins may request events to be forwarded directly.
-    // If no active logger is marked 'usesLogEvent' then this is a no-op.
-    EventFactory::forwardEvent(serialized_row);
+    if (binary_rows) {
+      serializeRowBinary(row, context.column_dictionary, serialized_row);
+    }
 
     // Store the event data in the batch
     database_data.push_back(
-        std::make_pair("data." + dbNamespace() + "." + string_event_identifier,
-                       serialized_row));
+        std::make_pair(databaseKeyForEvent(event_time, event_identifier),
+                       std::move(serialized_row)));
   }
 
   if (database_data.empty()) {
@@ -163,11 +237,32 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   {
     WriteLock lock(event_id_lock_);
 
-    auto status = setDatabaseBatch(kEvents, database_data);
+    // Store the dictionary before the first events using new columns.
+    std::size_t column_count{0U};
+    if (binary_rows) {
+      column_count = context.column_dictionary.size();
+      if (column_count != context.stored_column_count) {
+        std::string serialized_columns;
+        serializeColumnDictionary(context.column_dictionary,
+                                  serialized_columns);
+        auto status = setDatabaseValue(
+            kEvents, databaseKeyForColumns(context), serialized_columns);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+
+    auto status = setDatabaseBatch(context.database_domain, database_data);
     if (!status.ok()) {
       return status;
     }
 
+    if (binary_rows) {
+      context.stored_column_count = column_count;
+      dictionary_lock.unlock();
+    }
+
     {
       WriteLock lock(context.event_index_mutex);
 
@@ -198,6 +293,40 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   return Status::success();
 }
 
+Status EventSubscriberPlugin::streamBatch(const EventStreamQueryList& queries,
+                                          std::vector<Row>& row_list,
+                                          EventTime event_time) {
+  auto string_event_time = std::to_string(event_time);
+
+  std::vector<EventStreamItem> items;
+  for (auto& row : row_list) {
+    row["time"] = string_event_time;
+    row["eid"] = toIndex(getEventID());
+
+    if (EventFactory::hasForwarders()) {
+      std::string serialized_row;
+      if (serializeEventJSON(row, serialized_row).ok()) {
+        EventFactory::forwardEvent(serialized_row);
+      }
+    }
+
+    for (const auto& query : queries) {
+      if (query->matches(row)) {
+        items.push_back({query->name(), query->project(row)});
+      }
+    }
+  }
+
+  {
+    WriteLock lock(event_id_lock_);
+    event_count_ += row_list.size();
+  }
+
+  // Rows that do not fit in the stream are dropped and counted.
+  EventStream::get().push(items);
+  return Status::success();
+}
+
 Status EventSubscriberPlugin::generateEventDataIndex() {
   return generateEventDataIndex(context, getDatabase());
 }
@@ -261,11 +390,13 @@ void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                          EventTime stop_time) {
   EventTime optimize_time{0U};
   EventID optimize_eid{0U};
+  std::string query_name;
   if (can_optimize && shouldOptimize()) {
     // If the daemon is querying a subscriber without a 'time' constraint and
     // allows optimization, only emit events since the last query.
-    std::string query_name;
-    getOptimizeData(getDatabase(), optimize_time, optimize_eid, query_name);
+    // Scheduler workers run several queries at once, each on its own thread.
+    query_name = Config::getExecutingQuery();
+    getOptimizeData(getDatabase(), query_name, optimize_time, optimize_eid);
     start_time = optimize_time == 0 ? 0 : optimize_time - 1;
 
     // Track the queries that have selected data.
@@ -281,7 +412,8 @@ void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                optimize_eid);
 
     if (can_optimize && shouldOptimize() && !result.isEnd) {
-      setOptimizeData(getDatabase(), result.last_time, result.last_id);
+      setOptimizeData(
+          getDatabase(), query_name, result.last_time, result.last_id);
     }
   }
 
@@ -335,6 +467,19 @@ bool EventSubscriberPlugin::executedAllQueries() const {
   return queries_.size() >= query_count_;
 }
 
+void EventSubscriberPlugin::setStreamQueries(EventStreamQueryList queries) {
+  std::shared_ptr<const EventStreamQueryList> stream_queries;
+  if (!queries.empty()) {
+    stream_queries =
+        std::make_shared<const EventStreamQueryList>(std::move(queries));
+  }
+  std::atomic_store(&stream_queries_, std::move(stream_queries));
+}
+
+bool EventSubscriberPlugin::isStreaming() const {
+  return std::atomic_load(&stream_queries_) != nullptr;
+}
+
 std::string EventSubscriberPlugin::toIndex(std::uint64_t i) {
   auto str_index = std::to_string(i);
   if (str_index.size() < 10) {
@@ -344,12 +489,10 @@ std::string EventSubscriberPlugin::toIndex(std::uint64_t i) {
 }
 
 void EventSubscriberPlugin::setOptimizeData(IDatabaseInterface& db_interface,
+                                            const std::string& query_name,
                                             EventTime time,
                                             EventID eid) {
   // Store the optimization time and eid.
-  std::string query_name;
-  db_interface.getDatabaseValue(
-      kPersistentSettings, kExecutingQuery, query_name);
   if (query_name.empty()) {
     return;
   }
@@ -367,13 +510,10 @@ EventTime EventSubscriberPlugin::timeFromRecord(const std::string& record) {
 }
 
 void EventSubscriberPlugin::getOptimizeData(IDatabaseInterface& db_interface,
+                                            const std::string& query_name,
                                             EventTime& o_time,
-                                            EventID& o_eid,
-                                            std::string& query_name) {
-  // Read the optimization time for the current executing query.
-  db_interface.getDatabaseValue(
-      kPersistentSettings, kExecutingQuery, query_name);
-
+                                            EventID& o_eid) {
+  // Read the optimization time for the executing query.
   if (query_name.empty()) {
     o_time = 0;
     o_eid = 0;
@@ -403,14 +543,15 @@ void EventSubscriberPlugin::setDatabaseNamespace(Context& context,
                                                  const std::string& type,
                                                  const std::string& name) {
   context.database_namespace = type + "." + name;
+  context.database_domain = kEventsDomainPrefix + context.database_namespace;
 }
 
 Status EventSubscriberPlugin::generateEventDataIndex(
     Context& context, IDatabaseInterface& db_interface) {
   std::vector<std::string> key_list;
 
-  std::string prefix = "data." + context.database_namespace + ".";
-  auto status = db_interface.scanDatabaseKeys(kEvents, key_list, prefix, 0);
+  auto status = db_interface.scanDatabaseKeys(
+      context.database_domain, key_list, "", 0);
   if (!status.ok()) {
     return status;
   }
@@ -421,58 +562,26 @@ Status EventSubscriberPlugin::generateEventDataIndex(
   EventID last_event_id{1U};
   EventIndex event_index;
 
+  // The keys hold the time and identifier of each event, values are not read.
   for (const auto& key : key_list) {
-    auto string_event_id = &key[prefix.size()];
-
-    EventID event_identifier = {};
-
-    {
-      char* null_terminator = nullptr;
-      auto int_value = std::strtoull(string_event_id, &null_terminator, 10);
-      if (int_value == 0U || null_terminator == nullptr ||
-          *null_terminator != '\0') {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      event_identifier = static_cast<EventID>(int_value);
+    EventTime event_time{0U};
+    EventID event_identifier{0U};
+    if (!parseEventKey(key, event_time, event_identifier)) {
+      invalid_data_key_list.push_back(key);
+      continue;
     }
 
     last_event_id = std::max(last_event_id, event_identifier);
 
-    EventTime event_time = {};
-
-    {
-      std::string serialized_row;
-      status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (!status.ok()) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      Row row;
-      if (!deserializeRowJSON(serialized_row, row)) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      if (row.count("time") == 0) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      event_time = boost::lexical_cast<EventTime>(row.at("time"));
-    }
-
-    auto it = event_index.find(event_time);
-    if (it == event_index.end()) {
-      auto insert_status = event_index.insert({event_time, {}});
-      it = insert_status.first;
+    // Keys are sorted by time, most events belong to the last batch.
+    auto it = event_index.end();
+    if (!event_index.empty() && event_index.rbegin()->first == event_time) {
+      it = std::prev(it);
+    } else {
+      it = event_index.insert({event_time, {}}).first;
     }
 
-    auto& event_id_list = it->second;
-    event_id_list.push_back(event_identifier);
-
+    it->second.push_back(event_identifier);
     ++event_count;
   }
 
@@ -480,18 +589,19 @@ Status EventSubscriberPlugin::generateEventDataIndex(
     VLOG(1) << "Found " << invalid_data_key_list.size()
             << " invalid events for subscriber " << context.database_namespace;
 
-    for (const auto& invalid_data_key : invalid_data_key_list) {
-      status = db_interface.deleteDatabaseValue(kEvents, invalid_data_key);
-      if (!status.ok()) {
-        VLOG(1) << "Failed to delete the following invalid event: "
-                << invalid_data_key;
-      }
+    status = db_interface.deleteDatabaseBatch(context.database_domain,
+                                              invalid_data_key_list);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to delete the invalid events: " << status.getMessage();
     }
   }
 
   if (event_count != 0U) {
     VLOG(1) << "Found " << event_count << " events for subscriber "
             << context.database_namespace;
+
+    // Binary events refer to the stored column dictionary.
+    loadColumnDictionary(context, db_interface);
   }
 
   context.last_event_id = last_event_id;
@@ -500,12 +610,67 @@ Status EventSubscriberPlugin::generateEventDataIndex(
   return Status::success();
 }
 
-std::string EventSubscriberPlugin::databaseKeyForEventId(Context& context,
-                                                         EventID event_id) {
-  auto string_event_id = toIndex(event_id);
+std::string EventSubscriberPlugin::databaseKeyForEvent(EventTime event_time,
+                                                       EventID event_id) {
+  return toTimeIndex(event_time) + "." + toIndex(event_id);
+}
+
+std::string EventSubscriberPlugin::databaseKeyForColumns(Context& context) {
+  return kEventColumnsPrefix + context.database_namespace;
+}
+
+Status EventSubscriberPlugin::loadColumnDictionary(
+    Context& context, IDatabaseInterface& db_interface) {
+  std::string serialized_columns;
+  auto status = db_interface.getDatabaseValue(
+      kEvents, databaseKeyForColumns(context), serialized_columns);
+  if (!status.ok()) {
+    return status;
+  }
+
+  WriteLock lock(context.column_dictionary_mutex);
+  status = deserializeColumnDictionary(serialized_columns,
+                                       context.column_dictionary);
+  if (!status.ok()) {
+    return status;
+  }
+
+  context.stored_column_count = context.column_dictionary.size();
+  return Status::success();
+}
+
+Status EventSubscriberPlugin::deserializeEvent(
+    Context& context, const std::string& serialized_row, Row& row) {
+  if (!isBinaryRowData(serialized_row)) {
+    return deserializeRowJSON(serialized_row, row);
+  }
+
+  ReadLock lock(context.column_dictionary_mutex);
+  return deserializeRowBinary(serialized_row, context.column_dictionary, row);
+}
+
+Status EventSubscriberPlugin::removeEventBatches(
+    Context& context,
+    IDatabaseInterface& db_interface,
+    const EventIndex& event_batches) {
+  if (event_batches.empty()) {
+    return Status::success();
+  }
+
+  // Batches are contiguous in the subscriber's domain, whole batches are
+  // dropped with a single range delete. It ends at the last removed event:
+  // a batch added later at the same time has greater identifiers.
+  const auto& last_batch = *event_batches.rbegin();
+  auto range = eventBatchKeyRange(event_batches.begin()->first,
+                                  last_batch.first);
+  if (!last_batch.second.empty()) {
+    auto last_event_id = *std::max_element(last_batch.second.begin(),
+                                           last_batch.second.end());
+    range.second = databaseKeyForEvent(last_batch.first, last_event_id);
+  }
 
-  return std::string("data.") + context.database_namespace + "." +
-         string_event_id;
+  return db_interface.deleteDatabaseRange(
+      context.database_domain, range.first, range.second);
 }
 
 void EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -554,26 +719,14 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     string_last_query_time = buffer.data();
   }
 
-  std::size_t batches_removed{};
-  for (const auto& p : excess_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (auto event_id : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_id);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++batches_removed;
-      }
-    }
-  }
-
-  auto failed_delete_count = (excess_event_batch_list.size() - batches_removed);
+  auto status =
+      removeEventBatches(context, db_interface, excess_event_batch_list);
 
   std::stringstream message;
-  message << "Removed " << batches_removed << " event batches ";
+  message << "Removed " << excess_event_batch_list.size() << " event batches ";
 
-  if (failed_delete_count > 0U) {
-    message << "(with " << failed_delete_count << " delete errors)  ";
+  if (!status.ok()) {
+    message << "(with delete errors: " << status.getMessage() << ") ";
   }
 
   message << "for subscriber: " << context.database_namespace
@@ -615,24 +768,12 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
     context.event_index.erase(range_start, range_end);
   }
 
-  // TODO(alessandro): Implement deleteDatabaseBatch
-  std::size_t error_count{};
-
-  for (const auto& p : expired_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (const auto& event_identifier : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (!status.ok()) {
-        ++error_count;
-      }
-    }
-  }
-
-  if (error_count > 0U) {
-    LOG(ERROR) << "Failed to expire " << error_count
-               << " events due to database errors";
+  auto status =
+      removeEventBatches(context, db_interface, expired_event_batch_list);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to expire " << expired_event_batch_list.size()
+               << " event batches due to database errors: "
+               << status.getMessage();
   }
 }
 
@@ -644,10 +785,9 @@ EventSubscriberPlugin::GenerateRowsResult EventSubscriberPlugin::generateRows(
     EventTime end_time,
     EventID last_eid) {
   EventSubscriberPlugin::GenerateRowsResult ret{true, 0, 0};
-  std::vector<EventID> collected_event_id_list;
+  EventTime first_time{0U};
   {
     ReadLock lock(context.event_index_mutex);
-    auto last = context.event_index.end();
     if (end_time != 0 && start_time > end_time) {
       return ret;
     }
@@ -666,59 +806,72 @@ EventSubscriberPlugin::GenerateRowsResult EventSubscriberPlugin::generateRows(
     auto upper_bound_it = (end_time == 0U)
                               ? context.event_index.end()
                               : context.event_index.upper_bound(end_time);
-
-    for (auto it = lower_bound_it; it != upper_bound_it; ++it) {
-      const auto& event_id_list = it->second;
-
-      for (const auto& event_identifier : event_id_list) {
-        if (last_eid >= event_identifier) {
-          // A previous optimized query has already visited this event.
-          continue;
-        }
-        collected_event_id_list.push_back(event_identifier);
-      }
-      last = it;
+    if (lower_bound_it == upper_bound_it) {
+      return ret;
     }
 
-    if (last != context.event_index.end()) {
-      ret = EventSubscriberPlugin::GenerateRowsResult{
-          false, last->first, last->second.empty() ? 0 : last->second.back()};
-    }
+    first_time = lower_bound_it->first;
+    auto last = std::prev(upper_bound_it);
+    ret = EventSubscriberPlugin::GenerateRowsResult{
+        false, last->first, last->second.empty() ? 0 : last->second.back()};
   }
 
+  // The events of the selected batches are contiguous, they are read and
+  // emitted in chunks of a single range read each.
+  auto range = eventBatchKeyRange(first_time, ret.last_time);
   std::vector<std::string> invalid_key_list;
-  for (const auto& event_identifier : collected_event_id_list) {
-    auto key = databaseKeyForEventId(context, event_identifier);
+  DatabaseStringValueList values;
+
+  while (true) {
+    values.clear();
+    auto status = db_interface.getDatabaseRange(context.database_domain,
+                                                range.first,
+                                                range.second,
+                                                values,
+                                                kEventsReadBatchSize);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read the events of subscriber "
+                 << context.database_namespace << ": " << status.getMessage();
+      break;
+    }
 
-    std::string serialized_row;
-    auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-    if (serialized_row.empty()) {
-      invalid_key_list.push_back(key);
-      continue;
+    for (auto& p : values) {
+      EventTime event_time{0U};
+      EventID event_identifier{0U};
+      if (!parseEventKey(p.first, event_time, event_identifier)) {
+        invalid_key_list.push_back(p.first);
+        continue;
+      }
+
+      if (last_eid >= event_identifier) {
+        // A previous optimized query has already visited this event.
+        continue;
+      }
+
+      Row row = {};
+      if (p.second.empty() || !deserializeEvent(context, p.second, row).ok()) {
+        invalid_key_list.push_back(p.first);
+        continue;
+      }
+
+      callback(std::move(row));
     }
 
-    Row row = {};
-    status = deserializeRowJSON(serialized_row, row);
-    if (!status.ok()) {
-      invalid_key_list.push_back(key);
-      continue;
+    if (values.size() < kEventsReadBatchSize) {
+      break;
     }
 
-    callback(std::move(row));
+    // Continue from the key following the last one read.
+    range.first = values.back().first + '\0';
   }
 
   if (!invalid_key_list.empty()) {
-    std::size_t erased_key_count{0U};
-
-    for (const auto& key : invalid_key_list) {
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++erased_key_count;
-      }
-    }
+    auto status = db_interface.deleteDatabaseBatch(context.database_domain,
+                                                   invalid_key_list);
 
     LOG(ERROR) << "Found " << invalid_key_list.size() << " invalid events ("
-               << erased_key_count << " have been successfully erased)";
+               << (status.ok() ? "they have been erased" : "erase failed")
+               << ")";
   }
 
   return ret;
@@ -757,6 +910,13 @@ void EventSubscriberPlugin::setDatabaseNamespace() {
 
 Status EventSubscriberPlugin::setUp() {
   setDatabaseNamespace();
+
+  // Record the domain, so migrations can find the stored events.
+  getDatabase().setDatabaseValue(kEvents,
+                                 kEventsDomainListPrefix +
+                                     context.database_namespace,
+                                 context.database_domain);
+
   generateEventDataIndex();
 
   expireEventBatches(context, getDatabase(), getMinExpiry(), getTime());
@@ -9,12 +9,17 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <gtest/gtest_prod.h>
 
 #include <osquery/core/plugins/plugin.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/events/eventer.h>
+#include <osquery/events/eventstream.h>
 #include <osquery/events/types.h>
 #include <osquery/utils/mutex.h>
 
@@ -75,6 +80,11 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Scans the database to enumerate all the data keys and build a new index
   Status generateEventDataIndex();
 
+  /// Stream the rows matching the streaming queries instead of storing them.
+  Status streamBatch(const EventStreamQueryList& queries,
+                     std::vector<Row>& row_list,
+                     EventTime event_time);
+
   /**
    * @brief Get a unique storage-related EventID.
    *
@@ -182,27 +192,48 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Compare the number of queries run against the queries configured.
   virtual bool executedAllQueries() const;
 
+  /**
+   * @brief Set the streaming queries of this EventSubscriber.
+   *
+   * While any is set, added rows are only matched against them and streamed
+   * to the loggers; nothing is stored in the backing store.
+   */
+  void setStreamQueries(EventStreamQueryList queries);
+
+  /// Check if the added rows are streamed instead of stored.
+  bool isStreaming() const;
+
   struct Context final {
     std::string database_namespace;
+
+    /// The domain where the events of the subscriber are stored.
+    std::string database_domain;
+
     EventIndex event_index;
     Mutex event_index_mutex;
 
     std::size_t last_query_time{0U};
     std::atomic<EventID> last_event_id{0U};
+
+    /// Column dictionary of the binary encoded events.
+    ColumnDictionary column_dictionary;
+    std::size_t stored_column_count{0U};
+    Mutex column_dictionary_mutex;
   };
 
   static std::string toIndex(std::uint64_t i);
 
   static void setOptimizeData(IDatabaseInterface& db_interface,
+                              const std::string& query_name,
                               EventTime time,
                               EventID eid);
 
   static EventTime timeFromRecord(const std::string& record);
 
   static void getOptimizeData(IDatabaseInterface& db_interface,
+                              const std::string& query_name,
                               EventTime& o_time,
-                              EventID& o_eid,
-                              std::string& query_name);
+                              EventID& o_eid);
 
   static EventID generateEventIdentifier(Context& context);
 
@@ -210,10 +241,42 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
                                    const std::string& type,
                                    const std::string& name);
 
+  /**
+   * @brief Rebuild the event index from the keys of the subscriber's domain.
+   *
+   * The keys hold the time and identifier of each event, so the stored
+   * events are not read. Keys that are not event keys are removed.
+   */
   static Status generateEventDataIndex(Context& context,
                                        IDatabaseInterface& db_interface);
 
-  static std::string databaseKeyForEventId(Context& context, EventID event_id);
+  /**
+   * @brief The key of an event in the subscriber's domain.
+   *
+   * Keys start with the event time, the events of a batch are contiguous and
+   * batches are sorted by time.
+   */
+  static std::string databaseKeyForEvent(EventTime event_time,
+                                         EventID event_id);
+
+  static std::string databaseKeyForColumns(Context& context);
+
+  static Status loadColumnDictionary(Context& context,
+                                     IDatabaseInterface& db_interface);
+
+  static Status deserializeEvent(Context& context,
+                                 const std::string& serialized_row,
+                                 Row& row);
+
+  /**
+   * @brief Remove the events of a list of event batches.
+   *
+   * The events stored between the first and the last batch are removed with
+   * a single range delete, callers remove the oldest batches.
+   */
+  static Status removeEventBatches(Context& context,
+                                   IDatabaseInterface& db_interface,
+                                   const EventIndex& event_batches);
 
   static void removeOverflowingEventBatches(Context& context,
                                             IDatabaseInterface& db_interface,
@@ -315,6 +378,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
   Context context;
 
+  /// The streaming queries, nullptr when the rows are stored.
+  std::shared_ptr<const EventStreamQueryList> stream_queries_;
+
   /**
    * @brief Allow subscriber implementations to default disable themselves.
    *
@@ -337,6 +403,8 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   FRIEND_TEST(EventSubscriberPluginTests, getEventsExpiry);
   FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithExpiry);
   FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithOptimize);
+  FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithConcurrentQueries);
+  FRIEND_TEST(EventSubscriberPluginTests, addBatchStreaming);
 
   friend class DBFakeEventSubscriber;
   friend class BenchmarkEventSubscriber;
@@ -15,8 +15,7 @@
 
 #include <chrono>
 #include <iostream>
-
-#include <boost/utility/string_ref.hpp>
+#include <stdexcept>
 
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/apparmor_events.h>
@@ -71,11 +70,10 @@ DECLARE_bool(audit_allow_seccomp_events);
 namespace {
 
 const std::string kAppArmorRecordMarker{"apparmor="};
-constexpr std::uint64_t kUnprocessedRecordsThreshold{4096};
-// How often in seconds a message should be displayed if throttling happened
-constexpr std::uint64_t kThrottlingMessageInterval{60};
-// How much to wait for each throttling loop in millseconds
-constexpr std::uint64_t kThrottlingDuration{100};
+// How often in seconds a message should be displayed if records were dropped
+constexpr std::uint64_t kOverflowMessageInterval{60};
+// How long to wait on a ring before checking for interruptions
+constexpr std::chrono::milliseconds kRingWaitTimeout{1000};
 
 bool IsSELinuxRecord(const audit_reply& reply) noexcept {
   static const auto& selinux_event_set = kSELinuxEventList;
@@ -152,32 +150,42 @@ AuditdNetlink::AuditdNetlink() {
 
 std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
   std::vector<AuditEventRecord> record_list;
+  auto& records = auditd_context_->processed_events;
 
-  {
-    std::unique_lock<std::mutex> queue_lock(
-        auditd_context_->processed_events_mutex);
-
-    /* NOTE: we want to wait up to one second for events,
-       but only if there aren't events to be processed already. */
-    auto should_process_events = auditd_context_->processed_records_cv.wait_for(
-        queue_lock, std::chrono::seconds(1), [this]() {
-          return !auditd_context_->processed_events.empty();
-        });
+  /* NOTE: we want to wait up to one second for events,
+     but only if there aren't events to be processed already. */
+  if (!records.waitForData(std::chrono::seconds(1))) {
+    return record_list;
+  }
 
-    if (should_process_events) {
-      record_list = std::move(auditd_context_->processed_events);
-      auditd_context_->processed_events.clear();
-      auditd_context_->processed_records_backlog = 0;
+  // Drain at most one ring's worth, the parser keeps adding records.
+  record_list.reserve(records.size());
+  for (std::size_t i = 0; i < records.capacity(); ++i) {
+    auto record = records.front();
+    if (record == nullptr) {
+      break;
     }
+
+    record_list.push_back(std::move(*record));
+    records.pop();
   }
 
   return record_list;
 }
 
+AuditdNetlinkStats AuditdNetlink::getStats() const noexcept {
+  AuditdNetlinkStats stats;
+  stats.unprocessed_records = auditd_context_->unprocessed_records.size();
+  stats.processed_events = auditd_context_->processed_events.size();
+  stats.reader_stalls = auditd_context_->unprocessed_records.stalls();
+  stats.parser_stalls = auditd_context_->processed_events.stalls();
+  stats.netlink_overflows = auditd_context_->netlink_overflows;
+  return stats;
+}
+
 AuditdNetlinkReader::AuditdNetlinkReader(AuditdContextRef context)
     : InternalRunnable("AuditdNetlinkReader"),
-      auditd_context_(std::move(context)),
-      read_buffer_(1024U) {}
+      auditd_context_(std::move(context)) {}
 
 void AuditdNetlinkReader::start() {
   int counter_to_next_status_request = 0;
@@ -235,7 +243,8 @@ void AuditdNetlinkReader::stop() {
 
   VLOG(1) << "Releasing the audit handle...";
 
-  auditd_context_->unprocessed_records_cv.notify_all();
+  auditd_context_->unprocessed_records.wakeAll();
+  auditd_context_->processed_events.wakeAll();
 
   if (FLAGS_audit_allow_config) {
     restoreAuditServiceConfiguration();
@@ -251,14 +260,22 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   struct sockaddr_nl nladdr = {};
   socklen_t nladdrlen = sizeof(nladdr);
 
+  auto& ring = auditd_context_->unprocessed_records;
   bool reset_handle = false;
   size_t events_received = 0;
 
   // Attempt to read as many messages as possible before we exit, and terminate
-  // early if we have been asked to terminate
-  for (events_received = 0;
-       !interrupted() && events_received < read_buffer_.size();
-       events_received++) {
+  // early if we have been asked to terminate. Messages are received directly
+  // into the free slots of the parser's ring
+  while (!interrupted() && events_received < ring.capacity()) {
+    auto reply = ring.claim();
+    if (reply == nullptr) {
+      /* The parser cannot keep up; wait for it to release a slot. Records
+         queue up in the netlink socket meanwhile */
+      ring.waitForSpace(kRingWaitTimeout);
+      continue;
+    }
+
     errno = 0;
     int poll_status = ::poll(fds, 1, 2000);
     if (poll_status == 0) {
@@ -278,15 +295,21 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    audit_reply reply = {};
     ssize_t len = recvfrom(audit_netlink_handle_,
-                           &reply.msg,
-                           sizeof(reply.msg),
+                           &reply->msg,
+                           sizeof(reply->msg),
                            0,
                            reinterpret_cast<struct sockaddr*>(&nladdr),
                            &nladdrlen);
 
     if (len < 0) {
+      if (errno == ENOBUFS) {
+        // The socket buffer overflowed and the kernel dropped records
+        ++auditd_context_->netlink_overflows;
+        ++auditd_context_->unreported_netlink_overflows;
+        continue;
+      }
+
       VLOG(1) << "Failed to receive data from the audit netlink";
       reset_handle = true;
       break;
@@ -304,8 +327,8 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    if (!NLMSG_OK(&reply.msg.nlh, static_cast<unsigned int>(len))) {
-      if (len == sizeof(reply.msg)) {
+    if (!NLMSG_OK(&reply->msg.nlh, static_cast<unsigned int>(len))) {
+      if (len == sizeof(reply->msg)) {
         VLOG(1) << "Netlink event too big (EFBIG)";
       } else {
         VLOG(1) << "Broken netlink event (EBADE)";
@@ -315,50 +338,16 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    read_buffer_[events_received] = reply;
-  }
-
-  if (events_received != 0) {
-    std::unique_lock<std::mutex> lock(
-        auditd_context_->unprocessed_records_mutex);
-
-    auditd_context_->unprocessed_records.reserve(
-        auditd_context_->unprocessed_records.size() + events_received);
-
-    auditd_context_->unprocessed_records.insert(
-        auditd_context_->unprocessed_records.end(),
-        read_buffer_.begin(),
-        std::next(read_buffer_.begin(), events_received));
-
-    auditd_context_->unprocessed_records_amount += events_received;
-
-    auditd_context_->unprocessed_records_cv.notify_all();
-  }
+    // Slots are reused rather than cleared; terminate the message text
+    if (static_cast<size_t>(len) < sizeof(reply->msg)) {
+      reinterpret_cast<char*>(&reply->msg)[len] = '\0';
+    }
 
-  /* Throttle reading if the processing thread cannot keep up,
-   we don't want to use too much memory */
-  while (auditd_context_->unprocessed_records_amount >
-             kUnprocessedRecordsThreshold &&
-         !interrupted()) {
-    ++auditd_context_->netlink_throttling_count;
-    std::this_thread::sleep_for(std::chrono::milliseconds(kThrottlingDuration));
+    ring.publish();
+    ++events_received;
   }
 
-  /* We want to warn about throttling happening at most every
-     kThrottlingMessageInterval seconds */
-  if (auditd_context_->netlink_throttling_count > 0) {
-    auto now = getUnixTime();
-    if (auditd_context_->last_netlink_throttling_message_time +
-            kThrottlingMessageInterval <=
-        now) {
-      LOG(WARNING) << "The Audit publisher has throttled reading records from "
-                      "Netlink for "
-                   << (auditd_context_->netlink_throttling_count / 10.0f)
-                   << " seconds. Some events may have been lost.";
-      auditd_context_->netlink_throttling_count = 0;
-      auditd_context_->last_netlink_throttling_message_time = now;
-    }
-  }
+  reportOverflows();
 
   if (reset_handle) {
     VLOG(1) << "Requesting audit handle reset";
@@ -366,7 +355,29 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   }
 
   return true;
-} // namespace osquery
+}
+
+void AuditdNetlinkReader::reportOverflows() noexcept {
+  /* We want to warn about dropped records at most every
+     kOverflowMessageInterval seconds */
+  if (auditd_context_->unreported_netlink_overflows == 0) {
+    return;
+  }
+
+  auto now = getUnixTime();
+  if (auditd_context_->last_netlink_overflow_message_time +
+          kOverflowMessageInterval >
+      now) {
+    return;
+  }
+
+  LOG(WARNING) << "The Audit publisher could not keep up with Netlink and "
+                  "the kernel dropped records "
+               << auditd_context_->unreported_netlink_overflows
+               << " times. Some events have been lost.";
+  auditd_context_->unreported_netlink_overflows = 0;
+  auditd_context_->last_netlink_overflow_message_time = now;
+}
 
 bool AuditdNetlinkReader::configureAuditService() noexcept {
   VLOG(1) << "Attempting to configure the audit service";
@@ -727,148 +738,298 @@ AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context)
       auditd_context_(std::move(context)) {}
 
 void AuditdNetlinkParser::start() {
+  auto& replies = auditd_context_->unprocessed_records;
+
   while (!interrupted()) {
-    std::vector<audit_reply> queue;
+    auto reply = replies.front();
+    if (reply == nullptr) {
+      replies.waitForData(kRingWaitTimeout);
+      continue;
+    }
 
-    {
-      std::unique_lock<std::mutex> lock(
-          auditd_context_->unprocessed_records_mutex);
+    processReply(*reply);
+    replies.pop();
+  }
+}
 
-      while (auditd_context_->unprocessed_records.empty()) {
-        if (interrupted()) {
-          return;
-        }
+void AuditdNetlinkParser::processReply(audit_reply& reply) noexcept {
+  AdjustAuditReply(reply);
+
+  // This record carries the process id of the controlling daemon; in case
+  // we lost control of the audit service, we are going to request a reset
+  // as soon as we finish processing the pending queue
+  if (reply.type == AUDIT_GET) {
+    reply.status = static_cast<struct audit_status*>(NLMSG_DATA(reply.nlh));
+    auto new_pid = static_cast<pid_t>(reply.status->pid);
+
+    if (new_pid != getpid()) {
+      VLOG(1) << "Audit control lost to pid: " << new_pid;
 
-        auditd_context_->unprocessed_records_cv.wait_for(
-            lock, std::chrono::seconds(1));
+      if (FLAGS_audit_persist) {
+        VLOG(1) << "Attempting to reacquire control of the audit service";
+        auditd_context_->acquire_handle = true;
       }
+    }
+
+    return;
+  }
 
-      queue = std::move(auditd_context_->unprocessed_records);
-      auditd_context_->unprocessed_records.clear();
+  // We are not interested in all messages; only get the ones related to
+  // user events, seccomp, syscalls, SELinux events and AppArmor events
+  if (!ShouldHandle(reply)) {
+    return;
+  }
+
+  /* Wait for the publisher to release a slot if it cannot keep up. This
+     holds the reader back in turn */
+  auto& records = auditd_context_->processed_events;
+  AuditEventRecord* audit_event_record = records.claim();
+  while (audit_event_record == nullptr) {
+    if (interrupted()) {
+      return;
     }
 
-    std::vector<AuditEventRecord> audit_event_record_queue;
-    audit_event_record_queue.reserve(queue.size());
+    records.waitForSpace(kRingWaitTimeout);
+    audit_event_record = records.claim();
+  }
 
-    for (auto& reply : queue) {
-      if (interrupted()) {
-        break;
-      }
+  // A slot is only published once the record is parsed
+  if (!ParseAuditReply(reply, *audit_event_record)) {
+    VLOG(1) << "Malformed audit record received";
+    return;
+  }
+
+  records.publish();
+}
 
-      AdjustAuditReply(reply);
+AuditFieldKey GetAuditFieldKey(std::string_view name) noexcept {
+  static const std::unordered_map<std::string_view, AuditFieldKey> kKeys = {
+      {"a0", AuditFieldKey::A0},
+      {"a1", AuditFieldKey::A1},
+      {"a2", AuditFieldKey::A2},
+      {"a3", AuditFieldKey::A3},
+      {"addr", AuditFieldKey::Addr},
+      {"apparmor", AuditFieldKey::AppArmor},
+      {"arch", AuditFieldKey::Arch},
+      {"argc", AuditFieldKey::Argc},
+      {"auid", AuditFieldKey::Auid},
+      {"capability", AuditFieldKey::Capability},
+      {"capname", AuditFieldKey::Capname},
+      {"code", AuditFieldKey::Code},
+      {"comm", AuditFieldKey::Comm},
+      {"compat", AuditFieldKey::Compat},
+      {"cwd", AuditFieldKey::Cwd},
+      {"denied_mask", AuditFieldKey::DeniedMask},
+      {"dev", AuditFieldKey::Dev},
+      {"egid", AuditFieldKey::Egid},
+      {"error", AuditFieldKey::Error},
+      {"euid", AuditFieldKey::Euid},
+      {"exe", AuditFieldKey::Exe},
+      {"exit", AuditFieldKey::Exit},
+      {"fd", AuditFieldKey::Fd},
+      {"flags", AuditFieldKey::Flags},
+      {"fsgid", AuditFieldKey::Fsgid},
+      {"fsuid", AuditFieldKey::Fsuid},
+      {"gid", AuditFieldKey::Gid},
+      {"info", AuditFieldKey::Info},
+      {"inode", AuditFieldKey::Inode},
+      {"ip", AuditFieldKey::Ip},
+      {"item", AuditFieldKey::Item},
+      {"items", AuditFieldKey::Items},
+      {"key", AuditFieldKey::Key},
+      {"label", AuditFieldKey::Label},
+      {"mode", AuditFieldKey::Mode},
+      {"msg", AuditFieldKey::Msg},
+      {"name", AuditFieldKey::Name},
+      {"namespace", AuditFieldKey::Namespace},
+      {"nametype", AuditFieldKey::Nametype},
+      {"oauid", AuditFieldKey::Oauid},
+      {"obj", AuditFieldKey::Obj},
+      {"objtype", AuditFieldKey::Objtype},
+      {"ocomm", AuditFieldKey::Ocomm},
+      {"ogid", AuditFieldKey::Ogid},
+      {"operation", AuditFieldKey::Operation},
+      {"oses", AuditFieldKey::Oses},
+      {"ouid", AuditFieldKey::Ouid},
+      {"parent", AuditFieldKey::Parent},
+      {"pid", AuditFieldKey::Pid},
+      {"ppid", AuditFieldKey::Ppid},
+      {"profile", AuditFieldKey::Profile},
+      {"rdev", AuditFieldKey::Rdev},
+      {"requested_mask", AuditFieldKey::RequestedMask},
+      {"saddr", AuditFieldKey::Saddr},
+      {"ses", AuditFieldKey::Ses},
+      {"sgid", AuditFieldKey::Sgid},
+      {"sig", AuditFieldKey::Sig},
+      {"subj", AuditFieldKey::Subj},
+      {"success", AuditFieldKey::Success},
+      {"suid", AuditFieldKey::Suid},
+      {"syscall", AuditFieldKey::Syscall},
+      {"terminal", AuditFieldKey::Terminal},
+      {"tty", AuditFieldKey::Tty},
+      {"uid", AuditFieldKey::Uid},
+  };
 
-      // This record carries the process id of the controlling daemon; in case
-      // we lost control of the audit service, we are going to request a reset
-      // as soon as we finish processing the pending queue
-      if (reply.type == AUDIT_GET) {
-        reply.status = static_cast<struct audit_status*>(NLMSG_DATA(reply.nlh));
-        auto new_pid = static_cast<pid_t>(reply.status->pid);
+  auto it = kKeys.find(name);
+  return it != kKeys.end() ? it->second : AuditFieldKey::Unknown;
+}
 
-        if (new_pid != getpid()) {
-          VLOG(1) << "Audit control lost to pid: " << new_pid;
+void AuditFieldList::parse(std::string_view text) {
+  clear();
+  text_.assign(text.data(), text.size());
+
+  auto add = [this](std::size_t name_offset,
+                    std::size_t name_size,
+                    std::size_t value_offset,
+                    std::size_t value_size) {
+    Field field;
+    field.key = GetAuditFieldKey(text_view().substr(name_offset, name_size));
+    field.name_offset = static_cast<std::uint32_t>(name_offset);
+    field.name_size = static_cast<std::uint32_t>(name_size);
+    field.value_offset = static_cast<std::uint32_t>(value_offset);
+    field.value_size = static_cast<std::uint32_t>(value_size);
+    fields_.push_back(field);
+  };
 
-          if (FLAGS_audit_persist) {
-            VLOG(1) << "Attempting to reacquire control of the audit service";
-            auditd_context_->acquire_handle = true;
-          }
-        }
+  // There are several ways of representing value data (enclosed strings,
+  // etc). Names and values are always contiguous, so they are only delimited
+  std::size_t name_offset{0};
+  std::size_t name_size{0};
+  std::size_t value_offset{0};
 
-        continue;
-      }
+  bool found_assignment{false};
+  bool found_enclose{false};
 
-      // We are not interested in all messages; only get the ones related to
-      // user events, seccomp, syscalls, SELinux events and AppArmor events
-      if (!ShouldHandle(reply)) {
-        continue;
+  for (std::size_t i = 0; i < text_.size(); ++i) {
+    auto c = text_[i];
+
+    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
+      // This is a terminating sequence, the end of an enclosure or space
+      // tok. The closing quote is part of the value
+      if (name_size > 0) {
+        auto value_end = c == '"' ? i + 1 : i;
+        add(name_offset,
+            name_size,
+            value_offset,
+            found_assignment ? value_end - value_offset : 0);
       }
 
-      AuditEventRecord audit_event_record = {};
-      if (!ParseAuditReply(reply, audit_event_record)) {
-        VLOG(1) << "Malformed audit record received";
-        continue;
+      found_enclose = false;
+      found_assignment = false;
+      name_size = 0;
+
+    } else if (found_assignment) {
+      // Enclosure sequences appear immediately following assignment.
+      if (c == '"') {
+        found_enclose = true;
       }
 
-      audit_event_record_queue.push_back(audit_event_record);
-    }
-
-    // Save the new records and notify the reader
-    if (!audit_event_record_queue.empty()) {
-      std::lock_guard<std::mutex> queue_lock(
-          auditd_context_->processed_events_mutex);
-
-      auditd_context_->processed_events.reserve(
-          auditd_context_->processed_events.size() +
-          audit_event_record_queue.size());
-
-      auditd_context_->processed_events.insert(
-          auditd_context_->processed_events.end(),
-          audit_event_record_queue.begin(),
-          audit_event_record_queue.end());
-
-      auditd_context_->processed_records_backlog =
-          auditd_context_->processed_events.size();
-
-      auditd_context_->processed_records_cv.notify_all();
-    }
-
-    auditd_context_->unprocessed_records_amount -= queue.size();
-    queue.clear();
-    audit_event_record_queue.clear();
-
-    /* Throttling the record processing if the consumer (the publisher)
-       cannot keep up */
-    while (auditd_context_->processed_records_backlog >
-               kUnprocessedRecordsThreshold &&
-           !interrupted()) {
-      ++auditd_context_->processing_throttling_count;
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(kThrottlingDuration));
-    }
-
-    /* We want to warn about throttling happening at most every
-       kThrottlingMessageInterval seconds */
-    if (auditd_context_->processing_throttling_count > 0) {
-      auto now = getUnixTime();
-      if (auditd_context_->last_processing_throttling_message_time +
-              kThrottlingMessageInterval <=
-          now) {
-        /* NOTE: this is meant as a debugging message since throttling here
-           doesn't mean that events will be lost. It might cause throttling on
-           the reading side, but if that happens a warning
-           will be given there */
-        VLOG(1) << "The Audit publisher has throttled record processing for "
-                << (auditd_context_->processing_throttling_count / 10.0f)
-                << " seconds. This may cause further throttling and loss of "
-                   "events.";
-        auditd_context_->processing_throttling_count = 0;
-        auditd_context_->last_processing_throttling_message_time = now;
+    } else if (c == '=') {
+      found_assignment = true;
+      value_offset = i + 1;
+
+    } else {
+      if (name_size == 0) {
+        name_offset = i;
       }
+
+      ++name_size;
     }
   }
+
+  // Last step, if there was no trailing tokenizer.
+  if (name_size > 0) {
+    add(name_offset,
+        name_size,
+        value_offset,
+        found_assignment ? text_.size() - value_offset : 0);
+  }
+}
+
+void AuditFieldList::clear() noexcept {
+  text_.clear();
+  fields_.clear();
+}
+
+std::string_view AuditFieldList::name(std::size_t index) const noexcept {
+  const auto& field = fields_[index];
+  return text_view().substr(field.name_offset, field.name_size);
+}
+
+std::string_view AuditFieldList::value(std::size_t index) const noexcept {
+  const auto& field = fields_[index];
+  return text_view().substr(field.value_offset, field.value_size);
+}
+
+std::optional<std::string_view> AuditFieldList::find(
+    AuditFieldKey key) const noexcept {
+  if (key == AuditFieldKey::Unknown) {
+    return std::nullopt;
+  }
+
+  for (std::size_t i = 0; i < fields_.size(); ++i) {
+    if (fields_[i].key == key) {
+      return value(i);
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::optional<std::string_view> AuditFieldList::find(
+    std::string_view name) const noexcept {
+  auto key = GetAuditFieldKey(name);
+  if (key != AuditFieldKey::Unknown) {
+    return find(key);
+  }
+
+  // Names without an interned key are compared as text
+  for (std::size_t i = 0; i < fields_.size(); ++i) {
+    if (fields_[i].key == AuditFieldKey::Unknown && this->name(i) == name) {
+      return value(i);
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::string_view AuditFieldList::at(std::string_view name) const {
+  auto value = find(name);
+  if (!value.has_value()) {
+    throw std::out_of_range("Missing audit record field: " +
+                            std::string(name));
+  }
+
+  return *value;
 }
 
 bool AuditdNetlinkParser::ParseAuditReply(
     const audit_reply& reply, AuditEventRecord& event_record) noexcept {
-  event_record = {};
+  // The record is reset without releasing its storage, since parsed records
+  // are usually written to reused slots
+  event_record.type = reply.type;
+  event_record.time = 0;
+  event_record.audit_id.clear();
+  event_record.fields.clear();
+  event_record.raw_data.clear();
 
   if (FLAGS_audit_debug) {
     VLOG(1) << reply.type << ", " << std::string(reply.message, reply.len);
   }
 
   // Parse the record header
-  event_record.type = reply.type;
-  boost::string_ref message_view(reply.message,
-                                 static_cast<unsigned int>(reply.len));
+  std::string_view message_view(reply.message,
+                                static_cast<std::size_t>(reply.len));
 
   auto preamble_end = message_view.find("): ");
-  if (preamble_end == std::string::npos) {
+  if (preamble_end == std::string_view::npos) {
     return false;
   }
 
   event_record.time =
-      tryTo<unsigned long int>(message_view.substr(6, 10).to_string(), 10)
+      tryTo<unsigned long int>(std::string(message_view.substr(6, 10)), 10)
           .takeOr(event_record.time);
-  event_record.audit_id = message_view.substr(6, preamble_end - 6).to_string();
+  event_record.audit_id = message_view.substr(6, preamble_end - 6);
 
   // SELinux doesn't output valid audit records; just save them as they are
   if (IsSELinuxRecord(reply)) {
@@ -882,64 +1043,7 @@ bool AuditdNetlinkParser::ParseAuditReply(
   }
 
   // Tokenize the message
-  boost::string_ref field_view(message_view.substr(preamble_end + 3));
-
-  // The linear search will construct series of key value pairs.
-  std::string key, value;
-  key.reserve(20);
-  value.reserve(256);
-
-  // There are several ways of representing value data (enclosed strings,
-  // etc).
-  bool found_assignment{false};
-  bool found_enclose{false};
-
-  for (const auto& c : field_view) {
-    // Iterate over each character in the audit message.
-    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
-      if (c == '"') {
-        value += c;
-      }
-
-      // This is a terminating sequence, the end of an enclosure or space
-      // tok.
-      if (!key.empty()) {
-        // Multiple space tokens are supported.
-        event_record.fields.emplace(
-            std::make_pair(std::move(key), std::move(value)));
-      }
-
-      found_enclose = false;
-      found_assignment = false;
-
-      key.clear();
-      value.clear();
-
-    } else if (!found_assignment && c == ' ') {
-      // A field tokenizer.
-
-    } else if (found_assignment) {
-      // Enclosure sequences appear immediately following assignment.
-      if (c == '"') {
-        found_enclose = true;
-      }
-
-      value += c;
-
-    } else if (c == '=') {
-      found_assignment = true;
-
-    } else {
-      key += c;
-    }
-  }
-
-  // Last step, if there was no trailing tokenizer.
-  if (!key.empty()) {
-    event_record.fields.emplace(
-        std::make_pair(std::move(key), std::move(value)));
-  }
-
+  event_record.fields.parse(message_view.substr(preamble_end + 3));
   return true;
 }
 
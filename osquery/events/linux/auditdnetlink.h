@@ -12,17 +12,21 @@
 #include <libaudit.h>
 
 #include <atomic>
-#include <condition_variable>
+#include <cstdint>
 #include <future>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include <boost/algorithm/hex.hpp>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/events/linux/spsc_ring.h>
 
 namespace osquery {
 
@@ -32,6 +36,136 @@ enum class NetlinkStatus { ActiveMutable, ActiveImmutable, Disabled, Error };
 /// Contains an audit_rule_data structure
 using AuditRuleDataObject = std::vector<std::uint8_t>;
 
+/// The keys of the audit record fields osquery reads, interned when parsing.
+enum class AuditFieldKey : std::uint8_t {
+  Unknown,
+  A0,
+  A1,
+  A2,
+  A3,
+  Addr,
+  AppArmor,
+  Arch,
+  Argc,
+  Auid,
+  Capability,
+  Capname,
+  Code,
+  Comm,
+  Compat,
+  Cwd,
+  DeniedMask,
+  Dev,
+  Egid,
+  Error,
+  Euid,
+  Exe,
+  Exit,
+  Fd,
+  Flags,
+  Fsgid,
+  Fsuid,
+  Gid,
+  Info,
+  Inode,
+  Ip,
+  Item,
+  Items,
+  Key,
+  Label,
+  Mode,
+  Msg,
+  Name,
+  Namespace,
+  Nametype,
+  Oauid,
+  Obj,
+  Objtype,
+  Ocomm,
+  Ogid,
+  Operation,
+  Oses,
+  Ouid,
+  Parent,
+  Pid,
+  Ppid,
+  Profile,
+  Rdev,
+  RequestedMask,
+  Saddr,
+  Ses,
+  Sgid,
+  Sig,
+  Subj,
+  Success,
+  Suid,
+  Syscall,
+  Terminal,
+  Tty,
+  Uid,
+};
+
+/// Returns the interned key of a field name, AuditFieldKey::Unknown if none
+AuditFieldKey GetAuditFieldKey(std::string_view name) noexcept;
+
+/// The key=value fields of an audit record, in the order they were received.
+class AuditFieldList final {
+ public:
+  /// Copies the field list of a record and tokenizes it in place
+  void parse(std::string_view text);
+
+  /// Removes every field, keeping the storage for the next record
+  void clear() noexcept;
+
+  std::size_t size() const noexcept {
+    return fields_.size();
+  }
+
+  bool empty() const noexcept {
+    return fields_.empty();
+  }
+
+  /// The interned key of a field
+  AuditFieldKey key(std::size_t index) const noexcept {
+    return fields_[index].key;
+  }
+
+  /// The name of a field, as it appears in the record
+  std::string_view name(std::size_t index) const noexcept;
+
+  /// The raw value of a field, enclosing quotes included
+  std::string_view value(std::size_t index) const noexcept;
+
+  /// Returns the value of the first field with the given key
+  std::optional<std::string_view> find(AuditFieldKey key) const noexcept;
+
+  /// Returns the value of the first field with the given name
+  std::optional<std::string_view> find(std::string_view name) const noexcept;
+
+  /// Like find, but throws std::out_of_range when the field is missing
+  std::string_view at(std::string_view name) const;
+
+ private:
+  /// A field, as offsets into the record text so that copies stay valid
+  struct Field final {
+    AuditFieldKey key{AuditFieldKey::Unknown};
+    std::uint32_t name_offset{0};
+    std::uint32_t name_size{0};
+    std::uint32_t value_offset{0};
+    std::uint32_t value_size{0};
+  };
+
+  std::string_view text_view() const noexcept {
+    return text_;
+  }
+
+ private:
+  /// The record text the fields point into
+  std::string text_;
+
+  std::vector<Field> fields_;
+};
+
 /// A single, prepared audit event record.
 struct AuditEventRecord final {
   /// Record type (i.e.: AUDIT_SYSCALL, AUDIT_PATH, ...)
@@ -45,7 +179,7 @@ struct AuditEventRecord final {
 
   /// The field list for this record. Valid for everything except SELinux and
   /// AppArmor records
-  std::map<std::string, std::string> fields;
+  AuditFieldList fields;
 
   /// The raw message, only valid for SELinux and AppArmor records (because they
   /// have broken syntax)
@@ -55,53 +189,50 @@ struct AuditEventRecord final {
 static_assert(std::is_move_constructible<AuditEventRecord>::value,
               "not move constructible");
 
+/// The number of raw records queued between the netlink reader and parser.
+constexpr std::size_t kAuditReplyRingCapacity{1024};
+
+/// The number of parsed records queued for the publisher.
+constexpr std::size_t kAuditRecordRingCapacity{4096};
+
 // This structure is used to share data between the reading and processing
 // services
 struct AuditdContext final {
-  /// Unprocessed audit records
-  std::vector<audit_reply> unprocessed_records;
-  static_assert(
-      std::is_move_constructible<decltype(unprocessed_records)>::value,
-      "not move constructible");
-
-  /// Mutex for the list of unprocessed records
-  std::mutex unprocessed_records_mutex;
-
-  /// Processed events condition variable
-  std::condition_variable unprocessed_records_cv;
-
-  /// This queue contains processed events
-  std::vector<AuditEventRecord> processed_events;
+  /// Raw records, received in place by the reader and parsed in place
+  SPSCRing<audit_reply> unprocessed_records{kAuditReplyRingCapacity};
 
-  /// Processed events queue mutex.
-  std::mutex processed_events_mutex;
-
-  /// Used to wake up the thread that processes the raw audit records
-  std::condition_variable processed_records_cv;
+  /// Parsed records, waiting for the publisher
+  SPSCRing<AuditEventRecord> processed_events{kAuditRecordRingCapacity};
 
   /// When set to true, the audit handle is (re)acquired
   std::atomic_bool acquire_handle{true};
 
-  /// Amount of records that are yet to be fully processed. Used for throttling
-  /// the netlink reader if the thread processing records cannot keep up
-  std::atomic<std::size_t> unprocessed_records_amount{};
+  /// Times the netlink socket overflowed and the kernel dropped records
+  std::atomic<std::uint64_t> netlink_overflows{};
+
+  /// Overflows not reported in a warning yet
+  std::uint64_t unreported_netlink_overflows{};
 
-  /// Amount of records that have been parsed but that still need to be consumed
-  /// by the publisher. Used for throttling the thread processing records if the
-  /// publisher cannot empty the backlog fast enough
-  std::atomic<std::size_t> processed_records_backlog{};
+  /// Timestamp of the last Netlink overflow message
+  std::uint64_t last_netlink_overflow_message_time{};
+};
 
-  /// Timestamp of the last Netlink records reading throttling message
-  std::uint64_t last_netlink_throttling_message_time{};
+/// Counters of the records queued between the audit services.
+struct AuditdNetlinkStats final {
+  /// Raw records waiting for the parser
+  std::size_t unprocessed_records{};
 
-  /// Timestamp of the last records processing throttling message
-  std::uint64_t last_processing_throttling_message_time{};
+  /// Parsed records waiting for the publisher
+  std::size_t processed_events{};
 
-  /// Count of loops done during Netlink records reading throttling
-  std::uint32_t netlink_throttling_count{};
+  /// Times the reader waited for the parser to release a slot
+  std::uint64_t reader_stalls{};
 
-  /// Count of loops done during records processing throttling
-  std::uint32_t processing_throttling_count{};
+  /// Times the parser waited for the publisher to release a slot
+  std::uint64_t parser_stalls{};
+
+  /// Times the kernel dropped records because the reader fell behind
+  std::uint64_t netlink_overflows{};
 };
 
 using AuditdContextRef = std::shared_ptr<AuditdContext>;
@@ -119,6 +250,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Reads as many audit event records as possible before returning.
   bool acquireMessages() noexcept;
 
+  /// Warn about the records the kernel dropped, at most once per interval.
+  void reportOverflows() noexcept;
+
   /// Configures the audit service and applies required rules
   bool configureAuditService() noexcept;
 
@@ -138,9 +272,6 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Shared data
   AuditdContextRef auditd_context_;
 
-  /// Read buffer used when receiving events from the netlink
-  std::vector<audit_reply> read_buffer_;
-
   /// The set of rules we applied (and that we'll uninstall when exiting)
   std::vector<audit_rule_data> installed_rule_list_;
 
@@ -164,6 +295,10 @@ class AuditdNetlinkParser final : public InternalRunnable {
   /// Adjusts the internal pointers of the audit_reply object
   static void AdjustAuditReply(audit_reply& reply) noexcept;
 
+ private:
+  /// Parses a raw record into the next slot of the publisher's ring.
+  void processReply(audit_reply& reply) noexcept;
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
@@ -178,6 +313,9 @@ class AuditdNetlink final : private boost::noncopyable {
   /// Prepares the raw audit event records stored in the given context.
   std::vector<AuditEventRecord> getEvents() noexcept;
 
+  /// Get the queue depths and the drop counters.
+  AuditdNetlinkStats getStats() const noexcept;
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
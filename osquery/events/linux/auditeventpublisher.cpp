@@ -35,8 +35,6 @@ REGISTER(AuditEventPublisher, "event_publisher", "auditeventpublisher");
 
 namespace {
 
-const std::string kAppArmorEventMarker{"apparmor"};
-
 bool IsPublisherEnabled() noexcept {
   if (FLAGS_disable_audit) {
     return false;
@@ -147,8 +145,7 @@ void AuditEventPublisher::ProcessEvents(
       // SELinux or AppArmor events
     } else if (selinux_event_set.find(audit_event_record.type) !=
                selinux_event_set.end()) {
-      if (audit_event_record.fields.find(kAppArmorEventMarker) ==
-          audit_event_record.fields.end()) {
+      if (!audit_event_record.fields.find(AuditFieldKey::AppArmor)) {
         // Pure SELinux Event
 
         AuditEvent audit_event;
@@ -434,39 +431,41 @@ const AuditEventRecord* GetEventRecord(const AuditEvent& event,
 };
 
 bool GetStringFieldFromMap(std::string& value,
-                           const std::map<std::string, std::string>& fields,
-                           const std::string& name,
+                           const AuditFieldList& fields,
+                           std::string_view name,
                            const std::string& default_value) noexcept {
-  auto it = fields.find(name);
-  if (it == fields.end()) {
+  auto field = fields.find(name);
+  if (!field.has_value()) {
     value = default_value;
     return false;
   }
 
-  value = it->second;
+  value.assign(field->data(), field->size());
   return true;
 }
 
 bool GetIntegerFieldFromMap(std::uint64_t& value,
-                            const std::map<std::string, std::string>& field_map,
-                            const std::string& field_name,
+                            const AuditFieldList& field_map,
+                            std::string_view field_name,
                             std::size_t base,
                             std::uint64_t default_value) noexcept {
-  std::string string_value;
-  if (!GetStringFieldFromMap(string_value, field_map, field_name, "")) {
+  auto field = field_map.find(field_name);
+  if (!field.has_value()) {
     value = default_value;
     return false;
   }
-  auto exp = tryTo<std::uint64_t>(string_value, base);
+
+  // Integer values are short enough not to allocate
+  auto exp = tryTo<std::uint64_t>(std::string(*field), base);
   value = exp.takeOr(std::move(default_value));
   return exp.isValue();
 }
 
 void CopyFieldFromMap(Row& row,
-                      const std::map<std::string, std::string>& fields,
-                      const std::string& name,
+                      const AuditFieldList& fields,
+                      std::string_view name,
                       const std::string& default_value) noexcept {
-  GetStringFieldFromMap(row[name], fields, name, default_value);
+  GetStringFieldFromMap(row[std::string(name)], fields, name, default_value);
 }
 
 std::string StripQuotes(const std::string& value) noexcept {
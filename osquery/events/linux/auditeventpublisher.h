@@ -172,27 +172,27 @@ class AuditEventPublisher final
 const AuditEventRecord* GetEventRecord(const AuditEvent& event,
                                        int record_type) noexcept;
 
-/// Extracts the specified string key from the given string map
+/// Extracts the specified string key from the given field list
 bool GetStringFieldFromMap(
     std::string& value,
-    const std::map<std::string, std::string>& fields,
-    const std::string& name,
+    const AuditFieldList& fields,
+    std::string_view name,
     const std::string& default_value = std::string()) noexcept;
 
-/// Extracts the specified integer key from the given string map
+/// Extracts the specified integer key from the given field list
 bool GetIntegerFieldFromMap(
     std::uint64_t& value,
-    const std::map<std::string, std::string>& field_map,
-    const std::string& field_name,
+    const AuditFieldList& field_map,
+    std::string_view field_name,
     std::size_t base = 10,
     std::uint64_t default_value =
         std::numeric_limits<std::uint64_t>::max()) noexcept;
 
-/// Copies a named field from the 'fields' map to the specified row
+/// Copies a named field from the 'fields' list to the specified row
 void CopyFieldFromMap(
     Row& row,
-    const std::map<std::string, std::string>& fields,
-    const std::string& name,
+    const AuditFieldList& fields,
+    std::string_view name,
     const std::string& default_value = std::string()) noexcept;
 
 // Strips first and last quote from string if present
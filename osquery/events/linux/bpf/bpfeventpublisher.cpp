@@ -19,6 +19,7 @@
 
 #include <fcntl.h>
 #include <sys/sysinfo.h>
+#include <sys/wait.h>
 
 namespace osquery {
 
@@ -69,6 +70,7 @@ const FunctionTracerAllocatorList kFunctionTracerAllocators = {
     {"fork", &BPFEventPublisher::processForkEvent, 0U, false},
     {"vfork", &BPFEventPublisher::processVforkEvent, 0U, false},
     {"clone", &BPFEventPublisher::processCloneEvent, 0U, false},
+    {"wait4", &BPFEventPublisher::processWait4Event, 0U, false},
     {"close", &BPFEventPublisher::processCloseEvent, 0U, false},
     {"dup", &BPFEventPublisher::processDupEvent, 0U, false},
     {"dup2", &BPFEventPublisher::processDup2Event, 0U, false},
@@ -313,6 +315,7 @@ Status BPFEventPublisher::run() {
   }
 
   BPFErrorState bpf_error_state;
+  ISystemStateTracker::ProcessExpirationStats last_expiration_stats;
 
   auto last_error_report = getUnixTime();
   auto last_tracker_restart = getUnixTime();
@@ -355,6 +358,26 @@ Status BPFEventPublisher::run() {
     current_time = getUnixTime();
     if (last_error_report + 5U < current_time) {
       reportAndClearBpfErrorState(bpf_error_state);
+
+      auto expiration_stats =
+          d->system_state_tracker->getProcessExpirationStats();
+
+      if (expiration_stats.reaped_processes !=
+              last_expiration_stats.reaped_processes ||
+          expiration_stats.swept_processes !=
+              last_expiration_stats.swept_processes) {
+        VLOG(1) << "BPF process contexts reaped: "
+                << expiration_stats.reaped_processes
+                << ", swept: " << expiration_stats.swept_processes
+                << ", expired: " << expiration_stats.expired_processes
+                << ", completed sweeps: " << expiration_stats.completed_sweeps
+                << ", sweep time: " << expiration_stats.sweep_time
+                << "us, longest slice: " << expiration_stats.max_slice_time
+                << "us";
+
+        last_expiration_stats = expiration_stats;
+      }
+
       last_error_report = current_time;
     }
 
@@ -435,6 +458,39 @@ bool BPFEventPublisher::processCloneEvent(
   return processForkEvent(state, event);
 }
 
+bool BPFEventPublisher::processWait4Event(
+    ISystemStateTracker& state, const ebpfpub::IFunctionTracer::Event& event) {
+  // The exit code is the pid of the child that changed state, if any
+  auto process_id = static_cast<pid_t>(event.header.exit_code);
+  if (process_id <= 0) {
+    return true;
+  }
+
+  std::uint64_t options{};
+  if (!getEventMapValue(options, event.in_field_map, "options")) {
+    return false;
+  }
+
+  // The child may have only been stopped or continued, and it is still
+  // around; the expiration sweep will take care of it
+  if ((options & (WUNTRACED | WCONTINUED)) != 0) {
+    return true;
+  }
+
+  // Tracers are also notified when a tracee stops, which is only told apart
+  // from an exit by the wait status. It is missing if the caller did not ask
+  // for it, which tracers always do
+  std::uint64_t wait_status{};
+  if (getEventMapValue(wait_status, event.out_field_map, "stat_addr")) {
+    auto status = static_cast<int>(wait_status);
+    if (!WIFEXITED(status) && !WIFSIGNALED(status)) {
+      return true;
+    }
+  }
+
+  return state.reapProcess(process_id);
+}
+
 bool BPFEventPublisher::processExecveEvent(
     ISystemStateTracker& state, const ebpfpub::IFunctionTracer::Event& event) {
   std::string binary_path;
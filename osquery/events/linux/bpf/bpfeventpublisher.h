@@ -76,6 +76,10 @@ class BPFEventPublisher final : public EventPublisher<BPFEventSC, BPFEventEC> {
       ISystemStateTracker& state,
       const tob::ebpfpub::IFunctionTracer::Event& event);
 
+  static bool processWait4Event(
+      ISystemStateTracker& state,
+      const tob::ebpfpub::IFunctionTracer::Event& event);
+
   static bool processExecveEvent(
       ISystemStateTracker& state,
       const tob::ebpfpub::IFunctionTracer::Event& event);
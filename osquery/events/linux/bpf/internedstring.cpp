@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/bpf/internedstring.h>
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace osquery {
+
+namespace {
+
+/// The live interned values, keyed by a view of the value itself
+using InternedStringPool =
+    std::unordered_map<std::string_view, std::weak_ptr<const std::string>>;
+
+struct InternedStringPoolData final {
+  std::mutex mutex;
+  InternedStringPool pool;
+};
+
+InternedStringPoolData& getPoolData() {
+  // Never destroyed, values may be released during static destruction
+  static auto* pool_data = new InternedStringPoolData;
+  return *pool_data;
+}
+
+/// Removes the value from the pool once its last holder is gone
+void releaseInternedString(const std::string* value) {
+  auto& pool_data = getPoolData();
+
+  {
+    std::lock_guard<std::mutex> lock(pool_data.mutex);
+
+    // The entry may have been replaced by a new holder of the same value
+    auto it = pool_data.pool.find(*value);
+    if (it != pool_data.pool.end() && it->second.expired()) {
+      pool_data.pool.erase(it);
+    }
+  }
+
+  delete value;
+}
+
+std::shared_ptr<const std::string> intern(const std::string& value) {
+  if (value.empty()) {
+    return nullptr;
+  }
+
+  auto& pool_data = getPoolData();
+  std::lock_guard<std::mutex> lock(pool_data.mutex);
+
+  auto it = pool_data.pool.find(value);
+  if (it != pool_data.pool.end()) {
+    auto interned = it->second.lock();
+    if (interned) {
+      return interned;
+    }
+
+    // The key views the expiring value; replace the entry altogether
+    pool_data.pool.erase(it);
+  }
+
+  std::shared_ptr<const std::string> interned(new std::string(value),
+                                              releaseInternedString);
+
+  pool_data.pool.emplace(*interned, interned);
+  return interned;
+}
+
+} // namespace
+
+InternedString::InternedString(const std::string& value)
+    : value_(intern(value)) {}
+
+InternedString::InternedString(const char* value)
+    : value_(intern(value)) {}
+
+const std::string& InternedString::emptyString() {
+  static const std::string kEmptyString;
+  return kEmptyString;
+}
+
+} // namespace osquery
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace osquery {
+
+/// \brief An immutable string shared by all the holders of the same value
+/// Process contexts hold a few paths (cwd, binary path) that are the same
+/// across most of the processes, and that are copied on every fork. Equal
+/// values are interned into a single allocation, so that copies only
+/// update a reference count. The value is released with its last holder
+class InternedString final {
+ public:
+  InternedString() = default;
+
+  InternedString(const std::string& value);
+  InternedString(const char* value);
+
+  /// Returns the interned value
+  const std::string& str() const {
+    return value_ ? *value_ : emptyString();
+  }
+
+  operator const std::string&() const {
+    return str();
+  }
+
+  bool empty() const {
+    return !value_;
+  }
+
+  friend bool operator==(const InternedString& lhs, const InternedString& rhs) {
+    return lhs.value_ == rhs.value_;
+  }
+
+  friend bool operator!=(const InternedString& lhs, const InternedString& rhs) {
+    return lhs.value_ != rhs.value_;
+  }
+
+  friend bool operator==(const InternedString& lhs, const std::string& rhs) {
+    return lhs.str() == rhs;
+  }
+
+  friend bool operator==(const std::string& lhs, const InternedString& rhs) {
+    return lhs == rhs.str();
+  }
+
+  friend bool operator==(const InternedString& lhs, const char* rhs) {
+    return lhs.str() == rhs;
+  }
+
+  friend std::ostream& operator<<(std::ostream& stream,
+                                  const InternedString& value) {
+    return stream << value.str();
+  }
+
+ private:
+  static const std::string& emptyString();
+
+  std::shared_ptr<const std::string> value_;
+};
+
+} // namespace osquery
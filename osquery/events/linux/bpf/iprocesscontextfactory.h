@@ -9,11 +9,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
 #include <osquery/events/linux/bpf/ifilesystem.h>
+#include <osquery/events/linux/bpf/internedstring.h>
 
 namespace osquery {
 
@@ -58,19 +64,116 @@ struct ProcessContext final {
     bool close_on_exec{false};
   };
 
-  using FileDescriptorMap = std::unordered_map<int, FileDescriptor>;
+  /// \brief A file descriptor map, shared with the forked processes
+  /// Copies share the same entries, so that a fork does not copy the whole
+  /// table. The entries are copied by the first change made to a map that
+  /// is still shared. Lookups never copy
+  class FileDescriptorMap final {
+   public:
+    using Container = std::unordered_map<int, FileDescriptor>;
+    using value_type = Container::value_type;
+    using const_iterator = Container::const_iterator;
+
+    std::size_t size() const {
+      return entries().size();
+    }
+
+    bool empty() const {
+      return entries().empty();
+    }
+
+    std::size_t count(int fd) const {
+      return entries().count(fd);
+    }
+
+    const FileDescriptor& at(int fd) const {
+      return entries().at(fd);
+    }
+
+    const_iterator find(int fd) const {
+      return entries().find(fd);
+    }
+
+    const_iterator begin() const {
+      return entries().begin();
+    }
+
+    const_iterator end() const {
+      return entries().end();
+    }
+
+    std::pair<Container::iterator, bool> insert(value_type value) {
+      return mutableMap().insert(std::move(value));
+    }
+
+    std::size_t erase(int fd) {
+      if (count(fd) == 0) {
+        return 0U;
+      }
+
+      return mutableMap().erase(fd);
+    }
+
+    /// Removes the matching entries, copying only the ones that are kept
+    template <typename Predicate>
+    void eraseIf(Predicate predicate) {
+      auto match_it = std::find_if(begin(), end(), predicate);
+      if (match_it == end()) {
+        return;
+      }
+
+      if (map_.use_count() == 1) {
+        for (auto it = map_->begin(); it != map_->end();) {
+          it = predicate(*it) ? map_->erase(it) : std::next(it);
+        }
+
+        return;
+      }
+
+      auto entries = std::make_shared<Container>();
+      for (const auto& entry : *map_) {
+        if (!predicate(entry)) {
+          entries->insert(entry);
+        }
+      }
+
+      map_ = std::move(entries);
+    }
+
+    /// Returns the entries for changing them, copying them if shared
+    Container& mutableMap() {
+      if (!map_) {
+        map_ = std::make_shared<Container>();
+
+      } else if (map_.use_count() > 1) {
+        map_ = std::make_shared<Container>(*map_);
+      }
+
+      return *map_;
+    }
+
+   private:
+    const Container& entries() const {
+      static const Container kEmptyContainer;
+      return map_ ? *map_ : kEmptyContainer;
+    }
+
+    std::shared_ptr<Container> map_;
+  };
+
+  using ArgumentList = std::vector<std::string>;
 
   /// Parent process id
   pid_t parent_process_id{};
 
   /// Current binary path
-  std::string binary_path;
+  InternedString binary_path;
 
-  /// Program argument list
-  std::vector<std::string> argv;
+  /// Program argument list, shared with the forked processes
+  std::shared_ptr<const ArgumentList> argv;
 
   /// Current working directory
-  std::string cwd;
+  InternedString cwd;
 
   /// File descriptor map, automatically inherited when forking
   FileDescriptorMap fd_map;
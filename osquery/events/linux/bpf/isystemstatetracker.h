@@ -89,6 +89,27 @@ class ISystemStateTracker {
 
   using EventList = std::vector<Event>;
 
+  /// Counters of the process contexts that have been removed
+  struct ProcessExpirationStats final {
+    /// Contexts removed when their process was reaped by the parent
+    std::uint64_t reaped_processes{};
+
+    /// Contexts checked against procfs by the expiration sweeper
+    std::uint64_t swept_processes{};
+
+    /// Contexts removed by the sweeper, since their process was gone
+    std::uint64_t expired_processes{};
+
+    /// Sweeps of the whole process map that have been completed
+    std::uint64_t completed_sweeps{};
+
+    /// Time spent by the sweeper, in microseconds
+    std::uint64_t sweep_time{};
+
+    /// Time spent by the longest sweeper slice, in microseconds
+    std::uint64_t max_slice_time{};
+  };
+
   ISystemStateTracker() = default;
   virtual ~ISystemStateTracker() = default;
 
@@ -122,6 +143,11 @@ class ISystemStateTracker {
       const std::string& binary_path,
       const tob::ebpfpub::IFunctionTracer::Event::Field::Argv& argv) = 0;
 
+  /// \brief Removes a process, in response to wait4
+  /// The parent has reaped the process, so its pid can no longer refer to
+  /// it. This removes the context without waiting for the expiration sweep
+  virtual bool reapProcess(pid_t process_id) = 0;
+
   /// Sets the process working directory, in response to fchdir
   virtual bool setWorkingDirectory(pid_t process_id, int dirfd) = 0;
 
@@ -212,6 +238,9 @@ class ISystemStateTracker {
 
   /// Returns the list of generated events
   virtual EventList eventList() = 0;
+
+  /// Returns the process context expiration counters
+  virtual ProcessExpirationStats getProcessExpirationStats() const = 0;
 };
 
 } // namespace osquery
@@ -130,22 +130,29 @@ bool ProcessContextFactory::captureSingleProcess(
     return false;
   }
 
-  succeeded = fs.readLinkAt(output.binary_path, process_root.get(), "exe");
+  std::string binary_path;
+  succeeded = fs.readLinkAt(binary_path, process_root.get(), "exe");
   static_cast<void>(succeeded);
 
-  succeeded = getArgvFromCmdlineFile(fs, output.argv, process_cmdline.get());
+  ProcessContext::ArgumentList argv;
+  succeeded = getArgvFromCmdlineFile(fs, argv, process_cmdline.get());
   static_cast<void>(succeeded);
 
   // If we failed to capture both fields, assume it's a special process
   // such as a kworker instance
-  if (output.binary_path.empty() != output.argv.empty()) {
+  if (binary_path.empty() != argv.empty()) {
     return false;
   }
 
-  if (!fs.readLinkAt(output.cwd, process_root.get(), "cwd")) {
+  std::string cwd;
+  if (!fs.readLinkAt(cwd, process_root.get(), "cwd")) {
     return false;
   }
 
+  output.binary_path = binary_path;
+  output.argv = std::make_shared<ProcessContext::ArgumentList>(std::move(argv));
+  output.cwd = cwd;
+
   if (!getParentPidFromStatFile(
           fs, output.parent_process_id, process_stat.get())) {
     return false;
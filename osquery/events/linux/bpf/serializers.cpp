@@ -315,6 +315,27 @@ const ParameterListMap kParameterListMap = {
        tob::ebpfpub::IFunctionTracer::Parameter::Mode::In,
        8U}}},
 
+    {"wait4",
+     {{"upid",
+       tob::ebpfpub::IFunctionTracer::Parameter::Type::Integer,
+       tob::ebpfpub::IFunctionTracer::Parameter::Mode::In,
+       8U},
+
+      {"stat_addr",
+       tob::ebpfpub::IFunctionTracer::Parameter::Type::IntegerPtr,
+       tob::ebpfpub::IFunctionTracer::Parameter::Mode::Out,
+       4U},
+
+      {"options",
+       tob::ebpfpub::IFunctionTracer::Parameter::Type::Integer,
+       tob::ebpfpub::IFunctionTracer::Parameter::Mode::In,
+       8U},
+
+      {"ru",
+       tob::ebpfpub::IFunctionTracer::Parameter::Type::Integer,
+       tob::ebpfpub::IFunctionTracer::Parameter::Mode::In,
+       8U}}},
+
     {"vfork", {}},
     {"fork", {}},
 };
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -29,6 +31,7 @@ namespace {
 const std::size_t kMaxFileHandleEntryCount{512U};
 const std::uint64_t kExpirationTime{180U};
 const std::size_t kEventsBeforeExpiration{10000U};
+const std::size_t kProcessesPerExpirationSlice{256U};
 }
 
 struct SystemStateTracker::PrivateData final {
@@ -102,6 +105,10 @@ bool SystemStateTracker::executeBinary(
                        argv);
 }
 
+bool SystemStateTracker::reapProcess(pid_t process_id) {
+  return reapProcess(d->context, process_id);
+}
+
 bool SystemStateTracker::setWorkingDirectory(pid_t process_id, int dirfd) {
   return setWorkingDirectory(
       d->context, *d->process_context_factory.get(), process_id, dirfd);
@@ -242,13 +249,21 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
 
   d->event_count_since_expiration += event_list.size();
 
+  // Reaped processes are removed as soon as the parent waits for them; the
+  // sweep only catches the ones nobody waited for. Once started, it checks
+  // a slice of the process map on each call, until it completes
+  auto sweep_in_progress = !d->context.expiration_queue.empty();
+
   auto current_time = getUnixTime();
-  if (d->last_expiration + kExpirationTime < current_time ||
+  if (sweep_in_progress ||
+      d->last_expiration + kExpirationTime < current_time ||
       d->event_count_since_expiration >= kEventsBeforeExpiration) {
     IFilesystem::Ref fs;
     auto status = IFilesystem::create(fs);
     if (status.ok()) {
-      status = expireProcessContexts(d->context, *fs.get());
+      status = expireProcessContexts(
+          d->context, *fs.get(), kProcessesPerExpirationSlice);
+
       if (!status.ok()) {
         LOG(ERROR) << "BPF system state tracker cleanup error: "
                    << status.getMessage();
@@ -259,13 +274,20 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
                  << status.getMessage();
     }
 
-    d->last_expiration = current_time;
-    d->event_count_since_expiration = 0;
+    if (!sweep_in_progress) {
+      d->last_expiration = current_time;
+      d->event_count_since_expiration = 0;
+    }
   }
 
   return event_list;
 }
 
+ISystemStateTracker::ProcessExpirationStats
+SystemStateTracker::getProcessExpirationStats() const {
+  return d->context.expiration_stats;
+}
+
 SystemStateTracker::SystemStateTracker(
     IProcessContextFactory::Ref process_context_factory)
     : d(new PrivateData) {
@@ -305,29 +327,67 @@ ProcessContext& SystemStateTracker::getProcessContext(
 }
 
 Status SystemStateTracker::expireProcessContexts(Context& context,
-                                                 IFilesystem& fs) {
+                                                 IFilesystem& fs,
+                                                 std::size_t max_count) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  // Start a new sweep from a snapshot of the process ids; the contexts that
+  // are created in the meantime are checked by the next one
+  auto& expiration_queue = context.expiration_queue;
+  if (expiration_queue.empty()) {
+    expiration_queue.reserve(context.process_map.size());
+
+    for (const auto& process_map_p : context.process_map) {
+      expiration_queue.push_back(process_map_p.first);
+    }
+  }
+
   tob::utils::UniqueFd procfs_root;
   if (!fs.open(procfs_root, "/proc", O_DIRECTORY)) {
     return Status::failure("Failed to open the procfs root: /proc");
   }
 
+  auto& expiration_stats = context.expiration_stats;
+
   bool return_error{false};
-  for (auto process_map_it = context.process_map.begin();
-       process_map_it != context.process_map.end();) {
-    auto process_id = std::to_string(process_map_it->first);
+  for (std::size_t checked_count{0U};
+       checked_count < max_count && !expiration_queue.empty();) {
+    auto process_id = expiration_queue.back();
+    expiration_queue.pop_back();
+
+    // Skip the processes that have been reaped since the sweep started
+    auto process_map_it = context.process_map.find(process_id);
+    if (process_map_it == context.process_map.end()) {
+      continue;
+    }
 
     bool exists{false};
-    if (!fs.fileExists(exists, procfs_root.get(), process_id.c_str())) {
+    if (!fs.fileExists(exists, procfs_root.get(), std::to_string(process_id))) {
       return_error = true;
     }
 
     if (!exists) {
-      process_map_it = context.process_map.erase(process_map_it);
-    } else {
-      ++process_map_it;
+      context.process_map.erase(process_map_it);
+      ++expiration_stats.expired_processes;
     }
+
+    ++expiration_stats.swept_processes;
+    ++checked_count;
   }
 
+  if (expiration_queue.empty()) {
+    ++expiration_stats.completed_sweeps;
+  }
+
+  auto slice_time = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_time)
+          .count());
+
+  expiration_stats.sweep_time += slice_time;
+  expiration_stats.max_slice_time =
+      std::max(expiration_stats.max_slice_time, slice_time);
+
   if (return_error) {
     return Status::failure(
         "Failed to access one or more entries in the procfs directory");
@@ -361,8 +421,18 @@ bool SystemStateTracker::createProcess(
 
   context.event_list.push_back(std::move(event));
 
-  context.process_map.insert(
-      {child_process_id, std::move(child_process_context)});
+  // A context that is still around for this pid belongs to a process that
+  // has exited without being reaped or swept yet
+  context.process_map.insert_or_assign(child_process_id,
+                                       std::move(child_process_context));
+
+  return true;
+}
+
+bool SystemStateTracker::reapProcess(Context& context, pid_t process_id) {
+  if (context.process_map.erase(process_id) != 0U) {
+    ++context.expiration_stats.reaped_processes;
+  }
 
   return true;
 }
@@ -409,7 +479,8 @@ bool SystemStateTracker::executeBinary(
     process_context.binary_path = binary_path;
 
   } else if (dirfd == AT_FDCWD) {
-    process_context.binary_path = process_context.cwd + '/' + binary_path;
+    process_context.binary_path =
+        process_context.cwd.str() + '/' + binary_path;
 
   } else {
     std::string root_path;
@@ -432,17 +503,14 @@ bool SystemStateTracker::executeBinary(
     process_context.binary_path = root_path + '/' + binary_path;
   }
 
-  process_context.argv = argv;
+  process_context.argv = std::make_shared<ProcessContext::ArgumentList>(argv);
 
-  for (auto fd_it = process_context.fd_map.begin();
-       fd_it != process_context.fd_map.end();) {
-    const auto& fd_info = fd_it->second;
-    if (fd_info.close_on_exec) {
-      fd_it = process_context.fd_map.erase(fd_it);
-    } else {
-      ++fd_it;
-    }
-  }
+  // The map may still be shared with the parent process; only the file
+  // descriptors that survive the exec are copied
+  process_context.fd_map.eraseIf(
+      [](const ProcessContext::FileDescriptorMap::value_type& fd) -> bool {
+        return fd.second.close_on_exec;
+      });
 
   Event event;
   event.type = Event::Type::Exec;
@@ -497,11 +565,13 @@ bool SystemStateTracker::setWorkingDirectory(
     process_context.cwd = path;
 
   } else {
-    if (process_context.cwd.back() != '/') {
-      process_context.cwd += '/';
+    auto cwd = process_context.cwd.str();
+    if (cwd.back() != '/') {
+      cwd += '/';
     }
 
-    process_context.cwd += path;
+    cwd += path;
+    process_context.cwd = cwd;
   }
 
   return true;
@@ -607,13 +677,7 @@ bool SystemStateTracker::closeHandle(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
-    return false;
-  }
-
-  process_context.fd_map.erase(fd_info_it);
-  return true;
+  return process_context.fd_map.erase(fd) != 0U;
 }
 
 bool SystemStateTracker::createSocket(
@@ -652,14 +716,14 @@ bool SystemStateTracker::bind(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutableMap();
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     fd_info_it = insert_status.first;
   }
@@ -796,14 +860,14 @@ bool SystemStateTracker::connect(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutableMap();
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     fd_info_it = insert_status.first;
   }
@@ -879,14 +943,14 @@ bool SystemStateTracker::accept(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto parent_fd_info_it = process_context.fd_map.find(fd);
-  if (parent_fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutableMap();
+  auto parent_fd_info_it = fd_map.find(fd);
+  if (parent_fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     parent_fd_info_it = insert_status.first;
   }
@@ -912,7 +976,7 @@ bool SystemStateTracker::accept(
     return false;
   }
 
-  process_context.fd_map.insert({newfd, new_fd_info});
+  fd_map.insert({newfd, new_fd_info});
 
   Event event;
   event.type = Event::Type::Accept;
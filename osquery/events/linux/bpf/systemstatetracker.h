@@ -42,6 +42,8 @@ class SystemStateTracker final : public ISystemStateTracker {
       const std::string& binary_path,
       const tob::ebpfpub::IFunctionTracer::Event::Field::Argv& argv) override;
 
+  virtual bool reapProcess(pid_t process_id) override;
+
   virtual bool setWorkingDirectory(pid_t process_id, int dirfd) override;
 
   virtual bool setWorkingDirectory(pid_t process_id,
@@ -103,6 +105,8 @@ class SystemStateTracker final : public ISystemStateTracker {
 
   virtual EventList eventList() override;
 
+  virtual ProcessExpirationStats getProcessExpirationStats() const override;
+
   struct Context;
   Context getContextCopy() const;
 
@@ -127,6 +131,10 @@ class SystemStateTracker final : public ISystemStateTracker {
 
     std::vector<std::string> file_handle_struct_index;
     FileHandleStructMap file_handle_struct_map;
+
+    /// Process ids left to check in the current expiration sweep
+    std::vector<pid_t> expiration_queue;
+    ProcessExpirationStats expiration_stats;
   };
 
   static ProcessContext& getProcessContext(
@@ -134,7 +142,9 @@ class SystemStateTracker final : public ISystemStateTracker {
       IProcessContextFactory& process_context_factory,
       pid_t process_id);
 
-  static Status expireProcessContexts(Context& context, IFilesystem& fs);
+  static Status expireProcessContexts(Context& context,
+                                      IFilesystem& fs,
+                                      std::size_t max_count);
 
   static bool createProcess(
       Context& context,
@@ -143,6 +153,8 @@ class SystemStateTracker final : public ISystemStateTracker {
       pid_t process_id,
       pid_t child_process_id);
 
+  static bool reapProcess(Context& context, pid_t process_id);
+
   static bool executeBinary(
       Context& context,
       IProcessContextFactory& process_context_factory,
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/// The size of the cache lines the ring indexes are kept apart by.
+constexpr std::size_t kCacheLineSize{64};
+
+/**
+ * @brief A bounded, lock-free queue between one producer and one consumer.
+ *
+ * Slots are allocated once. The producer fills a slot in place between
+ * claim and publish, and the consumer reads it in place between front and
+ * pop, so large values are never copied through the ring.
+ *
+ * The producer and consumer indexes, and the flags each side raises while
+ * it waits, live on their own cache lines. Each side also keeps its own copy
+ * of the other side's index and only reloads it when the ring looks full or
+ * empty.
+ *
+ * A side that cannot progress blocks on an eventfd until the other side
+ * makes progress, or until a timeout so it can check for interruptions. The
+ * other side only writes to the eventfd when a waiter announced itself, so
+ * a ring that keeps up makes no system calls.
+ */
+template <typename T>
+class SPSCRing : private boost::noncopyable {
+ public:
+  /// Allocate the slots, the capacity is rounded up to a power of two.
+  explicit SPSCRing(std::size_t capacity) {
+    std::size_t slots = 1;
+    while (slots < capacity) {
+      slots <<= 1;
+    }
+
+    // Slots are default-initialized, the pages of trivial types are only
+    // touched once they are used.
+    slots_.reset(new T[slots]);
+    mask_ = slots - 1;
+
+    data_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    space_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  }
+
+  ~SPSCRing() {
+    if (data_fd_ != -1) {
+      ::close(data_fd_);
+    }
+    if (space_fd_ != -1) {
+      ::close(space_fd_);
+    }
+  }
+
+  /// The next free slot, for the producer. nullptr if the ring is full.
+  T* claim() noexcept {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+    }
+    return &slots_[tail & mask_];
+  }
+
+  /// Hand the claimed slot to the consumer.
+  void publish() noexcept {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_seq_cst);
+    if (consumer_waiting_.load(std::memory_order_seq_cst)) {
+      signal(data_fd_);
+    }
+  }
+
+  /// The oldest published slot, for the consumer. nullptr if it is empty.
+  T* front() noexcept {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return nullptr;
+      }
+    }
+    return &slots_[head & mask_];
+  }
+
+  /// Release the front slot to the producer.
+  void pop() noexcept {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_seq_cst);
+    if (producer_waiting_.load(std::memory_order_seq_cst)) {
+      signal(space_fd_);
+    }
+  }
+
+  /// Block the producer until a slot is free, false if the timeout expired.
+  bool waitForSpace(std::chrono::milliseconds timeout) noexcept {
+    auto full = [this]() {
+      return tail_.load(std::memory_order_relaxed) -
+                 head_.load(std::memory_order_seq_cst) >
+             mask_;
+    };
+    if (!full()) {
+      return true;
+    }
+
+    // Announce the wait before checking again, so either the consumer sees
+    // the flag or this side sees the released slot.
+    producer_waiting_.store(true, std::memory_order_seq_cst);
+    if (full()) {
+      wait(space_fd_, timeout);
+    }
+    producer_waiting_.store(false, std::memory_order_relaxed);
+    return !full();
+  }
+
+  /// Block the consumer until a slot is published, false on timeout.
+  bool waitForData(std::chrono::milliseconds timeout) noexcept {
+    auto empty = [this]() {
+      return tail_.load(std::memory_order_seq_cst) ==
+             head_.load(std::memory_order_relaxed);
+    };
+    if (!empty()) {
+      return true;
+    }
+
+    consumer_waiting_.store(true, std::memory_order_seq_cst);
+    if (empty()) {
+      wait(data_fd_, timeout);
+    }
+    consumer_waiting_.store(false, std::memory_order_relaxed);
+    return !empty();
+  }
+
+  /// Wake both sides up, such as when the services using the ring stop.
+  void wakeAll() noexcept {
+    signal(data_fd_);
+    signal(space_fd_);
+  }
+
+  /// The number of published slots the consumer did not release yet.
+  std::size_t size() const noexcept {
+    // The head is loaded first, so it is never ahead of the tail.
+    auto head = head_.load(std::memory_order_acquire);
+    auto tail = tail_.load(std::memory_order_acquire);
+    return std::min(tail - head, capacity());
+  }
+
+  std::size_t capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  /// The number of times the producer found the ring full.
+  std::uint64_t stalls() const noexcept {
+    return stalls_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static void signal(int fd) noexcept {
+    if (fd != -1) {
+      std::uint64_t count = 1;
+      auto written = ::write(fd, &count, sizeof(count));
+      static_cast<void>(written);
+    }
+  }
+
+  /// Wait for an eventfd to be signaled and reset it.
+  static void wait(int fd, std::chrono::milliseconds timeout) noexcept {
+    // Without an eventfd, poll only waits for the timeout.
+    pollfd fds[] = {{fd, POLLIN, 0}};
+    if (::poll(fds, 1, static_cast<int>(timeout.count())) > 0 &&
+        (fds[0].revents & POLLIN) != 0) {
+      std::uint64_t count = 0;
+      auto bytes = ::read(fd, &count, sizeof(count));
+      static_cast<void>(bytes);
+    }
+  }
+
+ private:
+  /// The next slot the consumer releases.
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0};
+
+  /// The consumer's copy of tail_.
+  std::size_t tail_cache_{0};
+
+  /// The next slot the producer claims.
+  alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0};
+
+  /// The producer's copy of head_.
+  std::size_t head_cache_{0};
+
+  std::atomic<std::uint64_t> stalls_{0};
+
+  alignas(kCacheLineSize) std::atomic<bool> consumer_waiting_{false};
+  alignas(kCacheLineSize) std::atomic<bool> producer_waiting_{false};
+
+  /// The slots and eventfds do not change after construction.
+  alignas(kCacheLineSize) std::unique_ptr<T[]> slots_;
+  std::size_t mask_{0};
+
+  /// Signaled when a slot is published to a waiting consumer.
+  int data_fd_{-1};
+
+  /// Signaled when a slot is released to a waiting producer.
+  int space_fd_{-1};
+};
+
+} // namespace osquery
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <osquery/core/plugins/logger.h>
+#include <osquery/events/eventstream.h>
+#include <osquery/registry/registry_factory.h>
+
+namespace osquery {
+
+DECLARE_uint64(events_stream_max);
+DECLARE_uint64(events_stream_wait);
+DECLARE_bool(logger_event_type);
+
+class StreamTestLoggerPlugin : public LoggerPlugin {
+ public:
+  Status logString(const std::string& s) override {
+    lines.push_back(s);
+    return Status::success();
+  }
+
+  void init(const std::string& name,
+            const std::vector<StatusLogLine>& log) override {}
+
+  static std::vector<std::string> lines;
+};
+
+std::vector<std::string> StreamTestLoggerPlugin::lines;
+
+class EventStreamTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    drain();
+  }
+
+  void TearDown() override {
+    drain();
+    FLAGS_events_stream_max = 10000;
+    FLAGS_events_stream_wait = 0;
+  }
+
+  /// Empty the stream shared by the tests.
+  static std::vector<EventStreamItem> drain() {
+    std::vector<EventStreamItem> items;
+    EventStream::get().pop(
+        items, static_cast<std::size_t>(-1), std::chrono::milliseconds(0));
+    return items;
+  }
+
+  static Status parseQuery(const std::string& config, EventStreamQuery& query) {
+    auto doc = JSON::newObject();
+    auto status = doc.fromString(config);
+    if (!status.ok()) {
+      return status;
+    }
+    return EventStreamQuery::parse("stream", doc.doc(), query);
+  }
+};
+
+TEST_F(EventStreamTests, test_parse) {
+  EventStreamQuery query;
+  auto status = parseQuery(
+      R"({"subscriber": "process_events", "columns": ["pid", "path"],)"
+      R"( "where": [{"column": "uid", "value": 0},)"
+      R"( {"column": "path", "op": "like", "value": "/usr/%"}]})",
+      query);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(query.name(), "stream");
+  EXPECT_EQ(query.subscriber(), "process_events");
+
+  // A stream must name its subscriber.
+  EXPECT_FALSE(parseQuery(R"({"columns": ["pid"]})", query).ok());
+  EXPECT_FALSE(parseQuery(R"({"subscriber": "s", "columns": "pid"})", query)
+                   .ok());
+  EXPECT_FALSE(parseQuery(R"({"subscriber": "s", "where": [{"column": "a",)"
+                          R"( "op": "~", "value": "b"}]})",
+                          query)
+                   .ok());
+  EXPECT_FALSE(parseQuery(R"({"subscriber": "s", "where": [{"column": "a"}]})",
+                          query)
+                   .ok());
+}
+
+TEST_F(EventStreamTests, test_matches_and_project) {
+  EventStreamQuery query;
+  auto status = parseQuery(
+      R"({"subscriber": "process_events", "columns": ["pid", "path"],)"
+      R"( "where": [{"column": "uid", "op": "<", "value": 1000},)"
+      R"( {"column": "path", "op": "like", "value": "/USR/%bin/_ash"}]})",
+      query);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  Row row = {
+      {"pid", "10"}, {"uid", "0"}, {"path", "/usr/bin/bash"}, {"cmdline", ""}};
+  EXPECT_TRUE(query.matches(row));
+  EXPECT_EQ(query.project(row),
+            (Row{{"pid", "10"}, {"path", "/usr/bin/bash"}}));
+
+  // Integers are not compared as strings.
+  row["uid"] = "999";
+  EXPECT_TRUE(query.matches(row));
+  row["uid"] = "1000";
+  EXPECT_FALSE(query.matches(row));
+
+  row["uid"] = "0";
+  row["path"] = "/bin/bash";
+  EXPECT_FALSE(query.matches(row));
+
+  // A missing column is a NULL, it never matches.
+  row.erase("uid");
+  row["path"] = "/usr/bin/bash";
+  EXPECT_FALSE(query.matches(row));
+
+  // Without columns, the rows are streamed whole.
+  status = parseQuery(R"({"subscriber": "process_events"})", query);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(query.matches(row));
+  EXPECT_EQ(query.project(row), row);
+}
+
+TEST_F(EventStreamTests, test_push_and_pop) {
+  auto& stream = EventStream::get();
+  std::vector<EventStreamItem> items = {{"a", {{"n", "1"}}},
+                                        {"b", {{"n", "2"}}}};
+  stream.push(items);
+  EXPECT_EQ(stream.getStats().queued, 2U);
+
+  std::vector<EventStreamItem> popped;
+  stream.pop(popped, 1, std::chrono::milliseconds(0));
+  ASSERT_EQ(popped.size(), 1U);
+  EXPECT_EQ(popped[0].name, "a");
+
+  stream.pop(popped, 10, std::chrono::milliseconds(0));
+  ASSERT_EQ(popped.size(), 2U);
+  EXPECT_EQ(popped[1].name, "b");
+  EXPECT_EQ(popped[1].row.at("n"), "2");
+  EXPECT_EQ(stream.getStats().queued, 0U);
+}
+
+TEST_F(EventStreamTests, test_backpressure_and_drops) {
+  auto& stream = EventStream::get();
+  auto before = stream.getStats();
+
+  FLAGS_events_stream_max = 3;
+  std::vector<EventStreamItem> items(2, EventStreamItem{"a", {}});
+  stream.push(items);
+
+  // The second batch only partly fits, the rest is dropped.
+  items.assign(2, EventStreamItem{"b", {}});
+  stream.push(items);
+
+  auto after = stream.getStats();
+  EXPECT_EQ(after.queued, 3U);
+  EXPECT_EQ(after.backpressure - before.backpressure, 1U);
+  EXPECT_EQ(after.dropped - before.dropped, 1U);
+
+  // A full stream waits for the runner to take rows, up to a timeout.
+  FLAGS_events_stream_wait = 5000;
+  std::thread runner([&stream]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<EventStreamItem> popped;
+    stream.pop(popped, 1, std::chrono::milliseconds(0));
+  });
+
+  items.assign(1, EventStreamItem{"c", {}});
+  stream.push(items);
+  runner.join();
+
+  after = stream.getStats();
+  EXPECT_EQ(after.queued, 3U);
+  EXPECT_EQ(after.backpressure - before.backpressure, 2U);
+  EXPECT_EQ(after.dropped - before.dropped, 1U);
+
+  auto drained = drain();
+  ASSERT_EQ(drained.size(), 3U);
+  EXPECT_EQ(drained.back().name, "c");
+}
+
+TEST_F(EventStreamTests, test_log_items) {
+  auto& rf = RegistryFactory::get();
+  rf.registry("logger")->add("stream_test",
+                             std::make_shared<StreamTestLoggerPlugin>());
+  auto active = rf.getActive("logger");
+  ASSERT_TRUE(rf.setActive("logger", "stream_test").ok());
+  StreamTestLoggerPlugin::lines.clear();
+
+  // Rows are logged as scheduled query results, one item per stream.
+  FLAGS_logger_event_type = false;
+  std::vector<EventStreamItem> items = {
+      {"a", {{"n", "1"}}}, {"a", {{"n", "2"}}}, {"b", {{"n", "3"}}}};
+  EXPECT_TRUE(EventStreamRunner::logItems(items).ok());
+  ASSERT_EQ(StreamTestLoggerPlugin::lines.size(), 2U);
+  EXPECT_NE(StreamTestLoggerPlugin::lines[0].find("\"diffResults\""),
+            std::string::npos);
+
+  // The event format emits a line per row.
+  FLAGS_logger_event_type = true;
+  StreamTestLoggerPlugin::lines.clear();
+  EXPECT_TRUE(EventStreamRunner::logItems(items).ok());
+  ASSERT_EQ(StreamTestLoggerPlugin::lines.size(), 3U);
+  EXPECT_NE(StreamTestLoggerPlugin::lines[2].find("\"action\":\"added\""),
+            std::string::npos);
+
+  if (!active.empty()) {
+    rf.setActive("logger", active);
+  }
+}
+
+} // namespace osquery
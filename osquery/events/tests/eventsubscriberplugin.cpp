@@ -12,10 +12,14 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #include <gtest/gtest.h>
 
+#include <osquery/config/config.h>
+#include <osquery/database/database.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/registry/registry_interface.h>
 
 namespace osquery {
 
@@ -32,27 +36,32 @@ TEST_F(EventSubscriberPluginTests, setDatabaseNamespace) {
   EventSubscriberPlugin::Context context;
   EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
   ASSERT_EQ(context.database_namespace, "type.name");
+  ASSERT_EQ(context.database_domain, kEventsDomainPrefix + "type.name");
 }
 
 TEST_F(EventSubscriberPluginTests, generateEventDataIndex) {
-  // We start with 10 good keys and 10 malformed ones
+  // We start with 10 batches of a good and a malformed event, and a key
+  // that is not an event key
   MockedOsqueryDatabase mocked_database;
   mocked_database.generateEvents("type", "name");
-  EXPECT_EQ(mocked_database.key_map.size(), 20U);
+  mocked_database.key_map.insert({"not_an_event", "{}"});
+  EXPECT_EQ(mocked_database.key_map.size(), 21U);
 
   EventSubscriberPlugin::Context context;
   EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
 
-  // The reindex will erase the malformed keys and leave us with
-  // just the 10 good ones
+  // The index is built from the keys alone, the malformed events are only
+  // found once they are read
   auto status =
       EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
 
-  // Make sure we have found the 10 keys and that the broken ones
-  // have been deleted
+  // Make sure we have found the 10 batches and that the invalid key
+  // has been deleted
   EXPECT_TRUE(status.ok());
-  EXPECT_EQ(mocked_database.key_map.size(), 10U);
+  EXPECT_EQ(mocked_database.key_map.size(), 20U);
   EXPECT_EQ(context.event_index.size(), 10U);
+  EXPECT_EQ(context.event_index.at(9U), (EventIDList{19U, 20U}));
+  EXPECT_EQ(context.last_event_id.load(), 20U);
 }
 
 TEST_F(EventSubscriberPluginTests, toIndex) {
@@ -68,19 +77,22 @@ TEST_F(EventSubscriberPluginTests, setOptimizeData) {
   const EventTime kEventTime{10U};
   const std::size_t kEventIdentifier{20U};
   EventSubscriberPlugin::setOptimizeData(
-      mocked_database, kEventTime, kEventIdentifier);
+      mocked_database, "test_query", kEventTime, kEventIdentifier);
 
-  EXPECT_EQ(mocked_database.key_map.size(), 22U);
+  // The optimization data is shared, it is not in the subscriber's domain
+  EXPECT_EQ(mocked_database.key_map.size(), 20U);
+  EXPECT_EQ(mocked_database.shared_key_map.size(), 2U);
 
-  ASSERT_EQ(mocked_database.key_map.count("optimize.test_query"), 1U);
-  EXPECT_EQ(mocked_database.key_map.at("optimize.test_query"),
+  ASSERT_EQ(mocked_database.shared_key_map.count("optimize.test_query"), 1U);
+  EXPECT_EQ(mocked_database.shared_key_map.at("optimize.test_query"),
             std::to_string(kEventTime));
 
   std::stringstream expected_eid;
   expected_eid << std::setfill('0') << std::setw(10) << kEventIdentifier;
 
-  ASSERT_EQ(mocked_database.key_map.count("optimize_eid.test_query"), 1U);
-  EXPECT_EQ(mocked_database.key_map.at("optimize_eid.test_query"),
+  ASSERT_EQ(mocked_database.shared_key_map.count("optimize_eid.test_query"),
+            1U);
+  EXPECT_EQ(mocked_database.shared_key_map.at("optimize_eid.test_query"),
             expected_eid.str());
 }
 
@@ -100,33 +112,39 @@ TEST_F(EventSubscriberPluginTests, getOptimizeData) {
   const EventTime kEventTime{10U};
   const std::size_t kEventIdentifier{20U};
   EventSubscriberPlugin::setOptimizeData(
-      mocked_database, kEventTime, kEventIdentifier);
+      mocked_database, "test_query", kEventTime, kEventIdentifier);
 
   EventTime event_time{};
   EventID event_id{};
-  std::string query_name;
   EventSubscriberPlugin::getOptimizeData(
-      mocked_database, event_time, event_id, query_name);
+      mocked_database, "test_query", event_time, event_id);
 
   EXPECT_EQ(kEventTime, event_time);
   EXPECT_EQ(kEventIdentifier, event_id);
-  EXPECT_EQ(query_name, "test_query");
-}
 
-TEST_F(EventSubscriberPluginTests, databaseKeyForEventId) {
-  EventSubscriberPlugin::Context context;
-  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  // Another query has no optimization data yet.
+  EventSubscriberPlugin::getOptimizeData(
+      mocked_database, "other_query", event_time, event_id);
+  EXPECT_EQ(0U, event_time);
+  EXPECT_EQ(0U, event_id);
+}
 
+TEST_F(EventSubscriberPluginTests, databaseKeyForEvent) {
+  const EventTime kEventTime{1600000000U};
   const std::size_t kEventIdentifier{1000};
 
   std::stringstream expected_key;
-  expected_key << "data." << context.database_namespace << "."
-               << std::setfill('0') << std::setw(10) << kEventIdentifier;
+  expected_key << std::setfill('0') << std::setw(20) << kEventTime << "."
+               << std::setw(10) << kEventIdentifier;
 
   auto key =
-      EventSubscriberPlugin::databaseKeyForEventId(context, kEventIdentifier);
+      EventSubscriberPlugin::databaseKeyForEvent(kEventTime, kEventIdentifier);
 
   EXPECT_EQ(key, expected_key.str());
+
+  // Keys are sorted by time first
+  EXPECT_LT(EventSubscriberPlugin::databaseKeyForEvent(9U, 100000U),
+            EventSubscriberPlugin::databaseKeyForEvent(10U, 1U));
 }
 
 TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
@@ -155,6 +173,7 @@ TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
       context, mocked_database, 6U);
 
   EXPECT_EQ(context.event_index.size(), 6U);
+  EXPECT_EQ(mocked_database.key_map.size(), 12U);
 
   // Try again with a limit of 4; this should remove an additional 2
   EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -191,6 +210,48 @@ TEST_F(EventSubscriberPluginTests, expireEventBatches) {
 
   EventSubscriberPlugin::expireEventBatches(context, mocked_database, 1, 5);
   EXPECT_EQ(context.event_index.size(), 5U);
+  EXPECT_EQ(mocked_database.key_map.size(), 10U);
+}
+
+TEST_F(EventSubscriberPluginTests, removeEventBatches) {
+  MockedOsqueryDatabase mocked_database;
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  for (EventTime event_time = 1U; event_time <= 4U; ++event_time) {
+    for (EventID event_id = 1U; event_id <= 2U; ++event_id) {
+      auto key = EventSubscriberPlugin::databaseKeyForEvent(
+          event_time, event_time * 2U + event_id);
+      mocked_database.key_map.insert({key, "{}"});
+    }
+  }
+
+  // Whole batches are removed with a single range delete.
+  EventIndex batches = {{1U, {3U, 4U}}, {2U, {5U, 6U}}};
+  auto status = EventSubscriberPlugin::removeEventBatches(
+      context, mocked_database, batches);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(mocked_database.key_map.size(), 4U);
+  EXPECT_EQ(mocked_database.key_map.count(
+                EventSubscriberPlugin::databaseKeyForEvent(3U, 7U)),
+            1U);
+
+  // A batch stored at the same time after its index entries were taken
+  // is not removed with them.
+  batches = {{3U, {7U}}};
+  status = EventSubscriberPlugin::removeEventBatches(
+      context, mocked_database, batches);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(mocked_database.key_map.size(), 3U);
+  EXPECT_EQ(mocked_database.key_map.count(
+                EventSubscriberPlugin::databaseKeyForEvent(3U, 8U)),
+            1U);
+
+  status = EventSubscriberPlugin::removeEventBatches(
+      context, mocked_database, EventIndex{});
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(mocked_database.key_map.size(), 3U);
 }
 
 TEST_F(EventSubscriberPluginTests, generateRows) {
@@ -221,6 +282,11 @@ TEST_F(EventSubscriberPluginTests, generateRows) {
   EXPECT_EQ(result.isEnd, false);
   EXPECT_EQ(result.last_time, 9U);
 
+  // The events are read with a single range read, the malformed ones are
+  // deleted
+  EXPECT_EQ(mocked_database.range_read_count, 1U);
+  EXPECT_EQ(mocked_database.key_map.size(), 10U);
+
   result = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 0, 4);
   EXPECT_EQ(callback_count, 15U);
@@ -239,6 +305,66 @@ TEST_F(EventSubscriberPluginTests, generateRows) {
   EXPECT_EQ(result.isEnd, true);
 }
 
+TEST_F(EventSubscriberPluginTests, generateRowsInChunks) {
+  MockedOsqueryDatabase mocked_database;
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  // A batch with more events than are read at a time
+  for (EventID event_id = 1U; event_id <= 1500U; ++event_id) {
+    auto key = EventSubscriberPlugin::databaseKeyForEvent(1U, event_id);
+    mocked_database.key_map.insert(
+        {key, "{\"eid\":\"" + std::to_string(event_id) + "\"}"});
+  }
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 1U);
+
+  std::vector<std::string> eid_list;
+  auto callback = [&eid_list](Row row) { eid_list.push_back(row["eid"]); };
+
+  // Events visited by a previous optimized query are skipped
+  auto result = EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0, 500U);
+
+  EXPECT_EQ(mocked_database.range_read_count, 2U);
+  ASSERT_EQ(eid_list.size(), 1000U);
+  EXPECT_EQ(eid_list.front(), "501");
+  EXPECT_EQ(eid_list.back(), "1500");
+  EXPECT_EQ(result.last_id, 1500U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsBinary) {
+  // Binary encoded events are decoded with the stored column dictionary
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name", true);
+  EXPECT_EQ(mocked_database.key_map.size(), 20U);
+  EXPECT_EQ(mocked_database.shared_key_map.size(), 1U);
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(mocked_database.key_map.size(), 20U);
+  EXPECT_EQ(context.event_index.size(), 10U);
+  EXPECT_EQ(context.column_dictionary.size(), 6U);
+
+  std::vector<Row> rows;
+  auto callback = [&rows](Row row) { rows.push_back(std::move(row)); };
+
+  EventSubscriberPlugin::generateRows(context, mocked_database, callback, 0, 0);
+  ASSERT_EQ(rows.size(), 10U);
+  EXPECT_EQ(rows[0]["key1"], "value1");
+  EXPECT_EQ(rows[0]["time"], "0");
+  EXPECT_EQ(rows[9]["time"], "9");
+}
+
 class FakeEventSubscriberPlugin : public EventSubscriberPlugin {
  public:
   FakeEventSubscriberPlugin(IDatabaseInterface& db)
@@ -372,9 +498,15 @@ TEST_F(EventSubscriberPluginTests, generateRowsWithOptimize) {
   EXPECT_EQ(0U, subscriber.queries_.size());
   EXPECT_EQ(10U, callback_count);
 
+  // Optimized queries resume from the data of the query running the scan.
+  registryAndPluginInit();
+  initDatabasePluginForTesting();
+  Config::get().recordQueryStart("test_query");
+
   const EventTime event_time{0U};
   const EventID event_id{0U};
-  subscriber.setOptimizeData(mocked_database, event_time, event_id);
+  subscriber.setOptimizeData(
+      mocked_database, "test_query", event_time, event_id);
 
   callback_count = 0;
   subscriber.setShouldOptimize(true);
@@ -392,5 +524,90 @@ TEST_F(EventSubscriberPluginTests, generateRowsWithOptimize) {
   subscriber.generateRows(callback, true, 0, 0);
   ASSERT_FALSE(subscriber.executedAllQueries());
   EXPECT_EQ(0U, callback_count);
+
+  Config::get().recordQueryPerformance(
+      "test_query", 0, 0, QueryResourceUsage{});
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsWithConcurrentQueries) {
+  MockedOsqueryDatabase mocked_database;
+  FakeEventSubscriberPlugin subscriber(mocked_database);
+  mocked_database.generateEvents(subscriber.getType(), subscriber.getName());
+
+  subscriber.setDatabaseNamespace();
+  subscriber.generateEventDataIndex();
+  subscriber.resetQueryCount(3);
+  subscriber.setShouldOptimize(true);
+
+  registryAndPluginInit();
+  initDatabasePluginForTesting();
+
+  // The first query is still running when a worker runs the second.
+  Config::get().recordQueryStart("first_query");
+
+  size_t second_count{0U};
+  std::thread worker([&subscriber, &second_count]() {
+    Config::get().recordQueryStart("second_query");
+    subscriber.generateRows(
+        [&second_count](Row) { ++second_count; }, true, 0, 0);
+    Config::get().recordQueryPerformance(
+        "second_query", 0, 0, QueryResourceUsage{});
+  });
+  worker.join();
+  EXPECT_EQ(10U, second_count);
+
+  // Each query resumes from its own data, not the last started query's.
+  size_t first_count{0U};
+  auto callback = [&first_count](Row) { ++first_count; };
+  subscriber.generateRows(callback, true, 0, 0);
+  EXPECT_EQ(10U, first_count);
+  EXPECT_EQ(2U, subscriber.queries_.size());
+  EXPECT_EQ(1U, mocked_database.shared_key_map.count("optimize.first_query"));
+  EXPECT_EQ(1U, mocked_database.shared_key_map.count("optimize.second_query"));
+
+  first_count = 0;
+  subscriber.generateRows(callback, true, 0, 0);
+  EXPECT_EQ(0U, first_count);
+
+  Config::get().recordQueryPerformance(
+      "first_query", 0, 0, QueryResourceUsage{});
+}
+
+TEST_F(EventSubscriberPluginTests, addBatchStreaming) {
+  MockedOsqueryDatabase mocked_database;
+  FakeEventSubscriberPlugin subscriber(mocked_database);
+  subscriber.setDatabaseNamespace();
+  subscriber.setTime(10);
+
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(R"({"subscriber": "fake", "columns": ["path"],)"
+                             R"( "where": [{"column": "uid", "value": 0}]})")
+                  .ok());
+
+  auto query = std::make_shared<EventStreamQuery>();
+  ASSERT_TRUE(EventStreamQuery::parse("root", doc.doc(), *query).ok());
+  subscriber.setStreamQueries({query});
+  ASSERT_TRUE(subscriber.isStreaming());
+
+  std::vector<EventStreamItem> items;
+  EventStream::get().pop(items, 1000, std::chrono::milliseconds(0));
+  items.clear();
+
+  std::vector<Row> rows = {{{"uid", "0"}, {"path", "/bin/sh"}},
+                           {{"uid", "1000"}, {"path", "/bin/ls"}}};
+  ASSERT_TRUE(subscriber.addBatch(rows).ok());
+
+  // Nothing is stored, only the matching row is streamed
+  EXPECT_TRUE(mocked_database.key_map.empty());
+  EXPECT_TRUE(subscriber.context.event_index.empty());
+  EXPECT_EQ(subscriber.numEvents(), 2U);
+
+  EventStream::get().pop(items, 1000, std::chrono::milliseconds(0));
+  ASSERT_EQ(items.size(), 1U);
+  EXPECT_EQ(items[0].name, "root");
+  EXPECT_EQ(items[0].row, (Row{{"path", "/bin/sh"}}));
+
+  subscriber.setStreamQueries({});
+  EXPECT_FALSE(subscriber.isStreaming());
 }
 } // namespace osquery
@@ -20,6 +20,7 @@
 #include <osquery/core/tables.h>
 
 #include "osquery/events/linux/auditdnetlink.h"
+#include "osquery/events/linux/auditeventpublisher.h"
 #include "osquery/tests/test_util.h"
 
 namespace osquery {
@@ -69,11 +70,46 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ(reply.type, audit_event_record.type);
   EXPECT_EQ("1440542781.644:403030", audit_event_record.audit_id);
   EXPECT_EQ(audit_event_record.fields.size(), 4U);
-  EXPECT_EQ(audit_event_record.fields.count("argc"), 1U);
-  EXPECT_EQ(audit_event_record.fields["argc"], "3");
-  EXPECT_EQ(audit_event_record.fields["a0"], "\"H=1 \"");
-  EXPECT_EQ(audit_event_record.fields["a1"], "\"/bin/sh\"");
-  EXPECT_EQ(audit_event_record.fields["a2"], "c");
+  EXPECT_EQ(audit_event_record.fields.key(0), AuditFieldKey::Argc);
+  EXPECT_EQ(audit_event_record.fields.at("argc"), "3");
+  EXPECT_EQ(audit_event_record.fields.at("a0"), "\"H=1 \"");
+  EXPECT_EQ(audit_event_record.fields.at("a1"), "\"/bin/sh\"");
+  EXPECT_EQ(audit_event_record.fields.at("a2"), "c");
+}
+
+TEST_F(AuditTests, test_field_list) {
+  AuditFieldList fields;
+  fields.parse("pid=12 a10=\"x y\" flag  exe=\"/bin/sh\" pid=13 msg=");
+
+  ASSERT_EQ(fields.size(), 6U);
+  EXPECT_EQ(fields.name(2), "flag");
+  EXPECT_EQ(fields.value(2), "");
+  EXPECT_EQ(fields.name(5), "msg");
+  EXPECT_EQ(fields.value(5), "");
+
+  // Known names are looked up by their interned key, others as text
+  EXPECT_EQ(fields.key(0), AuditFieldKey::Pid);
+  EXPECT_EQ(fields.key(1), AuditFieldKey::Unknown);
+  EXPECT_EQ(fields.find(AuditFieldKey::Exe), std::string_view("\"/bin/sh\""));
+  EXPECT_EQ(fields.find("a10"), std::string_view("\"x y\""));
+  EXPECT_FALSE(fields.find("a11").has_value());
+  EXPECT_THROW(fields.at("a11"), std::out_of_range);
+
+  // The first of duplicated fields is returned
+  EXPECT_EQ(fields.find("pid"), std::string_view("12"));
+
+  // Copies do not refer to the original text
+  AuditFieldList copy = fields;
+  fields.parse("pid=14");
+  EXPECT_EQ(copy.find("pid"), std::string_view("12"));
+
+  std::uint64_t pid = 0;
+  EXPECT_TRUE(GetIntegerFieldFromMap(pid, copy, "pid"));
+  EXPECT_EQ(pid, 12U);
+
+  std::string cwd;
+  EXPECT_FALSE(GetStringFieldFromMap(cwd, copy, "cwd", "none"));
+  EXPECT_EQ(cwd, "none");
 }
 
 TEST_F(AuditTests, test_audit_value_decode) {
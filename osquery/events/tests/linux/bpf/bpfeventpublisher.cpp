@@ -15,6 +15,7 @@
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/un.h>
 
 namespace osquery {
@@ -192,6 +193,98 @@ TEST_F(BPFEventPublisherTests, processCloneEvent) {
   EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
 }
 
+TEST_F(BPFEventPublisherTests, processWait4Event) {
+  auto state_tracker_ref =
+      SystemStateTracker::create(getMockedProcessContextFactory());
+
+  auto& state_tracker =
+      static_cast<SystemStateTracker&>(*state_tracker_ref.get());
+
+  // Create the child process that is going to be reaped
+  auto bpf_event = kBaseBPFEvent;
+  bpf_event.name = "fork";
+  bpf_event.header.exit_code = 1001; // child process id
+  bpf_event.header.process_id = 1000; // parent process id
+
+  auto succeeded =
+      BPFEventPublisher::processForkEvent(state_tracker, bpf_event);
+
+  EXPECT_TRUE(succeeded);
+  EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
+
+  // Calls that did not return a child process should be ignored
+  bpf_event = kBaseBPFEvent;
+  bpf_event.name = "wait4";
+  bpf_event.header.process_id = 1000;
+  bpf_event.header.exit_code = static_cast<std::uint64_t>(-1);
+
+  succeeded = BPFEventPublisher::processWait4Event(state_tracker, bpf_event);
+  EXPECT_TRUE(succeeded);
+  EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
+
+  // Processing should fail if the options parameter is missing
+  bpf_event.header.exit_code = 1001; // child process id
+
+  succeeded = BPFEventPublisher::processWait4Event(state_tracker, bpf_event);
+  EXPECT_FALSE(succeeded);
+  EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
+
+  // The child may have only been stopped; this event should be ignored
+
+  // clang-format off
+  bpf_event.in_field_map.insert(
+    {
+      "options",
+
+      {
+        "options",
+        true,
+        static_cast<std::uint64_t>(WUNTRACED)
+      }
+    }
+  );
+  // clang-format on
+
+  succeeded = BPFEventPublisher::processWait4Event(state_tracker, bpf_event);
+  EXPECT_TRUE(succeeded);
+  EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
+
+  // A tracer is notified when the child stops even without WUNTRACED; the
+  // wait status shows it is still running, so this should be ignored
+  bpf_event.in_field_map.at("options").data_var = 0ULL;
+
+  // clang-format off
+  bpf_event.out_field_map.insert(
+    {
+      "stat_addr",
+
+      {
+        "stat_addr",
+        false,
+        static_cast<std::uint64_t>((SIGTRAP << 8) | 0x7f)
+      }
+    }
+  );
+  // clang-format on
+
+  succeeded = BPFEventPublisher::processWait4Event(state_tracker, bpf_event);
+  EXPECT_TRUE(succeeded);
+  EXPECT_EQ(state_tracker.getContextCopy().process_map.size(), 3U);
+
+  // The child has been reaped, and its context should be removed
+  bpf_event.out_field_map.at("stat_addr").data_var =
+      static_cast<std::uint64_t>(1 << 8);
+
+  succeeded = BPFEventPublisher::processWait4Event(state_tracker, bpf_event);
+  EXPECT_TRUE(succeeded);
+
+  auto context = state_tracker.getContextCopy();
+  EXPECT_EQ(context.process_map.size(), 2U);
+  EXPECT_EQ(context.process_map.count(1001), 0U);
+
+  EXPECT_EQ(state_tracker.getProcessExpirationStats().reaped_processes, 1U);
+}
+
 TEST_F(BPFEventPublisherTests, processExecveEvent) {
   auto state_tracker_ref =
       SystemStateTracker::create(getMockedProcessContextFactory());
@@ -34,7 +34,8 @@ ProcessContext createProcessContext(pid_t process_id) {
   }
 
   process_context.binary_path = "/usr/bin/zsh";
-  process_context.argv = {"zsh", "-H", "-i"};
+  process_context.argv = std::make_shared<ProcessContext::ArgumentList>(
+      ProcessContext::ArgumentList{"zsh", "-H", "-i"});
   process_context.cwd = "/home/alessandro";
 
   setFileDescriptor(process_context, 0, true, "/dev/pts/1");
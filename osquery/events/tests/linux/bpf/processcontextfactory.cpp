@@ -33,10 +33,11 @@ TEST_F(ProcessContextFactoryTests, captureSingleProcess) {
   EXPECT_EQ(process_context.parent_process_id, 3616);
   EXPECT_EQ(process_context.binary_path, "/usr/bin/zsh");
 
-  ASSERT_EQ(process_context.argv.size(), 3U);
-  EXPECT_EQ(process_context.argv.at(0), "zsh");
-  EXPECT_EQ(process_context.argv.at(1), "-i");
-  EXPECT_EQ(process_context.argv.at(2), "-H");
+  ASSERT_TRUE(process_context.argv);
+  ASSERT_EQ(process_context.argv->size(), 3U);
+  EXPECT_EQ(process_context.argv->at(0), "zsh");
+  EXPECT_EQ(process_context.argv->at(1), "-i");
+  EXPECT_EQ(process_context.argv->at(2), "-H");
 
   EXPECT_EQ(process_context.cwd, "/home/alessandro");
 
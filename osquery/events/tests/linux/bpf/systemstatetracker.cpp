@@ -217,6 +217,66 @@ TEST_F(SystemStateTrackerTests, create_process) {
   EXPECT_TRUE(std::holds_alternative<std::monostate>(fork_event2.data));
 }
 
+TEST_F(SystemStateTrackerTests, fork_shares_process_state) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  auto bpf_event_header = kBaseBPFEventHeader;
+  bpf_event_header.process_id = 1001;
+
+  SystemStateTracker::Context context;
+  auto succeeded = SystemStateTracker::createProcess(
+      context,
+      *process_context_factory.get(),
+      bpf_event_header,
+      1000, // parent pid
+      bpf_event_header.process_id); // child pid
+
+  ASSERT_TRUE(succeeded);
+
+  // The child starts out with the same file descriptor table, argv and paths
+  // of the parent process, without any copy
+  {
+    const auto& parent_process = context.process_map.at(1000);
+    const auto& child_process = context.process_map.at(1001);
+
+    EXPECT_EQ(child_process.argv.get(), parent_process.argv.get());
+    EXPECT_EQ(&child_process.binary_path.str(),
+              &parent_process.binary_path.str());
+
+    EXPECT_EQ(&child_process.cwd.str(), &parent_process.cwd.str());
+    EXPECT_EQ(&child_process.fd_map.at(0), &parent_process.fd_map.at(0));
+  }
+
+  // Changing the child process must not affect the parent
+  succeeded = SystemStateTracker::closeHandle(
+      context, *process_context_factory.get(), 1001, 0);
+
+  ASSERT_TRUE(succeeded);
+
+  succeeded =
+      SystemStateTracker::setWorkingDirectory(context,
+                                              *process_context_factory.get(),
+                                              1001,
+                                              "/tmp");
+
+  ASSERT_TRUE(succeeded);
+
+  const auto& parent_process = context.process_map.at(1000);
+  const auto& child_process = context.process_map.at(1001);
+
+  EXPECT_EQ(parent_process.fd_map.size(), child_process.fd_map.size() + 1U);
+  EXPECT_EQ(parent_process.fd_map.count(0), 1U);
+  EXPECT_EQ(child_process.fd_map.count(0), 0U);
+
+  EXPECT_EQ(child_process.cwd, "/tmp");
+  EXPECT_NE(child_process.cwd, parent_process.cwd);
+
+  // Equal paths are interned into the same value
+  InternedString cwd("/tmp");
+  EXPECT_EQ(&cwd.str(), &child_process.cwd.str());
+}
+
 TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   auto bpf_event_header = kBaseBPFEventHeader;
   bpf_event_header.process_id = 1001;
@@ -258,7 +318,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   const auto& process_context = context.process_map.at(1001);
 
   EXPECT_EQ(process_context.binary_path, "/usr/bin/date");
-  EXPECT_EQ(process_context.argv, kExecArgumentList);
+  EXPECT_EQ(*process_context.argv, kExecArgumentList);
   EXPECT_EQ(process_context.fd_map.size(), 5U);
 
   // Make sure that the exec event was generated
@@ -276,7 +336,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   const auto& exec_data =
       std::get<ISystemStateTracker::Event::ExecData>(exec_event.data);
 
-  EXPECT_EQ(exec_data.argv, process_context.argv);
+  EXPECT_EQ(exec_data.argv, *process_context.argv);
 }
 
 TEST_F(SystemStateTrackerTests, execute_binary_at_cwd) {
@@ -322,7 +382,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_at_cwd) {
   const auto& process_context = context.process_map.at(1001);
 
   EXPECT_EQ(process_context.binary_path, "/usr/bin/date");
-  EXPECT_EQ(process_context.argv, kExecArgumentList);
+  EXPECT_EQ(*process_context.argv, kExecArgumentList);
   EXPECT_EQ(process_context.fd_map.size(), 5U);
 
   // Make sure that the exec event was generated
@@ -340,7 +400,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_at_cwd) {
   const auto& exec_data =
       std::get<ISystemStateTracker::Event::ExecData>(exec_event.data);
 
-  EXPECT_EQ(exec_data.argv, process_context.argv);
+  EXPECT_EQ(exec_data.argv, *process_context.argv);
 }
 
 TEST_F(SystemStateTrackerTests, execute_binary_with_fd) {
@@ -401,7 +461,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_with_fd) {
   const auto& process_context = context.process_map.at(1001);
 
   EXPECT_EQ(process_context.binary_path, "/usr/bin/date");
-  EXPECT_EQ(process_context.argv, kExecArgumentList);
+  EXPECT_EQ(*process_context.argv, kExecArgumentList);
   EXPECT_EQ(process_context.fd_map.size(), 5U);
 
   // Make sure that the exec event was generated
@@ -419,7 +479,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_with_fd) {
   const auto& exec_data =
       std::get<ISystemStateTracker::Event::ExecData>(exec_event.data);
 
-  EXPECT_EQ(exec_data.argv, process_context.argv);
+  EXPECT_EQ(exec_data.argv, *process_context.argv);
 }
 
 TEST_F(SystemStateTrackerTests, execute_binary_at_dirfd) {
@@ -481,7 +541,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_at_dirfd) {
   // The path we are expecting is: (process_context.fd_map.at(15).path) +
   // "/date"
   EXPECT_EQ(process_context.binary_path, "/usr/bin/date");
-  EXPECT_EQ(process_context.argv, kExecArgumentList);
+  EXPECT_EQ(*process_context.argv, kExecArgumentList);
   EXPECT_EQ(process_context.fd_map.size(), 5U);
 
   // Make sure that the exec event was generated
@@ -499,7 +559,7 @@ TEST_F(SystemStateTrackerTests, execute_binary_at_dirfd) {
   const auto& exec_data =
       std::get<ISystemStateTracker::Event::ExecData>(exec_event.data);
 
-  EXPECT_EQ(exec_data.argv, process_context.argv);
+  EXPECT_EQ(exec_data.argv, *process_context.argv);
 }
 
 TEST_F(SystemStateTrackerTests, set_working_directory_with_path) {
@@ -747,11 +807,11 @@ TEST_F(SystemStateTrackerTests, open_file) {
 
   EXPECT_TRUE(succeeded);
   EXPECT_EQ(process_context.fd_map.size(), 11U);
-  EXPECT_TRUE(
-      validateFileDescriptor(process_context,
-                             18,
-                             false,
-                             process_context.cwd + "/" + relative_test_path));
+  EXPECT_TRUE(validateFileDescriptor(
+      process_context,
+      18,
+      false,
+      process_context.cwd.str() + "/" + relative_test_path));
 
   EXPECT_EQ(process_context_factory->invocationCount(), 1U);
 
@@ -769,7 +829,7 @@ TEST_F(SystemStateTrackerTests, open_file) {
   validateFileDescriptor(process_context,
                          19,
                          true,
-                         process_context.cwd + "/" + relative_test_path);
+                         process_context.cwd.str() + "/" + relative_test_path);
 
   EXPECT_EQ(process_context_factory->invocationCount(), 1U);
 
@@ -1451,8 +1511,75 @@ TEST_F(SystemStateTrackerTests, expireProcessContexts) {
   MockedFilesystem mocked_filesystem;
   EXPECT_EQ(context.process_map.size(), 3U);
 
-  SystemStateTracker::expireProcessContexts(context, mocked_filesystem);
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 3U);
+  EXPECT_EQ(context.process_map.size(), 1U);
+  EXPECT_TRUE(context.expiration_queue.empty());
+
+  const auto& expiration_stats = context.expiration_stats;
+  EXPECT_EQ(expiration_stats.swept_processes, 3U);
+  EXPECT_EQ(expiration_stats.expired_processes, 2U);
+  EXPECT_EQ(expiration_stats.completed_sweeps, 1U);
+}
+
+TEST_F(SystemStateTrackerTests, expireProcessContexts_in_slices) {
+  SystemStateTracker::Context context;
+
+  for (pid_t process_id = 1000; process_id < 1010; ++process_id) {
+    context.process_map.insert({process_id, ProcessContext{}});
+  }
+
+  // Each call only checks a slice of the process map
+  MockedFilesystem mocked_filesystem;
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 4U);
+
+  const auto& expiration_stats = context.expiration_stats;
+  EXPECT_EQ(expiration_stats.swept_processes, 4U);
+  EXPECT_EQ(expiration_stats.completed_sweeps, 0U);
+  EXPECT_EQ(context.expiration_queue.size(), 6U);
+
+  // Processes reaped in the meantime are skipped without being checked
+  std::size_t reaped_count{0U};
+  for (auto process_id : context.expiration_queue) {
+    if (process_id != 1000 && process_id != 1001) {
+      SystemStateTracker::reapProcess(context, process_id);
+      ++reaped_count;
+    }
+  }
+
+  EXPECT_EQ(expiration_stats.reaped_processes, reaped_count);
+
+  // New processes are left for the next sweep
+  context.process_map.insert({1234, ProcessContext{}});
+
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 4U);
+  EXPECT_TRUE(context.expiration_queue.empty());
+  EXPECT_EQ(expiration_stats.completed_sweeps, 1U);
+  EXPECT_EQ(expiration_stats.swept_processes, 4U + 6U - reaped_count);
+
+  ASSERT_EQ(context.process_map.size(), 3U);
+  EXPECT_EQ(context.process_map.count(1000), 1U);
+  EXPECT_EQ(context.process_map.count(1001), 1U);
+  EXPECT_EQ(context.process_map.count(1234), 1U);
+
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 4U);
+  EXPECT_EQ(context.process_map.size(), 2U);
+  EXPECT_EQ(expiration_stats.completed_sweeps, 2U);
+}
+
+TEST_F(SystemStateTrackerTests, reapProcess) {
+  SystemStateTracker::Context context;
+  context.process_map.insert({1000, ProcessContext{}});
+  context.process_map.insert({1001, ProcessContext{}});
+
+  // Reaping an untracked process is not an error
+  EXPECT_TRUE(SystemStateTracker::reapProcess(context, 1002));
+  EXPECT_EQ(context.process_map.size(), 2U);
+  EXPECT_EQ(context.expiration_stats.reaped_processes, 0U);
+
+  EXPECT_TRUE(SystemStateTracker::reapProcess(context, 1001));
   EXPECT_EQ(context.process_map.size(), 1U);
+  EXPECT_EQ(context.process_map.count(1001), 0U);
+  EXPECT_EQ(context.expiration_stats.reaped_processes, 1U);
 }
 
 TEST_F(SystemStateTrackerTests, parseSocketAddress) {
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <osquery/events/linux/spsc_ring.h>
+
+namespace osquery {
+
+class SPSCRingTests : public testing::Test {};
+
+TEST_F(SPSCRingTests, test_capacity) {
+  SPSCRing<int> ring(1000);
+  EXPECT_EQ(ring.capacity(), 1024U);
+  EXPECT_EQ(ring.size(), 0U);
+
+  SPSCRing<int> small(1);
+  EXPECT_EQ(small.capacity(), 1U);
+}
+
+TEST_F(SPSCRingTests, test_full_and_empty) {
+  SPSCRing<int> ring(4);
+  EXPECT_EQ(ring.front(), nullptr);
+
+  for (int i = 0; i < 4; i++) {
+    auto slot = ring.claim();
+    ASSERT_NE(slot, nullptr);
+    *slot = i;
+    ring.publish();
+  }
+  EXPECT_EQ(ring.size(), 4U);
+
+  // The ring is full, the producer is told so and the stall is counted.
+  EXPECT_EQ(ring.claim(), nullptr);
+  EXPECT_EQ(ring.stalls(), 1U);
+
+  for (int i = 0; i < 4; i++) {
+    auto slot = ring.front();
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(*slot, i);
+    ring.pop();
+  }
+  EXPECT_EQ(ring.front(), nullptr);
+  EXPECT_EQ(ring.size(), 0U);
+
+  // Released slots are reused.
+  ASSERT_NE(ring.claim(), nullptr);
+}
+
+TEST_F(SPSCRingTests, test_wait_timeouts) {
+  SPSCRing<int> ring(1);
+  EXPECT_FALSE(ring.waitForData(std::chrono::milliseconds(10)));
+  EXPECT_TRUE(ring.waitForSpace(std::chrono::milliseconds(10)));
+
+  ring.claim();
+  ring.publish();
+  EXPECT_TRUE(ring.waitForData(std::chrono::milliseconds(10)));
+  EXPECT_FALSE(ring.waitForSpace(std::chrono::milliseconds(10)));
+}
+
+TEST_F(SPSCRingTests, test_wake_all) {
+  SPSCRing<int> ring(1);
+
+  // A consumer waiting on an empty ring returns early once woken up.
+  auto start = std::chrono::steady_clock::now();
+  std::thread consumer(
+      [&ring]() { ring.waitForData(std::chrono::milliseconds(5000)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ring.wakeAll();
+  consumer.join();
+
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(5000));
+}
+
+TEST_F(SPSCRingTests, test_ordering_across_threads) {
+  const std::uint64_t kItems = 200000;
+  SPSCRing<std::uint64_t> ring(64);
+
+  std::thread producer([&ring, kItems]() {
+    for (std::uint64_t i = 0; i < kItems; i++) {
+      std::uint64_t* slot = nullptr;
+      while ((slot = ring.claim()) == nullptr) {
+        ring.waitForSpace(std::chrono::milliseconds(100));
+      }
+      *slot = i;
+      ring.publish();
+    }
+  });
+
+  std::uint64_t expected = 0;
+  bool ordered = true;
+  while (expected < kItems) {
+    auto slot = ring.front();
+    if (slot == nullptr) {
+      ring.waitForData(std::chrono::milliseconds(100));
+      continue;
+    }
+
+    ordered = ordered && *slot == expected;
+    expected++;
+    ring.pop();
+  }
+  producer.join();
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(expected, kItems);
+  EXPECT_EQ(ring.size(), 0U);
+}
+
+} // namespace osquery
@@ -10,6 +10,7 @@
 #include <osquery/events/eventsubscriber.h>
 
 #include "mockedosquerydatabase.h"
+#include "osquery/core/sql/binary_rows.h"
 #include "osquery/core/sql/row.h"
 
 namespace osquery {
@@ -26,10 +27,10 @@ const Row kBaseRow = {
 } // namespace
 
 extern const std::string kEvents;
-extern const std::string kExecutingQuery;
 
 void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
-                                           const std::string& name) {
+                                           const std::string& name,
+                                           bool binary_rows) {
   EventSubscriberPlugin::Context context;
   EventSubscriberPlugin::setDatabaseNamespace(context, publisher, name);
 
@@ -43,53 +44,64 @@ void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
     row.insert({"eid", std::to_string(event_id)});
 
     std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
+    Status status;
+    if (binary_rows) {
+      status =
+          serializeRowBinary(row, context.column_dictionary, serialized_row);
+    } else {
+      status = serializeRowJSON(row, serialized_row);
+    }
+
     if (!status.ok()) {
       throw std::runtime_error(
           "MockedOsqueryDatabase: Failed to serialize the row");
     }
 
-    auto key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    auto key = EventSubscriberPlugin::databaseKeyForEvent(i, event_id);
     key_map.insert({key, std::move(serialized_row)});
 
     // this value can't be deserialized and should be skipped
     event_id = EventSubscriberPlugin::generateEventIdentifier(context);
-    key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    key = EventSubscriberPlugin::databaseKeyForEvent(i, event_id);
     key_map.insert({key, "broken_serialized_value"});
   }
-}
 
-Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
-                                               const std::string& key,
-                                               std::string& value) const {
-  value = {};
+  if (binary_rows) {
+    std::string serialized_columns;
+    serializeColumnDictionary(context.column_dictionary, serialized_columns);
+    shared_key_map.insert(
+        {EventSubscriberPlugin::databaseKeyForColumns(context),
+         std::move(serialized_columns)});
+  }
+}
 
+std::map<std::string, std::string>& MockedOsqueryDatabase::getKeyMap(
+    const std::string& domain) const {
   if (domain == kEvents) {
-    auto key_it = key_map.find(key);
-    if (key_it == key_map.end()) {
-      throw std::logic_error(
-          "MockedOsqueryDatabase: Invalid key passed to getDatabaseValue: " +
-          key);
-    }
+    return shared_key_map;
 
-    value = key_it->second;
-    return Status::success();
+  } else if (isEventsDomain(domain)) {
+    return key_map;
 
-  } else if (domain == kPersistentSettings) {
-    if (key != kExecutingQuery) {
-      throw std::logic_error(
-          "MockedOsqueryDatabase: Invalid key passed to getDatabaseValue: " +
-          key);
-    }
+  } else {
+    throw std::logic_error("MockedOsqueryDatabase: Invalid domain: " + domain);
+  }
+}
 
-    value = "test_query";
-    return Status::success();
+Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
+                                               const std::string& key,
+                                               std::string& value) const {
+  value = {};
 
-  } else {
-    throw std::logic_error(
-        "MockedOsqueryDatabase: Invalid domain passed to getDatabaseValue: " +
-        domain);
+  // Like the database, missing keys are not an error.
+  const auto& domain_key_map = getKeyMap(domain);
+  auto key_it = domain_key_map.find(key);
+  if (key_it == domain_key_map.end()) {
+    return Status::failure("MockedOsqueryDatabase: Key not found: " + key);
   }
+
+  value = key_it->second;
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
@@ -99,6 +111,31 @@ Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
       "MockedOsqueryDatabase: Unsupported getDatabaseValue call");
 }
 
+Status MockedOsqueryDatabase::getDatabaseRange(const std::string& domain,
+                                               const std::string& low,
+                                               const std::string& high,
+                                               DatabaseStringValueList& values,
+                                               size_t max) const {
+  if (low > high) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid parameter passed to "
+        "getDatabaseRange");
+  }
+
+  ++range_read_count;
+
+  const auto& domain_key_map = getKeyMap(domain);
+  auto last = domain_key_map.upper_bound(high);
+  for (auto it = domain_key_map.lower_bound(low); it != last; ++it) {
+    values.push_back(*it);
+    if (max != 0 && values.size() >= max) {
+      break;
+    }
+  }
+
+  return Status::success();
+}
+
 Status MockedOsqueryDatabase::setDatabaseValue(const std::string& domain,
                                                const std::string& key,
                                                const std::string& value) const {
@@ -108,13 +145,13 @@ Status MockedOsqueryDatabase::setDatabaseValue(const std::string& domain,
         domain);
   }
 
-  if (key != "optimize.test_query" && key != "optimize_eid.test_query") {
+  if (key.find("optimize.") != 0 && key.find("optimize_eid.") != 0) {
     throw std::logic_error(
         "MockedOsqueryDatabase: Invalid key passed to setDatabaseValue: " +
         key);
   }
 
-  key_map[key] = value;
+  shared_key_map[key] = value;
   return Status::success();
 }
 
@@ -133,21 +170,24 @@ Status MockedOsqueryDatabase::setDatabaseBatch(
 
 Status MockedOsqueryDatabase::deleteDatabaseValue(
     const std::string& domain, const std::string& key) const {
-  if (domain != kEvents) {
-    throw std::logic_error(
-        "MockedOsqueryDatabase: Invalid domain passed to "
-        "deleteDatabaseValue: " +
-        domain);
-  }
-
-  auto key_it = key_map.find(key);
-  if (key_it == key_map.end()) {
+  auto& domain_key_map = getKeyMap(domain);
+  auto key_it = domain_key_map.find(key);
+  if (key_it == domain_key_map.end()) {
     throw std::logic_error(
         "MockedOsqueryDatabase: Invalid key passed to deleteDatabaseValue: " +
         key);
   }
 
-  key_map.erase(key_it);
+  domain_key_map.erase(key_it);
+  return Status::success();
+}
+
+Status MockedOsqueryDatabase::deleteDatabaseBatch(
+    const std::string& domain, const std::vector<std::string>& keys) const {
+  for (const auto& key : keys) {
+    deleteDatabaseValue(domain, key);
+  }
+
   return Status::success();
 }
 
@@ -155,8 +195,16 @@ Status MockedOsqueryDatabase::deleteDatabaseRange(
     const std::string& domain,
     const std::string& low,
     const std::string& high) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported deleteDatabaseRange call");
+  if (low > high) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid parameter passed to "
+        "deleteDatabaseRange");
+  }
+
+  auto& domain_key_map = getKeyMap(domain);
+  domain_key_map.erase(domain_key_map.lower_bound(low),
+                       domain_key_map.upper_bound(high));
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
@@ -172,14 +220,14 @@ Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
                                                size_t max) const {
   keys = {};
 
-  if (max != 0 || domain != kEvents) {
+  if (max != 0) {
     throw std::logic_error(
         "MockedOsqueryDatabase: Invalid parameter passed to scanDatabaseKeys. "
         "max=" +
         std::to_string(max) + " domain:" + domain);
   }
 
-  for (const auto& p : key_map) {
+  for (const auto& p : getKeyMap(domain)) {
     const auto& current_key = p.first;
 
     if (current_key.find(prefix) == 0) {
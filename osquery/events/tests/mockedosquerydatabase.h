@@ -15,12 +15,20 @@ namespace osquery {
 
 class MockedOsqueryDatabase final : public IDatabaseInterface {
  public:
+  /// The keys of the subscriber's events domain.
   mutable std::map<std::string, std::string> key_map;
 
+  /// The keys of the shared events domain, such as the optimization data.
+  mutable std::map<std::string, std::string> shared_key_map;
+
+  mutable std::size_t range_read_count{0U};
+
   MockedOsqueryDatabase() = default;
   virtual ~MockedOsqueryDatabase() override = default;
 
-  void generateEvents(const std::string& publisher, const std::string& name);
+  void generateEvents(const std::string& publisher,
+                      const std::string& name,
+                      bool binary_rows = false);
 
   virtual Status getDatabaseValue(const std::string& domain,
                                   const std::string& key,
@@ -30,6 +38,12 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   const std::string& key,
                                   int& value) const override;
 
+  virtual Status getDatabaseRange(const std::string& domain,
+                                  const std::string& low,
+                                  const std::string& high,
+                                  DatabaseStringValueList& values,
+                                  size_t max) const override;
+
   virtual Status setDatabaseValue(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) const override;
@@ -45,6 +59,10 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
   virtual Status deleteDatabaseValue(const std::string& domain,
                                      const std::string& key) const override;
 
+  virtual Status deleteDatabaseBatch(
+      const std::string& domain,
+      const std::vector<std::string>& keys) const override;
+
   virtual Status deleteDatabaseRange(const std::string& domain,
                                      const std::string& low,
                                      const std::string& high) const override;
@@ -57,6 +75,10 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   std::vector<std::string>& keys,
                                   const std::string& prefix,
                                   size_t max) const override;
+
+ private:
+  std::map<std::string, std::string>& getKeyMap(
+      const std::string& domain) const;
 };
 
 } // namespace osquery
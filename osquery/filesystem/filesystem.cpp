@@ -16,9 +16,15 @@
 #ifndef WIN32
 #include <glob.h>
 #include <pwd.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #endif
 
+#ifdef __linux__
+#include <linux/magic.h>
+#include <sys/vfs.h>
+#endif
+
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -28,11 +34,15 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
+#ifndef WIN32
+#include <osquery/filesystem/posix/directory_walker.h>
+#endif
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
 #if WIN32
 #include <osquery/utils/conversions/windows/strings.h>
 #endif
+#include <osquery/utils/scope_guard.h>
 #include <osquery/utils/system/system.h>
 
 #include <osquery/utils/json/json.h>
@@ -48,8 +58,21 @@ FLAG(uint64, read_max, 50 * 1024 * 1024, "Maximum file read size");
 /// See reference #1382 for reasons why someone would allow unsafe.
 HIDDEN_FLAG(bool, allow_unsafe, false, "Allow unsafe executable permissions");
 
+FLAG(uint64,
+     glob_walk_threads,
+     1,
+     "Threads walking the subdirectories of a recursive file pattern");
+
+FLAG(bool,
+     read_mmap,
+     false,
+     "Map regular files into memory to read them, instead of copying them");
+
 static const size_t kMaxRecursiveGlobs = 64;
 
+/// Smaller files are cheaper to read than to map.
+static const off_t kMinMappedFileSize = 64 * 1024;
+
 Status writeTextFile(const fs::path& path,
                      const std::string& content,
                      int permissions,
@@ -107,11 +130,51 @@ void initializeFilesystemAPILocale() {
 #endif
 }
 
+#ifndef WIN32
+/**
+ * @brief Hand a regular file to the callback as a single mapped block.
+ *
+ * Only files backed by storage are mapped, never pseudo-filesystem attributes
+ * that may map device memory. Returns false, without calling back, when the
+ * file is not mapped.
+ */
+static bool readMappedFile(const PlatformFile& file,
+                           off_t size,
+                           const FileBlockCallback& callback) {
+  struct stat file_stat;
+  if (::fstat(file.nativeHandle(), &file_stat) < 0 ||
+      !S_ISREG(file_stat.st_mode)) {
+    return false;
+  }
+
+#ifdef __linux__
+  struct statfs fs_stat;
+  if (::fstatfs(file.nativeHandle(), &fs_stat) < 0 ||
+      fs_stat.f_type == SYSFS_MAGIC || fs_stat.f_type == PROC_SUPER_MAGIC ||
+      fs_stat.f_type == DEBUGFS_MAGIC) {
+    return false;
+  }
+#endif
+
+  auto data =
+      ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.nativeHandle(), 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  auto const unmap_guard =
+      scope_guard::create([data, size]() { ::munmap(data, size); });
+  ::madvise(data, size, MADV_SEQUENTIAL);
+  callback(std::string_view(static_cast<const char*>(data), size));
+  return true;
+}
+#endif
+
 Status readFile(const fs::path& path,
                 size_t size,
-                size_t block_size,
+                std::vector<char>& buffer,
                 bool dry_run,
-                std::function<void(std::string& buffer, size_t size)> predicate,
+                const FileBlockCallback& callback,
                 bool blocking,
                 bool log) {
   OpenReadableFile handle(path, blocking);
@@ -156,12 +219,13 @@ Status readFile(const fs::path& path,
   off_t total_bytes = 0;
   if (handle.blocking_io || handle.fd->isSpecialFile()) {
     // Reset block size to a sane minimum.
-    block_size = (block_size < 4096) ? 4096 : block_size;
+    if (buffer.size() < 4096) {
+      buffer.resize(4096);
+    }
     ssize_t part_bytes = 0;
     bool overflow = false;
     do {
-      std::string part(block_size, '\0');
-      part_bytes = handle.fd->read(&part[0], block_size);
+      part_bytes = handle.fd->read(buffer.data(), buffer.size());
       if (part_bytes > 0) {
         total_bytes += static_cast<off_t>(part_bytes);
         if (total_bytes >= read_max) {
@@ -171,23 +235,57 @@ Status readFile(const fs::path& path,
           overflow = true;
           part_bytes -= (total_bytes - file_size);
         }
-        predicate(part, part_bytes);
+        callback(std::string_view(buffer.data(), part_bytes));
       }
     } while (part_bytes > 0 && !overflow);
-  } else {
-    std::string content(file_size, '\0');
-    do {
-      auto part_bytes =
-          handle.fd->read(&content[total_bytes], file_size - total_bytes);
-      if (part_bytes > 0) {
-        total_bytes += static_cast<off_t>(part_bytes);
-      }
-    } while (handle.fd->hasPendingIo());
-    predicate(content, file_size);
+    return Status::success();
+  }
+
+#ifndef WIN32
+  if (FLAGS_read_mmap && file_size >= kMinMappedFileSize &&
+      readMappedFile(*handle.fd, file_size, callback)) {
+    return Status::success();
   }
+#endif
+
+  if (buffer.size() < static_cast<size_t>(file_size)) {
+    buffer.resize(file_size);
+  }
+  do {
+    auto part_bytes =
+        handle.fd->read(buffer.data() + total_bytes, file_size - total_bytes);
+    if (part_bytes > 0) {
+      total_bytes += static_cast<off_t>(part_bytes);
+    }
+  } while (handle.fd->hasPendingIo());
+
+  // A short read leaves the rest of the block zeroed, as a fresh buffer was.
+  std::fill(buffer.begin() + total_bytes, buffer.begin() + file_size, '\0');
+  callback(std::string_view(buffer.data(), file_size));
 
   return Status::success();
-} // namespace osquery
+}
+
+Status readFile(const fs::path& path,
+                size_t size,
+                size_t block_size,
+                bool dry_run,
+                std::function<void(std::string& buffer, size_t size)> predicate,
+                bool blocking,
+                bool log) {
+  std::vector<char> buffer(block_size);
+  std::string part;
+  return readFile(path,
+                  size,
+                  buffer,
+                  dry_run,
+                  ([&part, &predicate](std::string_view block) {
+                    part.assign(block.data(), block.size());
+                    predicate(part, block.size());
+                  }),
+                  blocking,
+                  log);
+}
 
 Status readFile(const fs::path& path,
                 std::string& content,
@@ -195,16 +293,13 @@ Status readFile(const fs::path& path,
                 bool dry_run,
                 bool blocking,
                 bool log) {
+  std::vector<char> buffer;
   return readFile(path,
                   size,
-                  4096,
+                  buffer,
                   dry_run,
-                  ([&content](std::string& buffer, size_t _size) {
-                    if (buffer.size() == _size) {
-                      content += std::move(buffer);
-                    } else {
-                      content += buffer.substr(0, _size);
-                    }
+                  ([&content](std::string_view block) {
+                    content.append(block.data(), block.size());
                   }),
                   blocking,
                   log);
@@ -307,16 +402,65 @@ static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   return false;
 }
 
+/// Glob characters that platformGlob expands in the base of a pattern.
+static const std::string kGlobCharacters{"*?[]{}~\\"};
+
+#ifndef WIN32
+/**
+ * @brief Walk the directories matched by the base of a "base/**" pattern.
+ *
+ * Each matched directory is read once by the walker, down to the depth the
+ * iterative globbing would have reached.
+ */
+static void walkRecursiveGlob(
+    const std::string& base,
+    std::vector<std::string>& results,
+    const std::vector<std::string>& exclude_prefixes) {
+  std::vector<std::string> roots;
+  if (base.find_first_of(kGlobCharacters) != std::string::npos) {
+    // The base ends with a '/', only directories match it.
+    roots = platformGlob(base);
+  } else if (isDirectory(base).ok()) {
+    roots.push_back(base);
+  }
+
+  DirectoryWalkerOptions options;
+  options.max_depth = kMaxRecursiveGlobs - 1;
+  options.exclude_prefixes = exclude_prefixes;
+  options.threads = std::max<size_t>(1, FLAGS_glob_walk_threads);
+
+  for (const auto& root : roots) {
+    walkDirectory(root,
+                  options,
+                  [&results](const std::string& path, bool /* is_directory */) {
+                    results.push_back(path);
+                  });
+  }
+}
+#endif
+
 static void genGlobs(std::string path,
                      std::vector<std::string>& results,
-                     GlobLimits limits) {
+                     GlobLimits limits,
+                     const std::vector<std::string>& exclude_prefixes) {
   // Use our helped escape/replace for wildcards.
   replaceGlobWildcards(path, limits);
+
+  // A trailing double star is resolved in a single walk.
+  bool walked = false;
+#ifndef WIN32
+  if (path.size() >= 3 && path.compare(path.size() - 3, 3, "/**") == 0) {
+    walkRecursiveGlob(
+        path.substr(0, path.size() - 2), results, exclude_prefixes);
+    walked = true;
+  }
+#endif
+
   // inodes of directory symlinks for loop detection
   std::set<int> dsym_inos;
 
   // Generate a glob set and recurse for double star.
-  for (size_t glob_index = 0; ++glob_index < kMaxRecursiveGlobs;) {
+  for (size_t glob_index = 0; !walked && ++glob_index < kMaxRecursiveGlobs;) {
     auto glob_results = platformGlob(path);
 
     for (auto& result_path : glob_results) {
@@ -359,7 +503,30 @@ Status resolveFilePattern(const fs::path& fs_path,
 Status resolveFilePattern(const fs::path& fs_path,
                           std::vector<std::string>& results,
                           GlobLimits setting) {
-  genGlobs(fs_path.string(), results, setting);
+  genGlobs(fs_path.string(), results, setting, {});
+  return Status::success();
+}
+
+Status resolveFilePattern(const fs::path& fs_path,
+                          std::vector<std::string>& results,
+                          GlobLimits setting,
+                          const std::vector<std::string>& exclude_patterns) {
+  // Only the patterns excluding a whole directory tree can prune the walk.
+  std::vector<std::string> exclude_prefixes;
+  for (auto pattern : exclude_patterns) {
+    replaceGlobWildcards(pattern, setting);
+    if (pattern.size() < 3 ||
+        pattern.compare(pattern.size() - 3, 3, "/**") != 0) {
+      continue;
+    }
+
+    pattern.resize(pattern.size() - 2);
+    if (pattern.find_first_of(kGlobCharacters) == std::string::npos) {
+      exclude_prefixes.push_back(std::move(pattern));
+    }
+  }
+
+  genGlobs(fs_path.string(), results, setting, exclude_prefixes);
   return Status::success();
 }
 
@@ -417,7 +584,7 @@ inline Status listInAbsoluteDirectory(const fs::path& path,
     return Status(1, "Path not a directory: " + path.parent_path().string());
   }
 
-  genGlobs(path.string(), results, limits);
+  genGlobs(path.string(), results, limits, {});
   return Status::success();
 }
 
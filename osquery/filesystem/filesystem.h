@@ -11,9 +11,11 @@
 
 #include <osquery/filesystem/fileops.h>
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
@@ -86,6 +88,38 @@ Status readFile(const boost::filesystem::path& path,
                 bool blocking = false,
                 bool log = true);
 
+/// Called with each block of a file read, only valid during the call.
+using FileBlockCallback = std::function<void(std::string_view block)>;
+
+/**
+ * @brief Read a file from disk, block by block, into a reusable buffer.
+ *
+ * Special files and blocking reads are read in blocks of the buffer's size,
+ * at least 4096 bytes. Regular files are read whole, the buffer growing to
+ * the file size if needed, or mapped into memory when --read_mmap is set.
+ * The buffer is only ever grown, a caller reading many files should keep it
+ * between reads rather than allocating for each file.
+ *
+ * The other readFile overloads are wrappers around this one.
+ *
+ * @param path the path of the file that you would like to read.
+ * @param size Number of bytes to read from file, 0 for the whole file.
+ * @param buffer the reusable buffer the blocks are read into.
+ * @param dry_run do not actually read the file content.
+ * @param callback called with each block read.
+ * @param blocking Request a blocking read.
+ * @param log emit log messages using default logger for read size errors.
+ *
+ * @return an instance of Status, indicating success or failure.
+ */
+Status readFile(const boost::filesystem::path& path,
+                size_t size,
+                std::vector<char>& buffer,
+                bool dry_run,
+                const FileBlockCallback& callback,
+                bool blocking = false,
+                bool log = true);
+
 /**
  * @brief Write text to disk.
  *
@@ -200,6 +234,27 @@ Status resolveFilePattern(const boost::filesystem::path& pattern,
                           std::vector<std::string>& results,
                           GlobLimits setting);
 
+/**
+ * @brief Given a filesystem globbing patten, resolve all matching paths.
+ *
+ * See resolveFilePattern, but a recursive pattern does not walk into the
+ * directories whose whole tree is excluded, i.e., by an exclude pattern ending
+ * with '%%' without any other wildcard. The excluded directories are still
+ * returned, as are the matches of other exclude patterns, which the caller
+ * filters as before.
+ *
+ * @param pattern filesystem globbing pattern.
+ * @param results output vector of matching paths.
+ * @param setting a bit list of match types, e.g., files, folders.
+ * @param exclude_patterns the globbing patterns excluded from the results.
+ *
+ * @return an instance of Status, indicating success or failure.
+ */
+Status resolveFilePattern(const boost::filesystem::path& pattern,
+                          std::vector<std::string>& results,
+                          GlobLimits setting,
+                          const std::vector<std::string>& exclude_patterns);
+
 /**
  * @brief Transform a path with SQL wildcards to globbing wildcard.
  *
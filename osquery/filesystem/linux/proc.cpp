@@ -7,9 +7,15 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem/filesystem.h>
@@ -24,19 +30,113 @@ const std::vector<std::string> kUserNamespaceList = {
 constexpr std::uint64_t kStatmElementsCount = 7;
 constexpr std::uint64_t kMemoryPageSize = 4096;
 
-Status procGetNamespaceInode(ino_t& inode,
-                             const std::string& namespace_name,
-                             const std::string& process_namespace_root) {
-  inode = 0;
+/// The chunk size used to read /proc files of any size.
+constexpr size_t kProcReadChunkSize = 4096;
 
-  auto path = process_namespace_root + "/" + namespace_name;
+namespace {
 
-  char link_destination[PATH_MAX] = {};
-  auto link_dest_length = readlink(path.data(), link_destination, PATH_MAX - 1);
-  if (link_dest_length < 0) {
-    return Status(1, "Failed to retrieve the inode for namespace " + path);
+inline bool isBlank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+/// Find the next space-separated field, return false at the end.
+bool nextField(const char*& pos,
+               const char* end,
+               const char*& field,
+               size_t& length) {
+  while (pos < end && (isBlank(*pos) || *pos == '\n')) {
+    pos++;
+  }
+
+  field = pos;
+  while (pos < end && !isBlank(*pos) && *pos != '\n') {
+    pos++;
+  }
+  length = static_cast<size_t>(pos - field);
+  return length > 0;
+}
+
+/// Parse a whole field as a decimal number.
+bool parseNumber(const char* field, size_t length, long long& value) {
+  if (length == 0) {
+    return false;
+  }
+
+  bool negative = (field[0] == '-');
+  size_t i = negative ? 1 : 0;
+  if (i == length) {
+    return false;
+  }
+
+  unsigned long long result = 0;
+  for (; i < length; ++i) {
+    if (field[i] < '0' || field[i] > '9') {
+      return false;
+    }
+    result = result * 10 + static_cast<unsigned long long>(field[i] - '0');
+  }
+
+  value = negative ? -static_cast<long long>(result)
+                   : static_cast<long long>(result);
+  return true;
+}
+
+/// Parse the numbers following a status or io key, return how many were read.
+size_t parseNumbers(const char* pos,
+                    const char* end,
+                    long long* values,
+                    size_t count) {
+  size_t parsed = 0;
+  const char* field = nullptr;
+  size_t length = 0;
+  while (parsed < count && nextField(pos, end, field, length) &&
+         parseNumber(field, length, values[parsed])) {
+    parsed++;
+  }
+  return parsed;
+}
+
+/// Compare a key of a 'Key: Value' line.
+inline bool isKey(const char* key, size_t length, const char* expected) {
+  return std::strlen(expected) == length &&
+         std::memcmp(key, expected, length) == 0;
+}
+
+/**
+ * @brief Call a predicate with the key and value bounds of each line.
+ *
+ * Lines are formatted 'Key: Value', the value starts after the blanks
+ * following the colon.
+ */
+template <typename Predicate>
+void forEachKeyValue(const char* content, size_t size, Predicate predicate) {
+  const char* pos = content;
+  const char* end = content + size;
+  while (pos < end) {
+    auto line_end =
+        static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+
+    auto colon =
+        static_cast<const char*>(std::memchr(pos, ':', line_end - pos));
+    if (colon != nullptr) {
+      auto value = colon + 1;
+      while (value < line_end && isBlank(*value)) {
+        value++;
+      }
+      predicate(pos, static_cast<size_t>(colon - pos), value, line_end);
+    }
+    pos = line_end + 1;
   }
+}
 
+/// Parse the inode in the destination of the namespace link at path.
+Status parseNamespaceLink(const char* link_destination,
+                          const std::string& namespace_name,
+                          const std::string& path,
+                          ino_t& inode) {
   // The link destination must be in the following form: namespace:[inode]
   if (std::strncmp(link_destination,
                    namespace_name.data(),
@@ -60,6 +160,24 @@ Status procGetNamespaceInode(ino_t& inode,
   return Status::success();
 }
 
+} // namespace
+
+Status procGetNamespaceInode(ino_t& inode,
+                             const std::string& namespace_name,
+                             const std::string& process_namespace_root) {
+  inode = 0;
+
+  auto path = process_namespace_root + "/" + namespace_name;
+
+  char link_destination[PATH_MAX] = {};
+  auto link_dest_length = readlink(path.data(), link_destination, PATH_MAX - 1);
+  if (link_dest_length < 0) {
+    return Status(1, "Failed to retrieve the inode for namespace " + path);
+  }
+
+  return parseNamespaceLink(link_destination, namespace_name, path, inode);
+}
+
 Status procGetProcessNamespaces(const std::string& process_id,
                                 ProcessNamespaceList& namespace_list,
                                 std::vector<std::string> namespaces) {
@@ -85,6 +203,37 @@ Status procGetProcessNamespaces(const std::string& process_id,
   return Status::success();
 }
 
+Status procGetProcessNamespaces(const ProcDirectory& process,
+                                ProcessNamespaceList& namespace_list,
+                                std::vector<std::string> namespaces) {
+  namespace_list.clear();
+
+  if (namespaces.empty()) {
+    namespaces = kUserNamespaceList;
+  }
+
+  std::string link_destination;
+  for (const auto& namespace_name : namespaces) {
+    auto name = "ns/" + namespace_name;
+    if (!process.readLink(name.c_str(), link_destination).ok()) {
+      continue;
+    }
+
+    ino_t namespace_inode{0};
+    auto status = parseNamespaceLink(link_destination.c_str(),
+                                     namespace_name,
+                                     "/proc/" + process.pid() + "/" + name,
+                                     namespace_inode);
+    if (!status.ok()) {
+      continue;
+    }
+
+    namespace_list[namespace_name] = namespace_inode;
+  }
+
+  return Status::success();
+}
+
 std::string procDecodeAddressFromHex(const std::string& encoded_address,
                                      int family) {
   char addr_buffer[INET6_ADDRSTRLEN] = {0};
@@ -399,6 +548,243 @@ Status procReadDescriptor(const std::string& process,
   }
 }
 
+ProcDirectory::ProcDirectory(const std::string& pid) : pid_(pid) {
+  // Only numeric names refer to processes, this also refuses relative paths.
+  if (pid.empty() ||
+      !std::all_of(pid.begin(), pid.end(), [](char c) { return isdigit(c); })) {
+    return;
+  }
+
+  auto path = kLinuxProcPath + "/" + pid;
+  fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+ProcDirectory::~ProcDirectory() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+ssize_t ProcDirectory::read(const char* name, char* buffer, size_t size) const {
+  if (fd_ < 0 || size == 0) {
+    return -1;
+  }
+
+  int fd = ::openat(fd_, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  size_t total = 0;
+  while (total < size - 1) {
+    auto bytes = ::read(fd, buffer + total, size - 1 - total);
+    if (bytes < 0) {
+      ::close(fd);
+      return -1;
+    } else if (bytes == 0) {
+      break;
+    }
+    total += static_cast<size_t>(bytes);
+  }
+  ::close(fd);
+
+  buffer[total] = '\0';
+  return static_cast<ssize_t>(total);
+}
+
+Status ProcDirectory::read(const char* name, std::string& content) const {
+  content.clear();
+  if (fd_ < 0) {
+    return Status::failure("Cannot open /proc/" + pid_);
+  }
+
+  int fd = ::openat(fd_, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open /proc/" + pid_ + "/" + name);
+  }
+
+  char buffer[kProcReadChunkSize];
+  ssize_t bytes = 0;
+  while ((bytes = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    content.append(buffer, static_cast<size_t>(bytes));
+  }
+  ::close(fd);
+
+  if (bytes < 0) {
+    return Status::failure("Cannot read /proc/" + pid_ + "/" + name);
+  }
+  return Status::success();
+}
+
+Status ProcDirectory::readLink(const char* name, std::string& target) const {
+  target.clear();
+  if (fd_ < 0) {
+    return Status::failure("Cannot open /proc/" + pid_);
+  }
+
+  char buffer[PATH_MAX];
+  auto size = ::readlinkat(fd_, name, buffer, sizeof(buffer) - 1);
+  if (size < 0) {
+    return Status::failure("Cannot read link /proc/" + pid_ + "/" + name);
+  }
+
+  target.assign(buffer, static_cast<size_t>(size));
+  return Status::success();
+}
+
+Status procParseStat(const char* content, size_t size, ProcStat& stat) {
+  // The comm is wrapped in parentheses and may contain any character, the
+  // fields start after the last closing parenthesis.
+  const char* end = content + size;
+  const char* pos = end;
+  while (pos > content && *(pos - 1) != ')') {
+    pos--;
+  }
+  if (pos == content) {
+    return Status::failure("Invalid /proc/stat header");
+  }
+
+  // Fields are numbered from the state, after the pid and comm.
+  const char* field = nullptr;
+  size_t length = 0;
+  long long value = 0;
+  for (size_t index = 0; index <= 19; ++index) {
+    if (!nextField(pos, end, field, length)) {
+      return Status::failure("Invalid /proc/stat content");
+    }
+
+    if (index == 0) {
+      stat.state = field[0];
+      continue;
+    }
+
+    if (index != 1 && index != 2 && index != 11 && index != 12 &&
+        index != 16 && index != 17 && index != 19) {
+      continue;
+    }
+
+    if (!parseNumber(field, length, value)) {
+      return Status::failure("Invalid /proc/stat field");
+    }
+
+    if (index == 1) {
+      stat.parent = value;
+    } else if (index == 2) {
+      stat.group = value;
+    } else if (index == 11) {
+      stat.user_time = static_cast<unsigned long long>(value);
+    } else if (index == 12) {
+      stat.system_time = static_cast<unsigned long long>(value);
+    } else if (index == 16) {
+      stat.nice = value;
+    } else if (index == 17) {
+      stat.threads = value;
+    } else {
+      stat.start_time = static_cast<unsigned long long>(value);
+    }
+  }
+  return Status::success();
+}
+
+Status procParseStatus(const char* content, size_t size, ProcStatus& status) {
+  bool has_name = false;
+  forEachKeyValue(
+      content,
+      size,
+      [&status, &has_name](
+          const char* key, size_t length, const char* value, const char* end) {
+        if (isKey(key, length, "Name")) {
+          auto value_end = end;
+          while (value_end > value && isBlank(*(value_end - 1))) {
+            value_end--;
+          }
+          status.name.assign(value, static_cast<size_t>(value_end - value));
+          has_name = true;
+        } else if (isKey(key, length, "Uid")) {
+          long long ids[3];
+          if (parseNumbers(value, end, ids, 3) == 3) {
+            std::copy(ids, ids + 3, status.uid);
+          }
+        } else if (isKey(key, length, "Gid")) {
+          long long ids[3];
+          if (parseNumbers(value, end, ids, 3) == 3) {
+            std::copy(ids, ids + 3, status.gid);
+          }
+        } else if (isKey(key, length, "VmRSS")) {
+          // Memory is reported in kB (1024 bytes).
+          long long kb = 0;
+          if (parseNumbers(value, end, &kb, 1) == 1) {
+            status.resident_size = kb * 1024;
+          }
+        } else if (isKey(key, length, "VmSize")) {
+          long long kb = 0;
+          if (parseNumbers(value, end, &kb, 1) == 1) {
+            status.total_size = kb * 1024;
+          }
+        }
+      });
+
+  if (!has_name) {
+    return Status::failure("Invalid /proc/status content");
+  }
+  return Status::success();
+}
+
+Status procParseIo(const char* content, size_t size, ProcIo& io) {
+  forEachKeyValue(
+      content,
+      size,
+      [&io](
+          const char* key, size_t length, const char* value, const char* end) {
+        if (isKey(key, length, "read_bytes")) {
+          parseNumbers(value, end, &io.read_bytes, 1);
+        } else if (isKey(key, length, "write_bytes")) {
+          parseNumbers(value, end, &io.write_bytes, 1);
+        } else if (isKey(key, length, "cancelled_write_bytes")) {
+          parseNumbers(value, end, &io.cancelled_write_bytes, 1);
+        }
+      });
+  return Status::success();
+}
+
+Status procEnumerateDescriptors(
+    const ProcDirectory& process,
+    const std::function<void(const char* fd, const std::string& target)>&
+        predicate) {
+  int fd = ::openat(process.fd(), "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open /proc/" + process.pid() + "/fd");
+  }
+
+  auto dir = ::fdopendir(fd);
+  if (dir == nullptr) {
+    ::close(fd);
+    return Status::failure("Cannot list /proc/" + process.pid() + "/fd");
+  }
+
+  std::string target;
+  char buffer[PATH_MAX];
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    // The descriptor may be closed before its link is read.
+    auto size = ::readlinkat(fd, entry->d_name, buffer, sizeof(buffer) - 1);
+    if (size < 0) {
+      continue;
+    }
+
+    target.assign(buffer, static_cast<size_t>(size));
+    predicate(entry->d_name, target);
+  }
+
+  // Closing the directory stream closes the descriptor.
+  ::closedir(dir);
+  return Status::success();
+}
+
 Expected<std::uint64_t, ProcError> getProcRSS(const std::string& process) {
   using ProcExpected = Expected<std::uint64_t, ProcError>;
 
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <unordered_map>
 
 #include <arpa/inet.h>
@@ -16,6 +18,7 @@
 #include <unistd.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
 
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
@@ -274,4 +277,118 @@ Status procEnumerateProcessDescriptors(const std::string& pid,
 enum class ProcError { GenericError };
 Expected<std::uint64_t, ProcError> getProcRSS(const std::string& process);
 
+/// The /proc/<pid> files and links a table may need for a process.
+enum ProcFiles : std::uint32_t {
+  PROC_FILE_NONE = 0,
+  PROC_FILE_STAT = 1 << 0,
+  PROC_FILE_STATUS = 1 << 1,
+  PROC_FILE_CMDLINE = 1 << 2,
+  PROC_FILE_IO = 1 << 3,
+  PROC_FILE_CGROUP = 1 << 4,
+  PROC_FILE_EXE = 1 << 5,
+  PROC_FILE_CWD = 1 << 6,
+  PROC_FILE_ROOT = 1 << 7,
+};
+
+/**
+ * @brief A /proc/<pid> directory held open while a process is scanned.
+ *
+ * Files and links are opened relative to the directory descriptor, so the
+ * path is not rebuilt for each of them and every read refers to the same
+ * process, even if the pid is reused while the scan runs.
+ */
+class ProcDirectory : private boost::noncopyable {
+ public:
+  explicit ProcDirectory(const std::string& pid);
+  ~ProcDirectory();
+
+  /// The process directory was opened.
+  bool isValid() const {
+    return fd_ >= 0;
+  }
+
+  /// The descriptor of the process directory.
+  int fd() const {
+    return fd_;
+  }
+
+  const std::string& pid() const {
+    return pid_;
+  }
+
+  /**
+   * @brief Read a small file into a caller-provided buffer.
+   *
+   * The content is NUL terminated and truncated to size - 1 bytes.
+   *
+   * @return The number of bytes read, or -1 if the file cannot be read.
+   */
+  ssize_t read(const char* name, char* buffer, size_t size) const;
+
+  /// Read a file of any size.
+  Status read(const char* name, std::string& content) const;
+
+  /// Read the target of a link such as exe or fd/<n>.
+  Status readLink(const char* name, std::string& target) const;
+
+ private:
+  std::string pid_;
+  int fd_{-1};
+};
+
+/// Fields parsed from /proc/<pid>/stat.
+struct ProcStat {
+  char state{0};
+  long long parent{0};
+  long long group{0};
+  long long nice{0};
+  long long threads{0};
+  unsigned long long user_time{0};
+  unsigned long long system_time{0};
+  unsigned long long start_time{0};
+};
+
+/// Fields parsed from /proc/<pid>/status, a missing field is left at -1.
+struct ProcStatus {
+  std::string name;
+  long long uid[3]{-1, -1, -1};
+  long long gid[3]{-1, -1, -1};
+
+  /// Memory sizes in bytes.
+  long long resident_size{-1};
+  long long total_size{-1};
+};
+
+/// Fields parsed from /proc/<pid>/io, a missing field is left at -1.
+struct ProcIo {
+  long long read_bytes{-1};
+  long long write_bytes{-1};
+  long long cancelled_write_bytes{-1};
+};
+
+/// Parse the content of /proc/<pid>/stat, the comm may contain spaces.
+Status procParseStat(const char* content, size_t size, ProcStat& stat);
+
+/// Parse the content of /proc/<pid>/status.
+Status procParseStatus(const char* content, size_t size, ProcStatus& status);
+
+/// Parse the content of /proc/<pid>/io.
+Status procParseIo(const char* content, size_t size, ProcIo& io);
+
+/**
+ * @brief Call a predicate with the number and target of each descriptor.
+ *
+ * Descriptors closed while the directory is listed are skipped.
+ */
+Status procEnumerateDescriptors(
+    const ProcDirectory& process,
+    const std::function<void(const char* fd, const std::string& target)>&
+        predicate);
+
+/// Read the namespaces of a process from the links of its ns directory.
+Status procGetProcessNamespaces(
+    const ProcDirectory& process,
+    ProcessNamespaceList& namespace_list,
+    std::vector<std::string> namespaces = std::vector<std::string>());
+
 } // namespace osquery
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem/posix/directory_walker.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+namespace {
+
+/// Files per leaf directory of the synthetic trees.
+const size_t kFilesPerDirectory = 100;
+
+/**
+ * @brief Get a synthetic tree holding the given number of files.
+ *
+ * The files are spread over two levels of directories, 100 files per leaf.
+ * Trees are created once and left in the temporary directory, the 1M files
+ * one takes a while to create.
+ */
+const std::string& getSyntheticTree(size_t files) {
+  static std::map<size_t, std::string> trees;
+
+  auto& root = trees[files];
+  if (!root.empty()) {
+    return root;
+  }
+
+  root = (fs::temp_directory_path() /
+          ("osquery.benchmarks.walker." + std::to_string(files)))
+             .string() +
+         "/";
+
+  auto leaves = (files + kFilesPerDirectory - 1) / kFilesPerDirectory;
+  auto fanout = static_cast<size_t>(std::sqrt(leaves)) + 1;
+
+  size_t created = 0;
+  for (size_t top = 0; top < fanout && created < files; ++top) {
+    for (size_t leaf = 0; leaf < fanout && created < files; ++leaf) {
+      auto dir = root + "d" + std::to_string(top) + "/l" + std::to_string(leaf);
+      boost::system::error_code ec;
+      fs::create_directories(dir, ec);
+
+      for (size_t i = 0; i < kFilesPerDirectory && created < files; ++i) {
+        auto path = dir + "/f" + std::to_string(i);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        ++created;
+      }
+    }
+  }
+
+  return root;
+}
+
+/// The former resolution of "root/**", globbing once more per depth level.
+size_t iterativeGlob(std::string pattern) {
+  size_t found = 0;
+  for (size_t depth = 0; depth < 63; ++depth) {
+    glob_t data;
+    ::glob(
+        pattern.c_str(), GLOB_TILDE | GLOB_MARK | GLOB_BRACE, nullptr, &data);
+    auto count = data.gl_pathc;
+    ::globfree(&data);
+
+    if (count == 0) {
+      break;
+    }
+
+    found += count;
+    pattern += "/**";
+  }
+  return found;
+}
+} // namespace
+
+static void FILESYSTEM_iterative_glob(benchmark::State& state) {
+  const auto& root = getSyntheticTree(state.range(0));
+
+  size_t found = 0;
+  for (auto _ : state) {
+    found = iterativeGlob(root + "**");
+    benchmark::DoNotOptimize(found);
+  }
+  state.counters["entries"] = found;
+}
+
+BENCHMARK(FILESYSTEM_iterative_glob)
+    ->Arg(10000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMillisecond);
+
+static void FILESYSTEM_directory_walker(benchmark::State& state) {
+  const auto& root = getSyntheticTree(state.range(0));
+
+  DirectoryWalkerOptions options;
+  options.max_depth = 63;
+  options.threads = state.range(1);
+
+  size_t found = 0;
+  for (auto _ : state) {
+    found = 0;
+    walkDirectory(root, options, [&found](const std::string&, bool) {
+      ++found;
+    });
+    benchmark::DoNotOptimize(found);
+  }
+  state.counters["entries"] = found;
+}
+
+BENCHMARK(FILESYSTEM_directory_walker)
+    ->Args({10000, 1})
+    ->Args({1000000, 1})
+    ->Args({1000000, 4})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace osquery
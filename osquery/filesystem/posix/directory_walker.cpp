@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/filesystem/posix/directory_walker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace osquery {
+namespace {
+
+/// A directory is known by its device and inode, whatever the path to it.
+using DirectoryId = std::pair<dev_t, ino_t>;
+
+/// Entries found by the parallel walkers are handed out in batches.
+const size_t kSharedBatchSize = 256;
+
+#ifdef __linux__
+/// Bytes of directory records read at once with getdents64.
+const size_t kDirentBufferSize = 32 * 1024;
+
+/// The record layout of getdents64, not exposed by older libc headers.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+#endif
+
+struct DirectoryEntry {
+  std::string name;
+  unsigned char type;
+};
+
+/// A subdirectory of the root, walked by one of the parallel walkers.
+struct Subtree {
+  std::string name;
+  std::string path;
+};
+
+bool isExcluded(const DirectoryWalkerOptions& options,
+                const std::string& path) {
+  for (const auto& prefix : options.exclude_prefixes) {
+    if (path.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+class DirectoryWalker {
+ public:
+  DirectoryWalker(const DirectoryWalkerOptions& options,
+                  const DirectoryWalkerCallback& callback,
+                  std::mutex* shared_mutex)
+      : options_(options), callback_(callback), shared_mutex_(shared_mutex) {}
+
+  ~DirectoryWalker() {
+    flush();
+  }
+
+  /// Walk an open directory, unless it is one of its own ancestors.
+  void descend(int fd,
+               const std::string& path,
+               size_t depth,
+               std::vector<DirectoryId>& ancestors) {
+    struct stat dir_stat;
+    if (::fstat(fd, &dir_stat) != 0) {
+      ::close(fd);
+      return;
+    }
+
+    DirectoryId id(dir_stat.st_dev, dir_stat.st_ino);
+    if (std::find(ancestors.begin(), ancestors.end(), id) != ancestors.end()) {
+      // A symlink loop, the directory is already being walked.
+      ::close(fd);
+      return;
+    }
+
+    ancestors.push_back(id);
+    walk(fd, path, depth, ancestors, nullptr);
+    ancestors.pop_back();
+    ::close(fd);
+  }
+
+  /**
+   * @brief List the entries of an open directory at the given depth.
+   *
+   * The subdirectories are walked in turn, or only collected in subtrees
+   * when those are walked by other threads.
+   */
+  void walk(int fd,
+            const std::string& path,
+            size_t depth,
+            std::vector<DirectoryId>& ancestors,
+            std::vector<Subtree>* subtrees) {
+    std::vector<DirectoryEntry> entries;
+    if (!readEntries(fd, entries)) {
+      return;
+    }
+
+    std::sort(entries.begin(),
+              entries.end(),
+              [](const DirectoryEntry& a, const DirectoryEntry& b) {
+                return a.name < b.name;
+              });
+
+    for (const auto& entry : entries) {
+      auto entry_path = path + entry.name;
+
+      bool is_directory = (entry.type == DT_DIR);
+      if (entry.type == DT_LNK || entry.type == DT_UNKNOWN) {
+        // Follow symlinks, a dangling one is listed as a file.
+        struct stat entry_stat;
+        is_directory = ::fstatat(fd, entry.name.c_str(), &entry_stat, 0) == 0 &&
+                       S_ISDIR(entry_stat.st_mode);
+      }
+
+      if (!is_directory) {
+        emit(entry_path, false);
+        continue;
+      }
+
+      entry_path += '/';
+      emit(entry_path, true);
+
+      if (depth >= options_.max_depth || isExcluded(options_, entry_path)) {
+        continue;
+      }
+
+      if (subtrees != nullptr) {
+        subtrees->push_back({entry.name, std::move(entry_path)});
+        continue;
+      }
+
+      int child_fd = ::openat(
+          fd, entry.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (child_fd >= 0) {
+        descend(child_fd, entry_path, depth + 1, ancestors);
+      }
+    }
+  }
+
+ private:
+  void addEntry(const char* name,
+                unsigned char type,
+                std::vector<DirectoryEntry>& entries) const {
+    if (name[0] == '.') {
+      if (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')) {
+        return;
+      }
+
+      if (!options_.include_hidden) {
+        return;
+      }
+    }
+
+    entries.push_back({name, type});
+  }
+
+  bool readEntries(int fd, std::vector<DirectoryEntry>& entries) {
+#ifdef __linux__
+    buffer_.resize(kDirentBufferSize);
+    for (;;) {
+      auto bytes =
+          ::syscall(SYS_getdents64, fd, buffer_.data(), buffer_.size());
+      if (bytes < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+
+      if (bytes == 0) {
+        return true;
+      }
+
+      for (long offset = 0; offset < bytes;) {
+        auto record =
+            reinterpret_cast<const LinuxDirent64*>(buffer_.data() + offset);
+        addEntry(record->d_name, record->d_type, entries);
+        offset += record->d_reclen;
+      }
+    }
+#else
+    // The directory stream takes the descriptor it reads from.
+    int dir_fd = ::dup(fd);
+    if (dir_fd < 0) {
+      return false;
+    }
+
+    auto dir = ::fdopendir(dir_fd);
+    if (dir == nullptr) {
+      ::close(dir_fd);
+      return false;
+    }
+
+    struct dirent* entry = nullptr;
+    while ((entry = ::readdir(dir)) != nullptr) {
+      addEntry(entry->d_name, entry->d_type, entries);
+    }
+
+    ::closedir(dir);
+    return true;
+#endif
+  }
+
+  void emit(const std::string& path, bool is_directory) {
+    if (shared_mutex_ == nullptr) {
+      callback_(path, is_directory);
+      return;
+    }
+
+    pending_.emplace_back(path, is_directory);
+    if (pending_.size() >= kSharedBatchSize) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (pending_.empty()) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(*shared_mutex_);
+    for (const auto& found : pending_) {
+      callback_(found.first, found.second);
+    }
+    pending_.clear();
+  }
+
+  const DirectoryWalkerOptions& options_;
+  const DirectoryWalkerCallback& callback_;
+
+  /// Serializes the callback between walkers, nullptr when walking alone.
+  std::mutex* shared_mutex_{nullptr};
+
+  /// Entries waiting for the callback, when sharing it.
+  std::vector<std::pair<std::string, bool>> pending_;
+
+  std::vector<char> buffer_;
+};
+} // namespace
+
+Status walkDirectory(const std::string& root,
+                     const DirectoryWalkerOptions& options,
+                     const DirectoryWalkerCallback& callback) {
+  auto path = root;
+  if (path.empty() || path.back() != '/') {
+    path += '/';
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open directory " + root + ": " +
+                           std::strerror(errno));
+  }
+
+  if (options.max_depth == 0 || isExcluded(options, path)) {
+    ::close(fd);
+    return Status::success();
+  }
+
+  std::vector<DirectoryId> ancestors;
+  if (options.threads <= 1) {
+    DirectoryWalker walker(options, callback, nullptr);
+    walker.descend(fd, path, 1, ancestors);
+    return Status::success();
+  }
+
+  struct stat root_stat;
+  if (::fstat(fd, &root_stat) != 0) {
+    ::close(fd);
+    return Status::failure("Cannot stat directory " + root + ": " +
+                           std::strerror(errno));
+  }
+  ancestors.emplace_back(root_stat.st_dev, root_stat.st_ino);
+
+  // The root is listed first, then its subtrees are shared between threads.
+  std::mutex callback_mutex;
+  std::vector<Subtree> subtrees;
+  {
+    DirectoryWalker walker(options, callback, &callback_mutex);
+    walker.walk(fd, path, 1, ancestors, &subtrees);
+  }
+
+  std::atomic<size_t> next_subtree{0};
+  auto walk_subtrees = [&]() {
+    DirectoryWalker walker(options, callback, &callback_mutex);
+    for (;;) {
+      auto index = next_subtree++;
+      if (index >= subtrees.size()) {
+        break;
+      }
+
+      const auto& subtree = subtrees[index];
+      int child_fd = ::openat(
+          fd, subtree.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (child_fd >= 0) {
+        auto subtree_ancestors = ancestors;
+        walker.descend(child_fd, subtree.path, 2, subtree_ancestors);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  auto thread_count = std::min(options.threads, subtrees.size());
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(walk_subtrees);
+  }
+  walk_subtrees();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ::close(fd);
+  return Status::success();
+}
+
+} // namespace osquery
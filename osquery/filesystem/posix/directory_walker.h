@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+struct DirectoryWalkerOptions {
+  /// Deepest level listed, the entries of the root directory are at 1.
+  size_t max_depth{std::numeric_limits<size_t>::max()};
+
+  /// List the entries starting with a '.', which globbing leaves out.
+  bool include_hidden{false};
+
+  /// Directories, with a trailing '/', listed but never walked into.
+  std::vector<std::string> exclude_prefixes;
+
+  /// Threads sharing the subtrees of the root, 1 walks them in place.
+  size_t threads{1};
+};
+
+/// Called with each path found, directories carry a trailing '/'.
+using DirectoryWalkerCallback =
+    std::function<void(const std::string& path, bool is_directory)>;
+
+/**
+ * @brief List every entry below a directory in a single pass.
+ *
+ * Each directory is opened relative to its parent and read once. The type of
+ * an entry is taken from the directory listing when the filesystem reports
+ * it, only symlinks and untyped entries are stat'ed. Symlinks are followed
+ * like globbing does, a directory already being walked on the way down from
+ * the root, by device and inode, is listed but not walked again.
+ *
+ * The entries of a directory are listed in name order, each subdirectory
+ * being walked right after it is listed. With several threads, the subtrees
+ * of the root are walked concurrently and the order between them is lost, but
+ * the callback is never called concurrently.
+ *
+ * @param root the directory to walk, with or without a trailing '/'.
+ * @param options the depth, hidden entries, pruning and threads to walk with.
+ * @param callback called with each entry found.
+ *
+ * @return an instance of Status, a failure if the root cannot be opened.
+ */
+Status walkDirectory(const std::string& root,
+                     const DirectoryWalkerOptions& options,
+                     const DirectoryWalkerCallback& callback);
+
+} // namespace osquery
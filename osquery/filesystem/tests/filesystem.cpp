@@ -54,6 +54,7 @@ const std::vector<std::string> kFileNameList{
 }
 
 DECLARE_uint64(read_max);
+DECLARE_bool(read_mmap);
 
 extern inline Status listInAbsoluteDirectory(const fs::path& path,
                                              std::vector<std::string>& results,
@@ -300,6 +301,50 @@ TEST_F(FilesystemTests, test_read_size) {
   EXPECT_EQ(content.size(), s);
 }
 
+TEST_F(FilesystemTests, test_read_file_buffer) {
+  auto test_file = test_working_dir_ / "buffer.txt";
+  std::string expected(200 * 1024, 'A');
+  expected.replace(100, 4, "test");
+  ASSERT_TRUE(writeTextFile(test_file, expected).ok());
+
+  // The buffer is reused between reads and only grows.
+  std::vector<char> buffer;
+  for (auto read_mmap : {false, true}) {
+    FLAGS_read_mmap = read_mmap;
+
+    std::string content;
+    size_t blocks = 0;
+    auto status =
+        readFile(test_file, 0, buffer, false, [&](std::string_view block) {
+          content.append(block.data(), block.size());
+          blocks++;
+        });
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    EXPECT_EQ(blocks, 1U);
+    EXPECT_EQ(content, expected);
+  }
+  FLAGS_read_mmap = false;
+  EXPECT_GE(buffer.size(), expected.size());
+
+  // Blocking reads are done in blocks of the buffer size.
+  buffer.assign(4096, '\0');
+  size_t blocks = 0;
+  size_t total = 0;
+  auto status = readFile(test_file,
+                         0,
+                         buffer,
+                         false,
+                         [&](std::string_view block) {
+                           total += block.size();
+                           blocks++;
+                         },
+                         true);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(total, expected.size());
+  EXPECT_EQ(blocks, 50U);
+  EXPECT_EQ(buffer.size(), 4096U);
+}
+
 TEST_F(FilesystemTests, test_list_files_missing_directory) {
   std::vector<std::string> results;
   auto status = listFilesInDirectory("/foo/bar", results);
@@ -454,6 +499,34 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+// Recursive patterns are only pruned by the POSIX directory walker.
+#ifndef WIN32
+TEST_F(FilesystemTests, test_wildcard_double_excluded) {
+  std::vector<std::string> results;
+  auto status = resolveFilePattern(
+      fake_directory_ / "%%",
+      results,
+      GLOB_ALL,
+      {(fake_directory_ / "deep11/%%").string(),
+       (fake_directory_ / "deep1/%.txt").string()});
+  EXPECT_TRUE(status.ok());
+
+  // Only the whole excluded tree is pruned, the other matches are kept.
+  EXPECT_EQ(results.size(), 14U);
+  EXPECT_TRUE(contains(
+      results,
+      fs::path(fake_directory_ / "deep11/").make_preferred().string()));
+  EXPECT_FALSE(contains(results,
+                        fs::path(fake_directory_ / "deep11/level1.txt")
+                            .make_preferred()
+                            .string()));
+  EXPECT_TRUE(contains(results,
+                       fs::path(fake_directory_ / "deep1/level1.txt")
+                           .make_preferred()
+                           .string()));
+}
+#endif
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(fake_directory_ / "%11/%sh", results);
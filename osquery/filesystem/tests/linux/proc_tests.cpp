@@ -123,5 +123,135 @@ TEST_F(LinuxProc, testProcGetSocketListPacketValidInvalidContent) {
   EXPECT_EQ("NONE", socket_list[0].state);
 }
 
+TEST_F(LinuxProc, testProcParseStat) {
+  // The comm may contain spaces and parentheses.
+  std::string content =
+      "1234 (a) b (c)) S 1 1234 1234 0 -1 4194560 100 0 0 0 15 7 0 0 20 -5 "
+      "3 0 4200 12345678 250 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 "
+      "17 3 0 0 0 0 0\n";
+
+  ProcStat stat;
+  auto status = procParseStat(content.data(), content.size(), stat);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ('S', stat.state);
+  EXPECT_EQ(1, stat.parent);
+  EXPECT_EQ(1234, stat.group);
+  EXPECT_EQ(15U, stat.user_time);
+  EXPECT_EQ(7U, stat.system_time);
+  EXPECT_EQ(-5, stat.nice);
+  EXPECT_EQ(3, stat.threads);
+  EXPECT_EQ(4200U, stat.start_time);
+
+  content = "1234 (truncated) S 1 1234";
+  status = procParseStat(content.data(), content.size(), stat);
+  EXPECT_FALSE(status.ok());
+
+  content = "1234 no comm";
+  status = procParseStat(content.data(), content.size(), stat);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(LinuxProc, testProcParseStatus) {
+  std::string content =
+      "Name:\tsome name \n"
+      "Umask:\t0022\n"
+      "State:\tS (sleeping)\n"
+      "Uid:\t1000\t1001\t1002\t1003\n"
+      "Gid:\t100\t101\t102\t103\n"
+      "VmSize:\t    2048 kB\n"
+      "VmRSS:\t     512 kB\n";
+
+  ProcStatus proc_status;
+  auto status =
+      procParseStatus(content.data(), content.size(), proc_status);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ("some name", proc_status.name);
+  EXPECT_EQ(1000, proc_status.uid[0]);
+  EXPECT_EQ(1001, proc_status.uid[1]);
+  EXPECT_EQ(1002, proc_status.uid[2]);
+  EXPECT_EQ(100, proc_status.gid[0]);
+  EXPECT_EQ(101, proc_status.gid[1]);
+  EXPECT_EQ(102, proc_status.gid[2]);
+  EXPECT_EQ(2048 * 1024, proc_status.total_size);
+  EXPECT_EQ(512 * 1024, proc_status.resident_size);
+
+  // Kernel threads have no memory fields.
+  content = "Name:\tkthreadd\nUid:\t0\t0\t0\t0\n";
+  ProcStatus kernel_status;
+  status = procParseStatus(content.data(), content.size(), kernel_status);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(0, kernel_status.uid[0]);
+  EXPECT_EQ(-1, kernel_status.gid[0]);
+  EXPECT_EQ(-1, kernel_status.resident_size);
+
+  content = "Uid:\t0\t0\t0\t0\n";
+  status = procParseStatus(content.data(), content.size(), kernel_status);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(LinuxProc, testProcParseIo) {
+  std::string content =
+      "rchar: 100\n"
+      "wchar: 200\n"
+      "read_bytes: 4096\n"
+      "write_bytes: 8192\n"
+      "cancelled_write_bytes: 1024\n";
+
+  ProcIo io;
+  auto status = procParseIo(content.data(), content.size(), io);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(4096, io.read_bytes);
+  EXPECT_EQ(8192, io.write_bytes);
+  EXPECT_EQ(1024, io.cancelled_write_bytes);
+}
+
+TEST_F(LinuxProc, testProcDirectory) {
+  ProcDirectory invalid("../self");
+  EXPECT_FALSE(invalid.isValid());
+
+  ProcDirectory process(std::to_string(getpid()));
+  ASSERT_TRUE(process.isValid());
+
+  char buffer[1024];
+  auto size = process.read("stat", buffer, sizeof(buffer));
+  ASSERT_GT(size, 0);
+
+  ProcStat stat;
+  EXPECT_TRUE(procParseStat(buffer, size, stat).ok());
+  EXPECT_EQ(getppid(), stat.parent);
+
+  // A buffer smaller than the file truncates the content.
+  size = process.read("stat", buffer, 4);
+  EXPECT_EQ(3, size);
+  EXPECT_EQ('\0', buffer[3]);
+
+  std::string content;
+  EXPECT_TRUE(process.read("status", content).ok());
+  EXPECT_FALSE(content.empty());
+  EXPECT_FALSE(process.read("does_not_exist", content).ok());
+
+  std::string exe;
+  EXPECT_TRUE(process.readLink("exe", exe).ok());
+  EXPECT_FALSE(exe.empty());
+
+  // The listing itself holds a descriptor open.
+  size_t descriptors = 0;
+  auto status = procEnumerateDescriptors(
+      process, [&descriptors](const char* fd, const std::string& target) {
+        EXPECT_FALSE(target.empty());
+        descriptors++;
+      });
+  EXPECT_TRUE(status.ok());
+  EXPECT_GT(descriptors, 0U);
+
+  // Namespaces read through the directory match those read by path.
+  ProcessNamespaceList by_directory;
+  ProcessNamespaceList by_path;
+  EXPECT_TRUE(procGetProcessNamespaces(process, by_directory).ok());
+  EXPECT_TRUE(procGetProcessNamespaces(process.pid(), by_path).ok());
+  EXPECT_EQ(by_path, by_directory);
+  EXPECT_EQ(1U, by_directory.count("net"));
+}
+
 } // namespace
 } // namespace osquery
\ No newline at end of file
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/posix/directory_walker.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class DirectoryWalkerTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.tests.walker.%%%%.%%%%");
+
+    fs::create_directories(root_ / "a/b/c");
+    fs::create_directories(root_ / "d");
+    fs::create_directories(root_ / ".hidden");
+    writeTextFile(root_ / "a/1.txt", "1");
+    writeTextFile(root_ / "a/b/2.txt", "2");
+    writeTextFile(root_ / "a/b/c/3.txt", "3");
+    writeTextFile(root_ / "d/4.txt", "4");
+    writeTextFile(root_ / ".hidden/5.txt", "5");
+
+    // A symlink back to the root and a dangling one.
+    boost::system::error_code ec;
+    fs::create_directory_symlink(root_, root_ / "a/b/loop", ec);
+    fs::create_symlink(root_ / "missing", root_ / "d/dangling", ec);
+  }
+
+  void TearDown() override {
+    boost::system::error_code ec;
+    fs::remove_all(root_, ec);
+  }
+
+  std::map<std::string, bool> walk(const DirectoryWalkerOptions& options) {
+    std::map<std::string, bool> found;
+    auto status = walkDirectory(
+        root_.string(),
+        options,
+        [&found](const std::string& path, bool is_directory) {
+          found[path] = is_directory;
+        });
+    EXPECT_TRUE(status.ok()) << status.getMessage();
+    return found;
+  }
+
+  std::string path(const std::string& relative) const {
+    return (root_ / relative).string();
+  }
+
+ protected:
+  fs::path root_;
+};
+
+TEST_F(DirectoryWalkerTests, test_walk) {
+  std::vector<std::string> order;
+  auto status =
+      walkDirectory(root_.string(),
+                    DirectoryWalkerOptions(),
+                    [&order](const std::string& path, bool /* is_directory */) {
+                      order.push_back(path);
+                    });
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  // Each directory is walked right after it is listed, in name order.
+  std::vector<std::string> expected = {path("a/"),
+                                       path("a/1.txt"),
+                                       path("a/b/"),
+                                       path("a/b/2.txt"),
+                                       path("a/b/c/"),
+                                       path("a/b/c/3.txt"),
+                                       path("a/b/loop/"),
+                                       path("d/"),
+                                       path("d/4.txt"),
+                                       path("d/dangling")};
+  EXPECT_EQ(order, expected);
+}
+
+TEST_F(DirectoryWalkerTests, test_walk_options) {
+  DirectoryWalkerOptions options;
+  options.max_depth = 2;
+  options.include_hidden = true;
+
+  auto found = walk(options);
+  EXPECT_EQ(found.size(), 8U);
+  EXPECT_FALSE(found.at(path(".hidden/5.txt")));
+  EXPECT_TRUE(found.at(path("a/b/")));
+  EXPECT_EQ(found.count(path("a/b/2.txt")), 0U);
+
+  // The excluded directories are listed but not walked.
+  options = DirectoryWalkerOptions();
+  options.exclude_prefixes = {path("a/b/")};
+
+  found = walk(options);
+  EXPECT_EQ(found.count(path("a/b/")), 1U);
+  EXPECT_EQ(found.count(path("a/b/2.txt")), 0U);
+  EXPECT_EQ(found.count(path("d/4.txt")), 1U);
+
+  // Nothing is walked below an excluded root.
+  options.exclude_prefixes = {root_.string() + "/"};
+  EXPECT_TRUE(walk(options).empty());
+
+  EXPECT_FALSE(walkDirectory(path("missing"),
+                             DirectoryWalkerOptions(),
+                             [](const std::string&, bool) {})
+                   .ok());
+}
+
+TEST_F(DirectoryWalkerTests, test_walk_threads) {
+  auto expected = walk(DirectoryWalkerOptions());
+
+  DirectoryWalkerOptions options;
+  options.threads = 4;
+  EXPECT_EQ(walk(options), expected);
+}
+
+} // namespace osquery
@@ -25,7 +25,7 @@
 namespace osquery {
 
 /// The buffer read size from file IO to hashing structures.
-const size_t kHashChunkSize{4096};
+const size_t kHashChunkSize{1024 * 1024};
 
 Hash::~Hash() {
   if (ctx_ != nullptr) {
@@ -103,22 +103,24 @@ std::string hashFromBuffer(HashType hash_type,
 }
 
 MultiHashes hashMultiFromFile(int mask, const std::string& path) {
-  std::map<HashType, std::shared_ptr<Hash>> hashes = {
-      {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
-      {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
-      {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
-  };
+  // Only the requested algorithms are computed, all in one pass.
+  std::map<HashType, std::shared_ptr<Hash>> hashes;
+  for (auto type : {HASH_TYPE_MD5, HASH_TYPE_SHA1, HASH_TYPE_SHA256}) {
+    if (mask & type) {
+      hashes[type] = std::make_shared<Hash>(type);
+    }
+  }
 
+  // The blocks are hashed where they are read, or mapped, without copies.
+  std::vector<char> buffer(kHashChunkSize);
   auto blocking = isPlatform(PlatformType::TYPE_WINDOWS);
   auto s = readFile(path,
                     0,
-                    kHashChunkSize,
+                    buffer,
                     false,
-                    ([&hashes, &mask](std::string& buffer, size_t size) {
+                    ([&hashes](std::string_view block) {
                       for (auto& hash : hashes) {
-                        if (mask & hash.first) {
-                          hash.second->update(&buffer[0], size);
-                        }
+                        hash.second->update(block.data(), block.size());
                       }
                     }),
                     blocking);
@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifdef __linux__
+// Needed for linux specific RUSAGE_THREAD, before including anything else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/profiler/query_usage.h>
+
+namespace osquery {
+
+FLAG(bool,
+     schedule_perf_counters,
+     false,
+     "Count instructions and cache misses of scheduled queries (Linux)");
+
+namespace {
+
+#ifdef __linux__
+/// Only account for the thread running the query.
+const int kRusageWho = RUSAGE_THREAD;
+const bool kThreadRusage = true;
+#else
+/// The times include every thread of the process.
+const int kRusageWho = RUSAGE_SELF;
+const bool kThreadRusage = false;
+#endif
+
+std::uint64_t toMilliseconds(const struct timeval& timepoint) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::seconds(timepoint.tv_sec) +
+             std::chrono::microseconds(timepoint.tv_usec))
+      .count();
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+/// Bytes of resident memory, as reported by the processes table.
+std::uint64_t getResidentBytes() {
+#ifdef __linux__
+  unsigned long size = 0;
+  unsigned long resident = 0;
+  auto* statm = std::fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+  auto fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+  std::fclose(statm);
+  if (fields != 2) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(resident) * ::sysconf(_SC_PAGESIZE);
+#else
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (::task_info(::mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info),
+                  &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#endif
+}
+#endif
+
+#ifdef __linux__
+/// Set after a counter could not be opened, they are not tried again.
+std::atomic<bool> perf_counters_unavailable{false};
+
+/**
+ * @brief The instructions and cache misses counters of the calling thread.
+ *
+ * Both are opened in one group the first time a thread runs a query and keep
+ * counting until the thread exits, each query reads them twice.
+ */
+class ThreadPerfCounters final {
+ public:
+  ~ThreadPerfCounters() {
+    for (auto fd : {cache_misses_fd_, instructions_fd_}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  bool read(std::uint64_t& instructions, std::uint64_t& cache_misses) {
+    if (!open()) {
+      return false;
+    }
+
+    // The group read format: the number of counters, then their values.
+    std::uint64_t values[3] = {0, 0, 0};
+    if (::read(instructions_fd_, values, sizeof(values)) !=
+            static_cast<ssize_t>(sizeof(values)) ||
+        values[0] != 2) {
+      return false;
+    }
+
+    instructions = values[1];
+    cache_misses = values[2];
+    return true;
+  }
+
+ private:
+  static int openCounter(std::uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(
+        ::syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+  }
+
+  bool open() {
+    if (instructions_fd_ >= 0) {
+      return true;
+    }
+
+    if (perf_counters_unavailable) {
+      return false;
+    }
+
+    instructions_fd_ = openCounter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (instructions_fd_ >= 0) {
+      cache_misses_fd_ =
+          openCounter(PERF_COUNT_HW_CACHE_MISSES, instructions_fd_);
+    }
+
+    if (cache_misses_fd_ < 0) {
+      if (!perf_counters_unavailable.exchange(true)) {
+        LOG(WARNING) << "Cannot open the query performance counters: "
+                     << std::strerror(errno);
+      }
+
+      if (instructions_fd_ >= 0) {
+        ::close(instructions_fd_);
+        instructions_fd_ = -1;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  int instructions_fd_{-1};
+  int cache_misses_fd_{-1};
+};
+#endif
+
+/// A sample of the counters, the meter returns the difference of two.
+struct UsageSample {
+  bool rusage_valid{false};
+  struct rusage stats;
+  std::uint64_t resident{0};
+
+  bool counters_valid{false};
+  std::uint64_t instructions{0};
+  std::uint64_t cache_misses{0};
+
+  UsageSample() {
+    rusage_valid = (::getrusage(kRusageWho, &stats) == 0);
+#if defined(__linux__) || defined(__APPLE__)
+    resident = getResidentBytes();
+#else
+    // Without a current resident size, the max resident size is the closest.
+    resident =
+        rusage_valid ? static_cast<std::uint64_t>(stats.ru_maxrss) * 1024 : 0;
+#endif
+
+#ifdef __linux__
+    if (FLAGS_schedule_perf_counters) {
+      static thread_local ThreadPerfCounters counters;
+      counters_valid = counters.read(instructions, cache_misses);
+    }
+#endif
+  }
+};
+
+std::uint64_t difference(std::uint64_t start, std::uint64_t end) {
+  return (end > start) ? end - start : 0;
+}
+
+} // namespace
+
+class QueryUsageMeter::QueryUsageMeterData {
+ public:
+  const UsageSample& getStart() const {
+    return start_;
+  }
+
+ private:
+  UsageSample start_;
+};
+
+QueryUsageMeter::QueryUsageMeter() : data_(new QueryUsageMeterData()) {}
+
+QueryUsageMeter::~QueryUsageMeter() {}
+
+QueryResourceUsage QueryUsageMeter::stop() {
+  UsageSample end;
+  const auto& start = data_->getStart();
+
+  QueryResourceUsage usage;
+  bool alone = overlap_.finish();
+  if (start.rusage_valid && end.rusage_valid && (kThreadRusage || alone)) {
+    usage.user_time = difference(toMilliseconds(start.stats.ru_utime),
+                                 toMilliseconds(end.stats.ru_utime));
+    usage.system_time = difference(toMilliseconds(start.stats.ru_stime),
+                                   toMilliseconds(end.stats.ru_stime));
+  }
+  if (alone) {
+    usage.memory = difference(start.resident, end.resident);
+  }
+
+  if (start.counters_valid && end.counters_valid) {
+    usage.instructions = difference(start.instructions, end.instructions);
+    usage.cache_misses = difference(start.cache_misses, end.cache_misses);
+  }
+  return usage;
+}
+
+} // namespace osquery
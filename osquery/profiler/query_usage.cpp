@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+
+#include <osquery/profiler/query_usage.h>
+
+namespace osquery {
+
+namespace {
+
+/// Number of meters started so far, identifies the start of each.
+std::atomic<std::uint64_t> meter_starts{0};
+
+/// Number of meters currently measuring.
+std::atomic<std::uint64_t> active_meters{0};
+
+} // namespace
+
+QueryUsageMeter::Overlap::Overlap() {
+  // A meter started earlier and still measuring overlaps this one.
+  overlapped_ = (++active_meters > 1);
+  start_id_ = ++meter_starts;
+}
+
+QueryUsageMeter::Overlap::~Overlap() {
+  finish();
+}
+
+bool QueryUsageMeter::Overlap::finish() {
+  if (!finished_) {
+    finished_ = true;
+    // A meter started since this one overlaps it too.
+    overlapped_ = overlapped_ || (meter_starts != start_id_);
+    --active_meters;
+  }
+  return !overlapped_;
+}
+
+} // namespace osquery
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <osquery/core/sql/query_performance.h>
+
+namespace osquery {
+
+/**
+ * @brief Measure the resources used by a query running on the calling thread.
+ *
+ * The meter samples the thread CPU times and the resident memory size when
+ * created and again when stopped, without running any query itself. The
+ * optional hardware counters are read when schedule_perf_counters is set.
+ *
+ * The resident memory (the working set on Windows) is process-wide, so its
+ * growth is only reported when no other meter was measuring at the same
+ * time; otherwise it is left at 0. Platforms without per-thread CPU times
+ * leave those at 0 in the same case.
+ *
+ * @code{.cpp}
+ *   QueryUsageMeter meter;
+ *   SQLInternal sql(query, true);
+ *   auto usage = meter.stop();
+ * @endcode
+ */
+class QueryUsageMeter final {
+ public:
+  QueryUsageMeter();
+
+  ~QueryUsageMeter();
+
+  /// Take the second sample and return the difference with the first one.
+  QueryResourceUsage stop();
+
+ private:
+  /// Detects the meters measuring at the same time as this one.
+  class Overlap final {
+   public:
+    Overlap();
+
+    ~Overlap();
+
+    /// Stop tracking, return true if no other meter overlapped this one.
+    bool finish();
+
+   private:
+    std::uint64_t start_id_{0};
+    bool overlapped_{false};
+    bool finished_{false};
+  };
+
+  class QueryUsageMeterData;
+
+  /// Started before the first sample is taken.
+  Overlap overlap_;
+
+  const std::unique_ptr<QueryUsageMeterData> data_;
+};
+
+} // namespace osquery
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/utils/system/system.h>
+
+#include <cstdint>
+
+#include <psapi.h>
+
+#include <osquery/profiler/query_usage.h>
+
+namespace osquery {
+namespace {
+
+/// FILETIME counts 100 nanosecond intervals.
+std::uint64_t toMilliseconds(const FILETIME& time) {
+  ULARGE_INTEGER value;
+  value.LowPart = time.dwLowDateTime;
+  value.HighPart = time.dwHighDateTime;
+  return value.QuadPart / 10000;
+}
+
+std::uint64_t difference(std::uint64_t start, std::uint64_t end) {
+  return (end > start) ? end - start : 0;
+}
+
+/// A sample of the thread times and the process working set.
+struct UsageSample {
+  bool times_valid{false};
+  std::uint64_t user_time{0};
+  std::uint64_t system_time{0};
+  std::uint64_t working_set{0};
+
+  UsageSample() {
+    FILETIME creation_time, exit_time, kernel_time, user_time_ft;
+    if (GetThreadTimes(GetCurrentThread(),
+                       &creation_time,
+                       &exit_time,
+                       &kernel_time,
+                       &user_time_ft)) {
+      times_valid = true;
+      user_time = toMilliseconds(user_time_ft);
+      system_time = toMilliseconds(kernel_time);
+    }
+
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(
+            GetCurrentProcess(), &counters, sizeof(counters))) {
+      working_set = counters.WorkingSetSize;
+    }
+  }
+};
+} // namespace
+
+class QueryUsageMeter::QueryUsageMeterData {
+ public:
+  const UsageSample& getStart() const {
+    return start_;
+  }
+
+ private:
+  UsageSample start_;
+};
+
+QueryUsageMeter::QueryUsageMeter() : data_(new QueryUsageMeterData()) {}
+
+QueryUsageMeter::~QueryUsageMeter() {}
+
+QueryResourceUsage QueryUsageMeter::stop() {
+  UsageSample end;
+  const auto& start = data_->getStart();
+
+  QueryResourceUsage usage;
+  if (start.times_valid && end.times_valid) {
+    usage.user_time = difference(start.user_time, end.user_time);
+    usage.system_time = difference(start.system_time, end.system_time);
+  }
+  if (overlap_.finish()) {
+    usage.memory = difference(start.working_set, end.working_set);
+  }
+  return usage;
+}
+
+} // namespace osquery
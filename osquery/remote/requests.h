@@ -231,13 +231,27 @@ class Request {
       return s;
     }
 
+    return callRaw(serialized);
+  }
+
+  /**
+   * @brief Send a body that is already serialized to the destination
+   *
+   * Use the "_content_type" option when the body is not serialized by the
+   * request's serializer, the response is still deserialized by it.
+   *
+   * @param body the request body
+   *
+   * @return success or failure of the operation
+   */
+  Status callRaw(const std::string& body) {
     bool compress = false;
     auto it = options_.doc().FindMember("compress");
     if (it != options_.doc().MemberEnd() && it->value.IsBool()) {
       compress = it->value.GetBool();
     }
 
-    return transport_->sendRequest(serialized, compress);
+    return transport_->sendRequest(body, compress);
   }
 
   /**
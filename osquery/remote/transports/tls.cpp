@@ -89,7 +89,14 @@ TLSTransport::TLSTransport() {
 }
 
 void TLSTransport::decorateRequest(http::Request& r) {
-  r << http::Request::Header("Content-Type", serializer_->getContentType());
+  // Allow request calls to override the content type of a raw body.
+  auto content_type = serializer_->getContentType();
+  auto it = options_.doc().FindMember("_content_type");
+  if (it != options_.doc().MemberEnd() && it->value.IsString()) {
+    content_type = it->value.GetString();
+  }
+
+  r << http::Request::Header("Content-Type", content_type);
   r << http::Request::Header("Accept", serializer_->getContentType());
   r << http::Request::Header("User-Agent", kTLSUserAgentBase + kVersion);
 }
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <osquery/sql/planner_stats.h>
+
+namespace osquery {
+
+namespace {
+
+/// Weight of a new observation in the moving averages.
+const double kPlannerStatsWeight{0.25};
+
+/// Bound the number of recorded shapes, new shapes are ignored past this.
+const size_t kPlannerStatsMaxEntries{4096};
+
+} // namespace
+
+TablePlannerStats& TablePlannerStats::get() {
+  static TablePlannerStats stats;
+  return stats;
+}
+
+std::string TablePlannerStats::getShape(const ConstraintSet& constraints,
+                                        const std::set<size_t>& in_lists) {
+  // SQLite may offer the same constraints in any order.
+  std::vector<std::string> terms;
+  for (size_t i = 0; i < constraints.size(); ++i) {
+    const auto& constraint = constraints[i];
+    terms.push_back(constraint.first + " " +
+                    ((in_lists.count(i) > 0)
+                         ? std::string("IN")
+                         : std::to_string(constraint.second.op)));
+  }
+  std::sort(terms.begin(), terms.end());
+
+  std::string shape;
+  for (const auto& term : terms) {
+    if (!shape.empty()) {
+      shape += ',';
+    }
+    shape += term;
+  }
+  return shape;
+}
+
+void TablePlannerStats::record(const std::string& table,
+                               const std::string& shape,
+                               size_t rows,
+                               uint64_t usec) {
+  WriteLock lock(mutex_);
+  auto key = std::make_pair(table, shape);
+  auto it = stats_.find(key);
+  if (it == stats_.end()) {
+    if (stats_.size() >= kPlannerStatsMaxEntries) {
+      return;
+    }
+
+    auto& stats = stats_[key];
+    stats.scans = 1;
+    stats.rows = static_cast<double>(rows);
+    stats.usec = static_cast<double>(usec);
+    return;
+  }
+
+  auto& stats = it->second;
+  stats.scans++;
+  stats.rows += kPlannerStatsWeight * (static_cast<double>(rows) - stats.rows);
+  stats.usec += kPlannerStatsWeight * (static_cast<double>(usec) - stats.usec);
+}
+
+bool TablePlannerStats::lookup(const std::string& table,
+                               const std::string& shape,
+                               TableScanStats& stats) {
+  ReadLock lock(mutex_);
+  auto it = stats_.find(std::make_pair(table, shape));
+  if (it == stats_.end()) {
+    return false;
+  }
+
+  stats = it->second;
+  return true;
+}
+
+void TablePlannerStats::clear() {
+  WriteLock lock(mutex_);
+  stats_.clear();
+}
+
+} // namespace osquery
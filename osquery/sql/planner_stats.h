@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// Observed cost of generating a table for a constraint shape.
+struct TableScanStats {
+  /// Number of recorded generate calls.
+  uint64_t scans{0};
+
+  /// Moving average of the rows returned by a generate call.
+  double rows{0};
+
+  /// Moving average of the microseconds spent in a generate call.
+  double usec{0};
+};
+
+/**
+ * @brief Runtime statistics of table generation used by the planner.
+ *
+ * Each generate call records its row count and latency against the table and
+ * the shape of the constraints it was given: the constrained columns and
+ * operators, without their values. xBestIndex uses these to estimate the
+ * rows and cost of the same shape in later queries.
+ */
+class TablePlannerStats : private boost::noncopyable {
+ public:
+  /// Get the process-wide statistics.
+  static TablePlannerStats& get();
+
+  /**
+   * @brief Build the shape of a constraint set.
+   *
+   * @param constraints the column and operator pairs from xBestIndex.
+   * @param in_lists the positions of constraints receiving a whole IN list.
+   */
+  static std::string getShape(const ConstraintSet& constraints,
+                              const std::set<size_t>& in_lists);
+
+  /// Record the rows and latency of a generate call.
+  void record(const std::string& table,
+              const std::string& shape,
+              size_t rows,
+              uint64_t usec);
+
+  /// Copy the statistics for a shape, return false if none were recorded.
+  bool lookup(const std::string& table,
+              const std::string& shape,
+              TableScanStats& stats);
+
+  /// Drop every recorded statistic.
+  void clear();
+
+ private:
+  TablePlannerStats() = default;
+
+ private:
+  /// Statistics keyed by table name and constraint shape.
+  std::map<std::pair<std::string, std::string>, TableScanStats> stats_;
+
+  Mutex mutex_;
+};
+
+} // namespace osquery
@@ -25,6 +25,8 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <chrono>
+
 namespace osquery {
 
 CLI_FLAG(string,
@@ -39,6 +41,16 @@ CLI_FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     sql_pool_size,
+     4,
+     "Maximum number of attached databases kept for concurrent queries");
+
+FLAG(uint64,
+     sql_pool_wait_ms,
+     100,
+     "Milliseconds to wait for a pooled database before opening a new one");
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -71,6 +83,9 @@ const std::map<std::string, std::string> kMemoryDBSettings = {
 };
 // clang-format on
 
+/// Number of virtual machine instructions between checks for interruption.
+const int kInterruptSteps{1000};
+
 #define OpComparator(x)                                                        \
   { x, QueryPlanner::Opcode(OpReg::P2, INTEGER_TYPE) }
 #define Arithmetic(x)                                                          \
@@ -181,10 +196,48 @@ Status SQLiteSQLPlugin::getQueryTables(const std::string& query,
   return Status(0);
 }
 
-SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
+SQLInterrupt::SQLInterrupt(std::chrono::milliseconds timeout) {
+  if (timeout.count() > 0) {
+    has_deadline_ = true;
+    deadline_ = std::chrono::steady_clock::now() + timeout;
+  }
+}
+
+bool SQLInterrupt::interrupted() const {
+  return cancelled_ || timedOut();
+}
+
+bool SQLInterrupt::timedOut() const {
+  return has_deadline_ && std::chrono::steady_clock::now() >= deadline_;
+}
+
+/// Progress handler returning non-zero to interrupt the running statement.
+static int checkInterrupt(void* interrupt) {
+  return static_cast<const SQLInterrupt*>(interrupt)->interrupted() ? 1 : 0;
+}
+
+SQLInternal::SQLInternal(const std::string& query, bool use_cache)
+    : SQLInternal(query, use_cache, SQLInterrupt()) {}
+
+SQLInternal::SQLInternal(const std::string& query,
+                         bool use_cache,
+                         const SQLInterrupt& interrupt) {
   auto dbc = SQLiteDBManager::get();
   dbc->useCache(use_cache);
+
+  // The handler is called every kInterruptSteps virtual machine instructions.
+  sqlite3_progress_handler(dbc->db(),
+                           kInterruptSteps,
+                           checkInterrupt,
+                           const_cast<SQLInterrupt*>(&interrupt));
   status_ = queryInternal(query, resultsTyped_, dbc);
+  sqlite3_progress_handler(dbc->db(), 0, nullptr, nullptr);
+
+  if (!status_.ok() && interrupt.timedOut()) {
+    status_ = Status::failure("The query ran past its timeout");
+  } else if (!status_.ok() && interrupt.interrupted()) {
+    status_ = Status::failure("The query was cancelled");
+  }
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -283,7 +336,12 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   auto dbc = SQLiteDBManager::getConnection(true);
 
   // Attach as an extension, allowing read/write tables
-  return attachTableInternal(name, dbc, is_extension);
+  status = attachTableInternal(name, dbc, is_extension);
+
+  // Pooled databases were attached without the new table.
+  SQLiteDBManager::invalidatePool();
+  SQLiteStatementCache::invalidate();
+  return status;
 }
 
 Status SQLiteSQLPlugin::detach(const std::string& name) {
@@ -291,7 +349,10 @@ Status SQLiteSQLPlugin::detach(const std::string& name) {
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
-  return detachTableInternal(name, dbc);
+  auto status = detachTableInternal(name, dbc);
+  SQLiteDBManager::invalidatePool();
+  SQLiteStatementCache::invalidate();
+  return status;
 }
 
 SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
@@ -299,9 +360,9 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The manager provides a pooled or new transient instance instead.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
+    VLOG(1) << "DBManager contention: using a transient SQLite database";
   }
 }
 
@@ -364,6 +425,31 @@ static inline void openOptimized(sqlite3*& db) {
   }
 }
 
+/// Sum the main and temp schema versions, any schema change increases it.
+static int getSchemaVersion(sqlite3* db) {
+  // The authorizer denies this pragma to queries.
+  sqlite3_set_authorizer(db, nullptr, nullptr);
+
+  int version = 0;
+  for (const auto& pragma :
+       {"PRAGMA main.schema_version", "PRAGMA temp.schema_version"}) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, pragma, -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+      version += sqlite3_column_int(stmt, 0);
+    } else {
+      version = -1;
+    }
+    sqlite3_finalize(stmt);
+    if (version < 0) {
+      break;
+    }
+  }
+
+  sqlite3_set_authorizer(db, &sqliteAuthorizer, nullptr);
+  return version;
+}
+
 void SQLiteDBInstance::init() {
   primary_ = false;
   openOptimized(db_);
@@ -384,6 +470,14 @@ RecursiveLock SQLiteDBInstance::attachLock() const {
   return RecursiveLock(attach_mutex_);
 }
 
+SQLiteStatementCache& SQLiteDBInstance::statements() {
+  if (isPrimary() && !managed_) {
+    // Similarly to clearAffectedTables, the cache belongs to the connection.
+    return SQLiteDBManager::getConnection(true)->statements();
+  }
+  return statements_;
+}
+
 void SQLiteDBInstance::addAffectedTable(
     std::shared_ptr<VirtualTableContent> table) {
   // An xFilter/scan was requested for this virtual table.
@@ -408,6 +502,24 @@ TableAttributes SQLiteDBInstance::getAttributes() const {
   return attributes;
 }
 
+/// Clear the state recorded by xBestIndex, except for cached statements.
+template <typename T>
+static void clearPlannedIndexes(std::unordered_map<size_t, T>& planned,
+                                const std::set<size_t>& cached) {
+  if (cached.empty()) {
+    planned.clear();
+    return;
+  }
+
+  for (auto it = planned.begin(); it != planned.end();) {
+    if (cached.count(it->first) > 0) {
+      ++it;
+    } else {
+      it = planned.erase(it);
+    }
+  }
+}
+
 void SQLiteDBInstance::clearAffectedTables() {
   if (isPrimary() && !managed_) {
     // A primary instance must forward clear requests to the DB manager's
@@ -417,10 +529,14 @@ void SQLiteDBInstance::clearAffectedTables() {
   }
 
   for (const auto& table : affected_tables_) {
-    table.second->constraints.clear();
+    const auto& cached = table.second->cachedIndexes;
+    clearPlannedIndexes(table.second->constraints, cached);
     table.second->cache.clear();
-    table.second->colsUsed.clear();
-    table.second->colsUsedBitsets.clear();
+    clearPlannedIndexes(table.second->colsUsed, cached);
+    clearPlannedIndexes(table.second->colsUsedBitsets, cached);
+    clearPlannedIndexes(table.second->inListConstraints, cached);
+    table.second->filterRequests.clear();
+    table.second->filterMemo.clear();
   }
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
@@ -428,7 +544,20 @@ void SQLiteDBInstance::clearAffectedTables() {
   use_cache_ = false;
 }
 
+void SQLiteDBInstance::clearFilterMemos() {
+  if (isPrimary() && !managed_) {
+    SQLiteDBManager::getConnection(true)->clearFilterMemos();
+    return;
+  }
+
+  for (const auto& table : affected_tables_) {
+    table.second->filterRequests.clear();
+    table.second->filterMemo.clear();
+  }
+}
+
 SQLiteDBInstance::~SQLiteDBInstance() {
+  statements_.clear();
   if (!isPrimary() && db_ != nullptr) {
     sqlite3_close(db_);
   } else {
@@ -489,6 +618,136 @@ void SQLiteDBManager::resetPrimary() {
     sqlite3_close(self.db_);
     self.db_ = nullptr;
   }
+
+  // Pooled databases keep their own arenas.
+  invalidatePool();
+}
+
+void SQLiteDBManager::invalidatePool() {
+  auto& self = instance();
+
+  // Idle instances are closed once the lock is released.
+  std::vector<SQLiteDBInstanceRef> idle;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.pool_generation_++;
+    self.pool_stats_.invalidations += self.pool_.size();
+    idle.swap(self.pool_);
+  }
+}
+
+SQLitePoolStats SQLiteDBManager::getPoolStats() {
+  auto& self = instance();
+
+  WriteLock lock(self.pool_mutex_);
+  auto stats = self.pool_stats_;
+  stats.size = FLAGS_sql_pool_size;
+  stats.idle = self.pool_.size();
+  stats.in_use = self.pool_in_use_;
+  return stats;
+}
+
+SQLiteDBInstanceRef SQLiteDBManager::checkout() {
+  auto& self = instance();
+
+  SQLiteDBInstanceRef pooled;
+  bool create = false;
+  uint64_t generation = 0;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.pool_stats_.checkouts++;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(FLAGS_sql_pool_wait_ms);
+    bool waited = false;
+    while (FLAGS_sql_pool_size > 0) {
+      if (!self.pool_.empty()) {
+        pooled = std::move(self.pool_.back());
+        self.pool_.pop_back();
+        self.pool_in_use_++;
+        break;
+      }
+
+      if (self.pool_in_use_ < FLAGS_sql_pool_size) {
+        // Reserve a slot, the database is attached without the lock held.
+        self.pool_in_use_++;
+        self.pool_stats_.created++;
+        generation = self.pool_generation_;
+        create = true;
+        break;
+      }
+
+      // A query may run nested queries while it holds a pooled database, so
+      // the wait is bounded and an unpooled database is used past it.
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        self.pool_stats_.overflows++;
+        break;
+      }
+      waited = true;
+      auto remaining =
+          std::chrono::duration_cast<std::chrono::microseconds>(deadline - now);
+      self.pool_released_.wait_for(
+          lock, boost::chrono::microseconds(remaining.count()));
+    }
+
+    if (waited) {
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      auto wait_time = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+              .count());
+      self.pool_stats_.waits++;
+      self.pool_stats_.wait_time += wait_time;
+      self.pool_stats_.max_wait_time =
+          std::max(self.pool_stats_.max_wait_time, wait_time);
+    }
+  }
+
+  if (pooled == nullptr) {
+    auto transient = std::make_shared<SQLiteDBInstance>();
+    attachVirtualTables(transient);
+    if (!create) {
+      return transient;
+    }
+
+    pooled = std::move(transient);
+    pooled->generation_ = generation;
+    pooled->schema_version_ = getSchemaVersion(pooled->db_);
+  }
+
+  // The returned reference hands the instance back to the pool when the
+  // query releases it.
+  auto* dbc = pooled.get();
+  return SQLiteDBInstanceRef(
+      dbc, [pooled](SQLiteDBInstance*) { SQLiteDBManager::release(pooled); });
+}
+
+void SQLiteDBManager::release(const SQLiteDBInstanceRef& pooled) {
+  auto& self = instance();
+
+  // Only return databases left as they were attached: no running statements
+  // or transactions, and no tables or views created by the queries.
+  pooled->clearAffectedTables();
+  auto* db = pooled->db_;
+  bool busy = false;
+  for (auto* stmt = sqlite3_next_stmt(db, nullptr); stmt != nullptr;
+       stmt = sqlite3_next_stmt(db, stmt)) {
+    busy = busy || sqlite3_stmt_busy(stmt) != 0;
+  }
+  bool reusable = !busy && sqlite3_get_autocommit(db) != 0 &&
+                  pooled->schema_version_ >= 0 &&
+                  getSchemaVersion(db) == pooled->schema_version_;
+
+  WriteLock lock(self.pool_mutex_);
+  self.pool_in_use_--;
+  if (reusable && pooled->generation_ == self.pool_generation_ &&
+      self.pool_.size() + self.pool_in_use_ < FLAGS_sql_pool_size) {
+    self.pool_.push_back(pooled);
+  } else {
+    // The instance is closed when the last reference is dropped.
+    self.pool_stats_.invalidations++;
+  }
+  self.pool_released_.notify_one();
 }
 
 void SQLiteDBManager::setDisabledTables(const std::string& list) {
@@ -511,30 +770,37 @@ SQLiteDBInstanceRef SQLiteDBManager::getUnique() {
 
 SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
   auto& self = instance();
-  WriteLock lock(self.create_mutex_);
+  SQLiteDBInstanceRef instance;
 
-  if (self.db_ == nullptr) {
-    // Create primary SQLite DB instance.
-    openOptimized(self.db_);
-    self.connection_ = SQLiteDBInstanceRef(new SQLiteDBInstance(self.db_));
-    attachVirtualTables(self.connection_);
-  }
+  {
+    WriteLock lock(self.create_mutex_);
+
+    if (self.db_ == nullptr) {
+      // Create primary SQLite DB instance.
+      openOptimized(self.db_);
+      self.connection_ = SQLiteDBInstanceRef(new SQLiteDBInstance(self.db_));
+      attachVirtualTables(self.connection_);
+    }
 
-  // Internal usage may request the primary connection explicitly.
-  if (primary) {
-    return self.connection_;
+    // Internal usage may request the primary connection explicitly.
+    if (primary) {
+      return self.connection_;
+    }
+
+    // Create a 'database connection' for the managed database instance.
+    instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
   }
 
-  // Create a 'database connection' for the managed database instance.
-  auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
+  // Waiting for a pooled database must not block other connections.
   if (!instance->isPrimary()) {
-    attachVirtualTables(instance);
+    return checkout();
   }
 
   return instance;
 }
 
 SQLiteDBManager::~SQLiteDBManager() {
+  pool_.clear();
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -638,14 +904,9 @@ Status queryInternal(const std::string& query,
   return status;
 }
 
-Status readRows(sqlite3_stmt* prepared_statement,
-                QueryDataTyped& results,
-                const SQLiteDBInstanceRef& instance) {
-  // Do nothing with a null prepared_statement (eg, if the sql was just
-  // whitespace)
-  if (prepared_statement == nullptr) {
-    return Status::success();
-  }
+/// Step a prepared statement and collect its rows, without finalizing it.
+static int stepRows(sqlite3_stmt* prepared_statement,
+                    QueryDataTyped& results) {
   int rc = sqlite3_step(prepared_statement);
   /* if we have a result set row... */
   if (SQLITE_ROW == rc) {
@@ -682,6 +943,19 @@ Status readRows(sqlite3_stmt* prepared_statement,
       rc = sqlite3_step(prepared_statement);
     } while (SQLITE_ROW == rc);
   }
+  return rc;
+}
+
+Status readRows(sqlite3_stmt* prepared_statement,
+                QueryDataTyped& results,
+                const SQLiteDBInstanceRef& instance) {
+  // Do nothing with a null prepared_statement (eg, if the sql was just
+  // whitespace)
+  if (prepared_statement == nullptr) {
+    return Status::success();
+  }
+
+  int rc = stepRows(prepared_statement, results);
   if (rc != SQLITE_DONE) {
     auto s = Status::failure(sqlite3_errmsg(instance->db()));
     sqlite3_finalize(prepared_statement);
@@ -713,15 +987,46 @@ Status queryInternal(const std::string& query,
     while (isspace(sql[0])) {
       sql++;
     }
-    rc = sqlite3_prepare_v2(
-        instance->db(), sql, -1, &prepared_statement, &leftover_sql);
-    if (rc != SQLITE_OK) {
-      Status s = Status::failure(sqlite3_errmsg(instance->db()));
-      sqlite3_finalize(prepared_statement);
-      return s;
+
+    // Reuse the statement if this text was prepared on the connection.
+    auto& statements = instance->statements();
+    std::string text(sql);
+    size_t tail = 0;
+    prepared_statement = statements.get(text, tail);
+    bool cached = (prepared_statement != nullptr);
+    if (cached) {
+      leftover_sql = sql + tail;
+    } else {
+      statements.beginPlan();
+      rc = sqlite3_prepare_v2(
+          instance->db(), sql, -1, &prepared_statement, &leftover_sql);
+      if (rc != SQLITE_OK) {
+        Status s = Status::failure(sqlite3_errmsg(instance->db()));
+        sqlite3_finalize(prepared_statement);
+        return s;
+      }
+
+      // Only statements without side effects are run again.
+      if (prepared_statement != nullptr &&
+          sqlite3_stmt_readonly(prepared_statement) != 0) {
+        cached = statements.add(text, prepared_statement, leftover_sql - sql);
+      }
+    }
+
+    Status s;
+    if (cached) {
+      rc = stepRows(prepared_statement, results);
+      if (rc != SQLITE_DONE) {
+        s = Status::failure(sqlite3_errmsg(instance->db()));
+      }
+      statements.reset(text, prepared_statement, !s.ok());
+      rc = SQLITE_OK;
+    } else {
+      s = readRows(prepared_statement, results, instance);
     }
 
-    Status s = readRows(prepared_statement, results, instance);
+    // Memoized filter rows only live for the statement that generated them.
+    instance->clearFilterMemos();
     if (!s.ok()) {
       return s;
     }
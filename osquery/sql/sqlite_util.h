@@ -10,9 +10,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -20,6 +23,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <osquery/sql/sql.h>
+#include <osquery/sql/statement_cache.h>
 
 #include <osquery/utils/mutex.h>
 
@@ -95,7 +99,8 @@ class SQLiteDBManager;
  *
  * If there is resource contention (multiple threads want access to the SQLite
  * abstraction layer), then the SQLiteDBManager will provide a transient
- * SQLiteDBInstance.
+ * SQLiteDBInstance, preferably backed by a pooled database that already has
+ * every virtual table attached.
  */
 class SQLiteDBInstance : private boost::noncopyable {
  public:
@@ -127,6 +132,9 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Clear per-query state of a table affected by the use of this instance.
   void clearAffectedTables();
 
+  /// Clear the rows memoized for repeated table filters within a statement.
+  void clearFilterMemos();
+
   /// Check if a virtual table had been called already.
   bool tableCalled(VirtualTableContent const& table);
 
@@ -139,6 +147,9 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Lock the database for attaching virtual tables.
   RecursiveLock attachLock() const;
 
+  /// The prepared statements cached for the database.
+  SQLiteStatementCache& statements();
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -155,6 +166,12 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Track whether this instance is managed internally by the DB manager.
   bool managed_{false};
 
+  /// The pool generation the pooled instance was attached in.
+  uint64_t generation_{0};
+
+  /// The schema version of the pooled database once its tables are attached.
+  int schema_version_{0};
+
   /// True if this query should bypass table cache.
   bool use_cache_{false};
 
@@ -184,6 +201,9 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, std::shared_ptr<VirtualTableContent>> affected_tables_;
 
+  /// Prepared statements, finalized before the database is closed.
+  SQLiteStatementCache statements_;
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
@@ -194,6 +214,37 @@ class SQLiteDBInstance : private boost::noncopyable {
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
 
+/// Usage of the pool of databases handed out under contention.
+struct SQLitePoolStats {
+  /// The configured maximum number of pooled databases.
+  size_t size{0};
+
+  /// Number of pooled databases waiting to be checked out.
+  size_t idle{0};
+
+  /// Number of pooled databases checked out.
+  size_t in_use{0};
+
+  /// Number of transient connections requested.
+  uint64_t checkouts{0};
+
+  /// Number of pooled databases opened and attached.
+  uint64_t created{0};
+
+  /// Number of unpooled databases opened because the pool was exhausted.
+  uint64_t overflows{0};
+
+  /// Number of pooled databases closed instead of being returned.
+  uint64_t invalidations{0};
+
+  /// Number of checkouts that waited for a database to be returned.
+  uint64_t waits{0};
+
+  /// Total and maximum time in milliseconds spent waiting.
+  uint64_t wait_time{0};
+  uint64_t max_wait_time{0};
+};
+
 /**
  * @brief osquery internal SQLite DB abstraction resource management.
  *
@@ -241,6 +292,17 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static void resetPrimary();
 
+  /**
+   * @brief Close every idle pooled database.
+   *
+   * Checked out databases are closed when released. This is called when
+   * tables are attached or detached, pooled databases would not see them.
+   */
+  static void invalidatePool();
+
+  /// Return the current usage of the database pool.
+  static SQLitePoolStats getPoolStats();
+
   /**
    * @brief Check if `table_name` is disabled.
    *
@@ -274,6 +336,29 @@ class SQLiteDBManager : private boost::noncopyable {
   /// A write mutex for initializing the primary database.
   Mutex create_mutex_;
 
+  /**
+   * @brief Idle pooled instances, all attached in the current generation.
+   *
+   * The instances are pooled rather than their databases: each attached
+   * virtual table refers to the instance that attached it.
+   */
+  std::vector<SQLiteDBInstanceRef> pool_;
+
+  /// Number of pooled databases checked out.
+  size_t pool_in_use_{0};
+
+  /// Incremented each time the pool is invalidated.
+  uint64_t pool_generation_{0};
+
+  /// Pool usage counters.
+  SQLitePoolStats pool_stats_;
+
+  /// Mutex protecting the pool and its counters.
+  Mutex pool_mutex_;
+
+  /// Notified when a pooled database is released.
+  ConditionVariable pool_released_;
+
   /// Member variable to hold set of disabled tables.
   std::unordered_set<std::string> disabled_tables_;
 
@@ -289,6 +374,12 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Provide a pooled instance, or a new transient one past the wait.
+  static SQLiteDBInstanceRef checkout();
+
+  /// Return a pooled instance once its last reference is released.
+  static void release(const SQLiteDBInstanceRef& pooled);
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
@@ -418,6 +509,39 @@ Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief Interrupts a running query once cancelled or past its deadline.
+ *
+ * SQLite checks for the interruption between the instructions of a
+ * statement, a table generating its rows is not interrupted until the
+ * generation returns.
+ */
+class SQLInterrupt : private boost::noncopyable {
+ public:
+  /// A query that is only interrupted when cancelled.
+  SQLInterrupt() = default;
+
+  /// A query interrupted after running for timeout, zero for no limit.
+  explicit SQLInterrupt(std::chrono::milliseconds timeout);
+
+  /// Interrupt the query, from any thread.
+  void cancel() {
+    cancelled_ = true;
+  }
+
+  /// Check if the query should stop.
+  bool interrupted() const;
+
+  /// Check if the query ran past its deadline.
+  bool timedOut() const;
+
+ private:
+  std::atomic<bool> cancelled_{false};
+
+  bool has_deadline_{false};
+  std::chrono::steady_clock::time_point deadline_;
+};
+
 /**
  * @brief SQLInternal: like SQL, but backed by internal calls, and deals
  * with QueryDataTyped results.
@@ -432,6 +556,17 @@ class SQLInternal : private only_movable {
    */
   explicit SQLInternal(const std::string& query, bool use_cache = false);
 
+  /**
+   * @brief Instantiate an instance of the class with an interruptible query.
+   *
+   * @param query An osquery SQL query.
+   * @param use_cache Set true to use the query cache.
+   * @param interrupt Stops the query when cancelled or timed out.
+   */
+  SQLInternal(const std::string& query,
+              bool use_cache,
+              const SQLInterrupt& interrupt);
+
  public:
   /**
    * @brief Const accessor for the rows returned by the query.
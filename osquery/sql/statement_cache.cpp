@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/sql/statement_cache.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     statement_cache_size,
+     512,
+     "Maximum number of prepared statements cached per SQLite connection");
+
+std::atomic<uint64_t> SQLiteStatementCache::kGeneration{0};
+
+namespace {
+
+int getReprepares(sqlite3_stmt* stmt) {
+  return sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+}
+
+} // namespace
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+  clear();
+}
+
+sqlite3_stmt* SQLiteStatementCache::get(const std::string& sql,
+                                        size_t& tail) {
+  if (generation_ != kGeneration) {
+    clear();
+    generation_ = kGeneration;
+  }
+
+  auto it = entries_.find(sql);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  tail = it->second.tail;
+  return it->second.stmt;
+}
+
+void SQLiteStatementCache::beginPlan() {
+  planned_.clear();
+}
+
+void SQLiteStatementCache::addPlannedIndex(
+    std::shared_ptr<VirtualTableContent> content, size_t index) {
+  planned_.emplace_back(std::move(content), index);
+}
+
+bool SQLiteStatementCache::add(const std::string& sql,
+                               sqlite3_stmt* stmt,
+                               size_t tail) {
+  if (FLAGS_statement_cache_size == 0 || entries_.count(sql) > 0) {
+    return false;
+  }
+
+  Entry entry;
+  entry.stmt = stmt;
+  entry.tail = tail;
+  entry.reprepares = getReprepares(stmt);
+  entry.indexes = std::move(planned_);
+  planned_.clear();
+  for (const auto& planned : entry.indexes) {
+    planned.first->cachedIndexes.insert(planned.second);
+  }
+
+  lru_.push_front(sql);
+  entry.lru = lru_.begin();
+  entries_.emplace(sql, std::move(entry));
+
+  while (entries_.size() > FLAGS_statement_cache_size) {
+    erase(entries_.find(lru_.back()));
+  }
+  return true;
+}
+
+void SQLiteStatementCache::reset(const std::string& sql,
+                                 sqlite3_stmt* stmt,
+                                 bool failed) {
+  sqlite3_reset(stmt);
+
+  auto it = entries_.find(sql);
+  if (it == entries_.end() || it->second.stmt != stmt) {
+    return;
+  }
+
+  // A re-prepared statement was planned again, its pinned indexes are stale.
+  if (failed || getReprepares(stmt) != it->second.reprepares) {
+    erase(it);
+  }
+}
+
+void SQLiteStatementCache::erase(Entries::iterator it) {
+  sqlite3_finalize(it->second.stmt);
+  for (const auto& planned : it->second.indexes) {
+    auto& content = *planned.first;
+    auto index = planned.second;
+    content.cachedIndexes.erase(index);
+    content.constraints.erase(index);
+    content.colsUsed.erase(index);
+    content.colsUsedBitsets.erase(index);
+    content.inListConstraints.erase(index);
+  }
+
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void SQLiteStatementCache::clear() {
+  while (!entries_.empty()) {
+    erase(entries_.begin());
+  }
+  planned_.clear();
+}
+
+void SQLiteStatementCache::invalidate() {
+  kGeneration++;
+}
+
+} // namespace osquery
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/// Constraint indexes recorded by xBestIndex for the tables of a statement.
+using PlannedIndexes =
+    std::vector<std::pair<std::shared_ptr<VirtualTableContent>, size_t>>;
+
+/**
+ * @brief A per-connection cache of prepared read-only statements.
+ *
+ * Scheduled and distributed queries repeat the same SQL text, and preparing
+ * a statement plans every virtual table it uses again. Cached statements are
+ * reset and stepped again instead.
+ *
+ * xFilter reads the constraints and used columns that xBestIndex recorded
+ * in the table's VirtualTableContent under the plan's index number. Those
+ * entries are normally cleared after each query, the indexes planned for a
+ * cached statement are pinned so they survive until it is evicted.
+ *
+ * Statements are keyed by their SQL text, including the statements that
+ * follow them in the same query. The cache is bounded by
+ * `--statement_cache_size`, least recently used statements are finalized
+ * first. SQLite may re-prepare a statement when the schema changes, which
+ * plans it again with new indexes, so such statements are evicted after
+ * they run.
+ *
+ * The cache is used with the lock of its connection held.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  ~SQLiteStatementCache();
+
+  /**
+   * @brief Find the prepared statement for the SQL text.
+   *
+   * @param sql the SQL text, starting with the statement.
+   * @param tail [output] the length of the statement within the text.
+   *
+   * @return the statement, or nullptr if it is not cached.
+   */
+  sqlite3_stmt* get(const std::string& sql, size_t& tail);
+
+  /// Forget the indexes planned before preparing a new statement.
+  void beginPlan();
+
+  /// Record an index planned by xBestIndex while a statement is prepared.
+  void addPlannedIndex(std::shared_ptr<VirtualTableContent> content,
+                       size_t index);
+
+  /**
+   * @brief Cache a prepared statement with the indexes planned for it.
+   *
+   * @return true if the cache owns the statement, otherwise the caller must
+   * finalize it.
+   */
+  bool add(const std::string& sql, sqlite3_stmt* stmt, size_t tail);
+
+  /// Reset a cached statement after it ran, evict it if it cannot be reused.
+  void reset(const std::string& sql, sqlite3_stmt* stmt, bool failed);
+
+  /// Finalize every cached statement.
+  void clear();
+
+  /// The number of cached statements.
+  size_t size() const {
+    return entries_.size();
+  }
+
+  /// Invalidate every cache, each is cleared before it is used again.
+  static void invalidate();
+
+ private:
+  struct Entry {
+    sqlite3_stmt* stmt{nullptr};
+    size_t tail{0};
+
+    /// The number of times SQLite re-prepared the statement when cached.
+    int reprepares{0};
+
+    /// Constraint indexes pinned in the tables' content.
+    PlannedIndexes indexes;
+
+    std::list<std::string>::iterator lru;
+  };
+
+  using Entries = std::unordered_map<std::string, Entry>;
+
+  /// Finalize a statement and release its pinned indexes.
+  void erase(Entries::iterator it);
+
+ private:
+  /// Cached statements, keyed by SQL text.
+  Entries entries_;
+
+  /// SQL text ordered from the most to the least recently used.
+  std::list<std::string> lru_;
+
+  /// Indexes planned since the last call to beginPlan.
+  PlannedIndexes planned_;
+
+  /// The invalidation generation the cached statements belong to.
+  uint64_t generation_{0};
+
+  static std::atomic<uint64_t> kGeneration;
+};
+
+} // namespace osquery
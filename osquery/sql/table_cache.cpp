@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/sql/table_cache.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/time.h>
+
+namespace osquery {
+
+FLAG(string,
+     table_cache_ttls,
+     "",
+     "Comma-separated table:seconds list of tables whose results are cached");
+
+FLAG(uint64,
+     table_cache_max_bytes,
+     64 * 1024 * 1024,
+     "Maximum estimated bytes of memory used by cached table results");
+
+namespace {
+
+/// Estimate the memory used by a copy of the rows.
+size_t estimateSize(const TableRows& rows) {
+  size_t bytes = 0;
+  for (const auto& row : rows) {
+    Row r = *row;
+    bytes += sizeof(Row);
+    for (const auto& column : r) {
+      bytes += 2 * sizeof(std::string) + column.first.size() +
+               column.second.size();
+    }
+  }
+  return bytes;
+}
+
+} // namespace
+
+TableResultCache& TableResultCache::get() {
+  static TableResultCache cache;
+  return cache;
+}
+
+void TableResultCache::updateTTLs() {
+  if (FLAGS_table_cache_ttls == ttls_source_) {
+    return;
+  }
+
+  ttls_source_ = FLAGS_table_cache_ttls;
+  ttls_.clear();
+  for (const auto& item : split(ttls_source_, ",")) {
+    auto separator = item.find(':');
+    if (separator == std::string::npos) {
+      LOG(WARNING) << "Invalid table cache TTL: " << item;
+      continue;
+    }
+
+    auto ttl = tryTo<uint64_t>(item.substr(separator + 1));
+    if (ttl.isError()) {
+      LOG(WARNING) << "Invalid table cache TTL: " << item;
+      continue;
+    }
+    ttls_[item.substr(0, separator)] = ttl.get();
+  }
+
+  // The cached results may have been stored with a different TTL.
+  entries_.clear();
+  lru_.clear();
+  bytes_ = 0;
+  for (auto& stats : stats_) {
+    stats.second.entries = 0;
+    stats.second.bytes = 0;
+  }
+}
+
+uint64_t TableResultCache::getTTL(const std::string& table,
+                                  TableAttributes attributes) {
+  if ((attributes & TableAttributes::EVENT_BASED) != 0) {
+    return 0;
+  }
+
+  WriteLock lock(mutex_);
+  updateTTLs();
+  auto it = ttls_.find(table);
+  return (it == ttls_.end()) ? 0 : it->second;
+}
+
+std::string TableResultCache::getKey(const std::string& table,
+                                     const QueryContext& context) {
+  // Lengths prefix each variable part so that keys cannot collide.
+  std::string key = table;
+  for (const auto& column : context.constraints) {
+    const auto& constraints = column.second.getAll();
+    if (constraints.empty()) {
+      continue;
+    }
+
+    key += '\0' + std::to_string(column.first.size()) + ':' + column.first;
+    for (const auto& constraint : constraints) {
+      key += '\0' + std::to_string(constraint.op) + ',' +
+             std::to_string(constraint.expr.size()) + ':' + constraint.expr;
+    }
+  }
+
+  if (context.colsUsedBitset) {
+    key += '\0' + context.colsUsedBitset->to_string();
+  }
+  return key;
+}
+
+bool TableResultCache::lookup(const std::string& table,
+                              const std::string& key,
+                              TableRows& rows) {
+  return lookup(table, key, rows, getUnixTime());
+}
+
+bool TableResultCache::lookup(const std::string& table,
+                              const std::string& key,
+                              TableRows& rows,
+                              uint64_t now) {
+  WriteLock lock(mutex_);
+  auto& stats = stats_[table];
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    stats.misses++;
+    return false;
+  }
+
+  if (it->second.expires <= now) {
+    stats.expirations++;
+    stats.misses++;
+    erase(it);
+    return false;
+  }
+
+  stats.hits++;
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+
+  rows.clear();
+  rows.reserve(it->second.rows.size());
+  for (const auto& row : it->second.rows) {
+    rows.push_back(row->clone());
+  }
+  return true;
+}
+
+void TableResultCache::store(const std::string& table,
+                             const std::string& key,
+                             uint64_t ttl,
+                             const TableRows& rows) {
+  store(table, key, ttl, rows, getUnixTime());
+}
+
+void TableResultCache::store(const std::string& table,
+                             const std::string& key,
+                             uint64_t ttl,
+                             const TableRows& rows,
+                             uint64_t now) {
+  if (ttl == 0) {
+    return;
+  }
+
+  auto bytes = estimateSize(rows) + key.size();
+  if (bytes > FLAGS_table_cache_max_bytes) {
+    VLOG(1) << "Results of table " << table
+            << " are too large to be cached: " << bytes << " bytes";
+    return;
+  }
+
+  Entry entry;
+  entry.table = table;
+  entry.bytes = bytes;
+  entry.expires = now + ttl;
+  entry.rows.reserve(rows.size());
+  for (const auto& row : rows) {
+    entry.rows.push_back(row->clone());
+  }
+
+  WriteLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    erase(it);
+  }
+
+  lru_.push_front(key);
+  entry.lru = lru_.begin();
+  entries_.emplace(key, std::move(entry));
+
+  auto& stats = stats_[table];
+  stats.entries++;
+  stats.bytes += bytes;
+  bytes_ += bytes;
+
+  // Evict the least recently used results, the new results are the most
+  // recently used and fit on their own.
+  while (bytes_ > FLAGS_table_cache_max_bytes) {
+    auto evicted = entries_.find(lru_.back());
+    stats_[evicted->second.table].evictions++;
+    erase(evicted);
+  }
+}
+
+void TableResultCache::erase(
+    std::unordered_map<std::string, Entry>::iterator it) {
+  auto& stats = stats_[it->second.table];
+  stats.entries--;
+  stats.bytes -= it->second.bytes;
+  bytes_ -= it->second.bytes;
+
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void TableResultCache::invalidate(const std::string& table) {
+  WriteLock lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    auto current = it++;
+    if (current->second.table == table) {
+      erase(current);
+    }
+  }
+}
+
+void TableResultCache::clear() {
+  WriteLock lock(mutex_);
+  while (!entries_.empty()) {
+    erase(entries_.begin());
+  }
+}
+
+void TableResultCache::getStats(
+    std::function<void(const std::string&, const TableCacheStats&)>
+        predicate) {
+  WriteLock lock(mutex_);
+  updateTTLs();
+  for (const auto& ttl : ttls_) {
+    stats_[ttl.first];
+  }
+
+  for (const auto& stats : stats_) {
+    auto ttl = ttls_.find(stats.first);
+    auto table_stats = stats.second;
+    table_stats.ttl = (ttl == ttls_.end()) ? 0 : ttl->second;
+    predicate(stats.first, table_stats);
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// Counters and usage of the result cache for a single table.
+struct TableCacheStats {
+  /// The configured time to live in seconds, 0 if caching is disabled.
+  uint64_t ttl{0};
+
+  /// Number of cached results, one per distinct constraint set.
+  size_t entries{0};
+
+  /// Estimated bytes of memory used by the cached results.
+  size_t bytes{0};
+
+  /// Number of table scans answered from the cache.
+  uint64_t hits{0};
+
+  /// Number of table scans that generated their results.
+  uint64_t misses{0};
+
+  /// Number of results evicted to stay within the memory budget.
+  uint64_t evictions{0};
+
+  /// Number of results dropped because their TTL elapsed.
+  uint64_t expirations{0};
+};
+
+/**
+ * @brief A TTL-based cache of table results shared by every query.
+ *
+ * Tables configured with `--table_cache_ttls` have the results of each scan
+ * kept for the table's TTL. Results are keyed on the table name, the
+ * constraints pushed down to the table, and the columns used, so scheduled
+ * queries, packs, and distributed queries selecting the same data from an
+ * expensive table share a single generation.
+ *
+ * The total estimated size of the cached results is bounded by
+ * `--table_cache_max_bytes`, least recently used results are evicted first.
+ * Event-based tables are never cached, their generation has side effects.
+ */
+class TableResultCache : private boost::noncopyable {
+ public:
+  /// Get the process-wide cache.
+  static TableResultCache& get();
+
+  /// Return the TTL configured for a table, 0 if it is not cached.
+  uint64_t getTTL(const std::string& table, TableAttributes attributes);
+
+  /// Build the cache key for a table scan.
+  static std::string getKey(const std::string& table,
+                            const QueryContext& context);
+
+  /**
+   * @brief Copy cached results for a key into rows.
+   *
+   * Counts a hit or a miss for the table.
+   *
+   * @return true if fresh results were found, otherwise false.
+   */
+  bool lookup(const std::string& table,
+              const std::string& key,
+              TableRows& rows);
+
+  /// Store a copy of the results generated for a key.
+  void store(const std::string& table,
+             const std::string& key,
+             uint64_t ttl,
+             const TableRows& rows);
+
+  /// Drop every cached result for a table.
+  void invalidate(const std::string& table);
+
+  /// Drop every cached result.
+  void clear();
+
+  /// Call a predicate with the stats of each table that used the cache.
+  void getStats(std::function<void(const std::string&,
+                                   const TableCacheStats&)> predicate);
+
+ public:
+  /// Lookup variant with an explicit time, used for testing expiry.
+  bool lookup(const std::string& table,
+              const std::string& key,
+              TableRows& rows,
+              uint64_t now);
+
+  /// Store variant with an explicit time, used for testing expiry.
+  void store(const std::string& table,
+             const std::string& key,
+             uint64_t ttl,
+             const TableRows& rows,
+             uint64_t now);
+
+ private:
+  TableResultCache() = default;
+
+  struct Entry {
+    std::string table;
+    TableRows rows;
+    size_t bytes{0};
+    uint64_t expires{0};
+    std::list<std::string>::iterator lru;
+  };
+
+  /// Parse the TTL flag again if it changed since the last call.
+  void updateTTLs();
+
+  /// Remove an entry, the caller must hold the lock.
+  void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+ private:
+  /// Cached results, keyed by scan.
+  std::unordered_map<std::string, Entry> entries_;
+
+  /// Cache keys ordered from the most to the least recently used.
+  std::list<std::string> lru_;
+
+  /// Per-table counters.
+  std::map<std::string, TableCacheStats> stats_;
+
+  /// Total estimated bytes of the cached results.
+  size_t bytes_{0};
+
+  /// Configured TTLs, parsed from the value of ttls_source_.
+  std::map<std::string, uint64_t> ttls_;
+  std::string ttls_source_;
+
+  Mutex mutex_;
+};
+
+} // namespace osquery
@@ -87,6 +87,90 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance_manager) {
   EXPECT_EQ(dbc1->db(), dbc1->db());
 }
 
+TEST_F(SQLiteUtilTests, test_sqlite_instance_pool) {
+  SQLiteDBManager::invalidatePool();
+  auto created = SQLiteDBManager::getPoolStats().created;
+
+  sqlite3* pooled_db = nullptr;
+  {
+    // Holding the primary makes the next request use the pool.
+    auto primary = SQLiteDBManager::get();
+    ASSERT_TRUE(primary->isPrimary());
+
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_FALSE(dbc->isPrimary());
+    pooled_db = dbc->db();
+
+    auto stats = SQLiteDBManager::getPoolStats();
+    EXPECT_EQ(created + 1, stats.created);
+    EXPECT_EQ(1U, stats.in_use);
+    EXPECT_EQ(0U, stats.idle);
+
+    QueryDataTyped results;
+    EXPECT_TRUE(queryInternal("select * from time", results, dbc).ok());
+    EXPECT_EQ(1U, results.size());
+  }
+
+  auto stats = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(0U, stats.in_use);
+  EXPECT_EQ(1U, stats.idle);
+
+  {
+    // The attached database is reused.
+    auto primary = SQLiteDBManager::get();
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_EQ(pooled_db, dbc->db());
+    EXPECT_EQ(created + 1, SQLiteDBManager::getPoolStats().created);
+
+    // A database with objects created by a query is not reused.
+    QueryDataTyped results;
+    queryInternal("create temp view pool_view as select 1", results, dbc);
+  }
+
+  stats = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(0U, stats.idle);
+  EXPECT_EQ(0U, stats.in_use);
+
+  {
+    auto primary = SQLiteDBManager::get();
+    auto dbc = SQLiteDBManager::get();
+    QueryDataTyped results;
+    EXPECT_FALSE(
+        queryInternal("select * from pool_view", results, dbc).ok());
+  }
+
+  // Invalidating the pool closes the idle databases.
+  EXPECT_EQ(1U, SQLiteDBManager::getPoolStats().idle);
+  SQLiteDBManager::invalidatePool();
+  EXPECT_EQ(0U, SQLiteDBManager::getPoolStats().idle);
+}
+
+TEST_F(SQLiteUtilTests, test_sqlite_instance_pool_exhausted) {
+  auto backup_size = Flag::getValue("sql_pool_size");
+  auto backup_wait = Flag::getValue("sql_pool_wait_ms");
+  Flag::updateValue("sql_pool_size", "1");
+  Flag::updateValue("sql_pool_wait_ms", "1");
+  SQLiteDBManager::invalidatePool();
+  auto before = SQLiteDBManager::getPoolStats();
+
+  {
+    auto primary = SQLiteDBManager::get();
+    auto dbc1 = SQLiteDBManager::get();
+    auto dbc2 = SQLiteDBManager::get();
+    EXPECT_FALSE(dbc2->isPrimary());
+    EXPECT_NE(dbc1->db(), dbc2->db());
+  }
+
+  auto stats = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(before.overflows + 1, stats.overflows);
+  EXPECT_EQ(before.waits + 1, stats.waits);
+  EXPECT_EQ(1U, stats.idle);
+
+  Flag::updateValue("sql_pool_size", backup_size);
+  Flag::updateValue("sql_pool_wait_ms", backup_wait);
+  SQLiteDBManager::invalidatePool();
+}
+
 TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   // Don't do this at home kids.
   // Keep a copy of the internal DB and let the SQLiteDBInstance go oos.
@@ -15,13 +15,19 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/planner_stats.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/table_cache.h>
 
 #include <osquery/sql/virtual_table.h>
 
 namespace osquery {
 
 DECLARE_bool(ignore_table_exceptions);
+DECLARE_bool(disable_filter_memo);
+DECLARE_string(table_cache_ttls);
+DECLARE_uint64(table_cache_max_bytes);
 
 class VirtualTableTests : public testing::Test {
  public:
@@ -29,6 +35,7 @@ class VirtualTableTests : public testing::Test {
     platformSetup();
     registryAndPluginInit();
     initDatabasePluginForTesting();
+    TablePlannerStats::get().clear();
   }
 };
 
@@ -630,6 +637,258 @@ TEST_F(VirtualTableTests, test_table_results_cache_colcheck) {
   EXPECT_EQ(cache->generates_, 2U);
 }
 
+TEST_F(VirtualTableTests, test_table_results_ttl_cache) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto cache = std::make_shared<tableCacheTablePlugin>();
+  tables->add("table_ttl_cache", cache);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_ttl_cache", dbc, false);
+
+  auto backup_ttls = FLAGS_table_cache_ttls;
+  FLAGS_table_cache_ttls = "table_ttl_cache:60";
+
+  // The TTL cache does not depend on the schedule's warm cache.
+  QueryData results;
+  queryInternal("SELECT * from table_ttl_cache", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(cache->generates_, 1U);
+
+  results.clear();
+  queryInternal("SELECT * from table_ttl_cache", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(cache->generates_, 1U);
+
+  // Constraints and used columns are part of the cache key.
+  results.clear();
+  queryInternal("SELECT * from table_ttl_cache where i = '1'", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(cache->generates_, 2U);
+
+  results.clear();
+  queryInternal("SELECT * from table_ttl_cache where i = '1'", results, dbc);
+  EXPECT_EQ(cache->generates_, 2U);
+
+  results.clear();
+  queryInternal("SELECT i from table_ttl_cache", results, dbc);
+  EXPECT_EQ(cache->generates_, 3U);
+
+  // Invalidation drops every result of the table.
+  TableResultCache::get().invalidate("table_ttl_cache");
+  results.clear();
+  queryInternal("SELECT * from table_ttl_cache", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(cache->generates_, 4U);
+
+  bool found = false;
+  TableResultCache::get().getStats(
+      [&found](const std::string& table, const TableCacheStats& stats) {
+        if (table == "table_ttl_cache") {
+          found = true;
+          EXPECT_EQ(stats.ttl, 60U);
+          EXPECT_EQ(stats.entries, 1U);
+          EXPECT_EQ(stats.hits, 2U);
+          EXPECT_EQ(stats.misses, 4U);
+        }
+      });
+  EXPECT_TRUE(found);
+
+  // Tables without a TTL are not cached.
+  FLAGS_table_cache_ttls = backup_ttls;
+  results.clear();
+  queryInternal("SELECT * from table_ttl_cache", results, dbc);
+  EXPECT_EQ(cache->generates_, 5U);
+}
+
+TEST_F(VirtualTableTests, test_table_results_ttl_cache_limits) {
+  auto& cache = TableResultCache::get();
+  cache.clear();
+
+  TableRows rows;
+  auto r = make_table_row();
+  r["data"] = std::string(100, 'a');
+  rows.push_back(std::move(r));
+
+  // Results expire once their TTL elapsed.
+  TableRows cached;
+  cache.store("limits", "first", 10, rows, 100);
+  EXPECT_TRUE(cache.lookup("limits", "first", cached, 109));
+  ASSERT_EQ(cached.size(), 1U);
+  EXPECT_EQ(static_cast<Row>(*cached[0])["data"], std::string(100, 'a'));
+  EXPECT_FALSE(cache.lookup("limits", "first", cached, 110));
+
+  // The least recently used results are evicted to respect the budget.
+  auto backup_max_bytes = FLAGS_table_cache_max_bytes;
+  cache.store("limits", "first", 10, rows, 100);
+  FLAGS_table_cache_max_bytes = 1024;
+  cache.store("limits", "second", 10, rows, 100);
+  cache.store("limits", "third", 10, rows, 100);
+  cache.store("limits", "fourth", 10, rows, 100);
+  EXPECT_TRUE(cache.lookup("limits", "second", cached, 100));
+  cache.store("limits", "fifth", 10, rows, 100);
+
+  EXPECT_FALSE(cache.lookup("limits", "first", cached, 100));
+  EXPECT_TRUE(cache.lookup("limits", "second", cached, 100));
+  EXPECT_TRUE(cache.lookup("limits", "fifth", cached, 100));
+
+  // Results larger than the budget are not cached.
+  auto large = make_table_row();
+  large["data"] = std::string(2048, 'a');
+  rows.clear();
+  rows.push_back(std::move(large));
+  cache.store("limits", "large", 10, rows, 100);
+  EXPECT_FALSE(cache.lookup("limits", "large", cached, 100));
+
+  FLAGS_table_cache_max_bytes = backup_max_bytes;
+  cache.clear();
+}
+
+class indexedTablePlugin : public TablePlugin {
+ public:
+  explicit indexedTablePlugin(bool batched_in) : batched_in_(batched_in) {}
+
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+    };
+  }
+
+  TableAttributes attributes() const override {
+    return batched_in_ ? TableAttributes::BATCHED_IN : TableAttributes::NONE;
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    generates_++;
+    TableRows results;
+    for (const auto& i : ctx.constraints["i"].getAll(EQUALS)) {
+      auto r = make_table_row();
+      r["i"] = i;
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+
+  bool batched_in_{false};
+  size_t generates_{0};
+};
+
+TEST_F(VirtualTableTests, test_filter_memo) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<indexedTablePlugin>(false);
+  tables->add("filter_memo", table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("filter_memo", dbc, false);
+
+  // The indexed table is filtered once for each value of the outer table.
+  std::string statement =
+      "SELECT m.i FROM (SELECT '1' AS v UNION ALL SELECT '1' UNION ALL "
+      "SELECT '1' UNION ALL SELECT '1' UNION ALL SELECT '2') t "
+      "JOIN filter_memo m ON m.i = t.v";
+
+  QueryData results;
+  auto status = queryInternal(statement, results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 5U);
+
+  // The first repeat of a filter is generated again and memoized.
+  EXPECT_EQ(table->generates_, 3U);
+
+  // The memoized rows do not outlive the statement.
+  results.clear();
+  queryInternal(statement, results, dbc);
+  EXPECT_EQ(results.size(), 5U);
+  EXPECT_EQ(table->generates_, 6U);
+
+  FLAGS_disable_filter_memo = true;
+  results.clear();
+  queryInternal(statement, results, dbc);
+  FLAGS_disable_filter_memo = false;
+  EXPECT_EQ(results.size(), 5U);
+  EXPECT_EQ(table->generates_, 11U);
+}
+
+TEST_F(VirtualTableTests, test_batched_in_constraints) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto batched = std::make_shared<indexedTablePlugin>(true);
+  tables->add("batched_in", batched);
+  auto unbatched = std::make_shared<indexedTablePlugin>(false);
+  tables->add("unbatched_in", unbatched);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("batched_in", dbc, false);
+  attachTableInternal("unbatched_in", dbc, false);
+
+  // All the values of the IN list are passed to a single generate.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT i FROM batched_in WHERE i IN ('a', 'b', 'c')", results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(batched->generates_, 1U);
+
+  // SQLite still checks each row against the IN list.
+  results.clear();
+  status = queryInternal(
+      "SELECT i FROM batched_in WHERE i IN ('a', 'b') AND i != 'a'",
+      results,
+      dbc);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["i"], "b");
+
+  // Tables that did not opt in are filtered once per value.
+  results.clear();
+  status = queryInternal(
+      "SELECT i FROM unbatched_in WHERE i IN ('a', 'b', 'c')", results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(unbatched->generates_, 3U);
+}
+
+TEST_F(VirtualTableTests, test_statement_cache) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<indexedTablePlugin>(true);
+  tables->add("statement_cache", table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("statement_cache", dbc, false);
+
+  // The constraints planned for a cached statement survive between queries.
+  std::string statement =
+      "SELECT i FROM statement_cache WHERE i IN ('a', 'b') AND i != 'c'";
+  for (size_t i = 1; i <= 3; i++) {
+    QueryData results;
+    auto status = queryInternal(statement, results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 2U);
+    EXPECT_EQ(results[0]["i"], "a");
+    EXPECT_EQ(table->generates_, i);
+    EXPECT_EQ(dbc->statements().size(), 1U);
+  }
+
+  // Each statement of a query is cached on its own, the last one is the
+  // statement already cached for the same text.
+  QueryData results;
+  queryInternal("SELECT i FROM statement_cache WHERE i = 'a'; " + statement,
+                results,
+                dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(dbc->statements().size(), 2U);
+
+  // Statements with side effects are not cached.
+  results.clear();
+  queryInternal("CREATE TEMP VIEW cached_view AS SELECT 1", results, dbc);
+  EXPECT_EQ(dbc->statements().size(), 2U);
+
+  // Invalidated statements are prepared and cached again.
+  SQLiteStatementCache::invalidate();
+  results.clear();
+  auto status = queryInternal(statement, results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(dbc->statements().size(), 1U);
+}
+
 class yieldTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -923,6 +1182,129 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, j->scans);
 }
 
+class hintedIndexTablePlugin : public indexIOptimizedTablePlugin {
+ private:
+  TablePlannerHints plannerHints() const override {
+    return {1000, 10000};
+  }
+};
+
+TEST_F(VirtualTableTests, test_planner_hints) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto hinted = std::make_shared<hintedIndexTablePlugin>();
+  table_registry->add("planner_hinted", hinted);
+  attachTableInternal("planner_hinted", dbc, false);
+
+  auto unhinted = std::make_shared<indexIOptimizedTablePlugin>();
+  table_registry->add("planner_unhinted", unhinted);
+  attachTableInternal("planner_unhinted", dbc, false);
+
+  // A full scan of the hinted table is more expensive than filtering it once
+  // for each row of the other table, even though it is listed first.
+  QueryData results;
+  queryInternal(
+      "SELECT * FROM planner_hinted JOIN planner_unhinted USING (i);",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(100U, results.size());
+  EXPECT_EQ(1U, unhinted->scans);
+  EXPECT_EQ(100U, hinted->scans);
+
+  // Each generate was recorded against its constraint shape.
+  TableScanStats stats;
+  ASSERT_TRUE(TablePlannerStats::get().lookup("planner_unhinted", "", stats));
+  EXPECT_EQ(1U, stats.scans);
+  EXPECT_EQ(100.0, stats.rows);
+
+  ConstraintSet constraints = {{"i", Constraint(EQUALS)}};
+  auto shape = TablePlannerStats::getShape(constraints, {});
+  ASSERT_TRUE(TablePlannerStats::get().lookup("planner_hinted", shape, stats));
+  EXPECT_EQ(100U, stats.scans);
+  EXPECT_EQ(1.0, stats.rows);
+  EXPECT_FALSE(TablePlannerStats::get().lookup("planner_hinted", "", stats));
+}
+
+class requiredIOptimizedTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::REQUIRED),
+        std::make_tuple("text", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    scans++;
+
+    TableRows results;
+    for (const auto& i : context.constraints["i"].getAll<int>(EQUALS)) {
+      results.push_back(make_table_row({{"i", INTEGER(i)}, {"text", "none"}}));
+    }
+    return results;
+  }
+
+  // Here the goal is to expect/assume the number of scans.
+  size_t scans{0};
+};
+
+TEST_F(VirtualTableTests, test_planner_slow_required) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto required = std::make_shared<requiredIOptimizedTablePlugin>();
+  table_registry->add("planner_required", required);
+  attachTableInternal("planner_required", dbc, false);
+
+  auto default_scan = std::make_shared<defaultScanTablePlugin>();
+  table_registry->add("planner_default", default_scan);
+  attachTableInternal("planner_default", dbc, false);
+
+  // Each constrained scan was observed to take longer than the max-cost.
+  ConstraintSet constraints = {{"i", Constraint(EQUALS)}};
+  auto shape = TablePlannerStats::getShape(constraints, {});
+  TablePlannerStats::get().record("planner_required", shape, 1, 5000000);
+
+  // The required column must still be satisfied from the other table.
+  QueryData results;
+  queryInternal(
+      "SELECT * FROM planner_required JOIN planner_default USING (i);",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(10U, results.size());
+  EXPECT_EQ(10U, required->scans);
+  EXPECT_EQ(1U, default_scan->scans);
+}
+
+TEST_F(VirtualTableTests, test_planner_stats) {
+  // The shape does not depend on the order SQLite offers constraints in.
+  ConstraintSet first = {{"path", Constraint(EQUALS)},
+                         {"directory", Constraint(LIKE)}};
+  ConstraintSet second = {{"directory", Constraint(LIKE)},
+                          {"path", Constraint(EQUALS)}};
+  auto shape = TablePlannerStats::getShape(first, {});
+  EXPECT_EQ(shape, TablePlannerStats::getShape(second, {}));
+  EXPECT_NE(shape, TablePlannerStats::getShape(first, {0}));
+
+  auto& planner_stats = TablePlannerStats::get();
+  planner_stats.record("stats_table", shape, 10, 100);
+  planner_stats.record("stats_table", shape, 20, 100);
+
+  // Later observations move the averages gradually.
+  TableScanStats stats;
+  ASSERT_TRUE(planner_stats.lookup("stats_table", shape, stats));
+  EXPECT_EQ(2U, stats.scans);
+  EXPECT_EQ(12.5, stats.rows);
+  EXPECT_EQ(100.0, stats.usec);
+
+  planner_stats.clear();
+  EXPECT_FALSE(planner_stats.lookup("stats_table", shape, stats));
+}
+
 class colsUsedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
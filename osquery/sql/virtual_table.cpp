@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <unordered_set>
 
 #include <osquery/core/core.h>
@@ -18,6 +20,8 @@
 #include <osquery/process/process.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/planner_stats.h>
+#include <osquery/sql/table_cache.h>
 #include <osquery/sql/virtual_table.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -46,6 +50,16 @@ FLAG(bool,
 
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
+FLAG(bool,
+     disable_filter_memo,
+     false,
+     "Disable reusing rows for repeated table filters within a statement");
+
+FLAG(bool,
+     disable_planner_stats,
+     false,
+     "Disable planning table scans using their observed generate costs");
+
 DECLARE_bool(disable_events);
 
 RecursiveMutex kAttachMutex;
@@ -66,6 +80,9 @@ static std::atomic<size_t> kConstraintIndexID{0};
 /// We consider the max-cost as an error-state, e.g., unusable constraints.
 const double kMaxIndexCost{1000000};
 
+/// Estimates stay below the max-cost so missing requirements always lose.
+const double kMaxEstimatedCost{kMaxIndexCost - 1};
+
 static inline std::string opString(unsigned char op) {
   switch (op) {
   case EQUALS:
@@ -519,6 +536,11 @@ int xUpdate(sqlite3_vtab* p,
     return SQLITE_ERROR;
   }
 
+  // The table contents changed, drop its cached results.
+  TableResultCache::get().invalidate(table_name);
+  content->filterRequests.clear();
+  content->filterMemo.clear();
+
   // INSERT actions must always return a valid rowid to sqlite
   if (plugin_request.at("action") == "insert") {
     std::string rowid;
@@ -672,6 +694,17 @@ int xCreate(sqlite3* db,
               static_cast<TableAttributes>(attr.take());
         }
       }
+    } else if (cid->second == "plannerHints") {
+      auto crows = column.find("rows");
+      auto ccost = column.find("cost");
+      if (crows != column.end() && ccost != column.end()) {
+        auto rows = tryTo<uint64_t>(crows->second);
+        auto cost = tryTo<uint64_t>(ccost->second);
+        if (rows && cost) {
+          pVtab->content->plannerHints.rows = rows.take();
+          pVtab->content->plannerHints.cost = cost.take();
+        }
+      }
     }
   }
 
@@ -702,6 +735,44 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
   return row->get_column(ctx, cur->pVtab, col);
 }
 
+/**
+ * @brief Estimate the rows and cost of a scan for the planner.
+ *
+ * Observed generate costs for the constraint shape are preferred, otherwise
+ * the table's planner hints are used. An equality on an index or required
+ * column is expected to return a single row. The cost is in microseconds,
+ * capped below kMaxIndexCost so a slow constrained scan is still preferred
+ * over a plan missing a required constraint.
+ *
+ * @return The source of the estimate, empty if the table has neither.
+ */
+static std::string estimateScan(const VirtualTableContent& content,
+                                const std::string& shape,
+                                bool equality,
+                                double& cost,
+                                sqlite3_int64& rows) {
+  TableScanStats stats;
+  if (!FLAGS_disable_planner_stats &&
+      TablePlannerStats::get().lookup(content.name, shape, stats)) {
+    rows = std::max<sqlite3_int64>(1, std::llround(stats.rows));
+    cost = std::min(kMaxEstimatedCost, std::max(1.0, stats.usec));
+    return "observed";
+  }
+
+  // Tables with only a cost hint cannot estimate an unconstrained scan.
+  const auto& hints = content.plannerHints;
+  if (hints.rows == 0 && (hints.cost == 0 || !equality)) {
+    return "";
+  }
+
+  rows = equality ? 1 : static_cast<sqlite3_int64>(hints.rows);
+  if (hints.cost > 0) {
+    cost = std::min(kMaxEstimatedCost,
+                    std::max(1.0, static_cast<double>(hints.cost * rows)));
+  }
+  return "hints";
+}
+
 static inline bool sensibleComparison(ColumnType type, unsigned char op) {
   if (type == TEXT_TYPE) {
     if (op == GREATER_THAN || op == GREATER_THAN_OR_EQUALS || op == LESS_THAN ||
@@ -719,6 +790,9 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   pVtab->instance->addAffectedTable(pVtab->content);
 
   ConstraintSet constraints;
+  std::set<size_t> in_list_constraints;
+  bool batched_in =
+      (pVtab->content->attributes & TableAttributes::BATCHED_IN) > 0;
   // Keep track of the index used for each valid constraint.
   // Expect this index to correspond with argv within xFilter.
   size_t expr_index = 0;
@@ -728,6 +802,8 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   // Tables may have requirements or use indexes.
   bool hasRequiredColumns = false;
   bool hasRequiredConstraints = false;
+  // An equality on an index or required column selects a single row.
+  bool equality = false;
 
   // Expressions operating on the same virtual table are loosely identified by
   // the consecutive sets of terms each of the constraint sets are applied onto.
@@ -773,6 +849,10 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
         continue;
       }
 
+      if (constraint_info.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+        equality = true;
+      }
+
       // Save a pair of the name and the constraint operator.
       // Use this constraint during xFilter by performing a scan and column
       // name lookup through out all cursor constraint lists.
@@ -789,11 +869,21 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
 
       pIdxInfo->aConstraintUsage[i].argvIndex = static_cast<int>(++expr_index);
 
+      // Tables that opt in receive every value of an IN list in one filter.
+      bool in_list = batched_in &&
+                     constraint_info.op == SQLITE_INDEX_CONSTRAINT_EQ &&
+                     sqlite3_vtab_in(pIdxInfo, static_cast<int>(i), -1) != 0;
+      if (in_list) {
+        sqlite3_vtab_in(pIdxInfo, static_cast<int>(i), 1);
+        in_list_constraints.insert(constraints.size() - 1);
+      }
+
       if (FLAGS_planner) {
         plan("xBestIndex Adding index constraint for table: " +
              pVtab->content->name + " [column=" + name +
              " arg_index=" + std::to_string(expr_index) +
-             " op=" + std::to_string(constraint_info.op) + "]");
+             " op=" + std::to_string(constraint_info.op) +
+             " in_list=" + std::to_string(in_list) + "]");
       }
     }
   }
@@ -831,14 +921,29 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
 
   // Return max-cost if a required constraint is not present.
   // For example, you can't do a hash of a file if path not provided.
+  std::string estimate;
+  sqlite3_int64 rows = 0;
   if (hasRequiredColumns && !hasRequiredConstraints) {
     cost = kMaxIndexCost;
+  } else {
+    estimate = estimateScan(
+        *pVtab->content,
+        TablePlannerStats::getShape(constraints, in_list_constraints),
+        equality,
+        cost,
+        rows);
+    if (!estimate.empty()) {
+      pIdxInfo->estimatedRows = rows;
+    }
   }
 
   pIdxInfo->idxNum = static_cast<int>(kConstraintIndexID++);
   if (FLAGS_planner) {
     plan("xBestIndex Recording constraint set for table: " +
          pVtab->content->name + " [cost=" + std::to_string(cost) +
+         " rows=" +
+         (estimate.empty() ? std::string("default") : std::to_string(rows)) +
+         " estimate=" + (estimate.empty() ? std::string("none") : estimate) +
          " size=" + std::to_string(constraints.size()) +
          " idx=" + std::to_string(pIdxInfo->idxNum) + "]");
   }
@@ -846,8 +951,16 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
   pVtab->content->colsUsed[pIdxInfo->idxNum] = std::move(colsUsed);
   pVtab->content->colsUsedBitsets[pIdxInfo->idxNum] = colsUsedBitset;
+  if (!in_list_constraints.empty()) {
+    pVtab->content->inListConstraints[pIdxInfo->idxNum] =
+        std::move(in_list_constraints);
+  }
   pIdxInfo->estimatedCost = cost;
 
+  // A cached statement keeps the constraint sets it was planned with.
+  pVtab->instance->statements().addPlannedIndex(
+      pVtab->content, static_cast<size_t>(pIdxInfo->idxNum));
+
   return SQLITE_OK;
 }
 
@@ -913,10 +1026,38 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   }
 
   // Iterate over every argument to xFilter, filling in constraint values.
+  std::string shape;
   if (content->constraints.size() > 0) {
     auto& constraints = content->constraints[idxNum];
+    const auto& in_lists = content->inListConstraints[idxNum];
+    shape = TablePlannerStats::getShape(constraints, in_lists);
     if (argc > 0) {
       for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
+        if (in_lists.count(i) > 0 && i < constraints.size()) {
+          // Expand the IN list into an EQUALS constraint for each value.
+          auto& constraint = constraints[i];
+          size_t count = 0;
+          sqlite3_value* value = nullptr;
+          for (auto rc = sqlite3_vtab_in_first(argv[i], &value);
+               rc == SQLITE_OK && value != nullptr;
+               rc = sqlite3_vtab_in_next(argv[i], &value)) {
+            auto expr = (const char*)sqlite3_value_text(value);
+            if (expr == nullptr || expr[0] == 0) {
+              continue;
+            }
+            context.constraints[constraint.first].add(
+                Constraint(constraint.second.op, std::string(expr)));
+            count++;
+          }
+
+          if (FLAGS_planner) {
+            plan("xFilter Adding IN list constraint to cursor (" +
+                 std::to_string(pCur->id) + "): " + constraint.first + " [" +
+                 std::to_string(count) + " values]");
+          }
+          continue;
+        }
+
         auto expr = (const char*)sqlite3_value_text(argv[i]);
         if (expr == nullptr || expr[0] == 0) {
           // SQLite did not expose the expression value.
@@ -993,13 +1134,54 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
+  // Tables configured with a result cache TTL may reuse a previous scan.
+  auto& result_cache = TableResultCache::get();
+  auto cache_ttl = result_cache.getTTL(content->name, content->attributes);
+  std::string cache_key;
+  if (cache_ttl > 0 || !FLAGS_disable_filter_memo) {
+    cache_key = TableResultCache::getKey(content->name, context);
+  }
+
+  // A JOIN may repeat the same filter, reuse the rows generated before.
+  bool memoize = false;
+  if (!FLAGS_disable_filter_memo) {
+    auto memo_it = content->filterMemo.find(cache_key);
+    if (memo_it != content->filterMemo.end()) {
+      pCur->rows.reserve(memo_it->second.size());
+      for (const auto& row : memo_it->second) {
+        pCur->rows.push_back(row->clone());
+      }
+      pCur->n = pCur->rows.size();
+      if (FLAGS_planner) {
+        plan("xFilter " + content->name +
+             " returned memoized row count:" + std::to_string(pCur->n));
+      }
+      return SQLITE_OK;
+    }
+
+    // Rows are kept from the first repeat of a request, most are not.
+    memoize = !content->filterRequests.insert(cache_key).second;
+  }
+
+  if (cache_ttl > 0) {
+    if (result_cache.lookup(content->name, cache_key, pCur->rows)) {
+      pCur->n = pCur->rows.size();
+      if (FLAGS_planner) {
+        plan("xFilter " + content->name +
+             " returned cached row count:" + std::to_string(pCur->n));
+      }
+      return SQLITE_OK;
+    }
+  }
+
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
+  auto generate_start = std::chrono::steady_clock::now();
   if (Registry::get().exists("table", pVtab->content->name, true)) {
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
     try {
-      if (table->usesGenerator()) {
+      if (table->usesGenerator() && cache_ttl == 0) {
         pCur->uses_generator = true;
         pCur->generator = std::make_unique<RowGenerator::pull_type>(
             std::bind(&TablePlugin::generator,
@@ -1011,7 +1193,19 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
         }
         return SQLITE_OK;
       }
-      pCur->rows = table->generate(context);
+
+      if (table->usesGenerator()) {
+        // Collect the generated rows so they can be cached.
+        RowGenerator::pull_type generator(std::bind(&TablePlugin::generator,
+                                                    table,
+                                                    std::placeholders::_1,
+                                                    std::move(context)));
+        for (; generator; generator()) {
+          pCur->rows.push_back(generator.get());
+        }
+      } else {
+        pCur->rows = table->generate(context);
+      }
     } catch (const std::exception& e) {
       LOG(ERROR) << "Exception while executing table " << pVtab->content->name
                  << ": " << e.what();
@@ -1038,6 +1232,27 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   // Set the number of rows.
   pCur->n = pCur->rows.size();
 
+  // Streamed generators are not recorded, SQLite interleaves their rows.
+  if (!FLAGS_disable_planner_stats) {
+    auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - generate_start)
+                    .count();
+    TablePlannerStats::get().record(
+        content->name, shape, pCur->n, static_cast<uint64_t>(usec));
+  }
+
+  if (cache_ttl > 0) {
+    result_cache.store(content->name, cache_key, cache_ttl, pCur->rows);
+  }
+
+  if (memoize) {
+    auto& memo = content->filterMemo[cache_key];
+    memo.reserve(pCur->rows.size());
+    for (const auto& row : pCur->rows) {
+      memo.push_back(row->clone());
+    }
+  }
+
   if (FLAGS_planner) {
     plan("xFilter " + pVtab->content->name +
          " generate returned row count:" + std::to_string(pCur->n));
@@ -1124,6 +1339,9 @@ Status attachTableInternal(const std::string& name,
 
 Status detachTableInternal(const std::string& name,
                            const SQLiteDBInstanceRef& instance) {
+  // Results cached from a detached table, such as an extension's, are stale.
+  TableResultCache::get().invalidate(name);
+
   auto lock(instance->attachLock());
   auto format = "DROP TABLE IF EXISTS temp." + name;
   int rc = sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, 0);
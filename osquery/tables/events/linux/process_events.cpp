@@ -276,8 +276,9 @@ Status AuditProcessEventSubscriber::ProcessExecveEventData(
 
   row["cmdline"].clear();
 
-  for (const auto& arg : execve_event_record->fields) {
-    if (arg.first == "argc") {
+  const auto& args = execve_event_record->fields;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (args.key(i) == AuditFieldKey::Argc) {
       continue;
     }
 
@@ -285,7 +286,7 @@ Status AuditProcessEventSubscriber::ProcessExecveEventData(
       row["cmdline"] += ' ';
     }
 
-    row["cmdline"] += DecodeAuditPathValues(arg.second);
+    row["cmdline"] += DecodeAuditPathValues(std::string(args.value(i)));
   }
 
   row["cmdline_size"] = std::to_string(row["cmdline"].size());
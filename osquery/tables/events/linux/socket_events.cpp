@@ -296,8 +296,9 @@ Status SocketEventSubscriber::ProcessEvents(
     CopyFieldFromMap(row, syscall_event_record->fields, "pid");
     GetStringFieldFromMap(row["fd"], syscall_event_record->fields, "a0");
 
-    row["path"] = DecodeAuditPathValues(syscall_event_record->fields.at("exe"));
-    row["fd"] = syscall_event_record->fields.at("a0");
+    row["path"] = DecodeAuditPathValues(
+        std::string(syscall_event_record->fields.at("exe")));
+    row["fd"] = std::string(syscall_event_record->fields.at("a0"));
     row["uptime"] = std::to_string(getUptime());
 
     // Set some sane defaults and then attempt to parse the sockaddr value
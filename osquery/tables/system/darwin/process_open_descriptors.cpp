@@ -17,6 +17,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 namespace osquery {
 namespace tables {
@@ -237,7 +238,7 @@ QueryData genOpenSockets(QueryContext& context) {
   return results;
 }
 
-QueryData genOpenFiles(QueryContext& context) {
+TableRows genOpenFiles(QueryContext& context) {
   QueryData results;
 
   auto pidlist = getProcList(context);
@@ -250,7 +251,7 @@ QueryData genOpenFiles(QueryContext& context) {
     genOpenDescriptors(pid, DESCRIPTORS_TYPE_VNODE, results);
   }
 
-  return results;
+  return tableRowsFromQueryData(std::move(results));
 }
 } // namespace tables
 } // namespace osquery
@@ -24,6 +24,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/rows/processes.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 #include <chrono>
 
@@ -796,7 +797,7 @@ static std::string getProcPath(int pid) {
   return std::string(path);
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
+TableRows genProcessMemoryMap(QueryContext& context) {
   QueryData results;
 
   auto pidlist = getProcList(context);
@@ -804,7 +805,7 @@ QueryData genProcessMemoryMap(QueryContext& context) {
     genProcessMemoryMap(pid, results);
   }
 
-  return results;
+  return tableRowsFromQueryData(std::move(results));
 }
 } // namespace tables
 } // namespace osquery
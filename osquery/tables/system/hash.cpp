@@ -16,17 +16,27 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <set>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <osquery/core/flags.h>
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/hash.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/mutex.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -42,6 +52,16 @@ FLAG(bool,
 
 FLAG(uint32, hash_cache_max, 500, "Size of LRU file hash cache");
 
+FLAG(bool,
+     hash_cache_persist,
+     false,
+     "Persist the file hash cache in the database across restarts");
+
+FLAG(uint32,
+     hash_workers,
+     4,
+     "Number of threads hashing files for a single hash query");
+
 HIDDEN_FLAG(uint32,
             hash_delay,
             20,
@@ -51,185 +71,388 @@ DECLARE_uint64(read_max);
 
 namespace tables {
 
-/// Clear this amount of rows every time cache eviction is triggered.
-const size_t kHashCacheEvictSize{5};
+/// Database key prefix for persisted file hashes.
+const std::string kHashCachePrefix{"hash_cache."};
 
-/**
- * @brief Implements persistent in-memory caching of files' hashes.
- *
- * This cache has LRU eviction policy. The hash is recalculated
- * every time the mtime or size of the file changes.
- */
-struct FileHashCache {
-  /// The file's modification time, changes with a touch.
-  time_t file_mtime;
+/// The hashes computed for every file.
+const int kHashMask{HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256};
 
-  /// The file's serial or information number (inode).
-  ino_t file_inode;
+#if defined(WIN32)
 
-  /// The file's size.
-  off_t file_size;
+#define stat _stat
+#define strerror_r(e, buf, sz) strerror_s((buf), (sz), (e))
 
-  /// For eviction, the last time this cache item was used.
-  time_t cache_access_time;
+#endif
 
-  /// Cache content, the hashes.
-  MultiHashes hashes;
+std::string FileHashKey::toString() const {
+  return std::to_string(device) + "." + std::to_string(inode) + "." +
+         std::to_string(mtime) + "." + std::to_string(size) + "." + path;
+}
 
-  /// Cache index, the file path.
-  std::string path;
+size_t FileHashKeyHasher::operator()(const FileHashKey& key) const {
+  size_t seed = 0;
+  boost::hash_combine(seed, key.device);
+  boost::hash_combine(seed, key.inode);
+  boost::hash_combine(seed, key.mtime);
+  boost::hash_combine(seed, key.size);
+  boost::hash_combine(seed, key.path);
+  return seed;
+}
 
-  /// Comparison function for organizing the LRU heap.
-  static bool greater(const FileHashCache* l, const FileHashCache* r) {
-    return l->cache_access_time > r->cache_access_time;
-  }
+FileHashCache& FileHashCache::get() {
+  static FileHashCache cache;
+  return cache;
+}
 
-  /**
-   * @brief Do-it-all access function.
-   *
-   * Maintains the cache of hash sums, stats file at path, if it has changed or
-   * it is not present in cache calculates the hashes and caches the result.
-   *
-   * @param path the path of file to hash.
-   * @param out stores the calculated hashes.
-   *
-   * @return true if succeeded, false if something went wrong.
-   */
-  static bool load(const std::string& path, MultiHashes& out, Logger& logger);
-};
+namespace {
 
-#if defined(WIN32)
+/// Parse a persisted key, the path may contain the separator.
+bool parseFileHashKey(const std::string& value, FileHashKey& key) {
+  std::vector<std::string> fields;
+  size_t begin = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    auto end = value.find('.', begin);
+    if (end == std::string::npos) {
+      return false;
+    }
+    fields.push_back(value.substr(begin, end - begin));
+    begin = end + 1;
+  }
 
-#define stat _stat
-#define strerror_r(e, buf, sz) strerror_s((buf), (sz), (e))
+  auto device = tryTo<unsigned long long>(fields[0]);
+  auto inode = tryTo<unsigned long long>(fields[1]);
+  auto mtime = tryTo<long long>(fields[2]);
+  auto size = tryTo<long long>(fields[3]);
+  if (device.isError() || inode.isError() || mtime.isError() ||
+      size.isError()) {
+    return false;
+  }
 
-#endif
+  key.device = device.take();
+  key.inode = inode.take();
+  key.mtime = mtime.take();
+  key.size = size.take();
+  key.path = value.substr(begin);
+  return true;
+}
 
-/**
- * @brief Checks the current stat output against the cached view.
- *
- * If the modified/altered time or the file's inode has changed then the hash
- * should be recalculated.
- */
-static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
-  if (st.st_ino != fh.file_inode || st.st_mtime != fh.file_mtime) {
-    // Most plausible case for modification detection.
-    return true;
+/// Parse persisted hashes, stored as the mask and each hash.
+bool parseMultiHashes(const std::string& value, MultiHashes& hashes) {
+  auto parts = osquery::split(value, ",");
+  if (parts.size() != 4) {
+    return false;
+  }
+
+  auto mask = tryTo<int>(parts[0]);
+  if (mask.isError()) {
+    return false;
   }
 
-  if (st.st_size != fh.file_size) {
-    // Just in case there's tomfoolery.
-    return true;
+  hashes.mask = mask.take();
+  hashes.md5 = parts[1];
+  hashes.sha1 = parts[2];
+  hashes.sha256 = parts[3];
+  return true;
+}
+
+void deletePersistedHashes(const std::list<FileHashKey>& keys) {
+  for (const auto& key : keys) {
+    deleteDatabaseValue(kPersistentSettings, kHashCachePrefix + key.toString());
   }
-  return false;
 }
 
-bool FileHashCache::load(const std::string& path,
-                         MultiHashes& out,
-                         Logger& logger) {
-  // synchronize the access to cache
-  static Mutex mx;
-  // path => cache entry
-  static std::unordered_map<std::string, FileHashCache> cache;
-  // minheap on cache_access_time
-  static std::vector<FileHashCache*> lru;
-
-  WriteLock guard(mx);
-
-  struct stat st;
-  if (stat(path.c_str(), &st) != 0) {
-    char buf[0x200] = {0};
-    strerror_r(errno, buf, sizeof(buf));
-    logger.log(google::GLOG_WARNING, "Cannot stat file: " + path + ": " + buf);
+} // namespace
+
+size_t FileHashCache::getShardIndex(const FileHashKey& key) const {
+  auto shards = std::min<size_t>(
+      kShards, std::max<size_t>(1, FLAGS_hash_cache_max));
+  return FileHashKeyHasher()(key) % shards;
+}
+
+bool FileHashCache::lookup(const FileHashKey& key, MultiHashes& hashes) {
+  if (FLAGS_hash_cache_persist) {
+    restore();
+  }
+
+  // Hashes cached before a restart were loaded with the rest.
+  auto& shard = shards_[getShardIndex(key)];
+  WriteLock lock(shard.mutex);
+  auto it = shard.entries.find(key);
+  if (it == shard.entries.end()) {
     return false;
   }
 
-  auto entry = cache.find(path);
-  if (entry == cache.end()) { // none, load
-    if (cache.size() >= FLAGS_hash_cache_max) {
-      // too large, evict
-      for (size_t i = 0; i < kHashCacheEvictSize; ++i) {
-        if (lru.empty()) {
-          continue;
-        }
-        std::string key = lru[0]->path;
-        std::pop_heap(lru.begin(), lru.end(), FileHashCache::greater);
-        lru.pop_back();
-        if (cache.find(key) != cache.end()) {
-          cache.erase(key);
-        }
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  hashes = it->second->second;
+  return true;
+}
+
+void FileHashCache::store(const FileHashKey& key, const MultiHashes& hashes) {
+  if (FLAGS_hash_cache_persist) {
+    restore();
+  }
+
+  auto index = getShardIndex(key);
+  std::list<FileHashKey> evicted;
+  {
+    WriteLock lock(shards_[index].mutex);
+    evicted = insert(index, key, hashes);
+  }
+
+  if (!FLAGS_hash_cache_persist) {
+    return;
+  }
+
+  deletePersistedHashes(evicted);
+
+  // Empty hashes are kept only in memory, the file may become readable.
+  if (hashes.md5.empty() && hashes.sha1.empty() && hashes.sha256.empty()) {
+    return;
+  }
+
+  setDatabaseValue(kPersistentSettings,
+                   kHashCachePrefix + key.toString(),
+                   std::to_string(hashes.mask) + "," + hashes.md5 + "," +
+                       hashes.sha1 + "," + hashes.sha256);
+}
+
+std::list<FileHashKey> FileHashCache::insert(size_t index,
+                                             const FileHashKey& key,
+                                             const MultiHashes& hashes) {
+  auto& shard = shards_[index];
+  auto it = shard.entries.find(key);
+  if (it != shard.entries.end()) {
+    it->second->second = hashes;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return {};
+  }
+
+  shard.lru.emplace_front(key, hashes);
+  shard.entries[key] = shard.lru.begin();
+
+  // Split the cache size between the shards in use, the first shards keep
+  // the remainder.
+  size_t max = std::max<size_t>(1, FLAGS_hash_cache_max);
+  size_t shards = std::min(kShards, max);
+  size_t shard_max = max / shards + ((index < max % shards) ? 1 : 0);
+  std::list<FileHashKey> evicted;
+  while (shard.lru.size() > shard_max) {
+    evicted.push_back(std::move(shard.lru.back().first));
+    shard.entries.erase(evicted.back());
+    shard.lru.pop_back();
+  }
+  return evicted;
+}
+
+void FileHashCache::restore() {
+  if (restored_) {
+    return;
+  }
+
+  WriteLock lock(restore_mutex_);
+  if (restored_) {
+    return;
+  }
+
+  // Every persisted entry is kept in memory, so it is deleted when evicted.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kPersistentSettings, keys, kHashCachePrefix);
+  std::list<FileHashKey> evicted;
+  for (const auto& persisted : keys) {
+    FileHashKey key;
+    MultiHashes hashes;
+    std::string value;
+    if (!parseFileHashKey(persisted.substr(kHashCachePrefix.size()), key) ||
+        !getDatabaseValue(kPersistentSettings, persisted, value).ok() ||
+        !parseMultiHashes(value, hashes)) {
+      deleteDatabaseValue(kPersistentSettings, persisted);
+      continue;
+    }
+
+    auto index = getShardIndex(key);
+    WriteLock shard_lock(shards_[index].mutex);
+    evicted.splice(evicted.end(), insert(index, key, hashes));
+  }
+  deletePersistedHashes(evicted);
+  restored_ = true;
+}
+
+void FileHashCache::clear() {
+  for (auto& shard : shards_) {
+    WriteLock lock(shard.mutex);
+    shard.entries.clear();
+    shard.lru.clear();
+  }
+  restored_ = false;
+}
+
+size_t FileHashCache::size() {
+  size_t entries = 0;
+  for (auto& shard : shards_) {
+    WriteLock lock(shard.mutex);
+    entries += shard.lru.size();
+  }
+  return entries;
+}
+
+namespace {
+
+/// A file to hash, and the results for each row using it.
+struct HashRequest {
+  std::string path;
+  MultiHashes hashes{};
+  FileHashKey key;
+
+  /// The file could be stat-ed and its hashes cached.
+  bool cacheable{false};
+
+  /// The hashes must be computed.
+  bool pending{false};
+
+  /// The warning to log if the file could not be stat-ed.
+  std::string error;
+};
+
+/// A row of the hash table, referring to a request for its hashes.
+struct HashRow {
+  std::string path;
+  std::string directory;
+  size_t request{0};
+};
+
+FileHashKey getFileHashKey(const std::string& path, const struct stat& st) {
+  FileHashKey key;
+  key.device = static_cast<uint64_t>(st.st_dev);
+  key.inode = static_cast<uint64_t>(st.st_ino);
+  key.mtime = static_cast<int64_t>(st.st_mtime);
+  key.size = static_cast<int64_t>(st.st_size);
+  if (key.inode == 0) {
+    // Files cannot be told apart without an inode number.
+    key.path = path;
+  }
+  return key;
+}
+
+/// Compute the pending hashes, spreading the files across worker threads.
+void hashRequests(std::vector<HashRequest>& requests) {
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (requests[i].pending) {
+      pending.push_back(i);
+    }
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&requests, &pending, &next]() {
+    for (auto i = next++; i < pending.size(); i = next++) {
+      auto& request = requests[pending[i]];
+      request.hashes = hashMultiFromFile(kHashMask, request.path);
+      if (FLAGS_disable_hash_cache) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(FLAGS_hash_delay));
       }
     }
+  };
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    FileHashCache rec = {st.st_mtime, // .file_mtime
-                         st.st_ino, // .file_inode
-                         st.st_size, // .file_size
-                         time(nullptr), // .cache_access_time
-                         std::move(hashes), // .hashes
-                         path}; // .path
-    cache[path] = std::move(rec);
-    lru.push_back(&cache[path]);
-    std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    entry->second.cache_access_time = time(nullptr);
-    entry->second.file_inode = st.st_ino;
-    entry->second.file_mtime = st.st_mtime;
-    entry->second.file_size = st.st_size;
-    entry->second.hashes = std::move(hashes);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = entry->second.hashes;
-  } else { // ok, got it
-    out = entry->second.hashes;
-    entry->second.cache_access_time = time(nullptr);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
+  size_t workers = std::min<size_t>(
+      std::max<uint32_t>(1, FLAGS_hash_workers), pending.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+
+  // The calling thread is one of the workers.
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
   }
-  return true;
 }
 
-void genHashForFile(const std::string& path,
-                    const std::string& dir,
-                    QueryContext& context,
-                    QueryData& results,
-                    Logger& logger) {
-  // Must provide the path, filename, directory separate from boost path->string
-  // helpers to match any explicit (query-parsed) predicate constraints.
-  auto tr = TableRowHolder(new DynamicTableRow());
-  MultiHashes hashes;
-  if (!FLAGS_disable_hash_cache) {
-    FileHashCache::load(path, hashes, logger);
-  } else {
-    if (context.isCached(path)) {
+void genHashRows(std::vector<HashRow>& rows,
+                 QueryContext& context,
+                 QueryData& results,
+                 Logger& logger) {
+  // Each file is hashed once, even if several rows refer to it.
+  std::vector<HashRequest> requests;
+  std::unordered_map<std::string, size_t> request_index;
+  for (auto& row : rows) {
+    auto it = request_index.find(row.path);
+    if (it != request_index.end()) {
+      row.request = it->second;
+      continue;
+    }
+
+    row.request = requests.size();
+    request_index[row.path] = requests.size();
+    HashRequest request;
+    request.path = row.path;
+    requests.push_back(std::move(request));
+  }
+
+  for (auto& request : requests) {
+    if (FLAGS_disable_hash_cache) {
       // Use the inner-query cache if the global hash cache is disabled.
-      // This protects against hashing the same content twice in the same query.
-      tr = context.getCache(path);
-    } else {
-      hashes = hashMultiFromFile(
-          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
+      // This protects against hashing the same content in the same query.
+      if (!context.isCached(request.path)) {
+        request.pending = true;
+        continue;
+      }
+
+      auto cached = context.getCache(request.path);
+      auto& r = *dynamic_cast<DynamicTableRow*>(cached.get());
+      request.hashes.md5 = r["md5"];
+      request.hashes.sha1 = r["sha1"];
+      request.hashes.sha256 = r["sha256"];
+      continue;
     }
+
+    struct stat st;
+    if (stat(request.path.c_str(), &st) != 0) {
+      char buf[0x200] = {0};
+      strerror_r(errno, buf, sizeof(buf));
+      request.error = "Cannot stat file: " + request.path + ": " + buf;
+      continue;
+    }
+
+    request.key = getFileHashKey(request.path, st);
+    request.cacheable = true;
+    request.pending = !FileHashCache::get().lookup(request.key, request.hashes);
   }
 
-  DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
-  r["path"] = path;
-  r["directory"] = dir;
-  r["md5"] = std::move(hashes.md5);
-  r["sha1"] = std::move(hashes.sha1);
-  r["sha256"] = std::move(hashes.sha256);
+  hashRequests(requests);
 
-  if (FLAGS_disable_hash_cache) {
-    context.setCache(path, tr);
+  for (const auto& request : requests) {
+    if (!request.error.empty()) {
+      logger.log(google::GLOG_WARNING, request.error);
+    } else if (request.cacheable && request.pending) {
+      FileHashCache::get().store(request.key, request.hashes);
+    }
   }
 
-  r["pid_with_namespace"] = "0";
+  // Must provide the path, filename, directory separate from boost path->string
+  // helpers to match any explicit (query-parsed) predicate constraints.
+  for (const auto& row : rows) {
+    const auto& request = requests[row.request];
+    auto tr = TableRowHolder(new DynamicTableRow());
+    DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
+    r["path"] = row.path;
+    r["directory"] = row.directory;
+    r["md5"] = request.hashes.md5;
+    r["sha1"] = request.hashes.sha1;
+    r["sha256"] = request.hashes.sha256;
+
+    if (FLAGS_disable_hash_cache) {
+      context.setCache(request.path, tr);
+    }
 
-  results.push_back(static_cast<Row>(r));
+    r["pid_with_namespace"] = "0";
+
+    results.push_back(static_cast<Row>(r));
+  }
 }
 
+} // namespace
+
 void expandFSPathConstraints(QueryContext& context,
                              const std::string& path_column_name,
                              std::set<std::string>& paths) {
@@ -252,6 +475,7 @@ void expandFSPathConstraints(QueryContext& context,
 
 QueryData genHashImpl(QueryContext& context, Logger& logger) {
   QueryData results;
+  std::vector<HashRow> rows;
   boost::system::error_code ec;
 
   // The query must provide a predicate with constraints including path or
@@ -267,8 +491,7 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
       continue;
     }
 
-    genHashForFile(
-        path_string, path.parent_path().string(), context, results, logger);
+    rows.push_back({path_string, path.parent_path().string()});
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -287,12 +510,12 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
     boost::filesystem::directory_iterator begin(directory), end;
     for (; begin != end; ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results, logger);
+        rows.push_back({begin->path().string(), directory_string});
       }
     }
   }
 
+  genHashRows(rows, context, results, logger);
   return results;
 }
 
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/hashing/hashing.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Identifies the content of a file in the hash cache.
+ *
+ * A change of the file's modification time or size, or a new file replacing
+ * it, changes the key and the file is hashed again. Hard links to the same
+ * file share a key. The path is only part of the key on platforms without
+ * inode numbers.
+ */
+struct FileHashKey {
+  uint64_t device{0};
+  uint64_t inode{0};
+  int64_t mtime{0};
+  int64_t size{0};
+  std::string path;
+
+  bool operator==(const FileHashKey& other) const {
+    return device == other.device && inode == other.inode &&
+           mtime == other.mtime && size == other.size && path == other.path;
+  }
+
+  /// The key used to persist the hashes in the database.
+  std::string toString() const;
+};
+
+struct FileHashKeyHasher {
+  size_t operator()(const FileHashKey& key) const;
+};
+
+/**
+ * @brief A sharded LRU cache of file hashes.
+ *
+ * Each shard has its own lock, list, and index so lookups and stores are
+ * constant time and concurrent hashing workers rarely contend. The total
+ * number of entries is bounded by `--hash_cache_max`.
+ *
+ * With `--hash_cache_persist` every entry is also written to the database
+ * and removed from it when evicted, so a restart does not rehash files that
+ * were cached before. The persisted entries are loaded once per process, so
+ * the ones that do not fit are evicted too.
+ */
+class FileHashCache : private boost::noncopyable {
+ public:
+  /// Get the process-wide cache.
+  static FileHashCache& get();
+
+  /// Copy the cached hashes for a key, return false if none are cached.
+  bool lookup(const FileHashKey& key, MultiHashes& hashes);
+
+  /// Cache the hashes of a key, evicting the least recently used entries.
+  void store(const FileHashKey& key, const MultiHashes& hashes);
+
+  /// Drop every in-memory entry, persisted entries are loaded again.
+  void clear();
+
+  /// The number of in-memory entries.
+  size_t size();
+
+ private:
+  FileHashCache() = default;
+
+  using Entry = std::pair<FileHashKey, MultiHashes>;
+
+  struct Shard {
+    Mutex mutex;
+
+    /// Entries ordered from the most to the least recently used.
+    std::list<Entry> lru;
+
+    /// Index into the list, keyed by the file.
+    std::unordered_map<FileHashKey,
+                       std::list<Entry>::iterator,
+                       FileHashKeyHasher>
+        entries;
+  };
+
+  /// The shard of a key, fewer shards are used for a small cache size.
+  size_t getShardIndex(const FileHashKey& key) const;
+
+  /// Insert an entry into a shard, return the keys it evicted.
+  std::list<FileHashKey> insert(size_t index,
+                                const FileHashKey& key,
+                                const MultiHashes& hashes);
+
+  /// Load the persisted entries, deleting those evicted from the cache.
+  void restore();
+
+ private:
+  static const size_t kShards{16};
+
+  std::array<Shard, kShards> shards_;
+
+  /// Set once the persisted entries are loaded, reset by clear.
+  std::atomic<bool> restored_{false};
+  Mutex restore_mutex_;
+};
+
+} // namespace tables
+} // namespace osquery
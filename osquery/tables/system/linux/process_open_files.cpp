@@ -10,34 +10,44 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/process_open_files.h>
+#include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
 namespace tables {
 
-void genDescriptors(const std::string& process,
-                    const std::map<std::string, std::string>& descriptors,
-                    QueryData& results) {
-  for (const auto& fd : descriptors) {
-    if (fd.second.find("socket:") != std::string::npos ||
-        fd.second.find("anon_inode:") != std::string::npos ||
-        fd.second.find("pipe:") != std::string::npos) {
-      // This is NOT a vnode/file descriptor.
-      continue;
-    }
-
-    Row r;
-    r["pid"] = process;
-    r["fd"] = fd.first;
-    r["path"] = fd.second;
-    results.push_back(r);
+void genDescriptors(const ProcDirectory& process, TableRows& results) {
+  auto pid = tryTo<long long>(process.pid());
+  if (pid.isError()) {
+    return;
   }
 
-  return;
+  procEnumerateDescriptors(
+      process, [&pid, &results](const char* fd, const std::string& target) {
+        if (target.find("socket:") != std::string::npos ||
+            target.find("anon_inode:") != std::string::npos ||
+            target.find("pipe:") != std::string::npos) {
+          // This is NOT a vnode/file descriptor.
+          return;
+        }
+
+        auto r = std::make_unique<ProcessOpenFilesRow>();
+        r->pid_col = pid.get();
+        auto fd_number = tryTo<long long>(std::string(fd));
+        if (fd_number.isValue()) {
+          r->fd_col = fd_number.get();
+        } else {
+          r->setNull(ProcessOpenFilesRow::FD_INDEX);
+        }
+        r->path_col = target;
+        results.push_back(std::move(r));
+      });
 }
 
-QueryData genOpenFiles(QueryContext& context) {
-  QueryData results;
+TableRows genOpenFiles(QueryContext& context) {
+  TableRows results;
 
   std::set<std::string> pids;
   if (context.constraints["pid"].exists(EQUALS)) {
@@ -46,14 +56,14 @@ QueryData genOpenFiles(QueryContext& context) {
     osquery::procProcesses(pids);
   }
 
-  for (const auto& process : pids) {
-    std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
-      genDescriptors(process, descriptors, results);
+  for (const auto& pid : pids) {
+    ProcDirectory process(pid);
+    if (process.isValid()) {
+      genDescriptors(process, results);
     }
   }
 
   return results;
 }
-}
-}
+} // namespace tables
+} // namespace osquery
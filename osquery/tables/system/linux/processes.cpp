@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <regex>
 #include <string>
@@ -15,20 +17,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-#include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/noncopyable.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
-#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/rows/process_memory_map.h>
+#include <osquery/rows/processes.h>
 #include <osquery/tables/system/linux/processes.h>
-#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/system/boottime.h>
 
 #include <ctime>
@@ -43,11 +43,49 @@ inline std::string getProcAttr(const std::string& attr,
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
+/// The /proc/<pid> files each processes column is generated from.
+const std::map<std::string, std::uint32_t> kProcessesColumnFiles = {
+    {"name", PROC_FILE_STATUS},
+    {"path", PROC_FILE_EXE},
+    {"cmdline", PROC_FILE_CMDLINE},
+    {"state", PROC_FILE_STAT},
+    {"cwd", PROC_FILE_CWD},
+    {"root", PROC_FILE_ROOT},
+    {"uid", PROC_FILE_STATUS},
+    {"gid", PROC_FILE_STATUS},
+    {"euid", PROC_FILE_STATUS},
+    {"egid", PROC_FILE_STATUS},
+    {"suid", PROC_FILE_STATUS},
+    {"sgid", PROC_FILE_STATUS},
+    {"on_disk", PROC_FILE_EXE},
+    {"resident_size", PROC_FILE_STATUS},
+    {"total_size", PROC_FILE_STATUS},
+    {"user_time", PROC_FILE_STAT},
+    {"system_time", PROC_FILE_STAT},
+    {"disk_bytes_read", PROC_FILE_IO},
+    {"disk_bytes_written", PROC_FILE_IO},
+    {"start_time", PROC_FILE_STAT},
+    {"parent", PROC_FILE_STAT},
+    {"pgroup", PROC_FILE_STAT},
+    {"threads", PROC_FILE_STAT},
+    {"nice", PROC_FILE_STAT},
+    {"cgroup_path", PROC_FILE_CGROUP},
+};
 
+/// Compute the /proc/<pid> files needed for the columns used by a query.
+std::uint32_t getProcessesFiles(const QueryContext& context) {
+  std::uint32_t files = PROC_FILE_NONE;
+  for (const auto& column : kProcessesColumnFiles) {
+    if (context.isColumnUsed(column.first)) {
+      files |= column.second;
+    }
+  }
+  return files;
+}
+
+inline std::string readProcCMDLine(const ProcDirectory& process) {
   std::string content;
-  readFile(attr, content);
+  process.read("cmdline", content);
   // Remove \0 delimiters.
   std::replace_if(
       content.begin(),
@@ -80,46 +118,19 @@ std::string parseProcCGroup(const std::string& content) {
   }
 }
 
-inline std::string readProcCgroup(const std::string& pid) {
-  auto attr = getProcAttr("cgroup", pid);
-
+inline std::string readProcCgroup(const ProcDirectory& process) {
   std::string content;
-  if (!readFile(attr, content).ok()) {
+  if (!process.read("cgroup", content).ok()) {
     return {};
   };
   return parseProcCGroup(content);
 }
 
-inline std::string readProcLink(const std::string& attr,
-                                const std::string& pid) {
-  // The exe is a symlink to the binary on-disk.
-  auto attr_path = getProcAttr(attr, pid);
-
-  std::string result = "";
-  struct stat sb;
-  if (lstat(attr_path.c_str(), &sb) != -1) {
-    // Some symlinks may report 'st_size' as zero
-    // Use PATH_MAX as best guess
-    // For cases when 'st_size' is not zero but smaller than
-    // PATH_MAX we will still use PATH_MAX to minimize chance
-    // of output trucation during race condition
-    ssize_t buf_size = sb.st_size < PATH_MAX ? PATH_MAX : sb.st_size;
-    // +1 for \0, since readlink does not append a null
-    char* linkname = static_cast<char*>(malloc(buf_size + 1));
-    ssize_t r = readlink(attr_path.c_str(), linkname, buf_size);
-
-    if (r > 0) { // Success check
-      // r may not be equal to buf_size
-      // if r == buf_size there was race condition
-      // and link is longer than buf_size and because of this
-      // truncated
-      linkname[r] = '\0';
-      result = std::string(linkname);
-    }
-    free(linkname);
-  }
-
-  return result;
+inline std::string readProcLink(const char* attr,
+                                const ProcDirectory& process) {
+  std::string target;
+  process.readLink(attr, target);
+  return target;
 }
 
 // In the case where the linked binary path ends in " (deleted)", and a file
@@ -172,225 +183,131 @@ std::set<std::string> getProcList(const QueryContext& context) {
 }
 
 void genProcessEnvironment(const std::string& pid, QueryData& results) {
-  auto attr = getProcAttr("environ", pid);
-
+  ProcDirectory process(pid);
   std::string content;
-  readFile(attr, content);
-  const char* variable = content.c_str();
+  process.read("environ", content);
 
   // Stop at the end of nul-delimited string content.
-  while (*variable > 0) {
-    auto buf = std::string(variable);
-    size_t idx = buf.find_first_of("=");
+  const char* variable = content.c_str();
+  const char* end = variable + content.size();
+  while (variable < end && *variable != '\0') {
+    auto size = std::strlen(variable);
+    auto separator =
+        static_cast<const char*>(std::memchr(variable, '=', size));
 
     Row r;
     r["pid"] = pid;
-    r["key"] = buf.substr(0, idx);
-    r["value"] = buf.substr(idx + 1);
-    results.push_back(r);
-    variable += buf.size() + 1;
+    if (separator != nullptr) {
+      r["key"].assign(variable, separator);
+      r["value"].assign(separator + 1, variable + size);
+    } else {
+      r["key"].assign(variable, size);
+      r["value"].assign(variable, size);
+    }
+    results.push_back(std::move(r));
+    variable += size + 1;
   }
 }
 
-void genProcessMap(const std::string& pid, QueryData& results) {
-  auto map = getProcAttr("maps", pid);
+namespace {
 
-  std::string content;
-  readFile(map, content);
-  for (auto& line : osquery::split(content, "\n")) {
-    auto fields = osquery::split(line, " ");
-    // If can't read address, not sure.
-    if (fields.size() < 5) {
-      continue;
-    }
-
-    Row r;
-    r["pid"] = pid;
-    if (!fields[0].empty()) {
-      auto addresses = osquery::split(fields[0], "-");
-      if (addresses.size() >= 2) {
-        r["start"] = "0x" + addresses[0];
-        r["end"] = "0x" + addresses[1];
-      } else {
-        // Problem with the address format.
-        continue;
-      }
-    }
-
-    r["permissions"] = fields[1];
-    auto offset = tryTo<long long>(fields[2], 16);
-    r["offset"] = BIGINT((offset) ? offset.take() : -1);
-    r["device"] = fields[3];
-    r["inode"] = fields[4];
-
-    // Path name must be trimmed.
-    if (fields.size() > 5) {
-      boost::trim(fields[5]);
-      r["path"] = fields[5];
-    }
+/// Find the next space-separated field of a maps line.
+bool nextMapField(const char*& pos,
+                  const char* end,
+                  const char*& field,
+                  size_t& size) {
+  while (pos < end && *pos == ' ') {
+    pos++;
+  }
 
-    // BSS with name in pathname.
-    r["pseudo"] = (fields[4] == "0" && !r["path"].empty()) ? "1" : "0";
-    results.push_back(std::move(r));
+  field = pos;
+  while (pos < end && *pos != ' ') {
+    pos++;
   }
+  size = static_cast<size_t>(pos - field);
+  return size > 0;
 }
 
-/**
- *  Output from string parsing /proc/<pid>/status.
- */
-struct SimpleProcStat : private boost::noncopyable {
- public:
-  std::string name;
-  std::string real_uid;
-  std::string real_gid;
-  std::string effective_uid;
-  std::string effective_gid;
-  std::string saved_uid;
-  std::string saved_gid;
-  std::string resident_size;
-  std::string total_size;
-  std::string state;
-  std::string parent;
-  std::string group;
-  std::string nice;
-  std::string threads;
-  std::string user_time;
-  std::string system_time;
-  std::string start_time;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcStat(const std::string& pid);
-};
+} // namespace
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
+void genProcessMap(const std::string& pid, TableRows& results) {
+  auto pid_value = tryTo<int>(pid);
+  if (pid_value.isError()) {
+    return;
+  }
+
+  ProcDirectory process(pid);
   std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
-    auto start = content.find_last_of(")");
-    // Start parsing stats from ") <MODE>..."
-    if (start == std::string::npos || content.size() <= start + 2) {
-      status = Status(1, "Invalid /proc/stat header");
-      return;
+  process.read("maps", content);
+
+  const char* line = content.data();
+  const char* content_end = line + content.size();
+  for (; line < content_end; line++) {
+    auto end = static_cast<const char*>(
+        std::memchr(line, '\n', content_end - line));
+    if (end == nullptr) {
+      end = content_end;
     }
 
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
-      status = Status(1, "Invalid /proc/stat content");
-      return;
+    // Fields are: address, permissions, offset, device, inode, and path.
+    const char* pos = line;
+    line = end;
+    const char* fields[5];
+    size_t sizes[5];
+    size_t count = 0;
+    while (count < 5 && nextMapField(pos, end, fields[count], sizes[count])) {
+      count++;
     }
 
-    this->state = details.at(0);
-    this->parent = details.at(1);
-    this->group = details.at(2);
-    this->user_time = details.at(11);
-    this->system_time = details.at(12);
-    this->nice = details.at(16);
-    this->threads = details.at(17);
-    this->start_time = details.at(19);
-  }
-
-  // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
-    status = Status(1, "Cannot read /proc/status");
-    return;
-  }
-
-  for (const auto& line : osquery::split(content, "\n")) {
-    // Status lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
+    // If can't read address, not sure.
+    if (count < 5) {
       continue;
     }
 
-    // There are specific fields from each detail.
-    if (detail.at(0) == "Name") {
-      this->name = detail.at(1);
-    } else if (detail.at(0) == "VmRSS") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB (1024 bytes).
-      auto resident_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
-
-      if (resident_size_result.isError()) {
-        status =
-            Status::failure("Failed to convert VmRSS string value to integer");
-        return;
-      }
-
-      const auto resident_size = resident_size_result.get() * 1024;
-
-      this->resident_size = std::to_string(resident_size);
-    } else if (detail.at(0) == "VmSize") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB (1024 bytes).
-      auto virtual_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
-
-      if (virtual_size_result.isError()) {
-        status =
-            Status::failure("Failed to convert VmSize string value to integer");
-        return;
-      }
-
-      const auto virtual_size = virtual_size_result.get() * 1024;
-
-      this->total_size = std::to_string(virtual_size);
-    } else if (detail.at(0) == "Gid") {
-      // Format is: R E - -
-      auto gid_detail = osquery::split(detail.at(1), "\t");
-      if (gid_detail.size() == 4) {
-        this->real_gid = gid_detail.at(0);
-        this->effective_gid = gid_detail.at(1);
-        this->saved_gid = gid_detail.at(2);
-      }
-    } else if (detail.at(0) == "Uid") {
-      auto uid_detail = osquery::split(detail.at(1), "\t");
-      if (uid_detail.size() == 4) {
-        this->real_uid = uid_detail.at(0);
-        this->effective_uid = uid_detail.at(1);
-        this->saved_uid = uid_detail.at(2);
-      }
+    auto address_end = fields[0] + sizes[0];
+    auto dash = static_cast<const char*>(std::memchr(fields[0], '-', sizes[0]));
+    if (dash == nullptr) {
+      // Problem with the address format.
+      continue;
     }
-  }
-}
-
-/**
- * Output from string parsing /proc/<pid>/io.
- */
-struct SimpleProcIo : private boost::noncopyable {
- public:
-  std::string read_bytes;
-  std::string write_bytes;
-  std::string cancelled_write_bytes;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcIo(const std::string& pid);
-};
-
-SimpleProcIo::SimpleProcIo(const std::string& pid) {
-  std::string content;
-  if (!readFile(getProcAttr("io", pid), content).ok()) {
-    status = Status(
-        1, "Cannot read /proc/" + pid + "/io (is osquery running as root?)");
-    return;
-  }
 
-  for (const auto& line : osquery::split(content, "\n")) {
-    // IO lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
-      continue;
+    auto r = std::make_unique<ProcessMemoryMapRow>();
+    r->pid_col = pid_value.get();
+    r->start_col.reserve(dash - fields[0] + 2);
+    r->start_col.append("0x").append(fields[0], dash);
+    r->end_col.reserve(address_end - dash + 1);
+    r->end_col.append("0x").append(dash + 1, address_end);
+
+    r->permissions_col.assign(fields[1], sizes[1]);
+    auto offset = tryTo<long long>(std::string(fields[2], sizes[2]), 16);
+    r->offset_col = (offset) ? offset.take() : -1;
+    r->device_col.assign(fields[3], sizes[3]);
+    auto inode = tryTo<long long>(std::string(fields[4], sizes[4]));
+    if (inode.isValue()) {
+      r->inode_col = inode.take();
+    } else {
+      r->setNull(ProcessMemoryMapRow::INODE_INDEX);
     }
 
-    // There are specific fields from each detail
-    if (detail.at(0) == "read_bytes") {
-      this->read_bytes = detail.at(1);
-    } else if (detail.at(0) == "write_bytes") {
-      this->write_bytes = detail.at(1);
-    } else if (detail.at(0) == "cancelled_write_bytes") {
-      this->cancelled_write_bytes = detail.at(1);
+    // Path name must be trimmed, it may contain spaces.
+    while (pos < end && (*pos == ' ' || *pos == '\t')) {
+      pos++;
+    }
+    auto path_end = end;
+    while (path_end > pos &&
+           (*(path_end - 1) == ' ' || *(path_end - 1) == '\t')) {
+      path_end--;
     }
+    if (path_end > pos) {
+      r->path_col.assign(pos, path_end);
+    } else {
+      r->setNull(ProcessMemoryMapRow::PATH_INDEX);
+    }
+
+    // BSS with name in pathname.
+    bool zero_inode = (sizes[4] == 1 && fields[4][0] == '0');
+    r->pseudo_col = (zero_inode && !r->path_col.empty()) ? 1 : 0;
+    results.push_back(std::move(r));
   }
 }
 
@@ -446,86 +363,171 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
+/// Assign a numeric /proc field to a typed column, or report it as NULL.
+template <typename T>
+inline void setNumericColumn(ProcessesRow& r,
+                             ProcessesRow::ColumnIndex index,
+                             T& column,
+                             const std::string& value) {
+  auto number = tryTo<long long>(value);
+  if (number.isValue()) {
+    column = static_cast<T>(number.take());
+  } else {
+    r.setNull(index);
+  }
+}
+
+/// Assign a parsed /proc field to a typed column, -1 is reported as NULL.
+template <typename T>
+inline void setParsedColumn(ProcessesRow& r,
+                            ProcessesRow::ColumnIndex index,
+                            T& column,
+                            long long value) {
+  if (value >= 0) {
+    column = static_cast<T>(value);
+  } else {
+    r.setNull(index);
+  }
+}
+
 void genProcess(const std::string& pid,
                 std::uint64_t system_boot_time,
-                QueryContext& context,
+                std::uint32_t files,
                 TableRows& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
-
-  if (!proc_stat.status.ok()) {
-    VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
+  ProcDirectory process(pid);
+  if (!process.isValid()) {
+    VLOG(1) << "Cannot open /proc/" << pid;
     return;
   }
 
-  auto r = make_table_row();
-  r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
-  // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  if (context.isColumnUsed("cgroup_path")) {
-    r["cgroup_path"] = readProcCgroup(pid);
-  }
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
-
-  // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
-
-  // time information
-  auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
-  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
-  auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
-  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
-
-  auto proc_start_time_exp = tryTo<long>(proc_stat.start_time);
-  if (proc_start_time_exp.isValue() && system_boot_time > 0) {
-    auto proc_start_time = proc_start_time_exp.take() / sysconf(_SC_CLK_TCK);
-
-    r["start_time"] = BIGINT(system_boot_time + proc_start_time);
-  } else {
-    r["start_time"] = "-1";
+  auto r = std::make_unique<ProcessesRow>();
+  setNumericColumn(*r, ProcessesRow::PID_INDEX, r->pid_col, pid);
+
+  // Only the files backing the used columns are read, a process is skipped
+  // if one of them is unreadable, as before.
+  if (files & PROC_FILE_STAT) {
+    char buffer[1024];
+    ProcStat proc_stat;
+    auto size = process.read("stat", buffer, sizeof(buffer));
+    auto status = (size < 0) ? Status::failure("Cannot read /proc/stat")
+                             : procParseStat(buffer, size, proc_stat);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
+
+    r->state_col = std::string(1, proc_stat.state);
+    r->parent_col = proc_stat.parent;
+    r->pgroup_col = proc_stat.group;
+    r->nice_col = static_cast<int>(proc_stat.nice);
+    r->threads_col = static_cast<int>(proc_stat.threads);
+
+    // time information
+    r->user_time_col = proc_stat.user_time * kMSIn1CLKTCK;
+    r->system_time_col = proc_stat.system_time * kMSIn1CLKTCK;
+    if (system_boot_time > 0) {
+      r->start_time_col =
+          system_boot_time + proc_stat.start_time / sysconf(_SC_CLK_TCK);
+    } else {
+      r->start_time_col = -1;
+    }
+  }
+
+  if (files & PROC_FILE_STATUS) {
+    // The fields used are at the start of the file, a truncated read of a
+    // very long status keeps them.
+    char buffer[4096];
+    ProcStatus proc_status;
+    auto size = process.read("status", buffer, sizeof(buffer));
+    auto status = (size < 0) ? Status::failure("Cannot read /proc/status")
+                             : procParseStatus(buffer, size, proc_status);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
+
+    r->name_col = std::move(proc_status.name);
+    setParsedColumn(
+        *r, ProcessesRow::UID_INDEX, r->uid_col, proc_status.uid[0]);
+    setParsedColumn(
+        *r, ProcessesRow::EUID_INDEX, r->euid_col, proc_status.uid[1]);
+    setParsedColumn(
+        *r, ProcessesRow::SUID_INDEX, r->suid_col, proc_status.uid[2]);
+    setParsedColumn(
+        *r, ProcessesRow::GID_INDEX, r->gid_col, proc_status.gid[0]);
+    setParsedColumn(
+        *r, ProcessesRow::EGID_INDEX, r->egid_col, proc_status.gid[1]);
+    setParsedColumn(
+        *r, ProcessesRow::SGID_INDEX, r->sgid_col, proc_status.gid[2]);
+
+    // size/memory information
+    setParsedColumn(*r,
+                    ProcessesRow::RESIDENT_SIZE_INDEX,
+                    r->resident_size_col,
+                    proc_status.resident_size);
+    setParsedColumn(*r,
+                    ProcessesRow::TOTAL_SIZE_INDEX,
+                    r->total_size_col,
+                    proc_status.total_size);
   }
+  r->wired_size_col = 0; // No support for unpagable counters in linux.
 
-  if (!proc_io.status.ok()) {
-    // /proc/<pid>/io can require root to access, so don't fail if we can't
-    VLOG(1) << proc_io.status.getMessage();
+  if (files & PROC_FILE_EXE) {
+    r->path_col = readProcLink("exe", process);
+    r->on_disk_col = getOnDisk(pid, r->path_col);
+  }
+
+  if (files & PROC_FILE_CMDLINE) {
+    // Read/parse cmdline arguments.
+    r->cmdline_col = readProcCMDLine(process);
+  }
+
+  if (files & PROC_FILE_CGROUP) {
+    r->cgroup_path_col = readProcCgroup(process);
   } else {
-    r["disk_bytes_read"] = proc_io.read_bytes;
-    long long write_bytes = tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
-    long long cancelled_write_bytes =
-        tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
+    r->setNull(ProcessesRow::CGROUP_PATH_INDEX);
+  }
 
-    r["disk_bytes_written"] =
-        std::to_string(write_bytes - cancelled_write_bytes);
+  if (files & PROC_FILE_CWD) {
+    r->cwd_col = readProcLink("cwd", process);
   }
 
-  results.push_back(r);
+  if (files & PROC_FILE_ROOT) {
+    r->root_col = readProcLink("root", process);
+  }
+
+  if (files & PROC_FILE_IO) {
+    char buffer[512];
+    ProcIo proc_io;
+    auto size = process.read("io", buffer, sizeof(buffer));
+    if (size < 0) {
+      // /proc/<pid>/io can require root to access, so don't fail if we can't
+      VLOG(1) << "Cannot read /proc/" << pid
+              << "/io (is osquery running as root?)";
+      r->setNull(ProcessesRow::DISK_BYTES_READ_INDEX);
+      r->setNull(ProcessesRow::DISK_BYTES_WRITTEN_INDEX);
+    } else {
+      procParseIo(buffer, size, proc_io);
+      setParsedColumn(*r,
+                      ProcessesRow::DISK_BYTES_READ_INDEX,
+                      r->disk_bytes_read_col,
+                      proc_io.read_bytes);
+      long long write_bytes = std::max(proc_io.write_bytes, 0ll);
+      long long cancelled_write_bytes =
+          std::max(proc_io.cancelled_write_bytes, 0ll);
+      r->disk_bytes_written_col = write_bytes - cancelled_write_bytes;
+    }
+  }
+
+  results.push_back(std::move(r));
 }
 
 void genNamespaces(const std::string& pid, QueryData& results) {
   Row r;
 
+  ProcDirectory process(pid);
   ProcessNamespaceList proc_ns;
-  Status status = procGetProcessNamespaces(pid, proc_ns);
+  Status status = procGetProcessNamespaces(process, proc_ns);
   if (!status.ok()) {
     VLOG(1) << "Namespaces for pid " << pid
             << " are incomplete: " << status.what();
@@ -543,9 +545,10 @@ TableRows genProcesses(QueryContext& context) {
   TableRows results;
   static const std::uint64_t system_boot_time = getBootTime();
 
+  auto files = getProcessesFiles(context);
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcess(pid, system_boot_time, context, results);
+    genProcess(pid, system_boot_time, files, results);
   }
 
   return results;
@@ -562,8 +565,8 @@ QueryData genProcessEnvs(QueryContext& context) {
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
+TableRows genProcessMemoryMap(QueryContext& context) {
+  TableRows results;
 
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
@@ -21,6 +21,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/rpm_package_files.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -241,21 +242,23 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
 
     // Iterate over every file in this package.
     for (size_t i = 0; rpmfiNext(fi) >= 0 && i < file_count; i++) {
-      auto r = make_table_row();
+      auto r = std::make_unique<RpmPackageFilesRow>();
       auto path = rpmfiFN(fi);
-      r["package"] = package_name;
-      r["path"] = (path != nullptr) ? path : "";
+      r->package_col = package_name;
+      r->path_col = (path != nullptr) ? path : "";
       auto username = rpmfiFUser(fi);
-      r["username"] = (username != nullptr) ? username : "";
+      r->username_col = (username != nullptr) ? username : "";
       auto groupname = rpmfiFGroup(fi);
-      r["groupname"] = (groupname != nullptr) ? groupname : "";
-      r["mode"] = lsperms(rpmfiFMode(fi));
-      r["size"] = BIGINT(rpmfiFSize(fi));
+      r->groupname_col = (groupname != nullptr) ? groupname : "";
+      r->mode_col = lsperms(rpmfiFMode(fi));
+      r->size_col = rpmfiFSize(fi);
 
       int digest_algo;
       auto digest = rpmfiFDigestHex(fi, &digest_algo);
       if (digest_algo == PGPHASHALGO_SHA256) {
-        r["sha256"] = (digest != nullptr) ? digest : "";
+        r->sha256_col = (digest != nullptr) ? digest : "";
+      } else {
+        r->setNull(RpmPackageFilesRow::SHA256_INDEX);
       }
       if (digest != nullptr) {
         free(digest);
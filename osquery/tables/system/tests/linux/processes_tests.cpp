@@ -7,12 +7,18 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <unistd.h>
+
 #include <gtest/gtest.h>
+
+#include <osquery/rows/processes.h>
 #include <osquery/tables/system/linux/processes.h>
 
 namespace osquery {
 namespace tables {
 
+TableRows genProcesses(QueryContext& context);
+
 class CGroupTest : public ::testing::Test {};
 
 TEST_F(CGroupTest, systemd_session) {
@@ -37,5 +43,30 @@ TEST_F(CGroupTest, invalid) {
   EXPECT_EQ("", got);
 }
 
+class ProcessesTest : public ::testing::Test {};
+
+TEST_F(ProcessesTest, typed_row_for_self) {
+  QueryContext context;
+  context.constraints["pid"].add(
+      Constraint(EQUALS, std::to_string(::getpid())));
+
+  auto results = genProcesses(context);
+  ASSERT_EQ(results.size(), 1U);
+
+  auto* row = dynamic_cast<ProcessesRow*>(results[0].get());
+  ASSERT_NE(row, nullptr);
+  EXPECT_EQ(row->pid_col, ::getpid());
+  EXPECT_EQ(row->parent_col, ::getppid());
+  EXPECT_FALSE(row->isNull(ProcessesRow::PID_INDEX));
+
+  // Columns from other platforms are never reported.
+  EXPECT_TRUE(row->isNull(ProcessesRow::UPID_INDEX));
+  EXPECT_TRUE(row->isNull(ProcessesRow::ELEVATED_TOKEN_INDEX));
+
+  auto legacy = static_cast<Row>(*row);
+  EXPECT_EQ(legacy["pid"], std::to_string(::getpid()));
+  EXPECT_EQ(legacy.count("upid"), 0U);
+}
+
 } // namespace tables
 } // namespace osquery
\ No newline at end of file
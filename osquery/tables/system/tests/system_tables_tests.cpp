@@ -24,6 +24,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
+#include <osquery/tables/system/hash.h>
 #include <osquery/tests/test_util.h>
 #include <osquery/utils/info/platform_type.h>
 #ifdef OSQUERY_WINDOWS
@@ -31,6 +32,10 @@
 #endif
 
 namespace osquery {
+
+DECLARE_uint32(hash_cache_max);
+DECLARE_bool(hash_cache_persist);
+
 namespace tables {
 
 class SystemsTablesTests : public testing::Test {
@@ -390,5 +395,116 @@ TEST_F(HashTableTest, test_cache_updates) {
   EXPECT_NE(rows[0].at("md5"), contentMd5);
   EXPECT_EQ(rows[0].at("md5"), badContentMd5);
 }
+
+TEST_F(HashTableTest, test_cache_bounded) {
+  auto& cache = FileHashCache::get();
+  cache.clear();
+
+  auto hash_cache_max = FLAGS_hash_cache_max;
+  FLAGS_hash_cache_max = 32;
+
+  MultiHashes hashes;
+  hashes.mask = HASH_TYPE_MD5;
+  hashes.md5 = contentMd5;
+  FileHashKey key;
+  for (size_t i = 0; i < 100; ++i) {
+    key.inode = i + 1;
+    cache.store(key, hashes);
+  }
+  EXPECT_LE(cache.size(), 32U);
+
+  // The most recently stored entry is never evicted.
+  MultiHashes cached;
+  ASSERT_TRUE(cache.lookup(key, cached));
+  EXPECT_EQ(cached.md5, contentMd5);
+
+  // A modified file is a different entry.
+  key.mtime++;
+  EXPECT_FALSE(cache.lookup(key, cached));
+
+  // Sizes that do not divide between the shards are not rounded down.
+  cache.clear();
+  FLAGS_hash_cache_max = 20;
+  for (size_t i = 0; i < 200; ++i) {
+    key.inode = i + 1;
+    cache.store(key, hashes);
+  }
+  EXPECT_EQ(cache.size(), 20U);
+
+  cache.clear();
+  FLAGS_hash_cache_max = 5;
+  for (size_t i = 0; i < 200; ++i) {
+    key.inode = i + 1;
+    cache.store(key, hashes);
+  }
+  EXPECT_EQ(cache.size(), 5U);
+
+  FLAGS_hash_cache_max = hash_cache_max;
+  cache.clear();
+}
+
+TEST_F(HashTableTest, test_cache_persist) {
+  initDatabasePluginForTesting();
+  auto& cache = FileHashCache::get();
+  cache.clear();
+  FLAGS_hash_cache_persist = true;
+
+  MultiHashes hashes;
+  hashes.mask = HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256;
+  hashes.md5 = contentMd5;
+  hashes.sha1 = contentSha1;
+  hashes.sha256 = contentSha256;
+  FileHashKey key;
+  key.device = 1;
+  key.inode = 31337;
+  key.size = 11;
+  cache.store(key, hashes);
+
+  // Hashes cached before a restart are read back from the database.
+  cache.clear();
+  MultiHashes cached;
+  ASSERT_TRUE(cache.lookup(key, cached));
+  EXPECT_EQ(cached.mask, hashes.mask);
+  EXPECT_EQ(cached.md5, contentMd5);
+  EXPECT_EQ(cached.sha1, contentSha1);
+  EXPECT_EQ(cached.sha256, contentSha256);
+
+  FLAGS_hash_cache_persist = false;
+  cache.clear();
+  EXPECT_FALSE(cache.lookup(key, cached));
+}
+
+TEST_F(HashTableTest, test_cache_persist_bounded) {
+  initDatabasePluginForTesting();
+  auto& cache = FileHashCache::get();
+  cache.clear();
+  deleteDatabaseRange(kPersistentSettings, "hash_cache.", "hash_cache/");
+
+  auto hash_cache_max = FLAGS_hash_cache_max;
+  FLAGS_hash_cache_max = 4;
+  FLAGS_hash_cache_persist = true;
+
+  // Entries persisted by earlier runs that were never looked up again.
+  for (size_t i = 0; i < 10; ++i) {
+    setDatabaseValue(kPersistentSettings,
+                     "hash_cache.1." + std::to_string(i + 1) + ".0.11.",
+                     "1," + contentMd5 + ",sha1,sha256");
+  }
+
+  // The first use loads them and deletes those that do not fit.
+  MultiHashes cached;
+  FileHashKey key;
+  EXPECT_FALSE(cache.lookup(key, cached));
+  EXPECT_EQ(cache.size(), 4U);
+
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kPersistentSettings, keys, "hash_cache.");
+  EXPECT_EQ(keys.size(), 4U);
+
+  FLAGS_hash_cache_persist = false;
+  FLAGS_hash_cache_max = hash_cache_max;
+  cache.clear();
+  deleteDatabaseRange(kPersistentSettings, "hash_cache.", "hash_cache/");
+}
 } // namespace tables
 } // namespace osquery
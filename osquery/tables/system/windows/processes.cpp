@@ -747,7 +747,7 @@ TableRows genProcesses(QueryContext& context) {
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
+TableRows genProcessMemoryMap(QueryContext& context) {
   QueryData results;
 
   std::set<long> pidlist;
@@ -770,7 +770,7 @@ QueryData genProcessMemoryMap(QueryContext& context) {
     }
   }
 
-  return results;
+  return tableRowsFromQueryData(std::move(results));
 }
 
 } // namespace tables
@@ -22,6 +22,8 @@
 #include <osquery/process/process.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/table_cache.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/macros/macros.h>
@@ -253,6 +255,8 @@ QueryData genOsquerySchedule(QueryContext& context) {
         r["last_system_time"] = "0";
         r["average_memory"] = "0";
         r["last_memory"] = "0";
+        r["instructions"] = "0";
+        r["cache_misses"] = "0";
         r["last_executed"] = "0";
 
         // Report optional performance information.
@@ -270,6 +274,8 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["last_system_time"] = BIGINT(perf.last_system_time);
               r["average_memory"] = BIGINT(perf.average_memory);
               r["last_memory"] = BIGINT(perf.last_memory);
+              r["instructions"] = BIGINT(perf.instructions);
+              r["cache_misses"] = BIGINT(perf.cache_misses);
             });
 
         results.push_back(r);
@@ -277,5 +283,41 @@ QueryData genOsquerySchedule(QueryContext& context) {
       true);
   return results;
 }
+
+QueryData genOsqueryTableCache(QueryContext& context) {
+  QueryData results;
+
+  TableResultCache::get().getStats(
+      [&results](const std::string& table, const TableCacheStats& stats) {
+        Row r;
+        r["table_name"] = table;
+        r["ttl"] = BIGINT(stats.ttl);
+        r["entries"] = BIGINT(stats.entries);
+        r["bytes"] = BIGINT(stats.bytes);
+        r["hits"] = BIGINT(stats.hits);
+        r["misses"] = BIGINT(stats.misses);
+        r["evictions"] = BIGINT(stats.evictions);
+        r["expirations"] = BIGINT(stats.expirations);
+        results.push_back(std::move(r));
+      });
+  return results;
+}
+
+QueryData genOsquerySQLPool(QueryContext& context) {
+  auto stats = SQLiteDBManager::getPoolStats();
+
+  Row r;
+  r["size"] = BIGINT(stats.size);
+  r["idle"] = BIGINT(stats.idle);
+  r["in_use"] = BIGINT(stats.in_use);
+  r["checkouts"] = BIGINT(stats.checkouts);
+  r["created"] = BIGINT(stats.created);
+  r["overflows"] = BIGINT(stats.overflows);
+  r["invalidations"] = BIGINT(stats.invalidations);
+  r["waits"] = BIGINT(stats.waits);
+  r["wait_time"] = BIGINT(stats.wait_time);
+  r["max_wait_time"] = BIGINT(stats.max_wait_time);
+  return {r};
+}
 } // namespace tables
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <unordered_map>
 
@@ -31,6 +32,11 @@ class TableChannelBase : only_movable {
     return static_cast<Derived&>(*this).recvStringMessageImpl(message);
   }
 
+  /// Wait until a message can be read, or the other end closed the channel.
+  bool waitForMessage(std::chrono::milliseconds timeout) {
+    return static_cast<Derived&>(*this).waitForMessageImpl(timeout);
+  }
+
   std::string table_name_;
 };
 } // namespace osquery
@@ -14,7 +14,7 @@
 #include <unordered_map>
 
 #include <osquery/core/sql/query_data.h>
-#include <osquery/worker/ipc/table_ipc_json_converter.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 
 #include <osquery/worker/logging/glog_logger_types.h>
 
@@ -23,115 +23,96 @@ template <typename Derived>
 class TableIPCBase {
  public:
   Status sendQueryData(const QueryData& query_data) {
-    JSON json_helper;
-    auto status =
-        TableIPCJSONConverter::queryDataToJSON(query_data, json_helper);
+    std::string frame;
+    auto status = TableIPCBinaryConverter::queryDataToBinary(query_data, frame);
 
     if (!status.ok()) {
       return status;
     }
 
-    json_helper.add("Type", "QueryData");
+    return static_cast<Derived&>(*this).sendMessage(frame);
+  }
 
-    std::string json_string;
-    status = json_helper.toString(json_string);
+  Status sendQueryDataEnd() {
+    std::string frame;
+    auto status = TableIPCBinaryConverter::queryDataEndToBinary(frame);
 
-    if (!status.ok())
+    if (!status.ok()) {
       return status;
+    }
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return static_cast<Derived&>(*this).sendMessage(frame);
   }
 
   Status sendLogMessage(int severity,
                         GLOGLogType log_type,
                         const std::string& message) {
-    JSON json_helper;
-    auto status = TableIPCJSONConverter::logMessageToJSON(
-        severity, static_cast<int>(log_type), message, json_helper);
-
-    if (!status.ok()) {
-      return status;
-    }
-
-    json_helper.add("Type", "Log");
-
-    std::string json_string;
-    status = json_helper.toString(json_string);
+    std::string frame;
+    auto status = TableIPCBinaryConverter::logMessageToBinary(
+        severity, static_cast<int>(log_type), message, frame);
 
     if (!status.ok()) {
       return status;
     }
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return static_cast<Derived&>(*this).sendMessage(frame);
   }
 
   Status sendJob(const QueryContext& context) {
-    JSON json_helper;
-    serializeQueryContextJSON(context, json_helper);
-    json_helper.add("Type", "Job");
-
-    std::string json_string;
-    auto status = json_helper.toString(json_string);
+    std::string frame;
+    auto status = TableIPCBinaryConverter::jobToBinary(context, frame);
 
     if (!status.ok()) {
       return status;
     }
 
-    return static_cast<Derived&>(*this).sendJSONString(json_string);
+    return static_cast<Derived&>(*this).sendMessage(frame);
   }
 
-  Status recvJSONMessage(JSON& json_message, JSONMessageType& message_type) {
-    std::string json_string;
-    auto status = static_cast<Derived&>(*this).recvJSONString(json_string);
+  Status recvBinaryMessage(std::string& frame,
+                           TableIPCMessageType& message_type) {
+    auto status = static_cast<Derived&>(*this).recvMessage(frame);
 
     if (!status.ok()) {
       return status;
     }
 
-    status = json_message.fromString(json_string);
-
-    if (!status.ok()) {
-      return status;
-    }
-
-    if (!json_message.doc().IsObject()) {
-      return Status::failure("JSON root is not an object");
-    }
-
-    if (!json_message.doc().HasMember("Type")) {
-      return Status::failure("No Type member");
-    }
-
-    return TableIPCJSONConverter::JSONTypeToMessageType(json_message,
-                                                        message_type);
+    return TableIPCBinaryConverter::binaryToMessageType(frame, message_type);
   }
 
   Status processOneMessage(QueryData* query_results,
-                           JSONMessageType& message_type) {
-    JSON json_message;
-    Status status = recvJSONMessage(json_message, message_type);
+                           TableIPCMessageType& message_type) {
+    std::string frame;
+    Status status = recvBinaryMessage(frame, message_type);
 
     if (!status.ok()) {
       return status;
     }
 
     switch (message_type) {
-    case JSONMessageType::Log: {
-      status = static_cast<Derived&>(*this).processLogMessage(json_message);
+    case TableIPCMessageType::Log: {
+      status = static_cast<Derived&>(*this).processLogMessage(frame);
       break;
     }
-    case JSONMessageType::QueryData: {
+    case TableIPCMessageType::QueryData: {
       if (!query_results) {
         status = Status::failure(1, "Received unexpected QueryData message");
         break;
       }
 
       status = static_cast<Derived&>(*this).processQueryDataMessage(
-          json_message, *query_results);
+          frame, *query_results);
+      break;
+    }
+    case TableIPCMessageType::QueryDataEnd: {
+      if (!query_results) {
+        status =
+            Status::failure(1, "Received unexpected QueryDataEnd message");
+      }
       break;
     }
-    case JSONMessageType::Job: {
-      status = static_cast<Derived&>(*this).processJobMessage(json_message);
+    case TableIPCMessageType::Job: {
+      status = static_cast<Derived&>(*this).processJobMessage(frame);
       break;
     }
     default: {
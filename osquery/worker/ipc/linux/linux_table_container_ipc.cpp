@@ -17,15 +17,20 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
 #include <osquery/worker/ipc/posix/pipe_channel_factory.h>
-#include <osquery/worker/ipc/table_ipc_json_converter.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 
 #include "osquery/worker/logging/glog/glog_logger.h"
 
@@ -36,8 +41,14 @@ DECLARE_bool(verbose);
 CLI_FLAG(bool,
          keep_container_worker_open,
          false,
-         "Keep the container worker running to be reused instead of closing it "
-         "after each query");
+         "Keep the container workers running until osquery exits instead of "
+         "stopping them once idle");
+
+CLI_FLAG(uint64,
+         container_worker_idle_timeout,
+         60,
+         "Seconds a container worker is kept running without queries, 0 stops "
+         "it after each query");
 
 namespace {
 
@@ -53,7 +64,15 @@ const std::string kMountNamespace = "/ns/mnt";
  */
 const int kMaxNamespaceIdLinkChars = 16;
 
-PlatformProcess current_running_process;
+/// The number of rows a worker sends in each QueryData message.
+const size_t kQueryDataChunkRows = 256;
+
+/**
+ * Workers wait this much longer than the idle timeout before stopping on their
+ * own, so that the parent always stops an idle worker before sending it a job
+ * it would not read.
+ */
+const std::chrono::milliseconds kWorkerIdleGrace{10000};
 
 Status extractMountNamespaceId(const std::string& mount_namespace_path,
                                std::string& mount_namespace_id) {
@@ -104,6 +123,36 @@ Status extractMountNamespaceId(const std::string& mount_namespace_path,
   return Status::success();
 }
 
+Status enterMountNamespace(pid_t pid) {
+  std::string path = kProc + "/" + std::to_string(pid) + kMountNamespace;
+  auto fd = open(path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return Status::failure("Could not open mount namespace of pid " +
+                           std::to_string(pid) +
+                           ", error: " + std::to_string(errno));
+  }
+
+  // We call the syscall directly because setns() has been added as a function
+  // from glibc 2.14 and on only.
+  int result = static_cast<int>(syscall(SYS_setns, fd, 0));
+
+  close(fd);
+
+  if (result < 0) {
+    return Status::failure("Could not switch namespace of pid " +
+                           std::to_string(pid) +
+                           ", error: " + std::to_string(errno));
+  }
+
+  return Status::success();
+}
+
+std::string getWorkerName(const std::string& table_name,
+                          const std::string& mount_namespace_id) {
+  return table_name + ":" + mount_namespace_id;
+}
+
 ProcessState checkProcessStateAndLog(const PlatformProcess& process,
                                      const std::string& table_name) {
   int child_exit_status = 0;
@@ -136,85 +185,65 @@ extern template std::set<int> ConstraintList::getAll<int>(
 LinuxTableContainerIPC::LinuxTableContainerIPC(PipeChannelFactory& factory)
     : ipc_(factory, *this) {}
 
-LinuxTableContainerIPC::~LinuxTableContainerIPC() {
-  close(original_mnt_fd_);
-}
-
 Status LinuxTableContainerIPC::connectToContainer(
-    const std::string& table_name,
-    bool keep_process_open,
+    const std::string& worker_name,
+    pid_t namespace_pid,
+    std::chrono::milliseconds max_idle_time,
     TableGeneratePtr function_ptr) {
-  keep_process_open_ = keep_process_open;
-
-  auto current_pid = getpid();
-  std::string original_mnt_path =
-      kProc + "/" + std::to_string(current_pid) + kMountNamespace;
+  worker_name_ = worker_name;
+  max_idle_time_ = max_idle_time;
+  table_generate_ptr_ = function_ptr;
 
-  if (original_mnt_fd_ > 0) {
-    close(original_mnt_fd_);
-  }
+  PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
 
-  original_mnt_fd_ = open(original_mnt_path.c_str(), O_RDONLY);
+  auto process_group = getpgrp();
 
-  if (original_mnt_fd_ < 0) {
-    return Status::failure(
-        "Failed to open the original mount namespace of the worker");
-  }
+  pid_t pid = fork();
 
-  bool is_open = ipc_.setActiveChannelIfOpen(table_name);
+  if (pid == 0) {
+    auto result = setpgid(0, process_group);
 
-  if (!is_open) {
-    // This will stop any worker connected to another table,
-    // so that we only have one open each time
-    if (keep_process_open_) {
-      stopContainerWorker();
+    if (result < 0) {
+      std::_Exit(1);
     }
 
-    PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
-
-    auto process_group = getpgrp();
-    table_generate_ptr_ = function_ptr;
-
-    pid_t pid = fork();
-
-    if (pid == 0) {
-      auto result = setpgid(0, process_group);
-
-      if (result < 0) {
-        std::_Exit(1);
-      }
+    try {
+      // The pipes of the other workers must only stay open in the parent,
+      // so that the workers see them close when they are stopped.
+      ipc_.dropAllChannels();
+      ipc_.connectToParent(worker_name, std::move(channel_ticket));
+    } catch (const std::exception& e) {
+      syslog(LOG_NOTICE, "Failed to connect to parent: %s", e.what());
+      std::_Exit(1);
+    }
 
-      try {
-        ipc_.connectToParent(table_name, std::move(channel_ticket));
-      } catch (const std::exception& e) {
-        syslog(LOG_NOTICE, "Failed to connect to parent: %s", e.what());
-        std::_Exit(1);
-      }
+    auto status = enterMountNamespace(namespace_pid);
 
-      executeQueryJobs();
-    } else if (pid == -1) {
-      return Status::failure("Failed to start container worker to table " +
-                             table_name);
-    } else {
-      current_running_process = PlatformProcess(pid);
-      ipc_.connectToChild(table_name, std::move(channel_ticket), pid);
+    if (!status.ok()) {
+      logger_.vlog(1, status.getMessage());
+      std::_Exit(1);
     }
+
+    executeQueryJobs();
+  } else if (pid == -1) {
+    return Status::failure("Failed to start container worker " + worker_name);
   }
 
+  worker_process_ = PlatformProcess(pid);
+  ipc_.connectToChild(worker_name, std::move(channel_ticket), pid);
+
   return Status::success();
 }
+
 void LinuxTableContainerIPC::stopContainerWorker() {
-  PlatformProcess child_process(std::move(current_running_process));
+  PlatformProcess child_process(std::move(worker_process_));
 
   if (child_process.pid() == kInvalidPid) {
     return;
   }
 
-  std::string table_name = ipc_.isChannelOpen()
-                               ? ipc_.getTableName()
-                               : ipc_.getTableNameFromPid(child_process.pid());
+  const auto& table_name = worker_name_;
 
-  ipc_.setActiveChannelIfOpen(table_name);
   ipc_.closeActiveChannel();
 
   ProcessState process_state =
@@ -280,103 +309,33 @@ Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
 }
 
 Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
-  QueryData query_data;
-  auto pids_with_namespace =
-      context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
-
-  if (pids_with_namespace.empty()) {
-    return Status::failure(
-        "Column constraint pid_with_namespace has been passed but there's no "
-        "value in it");
-  }
+  QueryData query_data = table_generate_ptr_(context, logger_);
 
-  for (const auto pid : pids_with_namespace) {
-    std::string path = kProc + "/" + std::to_string(pid) + kMountNamespace;
-    auto fd = open(path.c_str(), O_RDONLY);
+  // The rows are sent in chunks, the parent decodes each while the next one
+  // is encoded, and no message has to hold the whole result set.
+  for (size_t pos = 0; pos < query_data.size(); pos += kQueryDataChunkRows) {
+    auto end = std::min(query_data.size(), pos + kQueryDataChunkRows);
+    QueryData chunk(std::make_move_iterator(query_data.begin() + pos),
+                    std::make_move_iterator(query_data.begin() + end));
 
-    if (fd < 0) {
-      logger_.vlog(1,
-                   "Could not open mount namespace of pid " +
-                       std::to_string(pid) +
-                       ", error: " + std::to_string(errno));
-      continue;
-    }
-
-    std::string mount_namespace_id;
-    auto status = extractMountNamespaceId(path, mount_namespace_id);
+    auto status = ipc_.sendQueryData(chunk);
 
     if (!status.ok()) {
-      logger_.vlog(1, status.getMessage());
-      close(fd);
-      continue;
-    }
-
-    // We call the syscall directly because setns() has been added as a function
-    // from glibc 2.14 and on only.
-    int result = static_cast<int>(syscall(SYS_setns, fd, 0));
-
-    close(fd);
-
-    if (result < 0) {
-      logger_.vlog(1,
-                   "Could not switch namespace of pid " + std::to_string(pid) +
-                       ", error: " + std::to_string(errno));
-      continue;
-    }
-
-    QueryData namespace_query_data = table_generate_ptr_(context, logger_);
-    for (auto& row : namespace_query_data) {
-      row["pid_with_namespace"] = INTEGER(pid);
-      row["mount_namespace_id"] = mount_namespace_id;
-    }
-
-    query_data.insert(query_data.end(),
-                      std::make_move_iterator(namespace_query_data.begin()),
-                      std::make_move_iterator(namespace_query_data.end()));
-  }
-
-  /*
-    While we still want to return results to the parent,
-    but not being able to restore the original namespace means that
-    if the child is kept around, it won't be able to be reused.
-    So after delivering the results, we return with an error so
-    that the process will be always closed.
-  */
-  auto write_status = ipc_.sendQueryData(query_data);
-
-  if (keep_process_open_) {
-    int result = static_cast<int>(syscall(SYS_setns, original_mnt_fd_, 0));
-
-    if (result < 0) {
-      auto status = Status::failure(
-          "Failed to restore the original mount namespace, due to error: " +
-          std::to_string(errno));
-      logger_.vlog(1, status.getMessage());
       return status;
     }
   }
 
-  return write_status;
+  return ipc_.sendQueryDataEnd();
 }
 
 void LinuxTableContainerIPC::executeQueryJobs() {
   int exit_status_code = 0;
-  if (keep_process_open_) {
-    while (true) {
-      JSONMessageType message_type;
-      auto status = ipc_.processOneMessage(nullptr, message_type);
-
-      if (!status.ok()) {
-        exit_status_code = status.getCode();
-
-        if (exit_status_code != 2 || FLAGS_verbose) {
-          syslog(LOG_NOTICE, "%s", status.getMessage().c_str());
-        }
-        break;
-      }
+  while (true) {
+    if (max_idle_time_.count() > 0 && !ipc_.waitForMessage(max_idle_time_)) {
+      break;
     }
-  } else {
-    JSONMessageType message_type;
+
+    TableIPCMessageType message_type;
     auto status = ipc_.processOneMessage(nullptr, message_type);
 
     if (!status.ok()) {
@@ -385,14 +344,14 @@ void LinuxTableContainerIPC::executeQueryJobs() {
       if (exit_status_code != 2 || FLAGS_verbose) {
         syslog(LOG_NOTICE, "%s", status.getMessage().c_str());
       }
+      break;
     }
   }
 
   std::_Exit(exit_status_code);
 }
 
-Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
-    const QueryContext& context, QueryData& result) {
+Status LinuxTableContainerIPC::sendJob(const QueryContext& context) {
   CleanupWorkerOnError cleanupOnError(*this);
   auto status = ipc_.sendJob(context);
 
@@ -400,58 +359,214 @@ Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
     return status;
   }
 
-  bool child_has_result = false;
-  while (!child_has_result) {
-    JSONMessageType message_type;
+  cleanupOnError.dismiss();
+  return status;
+}
+
+Status LinuxTableContainerIPC::recvQueryData(QueryData& result) {
+  CleanupWorkerOnError cleanupOnError(*this);
+
+  auto message_type = TableIPCMessageType::None;
+  while (message_type != TableIPCMessageType::QueryDataEnd) {
     auto status = ipc_.processOneMessage(&result, message_type);
 
     if (!status.ok())
       return status;
+  }
+
+  cleanupOnError.dismiss();
+  return Status::success();
+}
+
+Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
+    const QueryContext& context, QueryData& result) {
+  auto status = sendJob(context);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  return recvQueryData(result);
+}
+
+Status ContainerWorkerPool::getWorker(const std::string& table_name,
+                                      const std::string& mount_namespace_id,
+                                      pid_t namespace_pid,
+                                      std::chrono::milliseconds max_idle_time,
+                                      TableGeneratePtr generate_ptr,
+                                      LinuxTableContainerIPC*& worker) {
+  auto worker_name = getWorkerName(table_name, mount_namespace_id);
+  auto it = workers_.find(worker_name);
+
+  if (it == workers_.end()) {
+    auto container_ipc = std::make_unique<LinuxTableContainerIPC>(*factory_);
+    auto status = container_ipc->connectToContainer(
+        worker_name, namespace_pid, max_idle_time, generate_ptr);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    it = workers_.emplace(worker_name, Worker{std::move(container_ipc), {}})
+             .first;
+  }
 
-    if (message_type == JSONMessageType::QueryData) {
-      child_has_result = true;
+  it->second.last_used = std::chrono::steady_clock::now();
+  worker = it->second.ipc.get();
+
+  return Status::success();
+}
+
+void ContainerWorkerPool::stopWorker(const std::string& table_name,
+                                     const std::string& mount_namespace_id) {
+  auto it = workers_.find(getWorkerName(table_name, mount_namespace_id));
+
+  if (it == workers_.end()) {
+    return;
+  }
+
+  it->second.ipc->stopContainerWorker();
+  workers_.erase(it);
+}
+
+void ContainerWorkerPool::stopIdleWorkers(
+    std::chrono::milliseconds idle_timeout) {
+  auto now = std::chrono::steady_clock::now();
+
+  for (auto it = workers_.begin(); it != workers_.end();) {
+    if (now - it->second.last_used < idle_timeout) {
+      ++it;
+      continue;
     }
+
+    it->second.ipc->stopContainerWorker();
+    it = workers_.erase(it);
   }
+}
 
-  cleanupOnError.dismiss();
-  return status;
+void ContainerWorkerPool::stopAllWorkers() {
+  for (auto& worker : workers_) {
+    worker.second.ipc->stopContainerWorker();
+  }
+
+  workers_.clear();
 }
 
 QueryData generateInNamespace(const QueryContext& context,
                               const std::string& table_name,
                               TableGeneratePtr generate_ptr) {
-  bool keep_container_worker_open = FLAGS_keep_container_worker_open;
   QueryData results;
 
-  static PipeChannelFactory factory;
+  auto pids_with_namespace =
+      context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
 
-  try {
-    LinuxTableContainerIPC ipc(factory);
-    auto status = ipc.connectToContainer(
-        table_name, keep_container_worker_open, generate_ptr);
+  if (pids_with_namespace.empty()) {
+    LOG(ERROR) << "Table " << table_name
+               << " has a pid_with_namespace constraint without a value";
+    return results;
+  }
+
+  // Processes sharing a mount namespace share its worker and its rows.
+  std::map<std::string, std::vector<int>> namespace_pids;
+  for (const auto pid : pids_with_namespace) {
+    std::string path = kProc + "/" + std::to_string(pid) + kMountNamespace;
+
+    std::string mount_namespace_id;
+    auto status = extractMountNamespaceId(path, mount_namespace_id);
 
     if (!status.ok()) {
-      LOG(ERROR) << "Table " << table_name
-                 << " failed to connect to the container: "
-                 << status.getMessage();
-      return results;
+      VLOG(1) << status.getMessage();
+      continue;
     }
 
-    status = ipc.retrieveQueryDataFromContainer(context, results);
+    namespace_pids[mount_namespace_id].push_back(pid);
+  }
 
-    if (!status.ok()) {
-      LOG(ERROR) << "Table " << table_name
-                 << " failed to retrieve QueryData from the container: "
-                 << status.getMessage();
+  static PipeChannelFactory factory;
+  static ContainerWorkerPool pool(factory);
+  static std::mutex pool_mutex;
+
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  bool keep_container_worker_open = FLAGS_keep_container_worker_open;
+  std::chrono::milliseconds idle_timeout =
+      std::chrono::seconds(FLAGS_container_worker_idle_timeout);
+
+  std::chrono::milliseconds max_idle_time(0);
+  if (!keep_container_worker_open) {
+    pool.stopIdleWorkers(idle_timeout);
+
+    if (idle_timeout.count() > 0) {
+      max_idle_time = idle_timeout + kWorkerIdleGrace;
+    }
+  }
+
+  try {
+    // All the workers get their job first, so that they run in parallel.
+    std::vector<std::pair<const std::string*, LinuxTableContainerIPC*>> jobs;
+    for (const auto& mount_namespace : namespace_pids) {
+      const auto& mount_namespace_id = mount_namespace.first;
+
+      LinuxTableContainerIPC* worker = nullptr;
+      auto status = pool.getWorker(table_name,
+                                   mount_namespace_id,
+                                   mount_namespace.second.front(),
+                                   max_idle_time,
+                                   generate_ptr,
+                                   worker);
+
+      if (!status.ok()) {
+        LOG(ERROR) << "Table " << table_name
+                   << " failed to connect to the container: "
+                   << status.getMessage();
+        continue;
+      }
+
+      status = worker->sendJob(context);
+
+      if (!status.ok()) {
+        LOG(ERROR) << "Table " << table_name
+                   << " failed to send a job to the container: "
+                   << status.getMessage();
+        pool.stopWorker(table_name, mount_namespace_id);
+        continue;
+      }
+
+      jobs.emplace_back(&mount_namespace_id, worker);
     }
 
-    if (!keep_container_worker_open)
-      ipc.stopContainerWorker();
+    for (const auto& job : jobs) {
+      const auto& mount_namespace_id = *job.first;
+
+      QueryData namespace_results;
+      auto status = job.second->recvQueryData(namespace_results);
+
+      if (!status.ok()) {
+        LOG(ERROR) << "Table " << table_name
+                   << " failed to retrieve QueryData from the container: "
+                   << status.getMessage();
+        pool.stopWorker(table_name, mount_namespace_id);
+        continue;
+      }
+
+      for (const auto pid : namespace_pids[mount_namespace_id]) {
+        for (const auto& row : namespace_results) {
+          Row pid_row = row;
+          pid_row["pid_with_namespace"] = INTEGER(pid);
+          pid_row["mount_namespace_id"] = mount_namespace_id;
+          results.push_back(std::move(pid_row));
+        }
+      }
+    }
   } catch (const std::exception& e) {
     LOG(ERROR) << "Table " << table_name
                << " failed to run query in the container: " << e.what();
   }
 
+  if (!keep_container_worker_open && idle_timeout.count() == 0) {
+    pool.stopAllWorkers();
+  }
+
   return results;
 }
 
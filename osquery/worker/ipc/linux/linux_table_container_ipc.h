@@ -11,10 +11,14 @@
 
 #include "osquery/worker/ipc/linux/linux_table_ipc.h"
 
+#include <chrono>
+#include <map>
+#include <memory>
 #include <string>
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/process/process.h>
 #include <osquery/utils/status/status.h>
 
 #include "osquery/worker/ipc/posix/pipe_channel.h"
@@ -31,16 +35,22 @@ using TableGeneratePtr = QueryData (*)(QueryContext& query_context,
  * @brief The LinuxTableContainerIPC class drives the logic to connect to, query
  * and retrieve results from a container, together with managing the container
  * worker lifetime.
+ *
+ * A worker enters the mount namespace of a container once, then runs the jobs
+ * of its table until the parent closes the channel or, if a maximum idle time
+ * is given, until no job arrived for that long.
  */
 class LinuxTableContainerIPC : TableIPCMessageHandler {
  public:
   LinuxTableContainerIPC() = delete;
   LinuxTableContainerIPC(PipeChannelFactory& factory);
-  ~LinuxTableContainerIPC();
 
-  Status connectToContainer(const std::string& table_name,
-                            bool keep_process_open,
+  Status connectToContainer(const std::string& worker_name,
+                            pid_t namespace_pid,
+                            std::chrono::milliseconds max_idle_time,
                             TableGeneratePtr table_generate_ptr_);
+  Status sendJob(const QueryContext& context);
+  Status recvQueryData(QueryData& result);
   Status retrieveQueryDataFromContainer(const QueryContext& context,
                                         QueryData& result);
   [[noreturn]] void executeQueryJobs();
@@ -51,12 +61,17 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
                    const std::string& message) override;
   Status handleJob(QueryContext& context) override;
 
+  pid_t getWorkerPid() const {
+    return worker_process_.pid();
+  }
+
  private:
   LinuxTableIPC ipc_;
   LinuxTableIPCLogger logger_{ipc_};
-  TableGeneratePtr table_generate_ptr_;
-  bool keep_process_open_{false};
-  int original_mnt_fd_{-1};
+  TableGeneratePtr table_generate_ptr_{nullptr};
+  std::string worker_name_;
+  PlatformProcess worker_process_;
+  std::chrono::milliseconds max_idle_time_{0};
 
   class CleanupWorkerOnError {
    public:
@@ -80,6 +95,60 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_connect);
 };
 
+/**
+ * @brief The long-lived container workers, one per table and mount namespace.
+ *
+ * Workers are started on first use and reused by the following queries, which
+ * saves a fork and a namespace switch per container on each query.
+ */
+class ContainerWorkerPool {
+ public:
+  ContainerWorkerPool() = delete;
+  explicit ContainerWorkerPool(PipeChannelFactory& factory)
+      : factory_(&factory) {}
+
+  /**
+   * @brief Get the worker of a table in a mount namespace.
+   *
+   * @param table_name The table the worker generates.
+   * @param mount_namespace_id The id of the mount namespace of the worker.
+   * @param namespace_pid A process in the mount namespace, used to enter it
+   * when the worker has to be started.
+   * @param max_idle_time How long a new worker waits for jobs, 0 for ever.
+   * @param generate_ptr The generate function of the table.
+   * @param worker [output] The worker, owned by the pool.
+   */
+  Status getWorker(const std::string& table_name,
+                   const std::string& mount_namespace_id,
+                   pid_t namespace_pid,
+                   std::chrono::milliseconds max_idle_time,
+                   TableGeneratePtr generate_ptr,
+                   LinuxTableContainerIPC*& worker);
+
+  void stopWorker(const std::string& table_name,
+                  const std::string& mount_namespace_id);
+
+  /// Stop the workers that did not get a job for at least idle_timeout.
+  void stopIdleWorkers(std::chrono::milliseconds idle_timeout);
+
+  void stopAllWorkers();
+
+  size_t size() const {
+    return workers_.size();
+  }
+
+ private:
+  struct Worker {
+    std::unique_ptr<LinuxTableContainerIPC> ipc;
+
+    /// When the worker was last handed out, before it got its last job.
+    std::chrono::steady_clock::time_point last_used;
+  };
+
+  PipeChannelFactory* factory_;
+  std::map<std::string, Worker> workers_;
+};
+
 inline bool hasNamespaceConstraint(const QueryContext& context) {
   return context.hasConstraint("pid_with_namespace");
 }
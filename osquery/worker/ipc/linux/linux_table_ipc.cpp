@@ -10,29 +10,37 @@
 #include "linux_table_ipc.h"
 
 namespace osquery {
-Status LinuxTableIPC::sendJSONString(const std::string& json_string) {
+Status LinuxTableIPC::sendMessage(const std::string& frame) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to write to");
   }
 
-  return active_channel_->sendStringMessage(json_string);
+  return active_channel_->sendStringMessage(frame);
 }
 
-Status LinuxTableIPC::recvJSONString(std::string& json_string) {
+Status LinuxTableIPC::recvMessage(std::string& frame) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to read from");
   }
 
-  return active_channel_->recvStringMessage(json_string);
+  return active_channel_->recvStringMessage(frame);
 }
 
-Status LinuxTableIPC::processLogMessage(const JSON& json_message) {
+bool LinuxTableIPC::waitForMessage(std::chrono::milliseconds timeout) {
+  if (active_channel_ == nullptr) {
+    return false;
+  }
+
+  return active_channel_->waitForMessage(timeout);
+}
+
+Status LinuxTableIPC::processLogMessage(const std::string& frame) {
   std::string message;
   int priority;
   int log_type_int;
 
-  auto status = TableIPCJSONConverter::JSONToLogMessage(
-      json_message, priority, log_type_int, message);
+  auto status = TableIPCBinaryConverter::binaryToLogMessage(
+      frame, priority, log_type_int, message);
 
   if (!status.ok())
     return status;
@@ -48,10 +56,10 @@ Status LinuxTableIPC::processLogMessage(const JSON& json_message) {
   return message_handler_->handleLog(log_type, priority, message);
 }
 
-Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
+Status LinuxTableIPC::processJobMessage(const std::string& frame) {
   QueryContext context;
 
-  auto status = deserializeQueryContextJSON(json_message, context);
+  auto status = TableIPCBinaryConverter::binaryToJob(frame, context);
   if (!status.ok()) {
     const std::string error_message =
         "Failed to deserialize the query context: " + status.getMessage();
@@ -61,10 +69,10 @@ Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
   return message_handler_->handleJob(context);
 }
 
-Status LinuxTableIPC::processQueryDataMessage(const JSON& json_message,
+Status LinuxTableIPC::processQueryDataMessage(const std::string& frame,
                                               QueryData& query_results) {
   auto status =
-      TableIPCJSONConverter::JSONToQueryData(json_message, query_results);
+      TableIPCBinaryConverter::binaryToQueryData(frame, query_results);
 
   if (!status.ok()) {
     return status;
@@ -107,6 +115,12 @@ void LinuxTableIPC::closeActiveChannel() {
   active_channel_ = nullptr;
 }
 
+void LinuxTableIPC::dropAllChannels() {
+  factory_->clear();
+
+  active_channel_ = nullptr;
+}
+
 std::string LinuxTableIPC::getTableNameFromPid(pid_t pid) {
   return factory_->getTableNameFromPid(pid);
 }
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include <osquery/worker/ipc/posix/pipe_channel.h>
 #include <osquery/worker/ipc/posix/pipe_channel_factory.h>
 
@@ -21,8 +23,8 @@ namespace osquery {
 
 /**
  * @brief The LinuxTableIPC class manages the communication and connection
- * between processes handling table logic, using JSON as message protocol and
- * blocking pipes as communication channel.
+ * between processes handling table logic, using binary frames as message
+ * protocol and blocking pipes as communication channel.
  *
  */
 class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
@@ -31,12 +33,15 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
                 TableIPCMessageHandler& message_handler)
       : factory_(&factory), message_handler_(&message_handler) {}
 
-  Status sendJSONString(const std::string& json_string);
-  Status recvJSONString(std::string& json_string);
+  Status sendMessage(const std::string& frame);
+  Status recvMessage(std::string& frame);
+
+  /// Wait for a message from the other end, false on timeout.
+  bool waitForMessage(std::chrono::milliseconds timeout);
 
-  Status processLogMessage(const JSON& json_message);
-  Status processJobMessage(const JSON& json_message);
-  Status processQueryDataMessage(const JSON& json_message,
+  Status processLogMessage(const std::string& frame);
+  Status processJobMessage(const std::string& frame);
+  Status processQueryDataMessage(const std::string& frame,
                                  QueryData& query_results);
 
   PipeChannelTicket createChannelTicket() {
@@ -50,6 +55,9 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
                        PipeChannelTicket channel_ticket);
   void closeActiveChannel();
 
+  /// Drop the channels inherited from the parent, such as in a new worker.
+  void dropAllChannels();
+
   std::string getTableNameFromPid(pid_t pid);
 
   bool isChannelOpen() {
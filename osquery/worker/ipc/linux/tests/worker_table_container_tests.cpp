@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/tables.h>
@@ -44,11 +46,12 @@ TEST_F(WorkerTableContainerTests, test_ipc_container_connect) {
 
   LinuxTableContainerIPC container_ipc(factory);
 
-  auto status = container_ipc.connectToContainer("test", false, genTest1);
-  ASSERT_TRUE(status.ok()) << status.getMessage();
-
   auto my_pid = getpid();
 
+  auto status = container_ipc.connectToContainer(
+      "test", my_pid, std::chrono::milliseconds(0), genTest1);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
   QueryContext context;
   context.constraints["pid_with_namespace"].add(
       Constraint(ConstraintOperator::EQUALS, std::to_string(my_pid)));
@@ -69,6 +72,58 @@ TEST_F(WorkerTableContainerTests, test_ipc_container_connect) {
   ASSERT_EQ(results[0].count("test"), 1);
   EXPECT_EQ(results[0]["test"], "Hello");
 
+  // The worker stays in the namespace and runs the next jobs too.
+  results.clear();
+  status = container_ipc.retrieveQueryDataFromContainer(context, results);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1);
+
   container_ipc.stopContainerWorker();
 }
+
+TEST_F(WorkerTableContainerTests, test_container_worker_pool) {
+  PipeChannelFactory factory;
+  ContainerWorkerPool pool(factory);
+
+  auto my_pid = getpid();
+
+  LinuxTableContainerIPC* worker = nullptr;
+  auto status = pool.getWorker(
+      "test", "1", my_pid, std::chrono::milliseconds(0), genTest1, worker);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_NE(worker, nullptr);
+
+  auto worker_pid = worker->getWorkerPid();
+
+  // The worker of a table in a namespace is reused.
+  LinuxTableContainerIPC* same_worker = nullptr;
+  status = pool.getWorker(
+      "test", "1", my_pid, std::chrono::milliseconds(0), genTest1, same_worker);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(same_worker, worker);
+  EXPECT_EQ(same_worker->getWorkerPid(), worker_pid);
+
+  LinuxTableContainerIPC* other_worker = nullptr;
+  status = pool.getWorker("test2",
+                          "1",
+                          my_pid,
+                          std::chrono::milliseconds(0),
+                          genTest1,
+                          other_worker);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_NE(other_worker, worker);
+  EXPECT_EQ(pool.size(), 2);
+
+  QueryContext context;
+  QueryData results;
+  status = worker->retrieveQueryDataFromContainer(context, results);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1);
+
+  pool.stopIdleWorkers(std::chrono::hours(1));
+  EXPECT_EQ(pool.size(), 2);
+
+  pool.stopIdleWorkers(std::chrono::milliseconds(0));
+  EXPECT_EQ(pool.size(), 0);
+}
 } // namespace osquery
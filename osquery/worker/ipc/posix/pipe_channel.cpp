@@ -9,10 +9,13 @@
 
 #include "pipe_channel.h"
 
+#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 
+#include <cerrno>
 #include <limits>
 
 namespace osquery {
@@ -30,37 +33,27 @@ Status PipeChannel::sendStringMessageImpl(const std::string& message) {
     return Status::failure("Cannot send a zero length message");
   }
 
-  if (message.size() > std::numeric_limits<ssize_t>::max()) {
+  if (message.size() >
+      std::numeric_limits<ssize_t>::max() - sizeof(ssize_t)) {
     return Status::failure("Cannot send, message too big, " +
                            std::to_string(message.size()) + " bytes");
   }
 
   const ssize_t message_size = static_cast<ssize_t>(message.size());
 
-  auto old_mask = blockSIGPIPE();
-
-  ssize_t result = write(write_pipe_fd,
-                         reinterpret_cast<const char*>(&message_size),
-                         sizeof(message_size));
+  // The size prefix and the message go out with a single system call.
+  struct iovec buffers[2];
+  buffers[0].iov_base = const_cast<ssize_t*>(&message_size);
+  buffers[0].iov_len = sizeof(message_size);
+  buffers[1].iov_base = const_cast<char*>(message.data());
+  buffers[1].iov_len = message.size();
 
-  if (result < 0) {
-    restoreSIGPIPE(old_mask);
-    return Status::failure(
-        errno,
-        "Failed to write the size of the message through the pipe of table " +
-            table_name_ + ", errno " + std::to_string(errno));
-  }
+  const ssize_t frame_size =
+      static_cast<ssize_t>(sizeof(message_size)) + message_size;
 
-  if (result != sizeof(message_size)) {
-    restoreSIGPIPE(old_mask);
-    return Status::failure(
-        "Failed to write the entire size of the message through the pipe of "
-        "table " +
-        table_name_ + ", sent only " + std::to_string(result) + "/" +
-        std::to_string(message_size) + " bytes");
-  }
+  auto old_mask = blockSIGPIPE();
 
-  result = write(write_pipe_fd, &message[0], static_cast<size_t>(message_size));
+  ssize_t result = writev(write_pipe_fd, buffers, 2);
 
   restoreSIGPIPE(old_mask);
 
@@ -71,11 +64,11 @@ Status PipeChannel::sendStringMessageImpl(const std::string& message) {
             ", errno " + std::to_string(errno));
   }
 
-  if (result != message_size) {
+  if (result != frame_size) {
     return Status::failure("Failed to send the entire message of table " +
                            table_name_ + ", sent only " +
                            std::to_string(result) + "/" +
-                           std::to_string(message_size));
+                           std::to_string(frame_size));
   }
 
   return Status::success();
@@ -136,6 +129,20 @@ Status PipeChannel::recvStringMessageImpl(std::string& message) {
   return Status::success();
 }
 
+bool PipeChannel::waitForMessageImpl(std::chrono::milliseconds timeout) {
+  struct pollfd read_poll_fd {
+    read_pipe_fd, POLLIN, 0
+  };
+
+  int result = 0;
+  do {
+    result = poll(&read_poll_fd, 1, static_cast<int>(timeout.count()));
+  } while (result < 0 && errno == EINTR);
+
+  // Errors are reported by the read that follows.
+  return result != 0;
+}
+
 sigset_t PipeChannel::blockSIGPIPE() {
   sigset_t new_mask;
   sigset_t old_mask;
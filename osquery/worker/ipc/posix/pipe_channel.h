@@ -38,6 +38,7 @@ class PipeChannel : public TableChannelBase<PipeChannel> {
 
   Status sendStringMessageImpl(const std::string& message);
   Status recvStringMessageImpl(std::string& message);
+  bool waitForMessageImpl(std::chrono::milliseconds timeout);
 
   sigset_t blockSIGPIPE();
   void restoreSIGPIPE(const sigset_t& old_mask);
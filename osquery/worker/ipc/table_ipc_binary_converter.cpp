@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_ipc_binary_converter.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <osquery/core/sql/binary_rows.h>
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+namespace {
+
+/// A Log frame holds the log type and the priority ahead of the message.
+const size_t kLogHeaderSize = 1 + sizeof(int32_t);
+
+void startFrame(TableIPCMessageType message_type, std::string& frame) {
+  frame.clear();
+  frame.push_back(static_cast<char>(message_type));
+}
+
+Status checkFrameType(const std::string& frame,
+                      TableIPCMessageType expected_type) {
+  TableIPCMessageType message_type;
+  auto status =
+      TableIPCBinaryConverter::binaryToMessageType(frame, message_type);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (message_type != expected_type) {
+    return Status::failure(
+        "Unexpected message type " +
+        std::to_string(static_cast<int>(message_type)) + ", expected " +
+        std::to_string(static_cast<int>(expected_type)));
+  }
+
+  return Status::success();
+}
+} // namespace
+
+Status TableIPCBinaryConverter::binaryToQueryData(const std::string& frame,
+                                                  QueryData& query_data) {
+  auto status = checkFrameType(frame, TableIPCMessageType::QueryData);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  return deserializeQueryDataBinary(frame.substr(1), query_data);
+}
+
+Status TableIPCBinaryConverter::queryDataToBinary(const QueryData& query_data,
+                                                  std::string& frame) {
+  std::string rows;
+  auto status = serializeQueryDataBinary(query_data, rows);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  startFrame(TableIPCMessageType::QueryData, frame);
+  frame.append(rows);
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::queryDataEndToBinary(std::string& frame) {
+  startFrame(TableIPCMessageType::QueryDataEnd, frame);
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::binaryToLogMessage(const std::string& frame,
+                                                   int& priority,
+                                                   int& log_type,
+                                                   std::string& message) {
+  auto status = checkFrameType(frame, TableIPCMessageType::Log);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (frame.size() < 1 + kLogHeaderSize) {
+    return Status::failure("Log message frame too short, it's " +
+                           std::to_string(frame.size()) + " bytes");
+  }
+
+  int32_t log_priority = 0;
+  std::memcpy(&log_priority, &frame[2], sizeof(log_priority));
+
+  log_type = static_cast<unsigned char>(frame[1]);
+  priority = log_priority;
+  message = frame.substr(1 + kLogHeaderSize);
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::logMessageToBinary(int priority,
+                                                   int log_type,
+                                                   const std::string& message,
+                                                   std::string& frame) {
+  if (log_type < 0 || log_type > 0xff) {
+    return Status::failure("Invalid log type " + std::to_string(log_type));
+  }
+
+  auto log_priority = static_cast<int32_t>(priority);
+
+  startFrame(TableIPCMessageType::Log, frame);
+  frame.reserve(1 + kLogHeaderSize + message.size());
+  frame.push_back(static_cast<char>(log_type));
+  frame.append(reinterpret_cast<const char*>(&log_priority),
+               sizeof(log_priority));
+  frame.append(message);
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::binaryToJob(const std::string& frame,
+                                            QueryContext& context) {
+  auto status = checkFrameType(frame, TableIPCMessageType::Job);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The query context is small next to the results, it stays in JSON.
+  JSON json_helper;
+  status = json_helper.fromString(frame.substr(1));
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  return deserializeQueryContextJSON(json_helper, context);
+}
+
+Status TableIPCBinaryConverter::jobToBinary(const QueryContext& context,
+                                            std::string& frame) {
+  JSON json_helper;
+  serializeQueryContextJSON(context, json_helper);
+
+  std::string json_string;
+  auto status = json_helper.toString(json_string);
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  startFrame(TableIPCMessageType::Job, frame);
+  frame.append(json_string);
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::binaryToMessageType(
+    const std::string& frame, TableIPCMessageType& message_type) {
+  message_type = TableIPCMessageType::None;
+
+  if (frame.empty()) {
+    return Status::failure("Empty message frame");
+  }
+
+  auto type = static_cast<TableIPCMessageType>(frame[0]);
+
+  switch (type) {
+  case TableIPCMessageType::QueryData:
+  case TableIPCMessageType::QueryDataEnd:
+  case TableIPCMessageType::Log:
+  case TableIPCMessageType::Job: {
+    message_type = type;
+    break;
+  }
+  default: {
+    return Status::failure("Unsupported message type: " +
+                           std::to_string(static_cast<int>(frame[0])));
+  }
+  }
+
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/core/tables.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+enum class TableIPCMessageType : char {
+  None = 0,
+  QueryData = 'd',
+  QueryDataEnd = 'e',
+  Log = 'l',
+  Job = 'j',
+};
+
+/**
+ * @brief Converts the messages exchanged with a table worker to and from
+ * binary frames.
+ *
+ * Each frame starts with its message type. The rows of a QueryData frame use
+ * the typed binary row encoding, with the column names written once per frame.
+ * The results of a job may span several QueryData frames and always end with
+ * a QueryDataEnd frame, so that a worker can send its rows as it goes.
+ */
+class TableIPCBinaryConverter {
+ public:
+  static Status binaryToQueryData(const std::string& frame,
+                                  QueryData& query_data);
+  static Status queryDataToBinary(const QueryData& query_data,
+                                  std::string& frame);
+  static Status queryDataEndToBinary(std::string& frame);
+  static Status binaryToLogMessage(const std::string& frame,
+                                   int& priority,
+                                   int& log_type,
+                                   std::string& message);
+  static Status logMessageToBinary(int priority,
+                                   int log_type,
+                                   const std::string& message,
+                                   std::string& frame);
+  static Status binaryToJob(const std::string& frame, QueryContext& context);
+  static Status jobToBinary(const QueryContext& context, std::string& frame);
+  static Status binaryToMessageType(const std::string& frame,
+                                    TableIPCMessageType& message_type);
+};
+} // namespace osquery
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/core/tables.h>
+#include <osquery/utils/status/status.h>
+#include <osquery/worker/ipc/table_ipc_base.h>
+
+namespace osquery {
+
+class TestTableIPC : public TableIPCBase<TestTableIPC> {
+ public:
+  Status sendMessage(const std::string& message) {
+    frame = message;
+    return Status::success();
+  }
+
+  Status recvMessage(std::string& message) {
+    message = frame;
+    return Status::success();
+  }
+
+  Status processQueryDataMessage(const std::string& message,
+                                 QueryData& query_results) {
+    return TableIPCBinaryConverter::binaryToQueryData(message, query_results);
+  }
+
+  Status processLogMessage(const std::string&) {
+    return Status::success();
+  }
+
+  Status processJobMessage(const std::string&) {
+    return Status::success();
+  }
+
+  std::string frame;
+};
+
+class WorkerBinaryConversionsTests : public testing::Test {};
+
+TEST_F(WorkerBinaryConversionsTests, test_querydata_and_binary_conversions) {
+  QueryData data;
+  Row r1;
+  r1["column1"] = "test";
+  r1["column2"] = "1";
+  data.push_back(r1);
+
+  Row r2;
+  r2["column1"] = "test2";
+  r2["column2"] = "02";
+  data.push_back(r2);
+
+  TestTableIPC ipc;
+  auto status = ipc.sendQueryData(data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  ASSERT_FALSE(ipc.frame.empty());
+  EXPECT_EQ(ipc.frame[0], static_cast<char>(TableIPCMessageType::QueryData));
+
+  TableIPCMessageType message_type;
+  std::string frame;
+  status = ipc.recvBinaryMessage(frame, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_TRUE(message_type == TableIPCMessageType::QueryData);
+
+  QueryData read_query_data;
+  status = TableIPCBinaryConverter::binaryToQueryData(frame, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  // Integers are read back as the same strings, others stay strings.
+  ASSERT_EQ(read_query_data.size(), 2);
+  EXPECT_EQ(read_query_data[0]["column1"], "test");
+  EXPECT_EQ(read_query_data[0]["column2"], "1");
+  EXPECT_EQ(read_query_data[1]["column1"], "test2");
+  EXPECT_EQ(read_query_data[1]["column2"], "02");
+
+  // The rows of each following message are appended.
+  status = TableIPCBinaryConverter::binaryToQueryData(frame, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(read_query_data.size(), 4);
+
+  // Try to read the message erroneously as a Log message
+  std::string message;
+  int priority;
+  int log_type_int;
+  status = TableIPCBinaryConverter::binaryToLogMessage(
+      frame, priority, log_type_int, message);
+
+  EXPECT_FALSE(status.ok()) << status.getMessage();
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_querydata_end_message) {
+  TestTableIPC ipc;
+  auto status = ipc.sendQueryDataEnd();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  ASSERT_EQ(ipc.frame.size(), 1);
+  EXPECT_EQ(ipc.frame[0],
+            static_cast<char>(TableIPCMessageType::QueryDataEnd));
+
+  QueryData results;
+  TableIPCMessageType message_type;
+  status = ipc.processOneMessage(&results, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(message_type == TableIPCMessageType::QueryDataEnd);
+  EXPECT_TRUE(results.empty());
+
+  // Only the side waiting for results expects the end of them.
+  status = ipc.processOneMessage(nullptr, message_type);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_log_message_and_binary_conversions) {
+  TestTableIPC ipc;
+  auto status =
+      ipc.sendLogMessage(1, GLOGLogType::VLOG, "This is a test message");
+
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  TableIPCMessageType message_type;
+  std::string frame;
+  status = ipc.recvBinaryMessage(frame, message_type);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(message_type == TableIPCMessageType::Log);
+
+  int priority = 0;
+  int log_type_int = 0;
+  std::string message;
+  status = TableIPCBinaryConverter::binaryToLogMessage(
+      frame, priority, log_type_int, message);
+
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  EXPECT_EQ(priority, 1);
+  EXPECT_EQ(log_type_int, static_cast<int>(GLOGLogType::VLOG));
+  EXPECT_EQ(message, "This is a test message");
+
+  // A truncated Log message is rejected.
+  frame.resize(3);
+  status = TableIPCBinaryConverter::binaryToLogMessage(
+      frame, priority, log_type_int, message);
+
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_job_and_binary_conversions) {
+  TestTableIPC ipc;
+  QueryContext context;
+
+  context.constraints["job_test_1"].add(Constraint(ConstraintOperator::EQUALS));
+  context.constraints["job_test_1"].add(
+      Constraint(ConstraintOperator::GREATER_THAN));
+  context.constraints["job_test_2"].add(Constraint(ConstraintOperator::LIKE));
+  context.constraints["job_test_2"].add(Constraint(ConstraintOperator::MATCH));
+
+  UsedColumns used_columns;
+  used_columns.emplace("job_test_1");
+  used_columns.emplace("job_test_2");
+  used_columns.emplace("job_test_3");
+  context.colsUsed = std::move(used_columns);
+
+  auto status = ipc.sendJob(context);
+
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  TableIPCMessageType message_type;
+  std::string frame;
+  status = ipc.recvBinaryMessage(frame, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_TRUE(message_type == TableIPCMessageType::Job);
+
+  QueryContext read_query_context;
+  status = TableIPCBinaryConverter::binaryToJob(frame, read_query_context);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  ASSERT_TRUE(read_query_context.colsUsed);
+
+  ASSERT_EQ(read_query_context.colsUsed->size(), 3);
+
+  ASSERT_EQ(read_query_context.colsUsed.get().count("job_test_1"), 1);
+  ASSERT_EQ(read_query_context.colsUsed.get().count("job_test_2"), 1);
+  ASSERT_EQ(read_query_context.colsUsed.get().count("job_test_3"), 1);
+
+  ASSERT_EQ(read_query_context.constraints.size(), 2);
+  ASSERT_EQ(read_query_context.constraints.count("job_test_1"), 1);
+  ASSERT_EQ(read_query_context.constraints.count("job_test_2"), 1);
+
+  ASSERT_TRUE(read_query_context.constraints["job_test_1"].exists(
+      ConstraintOperator::EQUALS));
+  ASSERT_TRUE(read_query_context.constraints["job_test_1"].exists(
+      ConstraintOperator::GREATER_THAN));
+  ASSERT_TRUE(read_query_context.constraints["job_test_2"].exists(
+      ConstraintOperator::LIKE));
+  ASSERT_TRUE(read_query_context.constraints["job_test_2"].exists(
+      ConstraintOperator::MATCH));
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_invalid_message_types) {
+  TableIPCMessageType message_type;
+  auto status = TableIPCBinaryConverter::binaryToMessageType("", message_type);
+  EXPECT_FALSE(status.ok());
+
+  status = TableIPCBinaryConverter::binaryToMessageType("{\"Type\": \"Log\"}",
+                                                        message_type);
+  EXPECT_FALSE(status.ok());
+  EXPECT_TRUE(message_type == TableIPCMessageType::None);
+}
+} // namespace osquery
@@ -44,6 +44,14 @@ std::atomic<bool> kRocksDBCorruptionIndicator{false};
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(RocksDBDatabasePlugin, "database", "rocksdb");
 
+/// Reads and removals in an events domain that was never written to succeed.
+static Status missingColumnFamily(const std::string& domain) {
+  if (isEventsDomain(domain)) {
+    return Status::success();
+  }
+  return Status(1, "Could not get column family for " + domain);
+}
+
 void GlogRocksDBLogger::Logv(const char* format, va_list ap) {
   // Convert RocksDB log to string and check if header or level-ed log.
   std::string log_line;
@@ -190,6 +198,15 @@ Status RocksDBDatabasePlugin::setUp() {
     return Status(1, "Cannot set permissions on RocksDB path: " + path_);
   }
 
+  {
+    WriteLock lock(events_handles_mutex_);
+    for (size_t i = 0; i < column_families_.size(); i++) {
+      if (isEventsDomain(column_families_[i].name)) {
+        events_handles_[column_families_[i].name] = handles_[i];
+      }
+    }
+  }
+
   for (const auto& cf_name : kDomains) {
     if (cf_name != kEvents) {
       auto compact_status = compactFiles(cf_name);
@@ -241,6 +258,18 @@ void RocksDBDatabasePlugin::tearDown() {
 
 void RocksDBDatabasePlugin::close() {
   WriteLock lock(close_mutex_);
+  {
+    // Handles of the events domains created while open are only kept here.
+    WriteLock events_lock(events_handles_mutex_);
+    for (const auto& it : events_handles_) {
+      if (std::find(handles_.begin(), handles_.end(), it.second) ==
+          handles_.end()) {
+        delete it.second;
+      }
+    }
+    events_handles_.clear();
+  }
+
   for (auto handle : handles_) {
     delete handle;
   }
@@ -297,11 +326,42 @@ rocksdb::ColumnFamilyHandle* RocksDBDatabasePlugin::getHandleForColumnFamily(
   size_t i = std::find(kDomains.begin(), kDomains.end(), cf) - kDomains.begin();
   if (i != kDomains.size()) {
     return handles_[i];
+  } else if (isEventsDomain(cf)) {
+    ReadLock lock(events_handles_mutex_);
+    auto it = events_handles_.find(cf);
+    return (it != events_handles_.end()) ? it->second : nullptr;
   } else {
     return nullptr;
   }
 }
 
+rocksdb::ColumnFamilyHandle*
+RocksDBDatabasePlugin::getOrCreateEventsColumnFamily(
+    const std::string& domain) {
+  auto handle = getHandleForColumnFamily(domain);
+  if (handle != nullptr || !isEventsDomain(domain) || getDB() == nullptr) {
+    return handle;
+  }
+
+  WriteLock lock(events_handles_mutex_);
+  auto it = events_handles_.find(domain);
+  if (it != events_handles_.end()) {
+    return it->second;
+  }
+
+  auto s = getDB()->CreateColumnFamily(options_, domain, &handle);
+  if (!s.ok()) {
+    LOG(ERROR) << "Cannot create column family " << domain << ": "
+               << s.ToString();
+    return nullptr;
+  }
+
+  // The database must be opened with every column family it contains.
+  column_families_.push_back(rocksdb::ColumnFamilyDescriptor(domain, options_));
+  events_handles_[domain] = handle;
+  return handle;
+}
+
 Status RocksDBDatabasePlugin::get(const std::string& domain,
                                   const std::string& key,
                                   std::string& value) const {
@@ -331,6 +391,47 @@ Status RocksDBDatabasePlugin::get(const std::string& domain,
   }
   return s;
 }
+Status RocksDBDatabasePlugin::getRange(const std::string& domain,
+                                       const std::string& low,
+                                       const std::string& high,
+                                       DatabaseStringValueList& values,
+                                       uint64_t max) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return missingColumnFamily(domain);
+  }
+
+  // A single forward pass, the range is usually read once and not cached.
+  auto options = rocksdb::ReadOptions();
+  options.verify_checksums = false;
+  options.fill_cache = false;
+  auto it = getDB()->NewIterator(options, cfh);
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  uint64_t count = 0;
+  for (it->Seek(low); it->Valid(); it->Next()) {
+    if (it->key().compare(high) > 0) {
+      break;
+    }
+
+    values.push_back(
+        std::make_pair(it->key().ToString(), it->value().ToString()));
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+
+  auto s = it->status();
+  delete it;
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::put(const std::string& domain,
                                   const std::string& key,
                                   const std::string& value) {
@@ -338,12 +439,12 @@ Status RocksDBDatabasePlugin::put(const std::string& domain,
 }
 
 inline bool skipWal(const std::string& domain) {
-  return (kEvents == domain);
+  return (kEvents == domain) || isEventsDomain(domain);
 }
 
 Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
                                        const DatabaseStringValueList& data) {
-  auto cfh = getHandleForColumnFamily(domain);
+  auto cfh = getOrCreateEventsColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
@@ -388,7 +489,7 @@ Status RocksDBDatabasePlugin::remove(const std::string& domain,
                                      const std::string& key) {
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
-    return Status(1, "Could not get column family for " + domain);
+    return missingColumnFamily(domain);
   }
   auto options = rocksdb::WriteOptions();
 
@@ -403,6 +504,30 @@ Status RocksDBDatabasePlugin::remove(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
+Status RocksDBDatabasePlugin::removeBatch(
+    const std::string& domain, const std::vector<std::string>& keys) {
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return missingColumnFamily(domain);
+  }
+  auto options = rocksdb::WriteOptions();
+
+  // A single write applies every tombstone, see the note in remove.
+  if (skipWal(domain)) {
+    options.disableWAL = true;
+  } else {
+    options.sync = false;
+  }
+
+  rocksdb::WriteBatch batch;
+  for (const auto& key : keys) {
+    batch.Delete(cfh, key);
+  }
+
+  auto s = getDB()->Write(options, &batch);
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
                                           const std::string& low,
                                           const std::string& high) {
@@ -414,7 +539,7 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
 
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
-    return Status(1, "Could not get column family for " + domain);
+    return missingColumnFamily(domain);
   }
   auto options = rocksdb::WriteOptions();
 
@@ -442,7 +567,7 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
 
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
-    return Status(1, "Could not get column family for " + domain);
+    return missingColumnFamily(domain);
   }
   auto options = rocksdb::ReadOptions();
   options.verify_checksums = false;
@@ -452,14 +577,17 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
     return Status(1, "Could not get iterator for " + domain);
   }
 
+  // Keys are sorted, matching keys start at the prefix and are contiguous.
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+  for (it->Seek(prefix); it->Valid(); it->Next()) {
     auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+    if (key.compare(0, prefix.size(), prefix) != 0) {
+      break;
+    }
+
+    results.push_back(std::move(key));
+    if (max > 0 && ++count >= max) {
+      break;
     }
   }
   delete it;
@@ -8,6 +8,7 @@
  */
 
 #include <atomic>
+#include <map>
 
 #include <rocksdb/db.h>
 
@@ -45,6 +46,13 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
              const std::string& key,
              int& value) const override;
 
+  /// Data range retrieval method.
+  Status getRange(const std::string& domain,
+                  const std::string& low,
+                  const std::string& high,
+                  DatabaseStringValueList& values,
+                  uint64_t max) const override;
+
   /// Data storage method.
   Status put(const std::string& domain,
              const std::string& key,
@@ -60,6 +68,10 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Data batch removal method.
+  Status removeBatch(const std::string& domain,
+                     const std::vector<std::string>& keys) override;
+
   /// Data range removal method.
   Status removeRange(const std::string& domain,
                      const std::string& low,
@@ -94,6 +106,15 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   rocksdb::ColumnFamilyHandle* getHandleForColumnFamily(
       const std::string& cf) const;
 
+  /**
+   * @brief Get the column family of a subscriber's events domain.
+   *
+   * The column family is created if it does not exist yet. It is only
+   * created on writes, a missing events domain is read as empty.
+   */
+  rocksdb::ColumnFamilyHandle* getOrCreateEventsColumnFamily(
+      const std::string& domain);
+
   /**
    * @brief Helper method which can be used to get a raw pointer to the
    * underlying RocksDB database handle
@@ -142,6 +163,12 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// A vector of pointers to column family handles
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
 
+  /// The handles of the events domains, also owned by handles_.
+  std::map<std::string, rocksdb::ColumnFamilyHandle*> events_handles_;
+
+  /// Protects the events domain handles created after the database opened.
+  mutable Mutex events_handles_mutex_;
+
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
@@ -152,5 +179,6 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
   FRIEND_TEST(RocksDBDatabasePluginTests, test_column_families_rollback);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_events_column_families);
 };
 } // namespace osquery
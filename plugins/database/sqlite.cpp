@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <sqlite3.h>
@@ -31,6 +32,11 @@ const std::map<std::string, std::string> kDBSettings = {
     {"page_count", "1000"},
 };
 
+/// Domains are tables, the names of the events domains contain dots.
+static std::string quoteDomain(const std::string& domain) {
+  return "\"" + domain + "\"";
+}
+
 Status SQLiteDatabasePlugin::setUp() {
   if (!allowOpen()) {
     LOG(WARNING) << RLOG(1629) << "Not allowed to set up database plugin";
@@ -65,7 +71,7 @@ Status SQLiteDatabasePlugin::setUp() {
   }
 
   for (const auto& domain : kDomains) {
-    std::string q = "create table if not exists " + domain +
+    std::string q = "create table if not exists " + quoteDomain(domain) +
                     " (key TEXT PRIMARY KEY, value TEXT);";
     result = sqlite3_exec(db_, q.c_str(), nullptr, nullptr, nullptr);
     if (result != SQLITE_OK) {
@@ -94,6 +100,29 @@ void SQLiteDatabasePlugin::close() {
     sqlite3_close(db_);
     db_ = nullptr;
   }
+
+  WriteLock domains_lock(events_domains_mutex_);
+  events_domains_.clear();
+}
+
+void SQLiteDatabasePlugin::createEventsDomain(const std::string& domain) const {
+  if (!isEventsDomain(domain)) {
+    return;
+  }
+
+  {
+    ReadLock lock(events_domains_mutex_);
+    if (events_domains_.count(domain) > 0) {
+      return;
+    }
+  }
+
+  WriteLock lock(events_domains_mutex_);
+  std::string q = "create table if not exists " + quoteDomain(domain) +
+                  " (key TEXT PRIMARY KEY, value TEXT);";
+  if (sqlite3_exec(db_, q.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK) {
+    events_domains_.insert(domain);
+  }
 }
 
 static int getData(void* argument, int argc, char* argv[], char* column[]) {
@@ -115,20 +144,25 @@ static int getData(void* argument, int argc, char* argv[], char* column[]) {
 Status SQLiteDatabasePlugin::get(const std::string& domain,
                                  const std::string& key,
                                  std::string& value) const {
-  QueryData results;
-  char* err = nullptr;
-  std::string q = "select value from " + domain + " where key = '" + key + "';";
-  sqlite3_exec(db_, q.c_str(), getData, &results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
-  }
+  sqlite3_stmt* stmt = nullptr;
+  createEventsDomain(domain);
+  std::string q =
+      "select value from " + quoteDomain(domain) + " where key = ?1;";
+  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
 
   // Only assign value if the query found a result.
-  if (results.size() > 0) {
-    value = std::move(results[0]["value"]);
-    return Status(0);
+  // Values are read by length, binary encoded rows may contain NUL bytes.
+  Status status(1);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto data = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+    auto size = static_cast<size_t>(sqlite3_column_bytes(stmt, 0));
+    value = (data != nullptr) ? std::string(data, size) : "";
+    status = Status(0);
   }
-  return Status(1);
+
+  sqlite3_finalize(stmt);
+  return status;
 }
 
 Status SQLiteDatabasePlugin::get(const std::string& domain,
@@ -147,6 +181,39 @@ Status SQLiteDatabasePlugin::get(const std::string& domain,
   return s;
 }
 
+Status SQLiteDatabasePlugin::getRange(const std::string& domain,
+                                      const std::string& low,
+                                      const std::string& high,
+                                      DatabaseStringValueList& values,
+                                      uint64_t max) const {
+  sqlite3_stmt* stmt = nullptr;
+  createEventsDomain(domain);
+  std::string q = "select key, value from " + quoteDomain(domain) +
+                  " where key >= ?1 and key <= ?2 order by key";
+  if (max > 0) {
+    q += " limit " + std::to_string(max);
+  }
+  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+  sqlite3_bind_text(
+      stmt, 1, low.c_str(), static_cast<int>(low.size()), SQLITE_STATIC);
+  sqlite3_bind_text(
+      stmt, 2, high.c_str(), static_cast<int>(high.size()), SQLITE_STATIC);
+
+  int rc = SQLITE_ROW;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto key = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+    auto value = static_cast<const char*>(sqlite3_column_blob(stmt, 1));
+    values.push_back(std::make_pair(
+        std::string(key != nullptr ? key : "",
+                    static_cast<size_t>(sqlite3_column_bytes(stmt, 0))),
+        std::string(value != nullptr ? value : "",
+                    static_cast<size_t>(sqlite3_column_bytes(stmt, 1)))));
+  }
+
+  sqlite3_finalize(stmt);
+  return (rc == SQLITE_DONE) ? Status(0) : Status(1, "Cannot read range");
+}
+
 static void tryVacuum(sqlite3* db) {
   std::string q =
       "SELECT (sum(s1.pageno + 1 == s2.pageno) * 1.0 / count(*)) < 0.01 as v "
@@ -177,8 +244,9 @@ Status SQLiteDatabasePlugin::put(const std::string& domain,
 Status SQLiteDatabasePlugin::putBatch(const std::string& domain,
                                       const DatabaseStringValueList& data) {
   // Prepare the query, adding placeholders for all the rows we have in `data`
+  createEventsDomain(domain);
   std::stringstream buffer;
-  buffer << "insert or replace into " + domain + " values ";
+  buffer << "insert or replace into " + quoteDomain(domain) + " values ";
 
   for (auto i = 1U; i <= data.size(); i++) {
     auto index = i * 2;
@@ -205,7 +273,11 @@ Status SQLiteDatabasePlugin::putBatch(const std::string& domain,
       const auto& value = p.second;
 
       sqlite3_bind_text(stmt, i, key.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, i + 1, value.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_text(stmt,
+                        i + 1,
+                        value.data(),
+                        static_cast<int>(value.size()),
+                        SQLITE_STATIC);
 
       i += 2;
     }
@@ -227,7 +299,8 @@ Status SQLiteDatabasePlugin::putBatch(const std::string& domain,
 Status SQLiteDatabasePlugin::remove(const std::string& domain,
                                     const std::string& key) {
   sqlite3_stmt* stmt = nullptr;
-  std::string q = "delete from " + domain + " where key IN (?1);";
+  createEventsDomain(domain);
+  std::string q = "delete from " + quoteDomain(domain) + " where key IN (?1);";
   sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
 
   sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
@@ -243,6 +316,46 @@ Status SQLiteDatabasePlugin::remove(const std::string& domain,
   return Status(0);
 }
 
+Status SQLiteDatabasePlugin::removeBatch(
+    const std::string& domain, const std::vector<std::string>& keys) {
+  createEventsDomain(domain);
+
+  // Stay below the default limit of bound parameters per statement.
+  const size_t kMaxBatchParameters = 500;
+
+  for (size_t offset = 0; offset < keys.size();
+       offset += kMaxBatchParameters) {
+    auto count = std::min(kMaxBatchParameters, keys.size() - offset);
+
+    std::stringstream buffer;
+    buffer << "delete from " << quoteDomain(domain) << " where key IN (";
+    for (size_t i = 1; i <= count; i++) {
+      buffer << "?" << i << ((i < count) ? ", " : ");");
+    }
+
+    const auto& q = buffer.str();
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+
+    for (size_t i = 0; i < count; i++) {
+      const auto& key = keys[offset + i];
+      sqlite3_bind_text(
+          stmt, static_cast<int>(i + 1), key.c_str(), -1, SQLITE_STATIC);
+    }
+
+    auto rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+      return Status(1);
+    }
+  }
+
+  if (rand() % 10 == 0) {
+    tryVacuum(db_);
+  }
+  return Status(0);
+}
+
 Status SQLiteDatabasePlugin::removeRange(const std::string& domain,
                                          const std::string& low,
                                          const std::string& high) {
@@ -251,11 +364,15 @@ Status SQLiteDatabasePlugin::removeRange(const std::string& domain,
   }
 
   sqlite3_stmt* stmt = nullptr;
-  std::string q = "delete from " + domain + " where key >= ?1 and key <= ?2;";
+  createEventsDomain(domain);
+  std::string q = "delete from " + quoteDomain(domain) +
+                  " where key >= ?1 and key <= ?2;";
   sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
 
-  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, high.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(
+      stmt, 1, low.c_str(), static_cast<int>(low.size()), SQLITE_STATIC);
+  sqlite3_bind_text(
+      stmt, 2, high.c_str(), static_cast<int>(high.size()), SQLITE_STATIC);
   auto rc = sqlite3_step(stmt);
   if (rc != SQLITE_DONE) {
     return Status(1);
@@ -275,8 +392,9 @@ Status SQLiteDatabasePlugin::scan(const std::string& domain,
   QueryData _results;
   char* err = nullptr;
 
-  std::string q =
-      "select key from " + domain + " where key LIKE '" + prefix + "%'";
+  createEventsDomain(domain);
+  std::string q = "select key from " + quoteDomain(domain) +
+                  " where key LIKE '" + prefix + "%'";
   if (max > 0) {
     q += " limit " + std::to_string(max);
   }
@@ -8,6 +8,7 @@
  */
 
 #include <mutex>
+#include <set>
 
 #include <sqlite3.h>
 
@@ -30,6 +31,13 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
              const std::string& key,
              int& value) const override;
 
+  /// Data range retrieval method.
+  Status getRange(const std::string& domain,
+                  const std::string& low,
+                  const std::string& high,
+                  DatabaseStringValueList& values,
+                  uint64_t max) const override;
+
   /// Data storage method.
   Status put(const std::string& domain,
              const std::string& key,
@@ -44,6 +52,10 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Data batch removal method.
+  Status removeBatch(const std::string& domain,
+                     const std::vector<std::string>& keys) override;
+
   /// Data range removal method.
   Status removeRange(const std::string& domain,
                      const std::string& low,
@@ -72,12 +84,19 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
  private:
   void close();
 
+  /// Create the table of a subscriber's events domain on first use.
+  void createEventsDomain(const std::string& domain) const;
+
  private:
   /// The long-lived sqlite3 database.
   sqlite3* db_{nullptr};
 
   /// Deconstruction mutex.
   Mutex close_mutex_;
+
+  /// The events domains with a table.
+  mutable std::set<std::string> events_domains_;
+  mutable Mutex events_domains_mutex_;
 };
 
 /// Backing-storage provider for osquery internal/core.
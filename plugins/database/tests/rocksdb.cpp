@@ -94,4 +94,42 @@ TEST_F(RocksDBDatabasePluginTests, test_column_families_rollback) {
   ASSERT_TRUE(s.ok()) << s.getMessage();
   db2.tearDown();
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_events_column_families) {
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_events_column_families.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  db_dirs_.push_back(test_db_path);
+
+  // A subscriber's events domain is a column family created on first write.
+  const auto domain = kEventsDomainPrefix + "publisher.subscriber";
+  EXPECT_EQ(db.getHandleForColumnFamily(domain), nullptr);
+  s = db.put(domain, "key", "value");
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_NE(db.getHandleForColumnFamily(domain), nullptr);
+
+  // The database is reopened with the column family.
+  db.tearDown();
+  s = db.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db.tearDown();
+
+  auto db2 = RocksDBDatabasePlugin();
+  s = db2.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  std::string value;
+  s = db2.get(domain, "key", value);
+  EXPECT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(value, "value");
+  db2.tearDown();
+}
 } // namespace osquery
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_sql_pool
+// Spec file: specs/utility/osquery_sql_pool.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osquerySQLPool : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osquerySQLPool, test_sanity) {
+  auto const data = execute_query("select * from osquery_sql_pool");
+  ASSERT_EQ(data.size(), 1ul);
+  ValidationMap row_map = {
+      {"size", NonNegativeInt},
+      {"idle", NonNegativeInt},
+      {"in_use", NonNegativeInt},
+      {"checkouts", NonNegativeInt},
+      {"created", NonNegativeInt},
+      {"overflows", NonNegativeInt},
+      {"invalidations", NonNegativeInt},
+      {"waits", NonNegativeInt},
+      {"wait_time", NonNegativeInt},
+      {"max_wait_time", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_table_cache
+// Spec file: specs/utility/osquery_table_cache.table
+
+#include <osquery/core/flags.h>
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+
+DECLARE_string(table_cache_ttls);
+
+namespace table_tests {
+
+class osqueryTableCache : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryTableCache, test_sanity) {
+  auto backup_ttls = FLAGS_table_cache_ttls;
+  FLAGS_table_cache_ttls = "time:60";
+
+  execute_query("select * from time");
+  execute_query("select * from time");
+  auto const data = execute_query(
+      "select * from osquery_table_cache where table_name = 'time'");
+  FLAGS_table_cache_ttls = backup_ttls;
+
+  ASSERT_EQ(data.size(), 1ul);
+  ValidationMap row_map = {
+      {"table_name", NormalType},
+      {"ttl", NonNegativeInt},
+      {"entries", NonNegativeInt},
+      {"bytes", NonNegativeInt},
+      {"hits", NonNegativeInt},
+      {"misses", NonNegativeInt},
+      {"evictions", NonNegativeInt},
+      {"expirations", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+
+  EXPECT_EQ(data[0].at("ttl"), "60");
+  EXPECT_EQ(data[0].at("entries"), "1");
+  EXPECT_EQ(data[0].at("hits"), "1");
+  EXPECT_EQ(data[0].at("misses"), "1");
+}
+
+} // namespace table_tests
+} // namespace osquery
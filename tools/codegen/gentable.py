@@ -101,6 +101,7 @@ TABLE_ATTRIBUTES = {
     "cacheable": "CACHEABLE",
     "utility": "UTILITY",
     "kernel_required": "KERNEL_REQUIRED", # Deprecated
+    "batched_in": "BATCHED_IN",
 }
 
 WINDOWS = ['windows', 'win32', 'cygwin']
@@ -201,6 +202,7 @@ class TableState(Singleton):
         self.class_name = ""
         self.description = ""
         self.attributes = {}
+        self.planner_hints = {}
         self.examples = []
         self.notes = ""
         self.aliases = []
@@ -244,12 +246,17 @@ class TableState(Singleton):
                         "Table %s column %s contains an unknown option: %s" % (
                             self.table_name, column.name, option)))
             column.options_set = " | ".join(column_options)
+            # Columns from another platform's extended schema are always NULL.
+            column.unavailable = (len(column.platforms) > 0 and
+                                  PLATFORM not in column.platforms)
             if len(column.aliases) > 0:
                 self.has_column_aliases = True
         if len(all_options) > 0:
             self.has_options = True
         if "event_subscriber" in self.attributes:
             self.generator = True
+        # The typed row header is generated for every spec, this attribute
+        # only makes the implementation return it instead of QueryData.
         if "strongly_typed_rows" in self.attributes:
             self.strongly_typed_rows = True
         if "cacheable" in self.attributes:
@@ -286,11 +293,13 @@ class TableState(Singleton):
             table_name_cc=to_camel_case(self.table_name),
             table_name_ucc=to_upper_camel_case(self.table_name),
             schema=self.columns(),
+            column_count=len(self.columns()),
             header=self.header,
             impl=self.impl,
             function=self.function,
             class_name=self.class_name,
             attributes=self.attributes,
+            planner_hints=self.planner_hints,
             examples=self.examples,
             aliases=self.aliases,
             has_options=self.has_options,
@@ -348,6 +357,7 @@ def table_name(name, aliases=[]):
     table.table_name = name
     table.description = ""
     table.attributes = {}
+    table.planner_hints = {}
     table.examples = []
     table.notes = ""
     table.aliases = aliases
@@ -405,6 +415,14 @@ def attributes(**kwargs):
         table.attributes[attr] = kwargs[attr]
 
 
+def planner_hints(rows=0, cost=0):
+    """
+    estimate the rows returned by an unconstrained scan, and the microseconds
+    spent generating each row, used to order scans until costs are observed
+    """
+    table.planner_hints = {"rows": int(rows), "cost": int(cost)}
+
+
 def fuzz_paths(paths):
     table.fuzz_paths = paths
 
@@ -169,28 +169,34 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         content_len = int(self.headers.get("content-length", 0))
 
         body = self.rfile.read(content_len)
-        request = json.loads(body)
+        path, _, query = self.path.partition("?")
+        if self.headers.get("content-type") == "application/octet-stream":
+            # Binary carve blocks carry their identifiers in the query string
+            request = {k: v[0] for k, v in parse_qs(query).items()}
+            request["data"] = body
+        else:
+            request = json.loads(body)
 
-        # This contains a base64 encoded block of a file printing to the screen
+        # This contains a block of a file printing to the screen
         # slows down carving and makes scroll back a pain
-        if self.path != "/carve_block":
+        if path != "/carve_block":
             debug("Request: %s" % str(request))
 
-        if self.path == "/enroll":
+        if path == "/enroll":
             self.enroll(request)
-        elif self.path == "/config":
+        elif path == "/config":
             self.config(request)
-        elif self.path == "/log":
+        elif path == "/log":
             self.log(request)
-        elif self.path == "/distributed_read":
+        elif path == "/distributed_read":
             self.distributed_read(request)
-        elif self.path == "/distributed_write":
+        elif path == "/distributed_write":
             self.distributed_write(request)
-        elif self.path == "/test_read_requests":
+        elif path == "/test_read_requests":
             self.test_read_requests()
-        elif self.path == "/carve_init":
+        elif path == "/carve_init":
             self.start_carve(request)
-        elif self.path == "/carve_block":
+        elif path == "/carve_block":
             self.continue_carve(request)
         else:
             self._reply(TEST_POST_RESPONSE)
@@ -289,57 +295,53 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         }
 
         # Lastly we let the agent know that the carve is good to start,
-        # and send the session id back
-        self._reply({"session_id": sid})
+        # and send the session id back. Blocks may be posted as raw bytes
+        # when the agent offers to.
+        self._reply(
+            {
+                "session_id": sid,
+                "binary_blocks": bool(request.get("binary_blocks", False)),
+            }
+        )
 
     # Endpoint where the blocks of the carve are received, and
-    # susequently reassembled.
+    # susequently reassembled. Blocks may arrive in any order.
     def continue_carve(self, request):
+        carve = FILE_CARVE_MAP[request["session_id"]]
+        block_id = int(request["block_id"])
+        data = request["data"]
+        if not isinstance(data, bytes):
+            data = base64.standard_b64decode(data)
+
         # First check if we have already received this block
-        if (
-            request["block_id"]
-            in FILE_CARVE_MAP[request["session_id"]]["blocks_received"]
-        ):
+        if not carve or block_id in carve["blocks_received"]:
+            self._reply({})
             return
 
         # Store block data to be reassembled later
-        FILE_CARVE_MAP[request["session_id"]]["blocks_received"][
-            int(request["block_id"])
-        ] = request["data"]
+        carve["blocks_received"][block_id] = data
 
         # Are we expecting to receive more blocks?
-        if (
-            len(FILE_CARVE_MAP[request["session_id"]]["blocks_received"])
-            < FILE_CARVE_MAP[request["session_id"]]["block_count"]
-        ):
+        if len(carve["blocks_received"]) < carve["block_count"]:
+            self._reply({})
             return
 
         # If not, let's reassemble everything
-        out_file_name = (
-            FILE_CARVE_DIR + FILE_CARVE_MAP[request["session_id"]]["carve_guid"]
-        )
+        out_file_name = FILE_CARVE_DIR + carve["carve_guid"]
 
         # Check the first four bytes for the zstd header. If not no
         # compression was used, it's an uncompressed .tar
-        if (
-            base64.standard_b64decode(
-                FILE_CARVE_MAP[request["session_id"]]["blocks_received"][0]
-            )[0:4]
-            == b"\x28\xB5\x2F\xFD"
-        ):
+        if carve["blocks_received"][0][0:4] == b"\x28\xB5\x2F\xFD":
             out_file_name += ".zst"
         else:
             out_file_name += ".tar"
         f = open(out_file_name, "wb")
-        for x in range(0, FILE_CARVE_MAP[request["session_id"]]["block_count"]):
-            f.write(
-                base64.standard_b64decode(
-                    FILE_CARVE_MAP[request["session_id"]]["blocks_received"][x]
-                )
-            )
+        for x in range(0, carve["block_count"]):
+            f.write(carve["blocks_received"][x])
         f.close()
         debug("File successfully carved to: %s" % out_file_name)
         FILE_CARVE_MAP[request["session_id"]] = {}
+        self._reply({})
 
     def _push_request(self, command, request):
         # Archive the http command and the request body so that unit tests